@@ -14,6 +14,7 @@
 #include "ff_rules.h"
 #include "ff_ruleshape.h"
 #include "ff_bleu.h"
+#include "ff_forest_bleu.h"
 #include "ff_soft_syntax.h"
 #include "ff_soft_syntax_mindist.h"
 #include "ff_source_path.h"
@@ -40,6 +41,7 @@ void register_feature_functions() {
   RegisterFF<SourceWordPenalty>();
   RegisterFF<ArityPenalty>();
   RegisterFF<BLEUModel>();
+  ff_registry.Register("ForestBLEU", new FFFactory<ForestBLEU>());
   RegisterFF<LexicalFeatures>();
 
   //TODO: use for all features the new Register which requires static FF::usage(false,false) give name
@@ -0,0 +1,70 @@
+#ifndef FF_CACHE_H_
+#define FF_CACHE_H_
+
+#include <pthread.h>
+#include <cstddef>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; using std::tr1::hash; }
+#endif
+
+// memo table of a feature function, e.g. from a rule (or a word) to the
+// features it fires. Feature functions fill these from their const scoring
+// methods, so lookups share a read lock and only an insertion takes the
+// write lock (the same scheme as Dict), and the table is emptied when it
+// reaches its capacity, so its memory stays bounded over a whole run.
+// Tables keyed by TRule pointers must still be cleared in PrepareForInput,
+// since the rules of one sentence may be freed and their addresses reused.
+template <typename Key, typename Value, typename Hash = std::hash<Key> >
+class FeatureCache {
+ public:
+  explicit FeatureCache(size_t capacity = 1000000) : capacity_(capacity) {
+    pthread_rwlock_init(&lock_, NULL);
+  }
+  ~FeatureCache() { pthread_rwlock_destroy(&lock_); }
+
+  // copies the value of key to *value, if it is in the table
+  bool Find(const Key& key, Value* value) const {
+    pthread_rwlock_rdlock(&lock_);
+    typename Map::const_iterator it = map_.find(key);
+    const bool found = it != map_.end();
+    if (found) *value = it->second;
+    pthread_rwlock_unlock(&lock_);
+    return found;
+  }
+
+  // if two threads compute the value of the same key, the first one is kept
+  // (both computed the same value)
+  void Insert(const Key& key, const Value& value) {
+    pthread_rwlock_wrlock(&lock_);
+    if (map_.size() >= capacity_) map_.clear();
+    map_.insert(std::make_pair(key, value));
+    pthread_rwlock_unlock(&lock_);
+  }
+
+  void Clear() {
+    pthread_rwlock_wrlock(&lock_);
+    map_.clear();
+    pthread_rwlock_unlock(&lock_);
+  }
+
+  size_t Size() const {
+    pthread_rwlock_rdlock(&lock_);
+    const size_t size = map_.size();
+    pthread_rwlock_unlock(&lock_);
+    return size;
+  }
+
+ private:
+  typedef std::unordered_map<Key, Value, Hash> Map;
+  FeatureCache(const FeatureCache&);
+  void operator=(const FeatureCache&);
+
+  Map map_;
+  const size_t capacity_;
+  mutable pthread_rwlock_t lock_;
+};
+
+#endif
@@ -29,14 +29,13 @@ void NonLatinCount::TraversalFeaturesImpl(const SentenceMetadata& smeta,
   int count = 0;
   for (int i = 0; i < e.size(); ++i) {
     if (e[i] > 0) {
-      map<WordID, bool>::iterator it = is_non_latin_.find(e[i]);
-      if (it == is_non_latin_.end()) {
-        if ((is_non_latin_[e[i]] = ContainsNonLatin(TD::Convert(e[i]))))
-          ++count;
-      } else {
-        if (it->second)
-          ++count;
+      bool is_non_latin;
+      if (!is_non_latin_.Find(e[i], &is_non_latin)) {
+        is_non_latin = ContainsNonLatin(TD::Convert(e[i]));
+        is_non_latin_.Insert(e[i], is_non_latin);
       }
+      if (is_non_latin)
+        ++count;
     }
   }
   if (count) features->set_value(fid_, count);
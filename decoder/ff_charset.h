@@ -2,8 +2,8 @@
 #define _FFCHARSET_H_
 
 #include <string>
-#include <map>
 #include "ff.h"
+#include "ff_cache.h"
 #include "hg.h"
 
 class SentenceMetadata;
@@ -19,7 +19,7 @@ class NonLatinCount : public FeatureFunction {
                                      SparseVector<double>* estimated_features,
                                      void* context) const;
  private:
-  mutable std::map<WordID, bool> is_non_latin_;
+  mutable FeatureCache<WordID, bool> is_non_latin_;
   const int fid_;
 };
 
@@ -0,0 +1,182 @@
+#include "ff_forest_bleu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+#include <boost/lexical_cast.hpp>
+
+#include "fdict.h"
+#include "hg.h"
+#include "lattice.h"
+#include "sentence_metadata.h"
+#include "stringlib.h"
+
+using namespace std;
+
+namespace {
+  // separates the left and right context words of a long antecedent; no
+  // n-gram may span it (terminals are always > 0)
+  const WordID kGAP = 0;
+
+  int ParseOrder(const string& param) {
+    vector<string> argv;
+    int argc = SplitOnWhitespace(param, &argv);
+    int order = 4;
+    if (argc >= 1) {
+      if (argv[0] != "-o" || argc < 2) {
+        cerr << ForestBLEU::usage(true, true) << "\nyou provided: " << param << endl;
+        abort();
+      }
+      order = boost::lexical_cast<int>(argv[1]);
+    }
+    if (order < 1 || order > 127) {
+      cerr << "ForestBLEU: bad order " << order << endl;
+      abort();
+    }
+    return order;
+  }
+}
+
+string ForestBLEU::usage(bool param, bool verbose) {
+  return usage_helper("ForestBLEU", "[-o N]",
+    "Fires the edge-local BLEU statistics (target length and number of reference n-gram matches of each order, default 4) used for linear BLEU hope/fear search over a forest. The references are taken from the sentence metadata or set with SetReferences; clipping is not applied.",
+    param, verbose);
+}
+
+ForestBLEU::ForestBLEU(const string& param) :
+    order_(ParseOrder(param)),
+    ctx_(order_ - 1),
+    fid_len_(FD::Convert("ForestBLEU_len")),
+    fid_match_(order_) {
+  for (int n = 1; n <= order_; ++n) {
+    ostringstream os;
+    os << "ForestBLEU_match" << n;
+    fid_match_[n - 1] = FD::Convert(os.str());
+  }
+  // left and right context words, followed by the number of each
+  SetStateSize(2 * ctx_ * sizeof(WordID) + 2);
+  refs_.Init(vector<vector<WordID> >(), order_);
+}
+
+void ForestBLEU::SetReferences(const vector<vector<WordID> >& refs) {
+  refs_.Init(refs, order_);
+  rule2matches_.clear();
+}
+
+void ForestBLEU::PrepareForInput(const SentenceMetadata& smeta) {
+  if (!smeta.HasReference()) return;
+  const Lattice& ref = smeta.GetReference();
+  vector<vector<WordID> > refs(1);
+  for (unsigned i = 0; i < ref.size(); ++i) {
+    assert(ref[i].size() == 1);
+    refs[0].push_back(ref[i][0].label);
+  }
+  SetReferences(refs);
+}
+
+// theta_0 = -1, theta_n = 1 / (N * p * r^(n-1)), Tromble et al. (2008)
+void ForestBLEU::AddLinearBLEUWeights(double scale, double p, double r, SparseVector<double>* weights) const {
+  weights->add_value(fid_len_, -scale);
+  for (int n = 1; n <= order_; ++n)
+    weights->add_value(fid_match_[n - 1], scale / (order_ * p * pow(r, n - 1)));
+}
+
+void ForestBLEU::RemoveFeatures(SparseVector<double>* feats) const {
+  feats->erase(fid_len_);
+  for (int n = 0; n < order_; ++n)
+    feats->erase(fid_match_[n]);
+}
+
+void ForestBLEU::CountMatches(int s, int e, vector<int>* matches) const {
+  uint64_t h = 0;
+  for (int j = s; j < e && j - s < order_; ++j) {
+    if (buf_[j] == kGAP) return;
+    h = NGramTable::Extend(h, buf_[j]);
+    if (!refs_.Find(&buf_[s], j - s + 1, h)) return;
+    if (j > seg_end_[s]) ++(*matches)[j - s];
+  }
+}
+
+const vector<int>& ForestBLEU::RuleMatches(const TRule& rule) const {
+  unordered_map<const TRule*, vector<int> >::iterator it = rule2matches_.find(&rule);
+  if (it != rule2matches_.end()) return it->second;
+  vector<int>& matches = rule2matches_[&rule];
+  matches.resize(order_);
+  const vector<WordID>& e = rule.e_;
+  for (unsigned i = 0; i < e.size(); ++i) {
+    if (e[i] <= 0) continue;
+    uint64_t h = 0;
+    for (unsigned j = i; j < e.size() && e[j] > 0 && j - i < static_cast<unsigned>(order_); ++j) {
+      h = NGramTable::Extend(h, e[j]);
+      if (!refs_.Find(&e[i], j - i + 1, h)) break;
+      ++matches[j - i];
+    }
+  }
+  return matches;
+}
+
+void ForestBLEU::TraversalFeaturesImpl(const SentenceMetadata& smeta,
+                                       const HG::Edge& edge,
+                                       const vector<const void*>& ant_contexts,
+                                       SparseVector<double>* features,
+                                       SparseVector<double>* estimated_features,
+                                       void* context) const {
+  const TRule& rule = *edge.rule_;
+  const vector<WordID>& e = rule.e_;
+  const vector<int>& rule_matches = RuleMatches(rule);
+
+  // lay out the target side with the antecedents' context words; every
+  // position records where its segment (a terminal run or an antecedent)
+  // ends, so only n-grams crossing a segment boundary are counted here
+  buf_.clear();
+  seg_end_.clear();
+  int num_terminals = 0;
+  for (unsigned i = 0; i < e.size(); ++i) {
+    const int seg_start = buf_.size();
+    if (e[i] > 0) {
+      for (; i < e.size() && e[i] > 0; ++i) buf_.push_back(e[i]);
+      --i;
+      num_terminals += buf_.size() - seg_start;
+    } else {
+      const unsigned char* ant = static_cast<const unsigned char*>(ant_contexts[-e[i]]);
+      const WordID* words = reinterpret_cast<const WordID*>(ant);
+      const int nleft = ant[2 * ctx_ * sizeof(WordID)];
+      const int nright = ant[2 * ctx_ * sizeof(WordID) + 1];
+      buf_.insert(buf_.end(), words, words + nleft);
+      if (nright) {
+        buf_.push_back(kGAP);
+        buf_.insert(buf_.end(), words + ctx_, words + ctx_ + nright);
+      }
+    }
+    seg_end_.resize(buf_.size(), buf_.size() - 1);
+  }
+
+  vector<int> matches(rule_matches);
+  const int len = buf_.size();
+  for (int s = 0; s < len; ++s)
+    if (seg_end_[s] < len - 1 && seg_end_[s] - s + 1 < order_)
+      CountMatches(s, len, &matches);
+
+  features->set_value(fid_len_, num_terminals);
+  for (int n = 0; n < order_; ++n)
+    if (matches[n]) features->set_value(fid_match_[n], matches[n]);
+
+  // the new state: the whole yield if it is shorter than the context size,
+  // otherwise its first and last ctx_ words (the first gap, if any, is
+  // always preceded by at least ctx_ words)
+  unsigned char* state = static_cast<unsigned char*>(context);
+  memset(state, 0, StateSize());
+  WordID* words = reinterpret_cast<WordID*>(state);
+  const bool has_gap = find(buf_.begin(), buf_.end(), kGAP) != buf_.end();
+  if (!has_gap && len < ctx_) {
+    copy(buf_.begin(), buf_.end(), words);
+    state[2 * ctx_ * sizeof(WordID)] = len;
+  } else if (ctx_ > 0) {
+    copy(buf_.begin(), buf_.begin() + ctx_, words);
+    copy(buf_.end() - ctx_, buf_.end(), words + ctx_);
+    state[2 * ctx_ * sizeof(WordID)] = ctx_;
+    state[2 * ctx_ * sizeof(WordID) + 1] = ctx_;
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef _FF_FOREST_BLEU_H_
+#define _FF_FOREST_BLEU_H_
+
+#include <vector>
+#include <string>
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+
+#include "ff.h"
+#include "trule.h"
+#include "ngram_table.h"
+
+// ForestBLEU fires, on each edge, the number of target words the edge adds
+// (ForestBLEU_len) and the number of newly formed n-grams that occur in the
+// references (ForestBLEU_match1 .. ForestBLEU_matchN). Summed over a
+// derivation these are the (unclipped) BLEU statistics of its yield, so a
+// weighted combination of them is the linear BLEU approximation of Tromble
+// et al. (2008), and hope/fear translations can be found with a Viterbi
+// search over a forest rescored with this feature.
+//
+// The reference n-grams are kept in an NGramTable built once per sentence;
+// the matches inside each rule's terminal runs are memoized per rule, so only
+// the n-grams that cross antecedent boundaries are looked up for each edge.
+class ForestBLEU : public FeatureFunction {
+ public:
+  // param = "[-o N]"
+  ForestBLEU(const std::string& param);
+  static std::string usage(bool param,bool verbose);
+
+  // the references are taken from the SentenceMetadata if it has any,
+  // otherwise they must be set with SetReferences before each input
+  virtual void PrepareForInput(const SentenceMetadata& smeta);
+  void SetReferences(const std::vector<std::vector<WordID> >& refs);
+
+  // adds scale times the linear BLEU weights to *weights, with p the average
+  // n-gram precision and r the ratio between precisions of successive orders
+  void AddLinearBLEUWeights(double scale, double p, double r, SparseVector<double>* weights) const;
+  // removes the features fired by this model from feats
+  void RemoveFeatures(SparseVector<double>* feats) const;
+
+ protected:
+  virtual void TraversalFeaturesImpl(const SentenceMetadata& smeta,
+                                     const HG::Edge& edge,
+                                     const std::vector<const void*>& ant_contexts,
+                                     SparseVector<double>* features,
+                                     SparseVector<double>* estimated_features,
+                                     void* context) const;
+ private:
+  // matches of the n-grams that lie entirely within terminal runs of rule
+  const std::vector<int>& RuleMatches(const TRule& rule) const;
+  // counts the matches of the n-grams starting at buf_[s] (and ending before
+  // buf_[e]) that extend beyond the segment buf_[s] belongs to
+  void CountMatches(int s, int e, std::vector<int>* matches) const;
+
+  const int order_;
+  const int ctx_;  // order_ - 1 words of context on each side
+  int fid_len_;
+  std::vector<int> fid_match_;
+  NGramTable refs_;
+  mutable std::unordered_map<const TRule*, std::vector<int> > rule2matches_;
+  mutable std::vector<WordID> buf_;
+  mutable std::vector<int> seg_end_;
+};
+
+#endif
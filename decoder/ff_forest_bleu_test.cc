@@ -0,0 +1,92 @@
+#define BOOST_TEST_MODULE ForestBLEUTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <iostream>
+#include <sstream>
+#include "apply_models.h"
+#include "fdict.h"
+#include "ff_forest_bleu.h"
+#include "ffset.h"
+#include "hg.h"
+#include "kbest.h"
+#include "lattice.h"
+#include "ns.h"
+#include "sentence_metadata.h"
+#include "tdict.h"
+#include "viterbi.h"
+
+using namespace std;
+
+struct ForestBLEUTest {
+  ForestBLEUTest() : fb("-o 4") {
+    refs.resize(2);
+    TD::ConvertSentence("the cat sat on the mat", &refs[0]);
+    TD::ConvertSentence("a cat is on the mat", &refs[1]);
+    fb.SetReferences(refs);
+
+    // 2 x 3 derivations; no yield has an n-gram more often than the
+    // references, so clipping makes no difference to its BLEU statistics
+    const char* subjects[] = { "the cat", "a cat" };
+    const char* predicates[] = { "[X,1] sat on the mat", "[X,1] is sitting on the mat", "on the mat [X,1] sat" };
+    Hypergraph hg;
+    hg.AddNode(-TD::Convert("X"));
+    for (int i = 0; i < 2; ++i)
+      AddEdge(string("[X] ||| katze ||| ") + subjects[i], Hypergraph::TailNodeVector(), 0, &hg);
+    hg.AddNode(-TD::Convert("X"));
+    for (int i = 0; i < 3; ++i)
+      AddEdge(string("[X] ||| [X,1] sass ||| ") + predicates[i], Hypergraph::TailNodeVector(1, 0), 1, &hg);
+    hg.AddNode(-TD::Convert("Goal"));
+    AddEdge("[Goal] ||| [X,1] ||| [X,1]", Hypergraph::TailNodeVector(1, 1), 2, &hg);
+
+    Lattice no_lattice;
+    SentenceMetadata smeta(0, no_lattice);
+    vector<const FeatureFunction*> ffs(1, &fb);
+    vector<double> no_weights;
+    ModelSet models(no_weights, ffs);
+    ApplyModelSet(hg, smeta, models, IntersectionConfiguration(exhaustive_t()), &forest);
+  }
+
+  static void AddEdge(const string& rule, const Hypergraph::TailNodeVector& tail, int head, Hypergraph* hg) {
+    TRulePtr r(new TRule(rule));
+    hg->ConnectEdgeToHeadNode(hg->AddEdge(r, tail), head);
+  }
+
+  ForestBLEU fb;
+  vector<vector<WordID> > refs;
+  Hypergraph forest;
+};
+
+BOOST_FIXTURE_TEST_CASE(TestSentenceStatistics, ForestBLEUTest) {
+  boost::shared_ptr<SegmentEvaluator> bleu = EvaluationMetric::Instance("IBM_BLEU")->CreateSegmentEvaluator(refs);
+  typedef KBest::KBestDerivations<vector<WordID>, ESentenceTraversal> K;
+  K kbest(forest, 10);
+  int num_derivations = 0;
+  for (int i = 0; i < 10; ++i) {
+    const K::Derivation* d = kbest.LazyKthBest(forest.nodes_.size() - 1, i);
+    if (!d) break;
+    ++num_derivations;
+    SufficientStats stats;
+    bleu->Evaluate(d->yield, &stats);
+    // fields: the matches of each order, then the n-gram counts, then the
+    // hypothesis and the reference lengths
+    BOOST_CHECK_EQUAL(d->feature_values.value(FD::Convert("ForestBLEU_len")), stats.fields[8]);
+    for (int n = 1; n <= 4; ++n) {
+      ostringstream os;
+      os << "ForestBLEU_match" << n;
+      BOOST_CHECK_EQUAL(d->feature_values.value(FD::Convert(os.str())), stats.fields[n - 1]);
+    }
+  }
+  BOOST_CHECK_EQUAL(num_derivations, 6);
+}
+
+BOOST_FIXTURE_TEST_CASE(TestLinearBLEUHope, ForestBLEUTest) {
+  SparseVector<double> theta;
+  fb.AddLinearBLEUWeights(1.0, 0.8, 0.6, &theta);
+  vector<weight_t> w(FD::NumFeats());
+  for (SparseVector<double>::iterator it = theta.begin(); it != theta.end(); ++it)
+    w[it->first] = it->second;
+  forest.Reweight(w);
+  vector<WordID> hope;
+  ViterbiESentence(forest, &hope);
+  BOOST_CHECK_EQUAL(TD::GetString(hope), "the cat sat on the mat");
+}
@@ -2,9 +2,9 @@
 #define FF_LEXICAL_H_
 
 #include <vector>
-#include <map>
 #include "trule.h"
 #include "ff.h"
+#include "ff_cache.h"
 #include "hg.h"
 #include "array2d.h"
 #include "wordid.h"
@@ -61,14 +61,14 @@ protected:
 			void* context) const;
 	virtual void PrepareForInput(const SentenceMetadata& smeta);
 private:
-	mutable std::map<const TRule*, SparseVector<double> > rule2feats_;
+	mutable FeatureCache<const TRule*, SparseVector<double> > rule2feats_;
 	bool T_;
 	bool I_;
 	bool D_;
 };
 
 void LexicalFeatures::PrepareForInput(const SentenceMetadata& smeta) {
-  rule2feats_.clear(); //  std::map<const TRule*, SparseVector<double> >
+  rule2feats_.Clear();
 }
 
 void LexicalFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
@@ -78,11 +78,9 @@ void LexicalFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
 	SparseVector<double>* estimated_features,
 	void* context) const {
 	
-	map<const TRule*, SparseVector<double> >::iterator it = rule2feats_.find(edge.rule_.get());	
-	if (it == rule2feats_.end()) {
+	SparseVector<double> f;
+	if (!rule2feats_.Find(edge.rule_.get(), &f)) {
 		const TRule& rule = *edge.rule_;
-	    it = rule2feats_.insert(make_pair(&rule, SparseVector<double>())).first;
-	    SparseVector<double>& f = it->second;
 	    std::vector<bool> sf(edge.rule_->FLength(),false); // stores if source tokens are visited by alignment points
 		std::vector<bool> se(edge.rule_->ELength(),false); // stores if target tokens are visited by alignment points
 		int fid = 0;
@@ -120,8 +118,9 @@ void LexicalFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
 		    		f.add_value(fid, 1.0);
 	    	}
 	    }
+	    rule2feats_.Insert(&rule, f);
 	}
-	(*features) += it->second;
+	(*features) += f;
 }
 
 
@@ -78,7 +78,7 @@ namespace NgramCache {
     Cache() : prob() {}
   };
   static Cache cache_;
-  void Clear() { cache_.tree.clear(); }
+  void Clear() { if (!cache_.tree.empty()) cache_.tree.clear(); }
 }
 
 struct LMClient {
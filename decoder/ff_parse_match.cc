@@ -42,9 +42,7 @@ struct ParseMatchFeaturesImpl {
 
   void InitializeGrids(const string& tree, unsigned src_len) {
     assert(tree.size() > 0);
-    fids_ef.clear();
     src_tree.clear();
-    fids_ef.resize(src_len, src_len + 1);
     src_tree.resize(src_len, src_len + 1, TD::Convert("XX"));
     ParseTreeString(tree, src_len);
   }
@@ -183,7 +181,6 @@ struct ParseMatchFeaturesImpl {
 
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
   unsigned int src_sent_len;
-  mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
   int scoring_method;
 };
 
@@ -31,8 +31,7 @@ RuleIdentityFeatures::RuleIdentityFeatures(const std::string& param) {
 }
 
 void RuleIdentityFeatures::PrepareForInput(const SentenceMetadata& smeta) {
-//  std::map<const TRule*, SparseVector<double> >
-  rule2_fid_.clear();
+  rule2_fid_.Clear();
 }
 
 void RuleIdentityFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
@@ -41,8 +40,8 @@ void RuleIdentityFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
                                          SparseVector<double>* features,
                                          SparseVector<double>* estimated_features,
                                          void* context) const {
-  map<const TRule*, int>::iterator it = rule2_fid_.find(edge.rule_.get());
-  if (it == rule2_fid_.end()) {
+  int fid;
+  if (!rule2_fid_.Find(edge.rule_.get(), &fid)) {
     const TRule& rule = *edge.rule_;
     ostringstream os;
     os << "R:";
@@ -64,17 +63,17 @@ void RuleIdentityFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
         os << TD::Convert(w);
       }
     }
-    it = rule2_fid_.insert(make_pair(&rule, FD::Convert(Escape(os.str())))).first;
+    fid = FD::Convert(Escape(os.str()));
+    rule2_fid_.Insert(&rule, fid);
   }
-  features->add_value(it->second, 1);
+  features->add_value(fid, 1);
 }
 
 RuleSourceBigramFeatures::RuleSourceBigramFeatures(const std::string& param) {
 }
 
 void RuleSourceBigramFeatures::PrepareForInput(const SentenceMetadata& smeta) {
-//  std::map<const TRule*, SparseVector<double> >
-  rule2_feats_.clear();
+  rule2_feats_.Clear();
 }
 
 void RuleSourceBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
@@ -83,11 +82,9 @@ void RuleSourceBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& sme
                                          SparseVector<double>* features,
                                          SparseVector<double>* estimated_features,
                                          void* context) const {
-  map<const TRule*, SparseVector<double> >::iterator it = rule2_feats_.find(edge.rule_.get());
-  if (it == rule2_feats_.end()) {
+  SparseVector<double> f;
+  if (!rule2_feats_.Find(edge.rule_.get(), &f)) {
     const TRule& rule = *edge.rule_;
-    it = rule2_feats_.insert(make_pair(&rule, SparseVector<double>())).first;
-    SparseVector<double>& f = it->second;
     string prev = "<r>";
     for (int i = 0; i < rule.f_.size(); ++i) {
       WordID w = rule.f_[i];
@@ -97,15 +94,19 @@ void RuleSourceBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& sme
       ostringstream os;
       os << "RBS:" << prev << '_' << cur;
       const int fid = FD::Convert(Escape(os.str()));
-      if (fid <= 0) return;
+      if (fid <= 0) {
+        rule2_feats_.Insert(&rule, f);
+        return;
+      }
       f.add_value(fid, 1.0);
       prev = cur;
     }
     ostringstream os;
     os << "RBS:" << prev << '_' << "</r>";
     f.set_value(FD::Convert(Escape(os.str())), 1.0);
+    rule2_feats_.Insert(&rule, f);
   }
-  (*features) += it->second;
+  (*features) += f;
 }
 
 RuleTargetBigramFeatures::RuleTargetBigramFeatures(const std::string& param) : inds(1000) {
@@ -117,7 +118,7 @@ RuleTargetBigramFeatures::RuleTargetBigramFeatures(const std::string& param) : i
 }
 
 void RuleTargetBigramFeatures::PrepareForInput(const SentenceMetadata& smeta) {
-  rule2_feats_.clear();
+  rule2_feats_.Clear();
 }
 
 void RuleTargetBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& smeta,
@@ -126,11 +127,9 @@ void RuleTargetBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& sme
                                          SparseVector<double>* features,
                                          SparseVector<double>* estimated_features,
                                          void* context) const {
-  map<const TRule*, SparseVector<double> >::iterator it = rule2_feats_.find(edge.rule_.get());
-  if (it == rule2_feats_.end()) {
+  SparseVector<double> f;
+  if (!rule2_feats_.Find(edge.rule_.get(), &f)) {
     const TRule& rule = *edge.rule_;
-    it = rule2_feats_.insert(make_pair(&rule, SparseVector<double>())).first;
-    SparseVector<double>& f = it->second;
     string prev = "<r>";
     vector<WordID> nt_types(rule.Arity());
     unsigned ntc = 0;
@@ -147,14 +146,18 @@ void RuleTargetBigramFeatures::TraversalFeaturesImpl(const SentenceMetadata& sme
       ostringstream os;
       os << "RBT:" << prev << '_' << cur;
       const int fid = FD::Convert(Escape(os.str()));
-      if (fid <= 0) return;
+      if (fid <= 0) {
+        rule2_feats_.Insert(&rule, f);
+        return;
+      }
       f.add_value(fid, 1.0);
       prev = cur;
     }
     ostringstream os;
     os << "RBT:" << prev << '_' << "</r>";
     f.set_value(FD::Convert(Escape(os.str())), 1.0);
+    rule2_feats_.Insert(&rule, f);
   }
-  (*features) += it->second;
+  (*features) += f;
 }
 
@@ -2,9 +2,9 @@
 #define _FF_RULES_H_
 
 #include <vector>
-#include <map>
 #include "trule.h"
 #include "ff.h"
+#include "ff_cache.h"
 #include "hg.h"
 #include "array2d.h"
 #include "wordid.h"
@@ -21,7 +21,7 @@ class RuleIdentityFeatures : public FeatureFunction {
                                      void* context) const;
   virtual void PrepareForInput(const SentenceMetadata& smeta);
  private:
-  mutable std::map<const TRule*, int> rule2_fid_;
+  mutable FeatureCache<const TRule*, int> rule2_fid_;
 };
 
 class RuleSourceBigramFeatures : public FeatureFunction {
@@ -36,7 +36,7 @@ class RuleSourceBigramFeatures : public FeatureFunction {
                                      void* context) const;
   virtual void PrepareForInput(const SentenceMetadata& smeta);
  private:
-  mutable std::map<const TRule*, SparseVector<double> > rule2_feats_;
+  mutable FeatureCache<const TRule*, SparseVector<double> > rule2_feats_;
 };
 
 class RuleTargetBigramFeatures : public FeatureFunction {
@@ -52,7 +52,7 @@ class RuleTargetBigramFeatures : public FeatureFunction {
   virtual void PrepareForInput(const SentenceMetadata& smeta);
  private:
   std::vector<std::string> inds;
-  mutable std::map<const TRule*, SparseVector<double> > rule2_feats_;
+  mutable FeatureCache<const TRule*, SparseVector<double> > rule2_feats_;
 };
 
 #endif
@@ -33,9 +33,7 @@ struct SoftSyntaxFeaturesImpl {
 
   void InitializeGrids(const string& tree, unsigned src_len) {
     assert(tree.size() > 0);
-    fids_ef.clear();
     src_tree.clear();
-    fids_ef.resize(src_len, src_len + 1);
     src_tree.resize(src_len, src_len + 1, TD::Convert("XX"));
     ParseTreeString(tree, src_len);
   }
@@ -97,7 +95,7 @@ struct SoftSyntaxFeaturesImpl {
 	string lhs_str = TD::Convert(lhs);
     //cerr << "LHS: " << lhs_str << " from " << i << " to " << j << endl;
 	  //cerr << "RULE :"<< rule << endl;
-    int& fid_ef = fids_ef(i,j)[&rule];
+    int fid_ef = 0;
     for (unsigned int i = 0; i < feat_labels.size(); i++) {
       ostringstream os;
       string label = feat_labels.at(i).first;
@@ -165,7 +163,6 @@ struct SoftSyntaxFeaturesImpl {
   }
 
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
-  mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
   vector<pair<string, string> > feat_labels;
 };
 
@@ -36,9 +36,7 @@ struct SoftSyntaxFeaturesMindistImpl {
 
   void InitializeGrids(const string& tree, unsigned src_len) {
     assert(tree.size() > 0);
-    fids_ef.clear();
     src_tree.clear();
-    fids_ef.resize(src_len, src_len + 1);
     src_tree.resize(src_len, src_len + 1, TD::Convert("XX"));
     ParseTreeString(tree, src_len);
   }
@@ -100,7 +98,7 @@ struct SoftSyntaxFeaturesMindistImpl {
 	string lhs_str = TD::Convert(lhs);
     //cerr << "LHS: " << lhs_str << " from " << i << " to " << j << endl;
 	  //cerr << "RULE :"<< rule << endl;
-    int& fid_ef = fids_ef(i,j)[&rule];
+    int fid_ef = 0;
     string lhs_to_str = TD::Convert(lhs);
     int min_dist;
     string min_dist_label;
@@ -201,7 +199,6 @@ struct SoftSyntaxFeaturesMindistImpl {
   }
 
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
-  mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
   vector<pair<string, string> > feat_labels;
 };
 
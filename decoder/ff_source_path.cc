@@ -7,14 +7,21 @@ using namespace std;
 SourcePathFeatures::SourcePathFeatures(const string& param) : FeatureFunction(sizeof(int)) {}
 
 void SourcePathFeatures::FireBigramFeature(WordID prev, WordID cur, SparseVector<double>* features) const {
-  int& fid = bigram_fids[prev][cur];
-  if (!fid) fid = FD::Convert("SB:"+TD::Convert(prev) + "_" + TD::Convert(cur));
+  const Bigram bigram(prev, cur);
+  int fid;
+  if (!bigram_fids.Find(bigram, &fid)) {
+    fid = FD::Convert("SB:"+TD::Convert(prev) + "_" + TD::Convert(cur));
+    bigram_fids.Insert(bigram, fid);
+  }
   if (fid) features->add_value(fid, 1.0);
 }
 
 void SourcePathFeatures::FireUnigramFeature(WordID cur, SparseVector<double>* features) const {
-  int& fid = unigram_fids[cur];
-  if (!fid) fid = FD::Convert("SU:" + TD::Convert(cur));
+  int fid;
+  if (!unigram_fids.Find(cur, &fid)) {
+    fid = FD::Convert("SU:" + TD::Convert(cur));
+    unigram_fids.Insert(cur, fid);
+  }
   if (fid) features->add_value(fid, 1.0);
 }
 
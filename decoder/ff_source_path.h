@@ -1,9 +1,11 @@
 #ifndef _FF_SOURCE_PATH_H_
 #define _FF_SOURCE_PATH_H_
 
+#include <utility>
 #include <vector>
-#include <map>
+#include <boost/functional/hash.hpp>
 #include "ff.h"
+#include "ff_cache.h"
 
 class SourcePathFeatures : public FeatureFunction {
  public:
@@ -19,8 +21,9 @@ class SourcePathFeatures : public FeatureFunction {
  private:
   void FireBigramFeature(WordID prev, WordID cur, SparseVector<double>* features) const;
   void FireUnigramFeature(WordID cur, SparseVector<double>* features) const;
-  mutable std::map<WordID, std::map<WordID, int> > bigram_fids;
-  mutable std::map<WordID, int> unigram_fids;
+  typedef std::pair<WordID, WordID> Bigram;
+  mutable FeatureCache<Bigram, int, boost::hash<Bigram> > bigram_fids;
+  mutable FeatureCache<WordID, int> unigram_fids;
 };
 
 #endif
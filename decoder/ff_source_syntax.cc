@@ -3,9 +3,11 @@
 #include <sstream>
 #include <stack>
 #include <unordered_set>
+#include <boost/functional/hash.hpp>
 
 #include "sentence_metadata.h"
 #include "array2d.h"
+#include "ff_cache.h"
 #include "filelib.h"
 
 using namespace std;
@@ -21,6 +23,10 @@ inline int SpanSizeTransform(unsigned span_size) {
   return static_cast<int>(log(span_size+1) / log(1.39)) - 1;
 }
 
+// feature ids of the rules used over each source span (i,j) of a sentence
+typedef pair<const TRule*, pair<int, int> > SpanRule;
+typedef FeatureCache<SpanRule, int, boost::hash<SpanRule> > SpanRuleFids;
+
 struct SourceSyntaxFeaturesImpl {
   SourceSyntaxFeaturesImpl() {}
 
@@ -38,10 +44,9 @@ struct SourceSyntaxFeaturesImpl {
   void InitializeGrids(const string& tree, unsigned src_len) {
     assert(tree.size() > 0);
     //fids_cat.clear();
-    fids_ef.clear();
+    fids_ef.Clear();
     src_tree.clear();
     //fids_cat.resize(src_len, src_len + 1);
-    fids_ef.resize(src_len, src_len + 1);
     src_tree.resize(src_len, src_len + 1, TD::Convert("XX"));
     ParseTreeString(tree, src_len);
   }
@@ -100,8 +105,9 @@ struct SourceSyntaxFeaturesImpl {
     //cerr << "fire features: " << rule.AsString() << " for " << i << "," << j << endl;
     const WordID lhs = src_tree(i,j);
     //int& fid_cat = fids_cat(i,j);
-    int& fid_ef = fids_ef(i,j)[&rule];
-    if (fid_ef <= 0) {
+    const SpanRule span_rule(&rule, make_pair(i, j));
+    int fid_ef;
+    if (!fids_ef.Find(span_rule, &fid_ef)) {
       ostringstream os;
       //ostringstream os2;
       os << "SSYN:" << TD::Convert(lhs);
@@ -128,6 +134,7 @@ struct SourceSyntaxFeaturesImpl {
           os << TD::Convert(ei);
       }
       fid_ef = FD::Convert(os.str());
+      fids_ef.Insert(span_rule, fid_ef);
     }
     if (fid_ef > 0) {
       if (feature_filter.size()>0) {
@@ -144,7 +151,7 @@ struct SourceSyntaxFeaturesImpl {
 
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
   // mutable Array2D<int> fids_cat; // this tends to overfit baddly
-  mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
+  SpanRuleFids fids_ef; // fires for fully lexicalized
   unordered_set<int> feature_filter;
 };
 
@@ -183,14 +190,14 @@ struct SourceSpanSizeFeaturesImpl {
   SourceSpanSizeFeaturesImpl() {}
 
   void InitializeGrids(unsigned src_len) {
-    fids.clear();
-    fids.resize(src_len, src_len + 1);
+    fids.Clear();
   }
 
   int FireFeatures(const TRule& rule, const int i, const int j, const WordID* ants, SparseVector<double>* feats) {
     if (rule.Arity() > 0) {
-      int& fid = fids(i,j)[&rule];
-      if (fid <= 0) {
+      const SpanRule span_rule(&rule, make_pair(i, j));
+      int fid;
+      if (!fids.Find(span_rule, &fid)) {
         ostringstream os;
         os << "SSS:";
         unsigned ntc = 0;
@@ -213,6 +220,7 @@ struct SourceSpanSizeFeaturesImpl {
             os << TD::Convert(ei);
         }
         fid = FD::Convert(os.str());
+        fids.Insert(span_rule, fid);
       }
       if (fid > 0)
         feats->set_value(fid, 1.0);
@@ -220,7 +228,7 @@ struct SourceSpanSizeFeaturesImpl {
     return SpanSizeTransform(j - i);
   }
 
-  mutable Array2D<map<const TRule*, int> > fids;
+  SpanRuleFids fids;
 };
 
 SourceSpanSizeFeatures::SourceSpanSizeFeatures(const string& param) :
@@ -29,9 +29,7 @@ struct SourceSyntaxFeatures2Impl {
 
   void InitializeGrids(const string& tree, unsigned src_len) {
     assert(tree.size() > 0);
-    fids_ef.clear();
     src_tree.clear();
-    fids_ef.resize(src_len, src_len + 1);
     src_tree.resize(src_len, src_len + 1, TD::Convert("XX"));
     ParseTreeString(tree, src_len);
   }
@@ -88,7 +86,7 @@ struct SourceSyntaxFeatures2Impl {
   WordID FireFeatures(const TRule& rule, const int i, const int j, const WordID* ants, SparseVector<double>* feats) {
     //cerr << "fire features: " << rule.AsString() << " for " << i << "," << j << endl;
     const WordID lhs = src_tree(i,j);
-    int& fid_ef = fids_ef(i,j)[&rule];
+    int fid_ef = 0;
     ostringstream os;
     os << "SSYN2:" << TD::Convert(lhs);
     os << ':';
@@ -129,7 +127,6 @@ struct SourceSyntaxFeatures2Impl {
   }
 
   Array2D<WordID> src_tree; // src_tree(i,j) NT = type
-  mutable Array2D<map<const TRule*, int> > fids_ef; // fires for fully lexicalized
   unordered_set<int> feature_filter;
 };
 
@@ -124,19 +124,18 @@ void LexicalPairIndicator::TraversalFeaturesImpl(const SentenceMetadata& smeta,
   }
 }
 
-OutputIndicator::OutputIndicator(const std::string& param) {}
+OutputIndicator::OutputIndicator(const std::string& param) {
+  escape_[TD::Convert("=")] = TD::Convert("__EQ");
+  escape_[TD::Convert(";")] = TD::Convert("__SC");
+  escape_[TD::Convert(",")] = TD::Convert("__CO");
+}
 
 void OutputIndicator::FireFeature(WordID trg,
                                  SparseVector<double>* features) const {
   int& fid = fmap_[trg];
   if (!fid) {
-    static map<WordID, WordID> escape;
-    if (escape.empty()) {
-      escape[TD::Convert("=")] = TD::Convert("__EQ");
-      escape[TD::Convert(";")] = TD::Convert("__SC");
-      escape[TD::Convert(",")] = TD::Convert("__CO");
-    }
-    if (escape.count(trg)) trg = escape[trg];
+    const map<WordID, WordID>::const_iterator it = escape_.find(trg);
+    if (it != escape_.end()) trg = it->second;
     ostringstream os;
     os << "T:" << TD::Convert(trg);
     fid = FD::Convert(Escape(os.str()));
@@ -67,6 +67,7 @@ class OutputIndicator : public FeatureFunction {
  private:
   void FireFeature(WordID trg,
                    SparseVector<double>* features) const;
+  std::map<WordID, WordID> escape_;
   mutable Class2FID fmap_;
 };
 
@@ -208,24 +208,6 @@ int BinnedLogLength(int len) {
   return res;
 }
 
-// <0>=jump size <1>=jump_dir <2>=flen, <3>=elen, <4>=f0, <5>=f-1, <6>=f+1, <7>=fprev
-typedef boost::tuple<short, char, short, short, WordID, WordID, WordID, WordID> NewJumpFeatureKey;
-
-struct KeyHash : unary_function<NewJumpFeatureKey, size_t> {
-  size_t operator()(const NewJumpFeatureKey& k) const {
-    size_t h = 0x37473DEF321;
-    boost::hash_combine(h, k.get<0>());
-    boost::hash_combine(h, k.get<1>());
-    boost::hash_combine(h, k.get<2>());
-    boost::hash_combine(h, k.get<3>());
-    boost::hash_combine(h, k.get<4>());
-    boost::hash_combine(h, k.get<5>());
-    boost::hash_combine(h, k.get<6>());
-    boost::hash_combine(h, k.get<7>());
-    return h;
-  }
-};
-
 void NewJump::FireFeature(const SentenceMetadata& smeta,
                           const int prev_src_index,
                           const int cur_src_index,
@@ -254,8 +236,7 @@ void NewJump::FireFeature(const SentenceMetadata& smeta,
   if (fp1_)   get<6>(key) = GetSourceWord(id, cur_src_index + 1);
   if (fprev_) get<7>(key) = GetSourceWord(id, prev_src_index);
 
-  static std::unordered_map<NewJumpFeatureKey, int, KeyHash> fids;
-  int& fid = fids[key];
+  int& fid = fids_[key];
   if (!fid) {
     ostringstream os;
     os << fid_str_ << ':' << jtype << jump_magnitude;
@@ -551,13 +532,12 @@ void IdentityCycleDetector::TraversalFeaturesImpl(const SentenceMetadata& smeta,
     out_is_identity = false;
     if (edge.rule_->e_[0] == edge.rule_->f_[0]) {
       const WordID word = edge.rule_->e_[0];
-      static map<WordID, bool> big_enough;
-      map<WordID,bool>::iterator it = big_enough_.find(word);
-      if (it == big_enough_.end()) {
-        out_is_identity = big_enough_[word] = TD::Convert(word).size() >= length_min_;
-      } else {
-        out_is_identity = it->second;
+      bool big_enough;
+      if (!big_enough_.Find(word, &big_enough)) {
+        big_enough = TD::Convert(word).size() >= length_min_;
+        big_enough_.Insert(word, big_enough);
       }
+      out_is_identity = big_enough;
     }
   } else if (edge.Arity() == 1) {
     memcpy(context, ant_contexts[0], 2);
@@ -576,19 +556,18 @@ void IdentityCycleDetector::TraversalFeaturesImpl(const SentenceMetadata& smeta,
 }
 
 
-InputIndicator::InputIndicator(const std::string& param) {}
+InputIndicator::InputIndicator(const std::string& param) {
+  escape_[TD::Convert("=")] = TD::Convert("__EQ");
+  escape_[TD::Convert(";")] = TD::Convert("__SC");
+  escape_[TD::Convert(",")] = TD::Convert("__CO");
+}
 
 void InputIndicator::FireFeature(WordID src,
                                  SparseVector<double>* features) const {
   int& fid = fmap_[src];
   if (!fid) {
-    static map<WordID, WordID> escape;
-    if (escape.empty()) {
-      escape[TD::Convert("=")] = TD::Convert("__EQ");
-      escape[TD::Convert(";")] = TD::Convert("__SC");
-      escape[TD::Convert(",")] = TD::Convert("__CO");
-    }
-    if (escape.count(src)) src = escape[src];
+    const map<WordID, WordID>::const_iterator it = escape_.find(src);
+    if (it != escape_.end()) src = it->second;
     ostringstream os;
     os << "S:" << TD::Convert(src);
     fid = FD::Convert(os.str());
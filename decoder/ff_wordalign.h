@@ -2,11 +2,15 @@
 #define _FF_WORD_ALIGN_H_
 
 #include "ff.h"
+#include "ff_cache.h"
 #include "array2d.h"
 #include "factored_lexicon_helper.h"
 
 #include <boost/functional/hash.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
 #include <cassert>
+#include <functional>
 #include <boost/scoped_ptr.hpp>
 #include <boost/multi_array.hpp>
 #ifndef HAVE_OLD_CPP
@@ -75,6 +79,24 @@ class LexNullJump : public FeatureFunction {
   const int fid_lex_lex_;
 };
 
+// <0>=jump size <1>=jump_dir <2>=flen, <3>=elen, <4>=f0, <5>=f-1, <6>=f+1, <7>=fprev
+typedef boost::tuple<short, char, short, short, WordID, WordID, WordID, WordID> NewJumpFeatureKey;
+
+struct NewJumpKeyHash : std::unary_function<NewJumpFeatureKey, size_t> {
+  size_t operator()(const NewJumpFeatureKey& k) const {
+    size_t h = 0x37473DEF321;
+    boost::hash_combine(h, k.get<0>());
+    boost::hash_combine(h, k.get<1>());
+    boost::hash_combine(h, k.get<2>());
+    boost::hash_combine(h, k.get<3>());
+    boost::hash_combine(h, k.get<4>());
+    boost::hash_combine(h, k.get<5>());
+    boost::hash_combine(h, k.get<6>());
+    boost::hash_combine(h, k.get<7>());
+    return h;
+  }
+};
+
 class NewJump : public FeatureFunction {
  public:
   NewJump(const std::string& param);
@@ -110,6 +132,7 @@ class NewJump : public FeatureFunction {
   bool fprev_;
   std::vector<std::vector<WordID> > src_;
   std::string fid_str_;  // identifies configuration uniquely
+  mutable std::unordered_map<NewJumpFeatureKey, int, NewJumpKeyHash> fids_;
 };
 
 class LexicalTranslationTrigger : public FeatureFunction {
@@ -239,7 +262,7 @@ class IdentityCycleDetector : public FeatureFunction {
  private:
   int length_min_;
   int fid_;
-  mutable std::map<WordID, bool> big_enough_;
+  mutable FeatureCache<WordID, bool> big_enough_;
 };
 
 class InputIndicator : public FeatureFunction {
@@ -255,6 +278,7 @@ class InputIndicator : public FeatureFunction {
  private:
   void FireFeature(WordID src,
                    SparseVector<double>* features) const;
+  std::map<WordID, WordID> escape_;
   mutable Class2FID fmap_;
 };
 
@@ -268,8 +292,6 @@ class Fertility : public FeatureFunction {
                                      SparseVector<double>* features,
                                      SparseVector<double>* estimated_features,
                                      void* context) const;
- private:
-  mutable std::map<WordID, int> fids_;
 };
 
 #endif
@@ -8,6 +8,7 @@
 #include <cstring>
 #include <cassert>
 #include <stack>
+#include <pthread.h>
 #include "tdict.h"
 #include "fdict.h"
 #include "trule.h"
@@ -22,6 +23,13 @@ void* rule_callback_extra = NULL;
 std::vector<int> scfglex_phrase_fnames;
 std::string scfglex_fname;
 
+// the state of the lexer is global, so rules are read by one thread at a time
+pthread_mutex_t rule_lexer_mutex = PTHREAD_MUTEX_INITIALIZER;
+struct RuleLexerLock {
+  RuleLexerLock() { pthread_mutex_lock(&rule_lexer_mutex); }
+  ~RuleLexerLock() { pthread_mutex_unlock(&rule_lexer_mutex); }
+};
+
 #undef YY_INPUT
 #define YY_INPUT(buf, result, max_size) (result = scfglex_stream->read(buf, max_size).gcount())
 
@@ -344,6 +352,7 @@ static void init_default_feature_names() {
 }
 
 void RuleLexer::ReadRules(std::istream* in, RuleLexer::RuleCallback func, const std::string& fname, void* extra) {
+  RuleLexerLock lock;
   init_default_feature_names();
   lex_mono_rules = false;
   lex_line = 1;
@@ -355,6 +364,7 @@ void RuleLexer::ReadRules(std::istream* in, RuleLexer::RuleCallback func, const
 }
 
 void RuleLexer::ReadRule(const std::string& srule, RuleCallback func, bool mono, void* extra) {
+  RuleLexerLock lock;
   init_default_feature_names();
   lex_mono_rules = mono;
   lex_line = 1;
@@ -29,6 +29,9 @@ Alignment::Alignment(const string& filename) {
   alignments.shrink_to_fit();
 }
 
+Alignment::Alignment(const vector<vector<pair<int, int>>>& alignments) :
+    alignments(alignments) {}
+
 Alignment::Alignment() {}
 
 Alignment::~Alignment() {}
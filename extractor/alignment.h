@@ -21,6 +21,9 @@ class Alignment {
   // Reads alignment from text file.
   Alignment(const string& filename);
 
+  // Creates alignment from the links of each sentence pair.
+  Alignment(const vector<vector<pair<int, int>>>& alignments);
+
   // Creates empty alignment.
   Alignment();
 
@@ -45,6 +45,11 @@ DataArray::DataArray(const string& filename, const Side& side) {
   CreateDataArray(lines);
 }
 
+DataArray::DataArray(const vector<string>& lines) {
+  InitializeDataArray();
+  CreateDataArray(lines);
+}
+
 void DataArray::InitializeDataArray() {
   word2id[NULL_WORD_STR] = NULL_WORD;
   id2word.push_back(NULL_WORD_STR);
@@ -78,7 +83,7 @@ void DataArray::CreateDataArray(const vector<string>& lines) {
 
 DataArray::~DataArray() {}
 
-vector<int> DataArray::GetData() const {
+const vector<int>& DataArray::GetData() const {
   return data;
 }
 
@@ -45,13 +45,16 @@ class DataArray {
   // Reads data array from bitext file where the sentences are separated by |||.
   DataArray(const string& filename, const Side& side);
 
+  // Creates data array from the given sentences.
+  DataArray(const vector<string>& lines);
+
   // Creates empty data array.
   DataArray();
 
   virtual ~DataArray();
 
-  // Returns a vector containing the word ids.
-  virtual vector<int> GetData() const;
+  // Returns the vector containing the word ids (without copying it).
+  virtual const vector<int>& GetData() const;
 
   // Returns the word id at the specified position.
   virtual int AtIndex(int index) const;
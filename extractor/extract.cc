@@ -1,6 +1,8 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -26,8 +28,10 @@
 #include "features/target_given_source_coherent.h"
 #include "grammar.h"
 #include "grammar_extractor.h"
+#include "online_bitext.h"
 #include "precomputation.h"
 #include "rule.h"
+#include "rule_cache.h"
 #include "scorer.h"
 #include "suffix_array.h"
 #include "time_util.h"
@@ -47,6 +51,45 @@ fs::path GetGrammarFilePath(const fs::path& grammar_path, int file_number) {
   return grammar_path / file_name;
 }
 
+// Prefix of the input lines adding a sentence pair to the corpus in online
+// mode.
+const string ADD_SENTENCE_PAIR = "ADD |||";
+
+// Parses "source ||| target ||| alignment", where the alignment is a list of
+// source-target links (e.g. "0-0 1-2").
+bool ParseSentencePair(const string& line, string& source, string& target,
+                       vector<pair<int, int>>& links) {
+  vector<string> fields;
+  string delimiter = "|||";
+  size_t start = 0, position;
+  while ((position = line.find(delimiter, start)) != line.npos) {
+    fields.push_back(line.substr(start, position - start));
+    start = position + delimiter.size();
+  }
+  fields.push_back(line.substr(start));
+  if (fields.size() != 3) {
+    return false;
+  }
+  source = fields[0];
+  target = fields[1];
+
+  istringstream buffer(fields[2]);
+  string link;
+  while (buffer >> link) {
+    int position = link.find('-');
+    if (position == link.npos) {
+      return false;
+    }
+    try {
+      links.push_back(make_pair(stoi(link.substr(0, position)),
+                                stoi(link.substr(position + 1))));
+    } catch (const logic_error&) {
+      return false;
+    }
+  }
+  return true;
+}
+
 int main(int argc, char** argv) {
   po::options_description general_options("General options");
   int max_threads = 1;
@@ -69,9 +112,16 @@ int main(int argc, char** argv) {
         "Maximum number of samples")
     ("tight_phrases", po::value<bool>()->default_value(true),
         "False if phrases may be loose (better, but slower)")
+    ("rule_cache_mb", po::value<int>()->default_value(0),
+        "Memory (in MB) for the occurrences and rules of the source phrases "
+        "cached across sentences (0 disables the cache)")
     ("leave_one_out", po::value<bool>()->zero_tokens(),
         "do leave-one-out estimation of grammars "
-        "(e.g. for extracting grammars for the training set");
+        "(e.g. for extracting grammars for the training set")
+    ("online", po::value<bool>()->zero_tokens(),
+        "Process the input one line at a time; lines of the form "
+        "\"ADD ||| source ||| target ||| alignment\" add a sentence pair to "
+        "the corpus used for the following sentences");
 
   po::options_description cmdline_options("Command line options");
   cmdline_options.add_options()
@@ -192,6 +242,34 @@ int main(int argc, char** argv) {
   };
   shared_ptr<Scorer> scorer = make_shared<Scorer>(features);
 
+  // Rules of the source phrases shared by several sentences.
+  shared_ptr<RuleCache> rule_cache;
+  if (vm["rule_cache_mb"].as<int>() > 0) {
+    rule_cache = make_shared<RuleCache>(
+        vm["rule_cache_mb"].as<int>() * (1LL << 20));
+  }
+
+  // Sentence pairs added to the corpus in online mode.
+  shared_ptr<OnlineBitext> online_bitext;
+  bool online = vm.count("online");
+  if (online) {
+    if (!table->HasLinksCount()) {
+      cerr << "The translation table has no link counts, which --online "
+           << "needs. Rerun sacompile to compile the data again." << endl;
+      return 1;
+    }
+    online_bitext = make_shared<OnlineBitext>(
+        vocabulary,
+        scorer,
+        table,
+        vm["min_gap_size"].as<int>(),
+        vm["max_rule_span"].as<int>(),
+        vm["max_nonterminals"].as<int>(),
+        vm["max_rule_symbols"].as<int>(),
+        vm["max_samples"].as<int>(),
+        vm["tight_phrases"].as<bool>());
+  }
+
   GrammarExtractor extractor(
       source_suffix_array,
       target_data_array,
@@ -204,7 +282,9 @@ int main(int argc, char** argv) {
       vm["max_nonterminals"].as<int>(),
       vm["max_rule_symbols"].as<int>(),
       vm["max_samples"].as<int>(),
-      vm["tight_phrases"].as<bool>());
+      vm["tight_phrases"].as<bool>(),
+      rule_cache,
+      online_bitext);
 
   // Creates the grammars directory if it doesn't exist.
   fs::path grammar_path = vm["grammars"].as<string>();
@@ -212,40 +292,88 @@ int main(int argc, char** argv) {
     fs::create_directory(grammar_path);
   }
 
-  // Reads all sentences for which we extract grammar rules (the paralellization
-  // is simplified if we read all sentences upfront).
-  string sentence;
-  vector<string> sentences;
-  while (getline(cin, sentence)) {
-    sentences.push_back(sentence);
-  }
-
-  // Extracts the grammar for each sentence and saves it to a file.
-  vector<string> suffixes(sentences.size());
   bool leave_one_out = vm.count("leave_one_out");
-  #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
-  for (size_t i = 0; i < sentences.size(); ++i) {
-    string suffix;
-    int position = sentences[i].find("|||");
-    if (position != sentences[i].npos) {
-      suffix = sentences[i].substr(position);
-      sentences[i] = sentences[i].substr(0, position);
+  if (online) {
+    // Extracts the grammar of each sentence as soon as it is read, so that it
+    // reflects all the sentence pairs added before it.
+    string line;
+    int sentence_id = 0;
+    while (getline(cin, line)) {
+      if (line.compare(0, ADD_SENTENCE_PAIR.size(), ADD_SENTENCE_PAIR) == 0) {
+        string source, target;
+        vector<pair<int, int>> links;
+        if (!ParseSentencePair(line.substr(ADD_SENTENCE_PAIR.size()),
+                               source, target, links) ||
+            !online_bitext->AddSentencePair(source, target, links)) {
+          cerr << "Ignoring invalid sentence pair: " << line << endl;
+        }
+        continue;
+      }
+
+      string suffix;
+      int position = line.find("|||");
+      if (position != line.npos) {
+        suffix = line.substr(position);
+        line = line.substr(0, position);
+      }
+
+      unordered_set<int> blacklisted_sentence_ids;
+      if (leave_one_out) {
+        blacklisted_sentence_ids.insert(sentence_id);
+      }
+      Grammar grammar = extractor.GetGrammar(line, blacklisted_sentence_ids);
+      fs::path grammar_file = GetGrammarFilePath(grammar_path, sentence_id);
+      ofstream output(grammar_file.c_str());
+      output << grammar;
+      output.close();
+      cout << "<seg grammar=" << grammar_file << " id=\"" << sentence_id
+           << "\"> " << line << " </seg> " << suffix << endl;
+      ++sentence_id;
+    }
+  } else {
+    // Reads all sentences for which we extract grammar rules (the
+    // paralellization is simplified if we read all sentences upfront).
+    string sentence;
+    vector<string> sentences;
+    while (getline(cin, sentence)) {
+      sentences.push_back(sentence);
+    }
+
+    // Extracts the grammar for each sentence and saves it to a file.
+    vector<string> suffixes(sentences.size());
+    #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t i = 0; i < sentences.size(); ++i) {
+      string suffix;
+      int position = sentences[i].find("|||");
+      if (position != sentences[i].npos) {
+        suffix = sentences[i].substr(position);
+        sentences[i] = sentences[i].substr(0, position);
+      }
+      suffixes[i] = suffix;
+
+      unordered_set<int> blacklisted_sentence_ids;
+      if (leave_one_out) {
+        blacklisted_sentence_ids.insert(i);
+      }
+      Grammar grammar = extractor.GetGrammar(
+          sentences[i], blacklisted_sentence_ids);
+      ofstream output(GetGrammarFilePath(grammar_path, i).c_str());
+      output << grammar;
     }
-    suffixes[i] = suffix;
 
-    unordered_set<int> blacklisted_sentence_ids;
-    if (leave_one_out) {
-      blacklisted_sentence_ids.insert(i);
+    for (size_t i = 0; i < sentences.size(); ++i) {
+      cout << "<seg grammar=" << GetGrammarFilePath(grammar_path, i) << " id=\""
+           << i << "\"> " << sentences[i] << " </seg> " << suffixes[i] << endl;
     }
-    Grammar grammar = extractor.GetGrammar(
-        sentences[i], blacklisted_sentence_ids);
-    ofstream output(GetGrammarFilePath(grammar_path, i).c_str());
-    output << grammar;
   }
 
-  for (size_t i = 0; i < sentences.size(); ++i) {
-    cout << "<seg grammar=" << GetGrammarFilePath(grammar_path, i) << " id=\""
-         << i << "\"> " << sentences[i] << " </seg> " << suffixes[i] << endl;
+  if (rule_cache != NULL) {
+    long long hits = rule_cache->GetHits();
+    long long lookups = hits + rule_cache->GetMisses();
+    cerr << "Rule cache: " << hits << " hits out of " << lookups
+         << " lookups (hit rate " << (lookups ? 100.0 * hits / lookups : 0)
+         << "%), " << rule_cache->GetSize() << " phrases cached in "
+         << rule_cache->GetMemoryUsage() / double(1 << 20) << " MB" << endl;
   }
 
   Clock::time_point extraction_stop_time = Clock::now();
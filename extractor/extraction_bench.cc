@@ -0,0 +1,199 @@
+// Measures the time spent extracting the grammar of each sentence read from
+// the standard input, and the time spent in the suffix array lookups alone
+// (every contiguous phrase of the sentence, with the words mapped to data
+// array ids once per sentence). The sentences are processed sequentially.
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "alignment.h"
+#include "data_array.h"
+#include "features/count_source_target.h"
+#include "features/feature.h"
+#include "features/is_source_singleton.h"
+#include "features/is_source_target_singleton.h"
+#include "features/max_lex_source_given_target.h"
+#include "features/max_lex_target_given_source.h"
+#include "features/sample_source_count.h"
+#include "features/target_given_source_coherent.h"
+#include "grammar.h"
+#include "grammar_extractor.h"
+#include "matchings_finder.h"
+#include "phrase_location.h"
+#include "precomputation.h"
+#include "rule.h"
+#include "rule_cache.h"
+#include "scorer.h"
+#include "suffix_array.h"
+#include "time_util.h"
+#include "translation_table.h"
+#include "vocabulary.h"
+
+namespace po = boost::program_options;
+using namespace std;
+using namespace extractor;
+using namespace features;
+
+// Prints the total, mean, median and maximum of the per sentence times.
+void PrintTimes(const string& name, vector<double> times) {
+  double total = 0;
+  for (double time: times) {
+    total += time;
+  }
+  sort(times.begin(), times.end());
+  cout << name << ": " << total << " seconds, per sentence: mean "
+       << total / times.size() << ", median " << times[times.size() / 2]
+       << ", max " << times.back() << endl;
+}
+
+int main(int argc, char** argv) {
+  po::options_description desc("Command line options");
+  desc.add_options()
+    ("help,h", "Show available options")
+    ("bitext,b", po::value<string>()->required(),
+        "Parallel text (source ||| target)")
+    ("alignment,a", po::value<string>()->required(), "Bitext word alignment")
+    ("frequent", po::value<int>()->default_value(100),
+        "Number of precomputed frequent patterns")
+    ("super_frequent", po::value<int>()->default_value(10),
+        "Number of precomputed super frequent patterns")
+    ("max_rule_span", po::value<int>()->default_value(15),
+        "Maximum rule span")
+    ("max_rule_symbols", po::value<int>()->default_value(5),
+        "Maximum number of symbols (terminals + nontermals) in a rule")
+    ("min_gap_size", po::value<int>()->default_value(1), "Minimum gap size")
+    ("max_phrase_len", po::value<int>()->default_value(4),
+        "Maximum frequent phrase length")
+    ("max_nonterminals", po::value<int>()->default_value(2),
+        "Maximum number of nonterminals in a rule")
+    ("min_frequency", po::value<int>()->default_value(1000),
+        "Minimum number of occurrences for a pharse to be considered frequent")
+    ("max_samples", po::value<int>()->default_value(300),
+        "Maximum number of samples")
+    ("tight_phrases", po::value<bool>()->default_value(true),
+        "False if phrases may be loose (better, but slower)")
+    ("rule_cache_mb", po::value<int>()->default_value(0),
+        "Memory (in MB) for the occurrences and rules of the source phrases "
+        "cached across sentences (0 disables the cache)");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  if (vm.count("help")) {
+    cout << desc << endl;
+    return 0;
+  }
+  po::notify(vm);
+
+  shared_ptr<DataArray> source_data_array = make_shared<DataArray>(
+      vm["bitext"].as<string>(), SOURCE);
+  shared_ptr<DataArray> target_data_array = make_shared<DataArray>(
+      vm["bitext"].as<string>(), TARGET);
+  shared_ptr<SuffixArray> source_suffix_array =
+      make_shared<SuffixArray>(source_data_array);
+  shared_ptr<Alignment> alignment =
+      make_shared<Alignment>(vm["alignment"].as<string>());
+  shared_ptr<Vocabulary> vocabulary = make_shared<Vocabulary>();
+  shared_ptr<Precomputation> precomputation = make_shared<Precomputation>(
+      vocabulary,
+      source_suffix_array,
+      vm["frequent"].as<int>(),
+      vm["super_frequent"].as<int>(),
+      vm["max_rule_span"].as<int>(),
+      vm["max_rule_symbols"].as<int>(),
+      vm["min_gap_size"].as<int>(),
+      vm["max_phrase_len"].as<int>(),
+      vm["min_frequency"].as<int>());
+  shared_ptr<TranslationTable> table = make_shared<TranslationTable>(
+      source_data_array, target_data_array, alignment);
+  vector<shared_ptr<Feature>> features = {
+      make_shared<TargetGivenSourceCoherent>(),
+      make_shared<SampleSourceCount>(),
+      make_shared<CountSourceTarget>(),
+      make_shared<MaxLexSourceGivenTarget>(table),
+      make_shared<MaxLexTargetGivenSource>(table),
+      make_shared<IsSourceSingleton>(),
+      make_shared<IsSourceTargetSingleton>()
+  };
+  shared_ptr<Scorer> scorer = make_shared<Scorer>(features);
+  shared_ptr<RuleCache> rule_cache;
+  if (vm["rule_cache_mb"].as<int>() > 0) {
+    rule_cache = make_shared<RuleCache>(
+        vm["rule_cache_mb"].as<int>() * (1LL << 20));
+  }
+  GrammarExtractor extractor(
+      source_suffix_array,
+      target_data_array,
+      alignment,
+      precomputation,
+      scorer,
+      vocabulary,
+      vm["min_gap_size"].as<int>(),
+      vm["max_rule_span"].as<int>(),
+      vm["max_nonterminals"].as<int>(),
+      vm["max_rule_symbols"].as<int>(),
+      vm["max_samples"].as<int>(),
+      vm["tight_phrases"].as<bool>(),
+      rule_cache);
+  MatchingsFinder finder(source_suffix_array);
+
+  string line;
+  vector<string> sentences;
+  while (getline(cin, line)) {
+    sentences.push_back(line);
+  }
+  if (sentences.empty()) {
+    cerr << "No sentences on the standard input" << endl;
+    return 1;
+  }
+
+  vector<double> lookup_times, extraction_times;
+  long long num_lookups = 0, num_rules = 0;
+  unordered_set<int> blacklisted_sentence_ids;
+  for (const string& sentence: sentences) {
+    istringstream buffer(sentence);
+    vector<string> words{istream_iterator<string>(buffer),
+                         istream_iterator<string>()};
+
+    Clock::time_point start_time = Clock::now();
+    vector<int> word_ids;
+    for (const string& word: words) {
+      word_ids.push_back(source_data_array->GetWordId(word));
+    }
+    for (size_t i = 0; i < word_ids.size(); ++i) {
+      PhraseLocation location;
+      for (size_t j = i; j < word_ids.size(); ++j) {
+        location = finder.Find(location, word_ids[j], j - i);
+        ++num_lookups;
+        if (location.IsEmpty()) {
+          break;
+        }
+      }
+    }
+    Clock::time_point stop_time = Clock::now();
+    lookup_times.push_back(GetDuration(start_time, stop_time));
+
+    start_time = Clock::now();
+    Grammar grammar = extractor.GetGrammar(sentence, blacklisted_sentence_ids);
+    stop_time = Clock::now();
+    extraction_times.push_back(GetDuration(start_time, stop_time));
+    num_rules += grammar.GetRules().size();
+  }
+
+  cout << sentences.size() << " sentences, " << num_lookups
+       << " suffix array lookups, " << num_rules << " rules" << endl;
+  PrintTimes("suffix array lookups", lookup_times);
+  PrintTimes("grammar extraction", extraction_times);
+  if (rule_cache != NULL) {
+    cout << "rule cache: " << rule_cache->GetHits() << " hits, "
+         << rule_cache->GetMisses() << " misses" << endl;
+  }
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "fast_intersector.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "data_array.h"
@@ -68,7 +69,7 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
     PhraseLocation& prefix_location, const Phrase& phrase,
     bool prefix_ends_with_x, int next_symbol) const {
   ExtendPhraseLocation(prefix_location);
-  vector<int> positions = *prefix_location.matchings;
+  const vector<int>& positions = *prefix_location.matchings;
   int num_subpatterns = prefix_location.num_subpatterns;
 
   vector<int> new_positions;
@@ -79,42 +80,42 @@ PhraseLocation FastIntersector::ExtendPrefixPhraseLocation(
     return PhraseLocation(new_positions, num_subpatterns);
   }
 
+  const vector<int>& data = data_array->GetData();
   pair<int, int> range = GetSearchRange(prefix_ends_with_x);
+  int offset = range.first;
+  if (prefix_ends_with_x) {
+    offset += phrase.GetChunkLen(phrase.Arity() - 1) - 1;
+  } else {
+    offset += phrase.GetChunkLen(phrase.Arity()) - 2;
+  }
   for (size_t i = 0; i < positions.size(); i += num_subpatterns) {
-    int sent_id = data_array->GetSentenceId(positions[i]);
-    int sent_end = data_array->GetSentenceStart(sent_id + 1) - 1;
-    int pattern_end = positions[i + num_subpatterns - 1] + range.first;
-    if (prefix_ends_with_x) {
-      pattern_end += phrase.GetChunkLen(phrase.Arity() - 1) - 1;
-    } else {
-      pattern_end += phrase.GetChunkLen(phrase.Arity()) - 2;
-    }
-    // Searches for the last symbol in the phrase after each prefix occurrence.
-    for (int j = range.first; j < range.second; ++j) {
-      if (pattern_end >= sent_end ||
-          pattern_end - positions[i] >= max_rule_span) {
-        break;
-      }
-
-      if (data_array->AtIndex(pattern_end) == data_array_symbol) {
+    // Searches for the last symbol in the phrase after each prefix occurrence,
+    // in the window of positions where it keeps the phrase inside the sentence
+    // and the maximum rule span.
+    int last_chunk_start = positions[i + num_subpatterns - 1];
+    int start = last_chunk_start + offset;
+    int end = min(start + range.second - range.first,
+                  positions[i] + max_rule_span);
+    end = FindSentenceEnd(data, last_chunk_start, end);
+    for (int pattern_end = start; pattern_end < end; ++pattern_end) {
+      if (data[pattern_end] == data_array_symbol) {
         new_positions.insert(new_positions.end(), positions.begin() + i,
                              positions.begin() + i + num_subpatterns);
         if (prefix_ends_with_x) {
           new_positions.push_back(pattern_end);
         }
       }
-      ++pattern_end;
     }
   }
 
-  return PhraseLocation(new_positions, phrase.Arity() + 1);
+  return PhraseLocation(move(new_positions), phrase.Arity() + 1);
 }
 
 PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
     PhraseLocation& suffix_location, const Phrase& phrase,
     bool suffix_starts_with_x, int prev_symbol) const {
   ExtendPhraseLocation(suffix_location);
-  vector<int> positions = *suffix_location.matchings;
+  const vector<int>& positions = *suffix_location.matchings;
   int num_subpatterns = suffix_location.num_subpatterns;
 
   vector<int> new_positions;
@@ -125,32 +126,49 @@ PhraseLocation FastIntersector::ExtendSuffixPhraseLocation(
     return PhraseLocation(new_positions, num_subpatterns);
   }
 
+  const vector<int>& data = data_array->GetData();
   pair<int, int> range = GetSearchRange(suffix_starts_with_x);
+  int last_chunk_len = phrase.GetChunkLen(phrase.Arity());
   for (size_t i = 0; i < positions.size(); i += num_subpatterns) {
-    int sent_id = data_array->GetSentenceId(positions[i]);
-    int sent_start = data_array->GetSentenceStart(sent_id);
-    int pattern_start = positions[i] - range.first;
-    int pattern_end = positions[i + num_subpatterns - 1] +
-        phrase.GetChunkLen(phrase.Arity()) - 1;
+    int pattern_end = positions[i + num_subpatterns - 1] + last_chunk_len - 1;
     // Searches for the first symbol in the phrase before each suffix
-    // occurrence.
-    for (int j = range.first; j < range.second; ++j) {
-      if (pattern_start < sent_start ||
-          pattern_end - pattern_start >= max_rule_span) {
-        break;
-      }
-
-      if (data_array->AtIndex(pattern_start) == data_array_symbol) {
+    // occurrence, in the window of positions where it keeps the phrase inside
+    // the sentence and the maximum rule span.
+    int start = max(positions[i] - range.second + 1,
+                    max(0, pattern_end - max_rule_span + 1));
+    start = FindSentenceStart(data, start, positions[i]);
+    int end = positions[i] - range.first + 1;
+    for (int pattern_start = end - 1; pattern_start >= start; --pattern_start) {
+      if (data[pattern_start] == data_array_symbol) {
         new_positions.push_back(pattern_start);
         new_positions.insert(new_positions.end(),
                              positions.begin() + i + !suffix_starts_with_x,
                              positions.begin() + i + num_subpatterns);
       }
-      --pattern_start;
     }
   }
 
-  return PhraseLocation(new_positions, phrase.Arity() + 1);
+  return PhraseLocation(move(new_positions), phrase.Arity() + 1);
+}
+
+int FastIntersector::FindSentenceEnd(const vector<int>& data, int start,
+                                     int end) const {
+  for (int i = start; i < end; ++i) {
+    if (data[i] == DataArray::END_OF_LINE) {
+      return i;
+    }
+  }
+  return end;
+}
+
+int FastIntersector::FindSentenceStart(const vector<int>& data, int start,
+                                       int end) const {
+  for (int i = end - 1; i >= start; --i) {
+    if (data[i] == DataArray::END_OF_LINE) {
+      return i + 1;
+    }
+  }
+  return start;
 }
 
 void FastIntersector::ExtendPhraseLocation(PhraseLocation& location) const {
@@ -160,6 +178,7 @@ void FastIntersector::ExtendPhraseLocation(PhraseLocation& location) const {
 
   location.num_subpatterns = 1;
   location.matchings = make_shared<vector<int>>();
+  location.matchings->reserve(location.sa_high - location.sa_low);
   for (int i = location.sa_low; i < location.sa_high; ++i) {
     location.matchings->push_back(suffix_array->GetSuffix(i));
   }
@@ -71,6 +71,16 @@ class FastIntersector {
                                             bool suffix_starts_with_x,
                                             int prev_symbol) const;
 
+  // Returns the position of the first END_OF_LINE marker in data[start, end),
+  // or end if there is none. Since every sentence in the data array ends with
+  // such a marker, this finds the end of a sentence without looking up the
+  // sentence of the occurrence.
+  int FindSentenceEnd(const vector<int>& data, int start, int end) const;
+
+  // Returns the position following the last END_OF_LINE marker in
+  // data[start, end), or start if there is none.
+  int FindSentenceStart(const vector<int>& data, int start, int end) const;
+
   // Extends the prefix/suffix location to a list of subpatterns positions if it
   // represents a suffix array range.
   void ExtendPhraseLocation(PhraseLocation& location) const;
@@ -0,0 +1,146 @@
+// Measures the time spent by FastIntersector on gapped patterns a X b and
+// a X b X c whose terminals are the most frequent words of a synthetic corpus
+// (the words of each sentence are drawn from a Zipf distribution). Such
+// patterns are the most expensive ones to intersect, since every occurrence
+// of the rarer side is checked against a window of max_rule_span positions.
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "data_array.h"
+#include "fast_intersector.h"
+#include "phrase.h"
+#include "phrase_builder.h"
+#include "phrase_location.h"
+#include "precomputation.h"
+#include "suffix_array.h"
+#include "time_util.h"
+#include "vocabulary.h"
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+using namespace std;
+using namespace extractor;
+
+// Writes a corpus of random sentences to the given file.
+void WriteCorpus(const string& filename, int num_sentences, int sentence_len,
+                 int vocabulary_size) {
+  vector<double> cumulative(vocabulary_size);
+  double total = 0;
+  for (int i = 0; i < vocabulary_size; ++i) {
+    total += 1.0 / (i + 1);
+    cumulative[i] = total;
+  }
+
+  ofstream out(filename.c_str());
+  unsigned long long state = 12345;
+  for (int i = 0; i < num_sentences; ++i) {
+    for (int j = 0; j < sentence_len; ++j) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      double r = (state >> 11) * (1.0 / 9007199254740992.0) * total;
+      int word = lower_bound(cumulative.begin(), cumulative.end(), r) -
+          cumulative.begin();
+      out << (j ? " " : "") << "w" << word;
+    }
+    out << "\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  po::options_description desc("Command line options");
+  desc.add_options()
+    ("help,h", "Show available options")
+    ("sentences", po::value<int>()->default_value(100000),
+        "Number of sentences in the synthetic corpus")
+    ("sentence_len", po::value<int>()->default_value(25),
+        "Number of words in each sentence")
+    ("vocabulary", po::value<int>()->default_value(10000),
+        "Number of distinct words")
+    ("frequent", po::value<int>()->default_value(8),
+        "Number of frequent words used to build patterns")
+    ("max_rule_span", po::value<int>()->default_value(15),
+        "Maximum rule span")
+    ("min_gap_size", po::value<int>()->default_value(1), "Minimum gap size")
+    ("repeats", po::value<int>()->default_value(3),
+        "Number of times each pattern is intersected");
+
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, desc), vm);
+  if (vm.count("help")) {
+    cout << desc << endl;
+    return 0;
+  }
+  po::notify(vm);
+
+  fs::path corpus = fs::temp_directory_path() / fs::unique_path();
+  WriteCorpus(corpus.string(), vm["sentences"].as<int>(),
+              vm["sentence_len"].as<int>(), vm["vocabulary"].as<int>());
+  shared_ptr<DataArray> data_array = make_shared<DataArray>(corpus.string());
+  fs::remove(corpus);
+  shared_ptr<SuffixArray> suffix_array = make_shared<SuffixArray>(data_array);
+  shared_ptr<Vocabulary> vocabulary = make_shared<Vocabulary>();
+  FastIntersector intersector(suffix_array, make_shared<Precomputation>(),
+      vocabulary, vm["max_rule_span"].as<int>(),
+      vm["min_gap_size"].as<int>());
+  PhraseBuilder phrase_builder(vocabulary);
+
+  // The words are numbered by decreasing frequency.
+  vector<int> words;
+  vector<PhraseLocation> locations;
+  for (int i = 0; i < vm["frequent"].as<int>(); ++i) {
+    string word = "w" + to_string(i);
+    words.push_back(vocabulary->GetTerminalIndex(word));
+    locations.push_back(suffix_array->Lookup(
+        0, suffix_array->GetSize(), data_array->GetWordId(word), 0));
+  }
+
+  int x1 = vocabulary->GetNonterminalIndex(1);
+  int x2 = vocabulary->GetNonterminalIndex(2);
+  double time_two = 0, time_three = 0;
+  long long num_two = 0, num_three = 0, num_patterns = 0;
+  for (int repeat = 0; repeat < vm["repeats"].as<int>(); ++repeat) {
+    for (size_t a = 0; a < words.size(); ++a) {
+      for (size_t b = 0; b < words.size(); ++b) {
+        // a X b, from the occurrences of a and b.
+        Phrase phrase = phrase_builder.Build({words[a], x1, words[b]});
+        PhraseLocation prefix = locations[a], suffix = locations[b];
+        Clock::time_point start_time = Clock::now();
+        PhraseLocation location = intersector.Intersect(prefix, suffix, phrase);
+        time_two += GetDuration(start_time, Clock::now());
+        num_two += location.GetSize() / 2;
+        ++num_patterns;
+
+        // a X b X c, from the occurrences of a X b and b X c.
+        size_t c = (a + b) % words.size();
+        Phrase suffix_phrase = phrase_builder.Build({words[b], x1, words[c]});
+        PhraseLocation suffix_prefix = locations[b];
+        PhraseLocation suffix_suffix = locations[c];
+        PhraseLocation suffix_location = intersector.Intersect(
+            suffix_prefix, suffix_suffix, suffix_phrase);
+        Phrase long_phrase = phrase_builder.Build(
+            {words[a], x1, words[b], x2, words[c]});
+        start_time = Clock::now();
+        location = intersector.Intersect(location, suffix_location,
+                                         long_phrase);
+        time_three += GetDuration(start_time, Clock::now());
+        num_three += location.GetSize() / 3;
+      }
+    }
+  }
+
+  cout << data_array->GetSize() << " words, " << num_patterns
+       << " intersections of each kind" << endl;
+  cout << "a X b: " << time_two << " seconds, " << num_two
+       << " occurrences" << endl;
+  cout << "a X b X c: " << time_three << " seconds, " << num_three
+       << " occurrences" << endl;
+  return 0;
+}
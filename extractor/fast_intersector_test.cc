@@ -30,22 +30,15 @@ class FastIntersectorTest : public Test {
           .WillRepeatedly(Return(words[i]));
     }
 
-    vector<int> data = {1, 2, 3, 4, 1, 5, 3, 6, 1,
-                        7, 3, 8, 4, 1, 9, 3, 10, 11, 0};
+    // The data array ids are the vocabulary ids shifted by one, so that "EOL"
+    // is the END_OF_LINE marker.
+    data = {2, 3, 4, 5, 2, 6, 4, 7, 2, 8, 4, 9, 5, 2, 10, 4, 11, 12, 1};
     data_array = make_shared<MockDataArray>();
-    for (size_t i = 0; i < data.size(); ++i) {
-      EXPECT_CALL(*data_array, AtIndex(i)).WillRepeatedly(Return(data[i]));
-      EXPECT_CALL(*data_array, GetSentenceId(i))
-          .WillRepeatedly(Return(0));
-    }
-    EXPECT_CALL(*data_array, GetSentenceStart(0))
-        .WillRepeatedly(Return(0));
-    EXPECT_CALL(*data_array, GetSentenceStart(1))
-        .WillRepeatedly(Return(19));
+    EXPECT_CALL(*data_array, GetData()).WillRepeatedly(ReturnRef(data));
     for (size_t i = 0; i < words.size(); ++i) {
       EXPECT_CALL(*data_array, GetWordId(words[i]))
-          .WillRepeatedly(Return(i));
-      EXPECT_CALL(*data_array, GetWord(i))
+          .WillRepeatedly(Return(i + 1));
+      EXPECT_CALL(*data_array, GetWord(i + 1))
           .WillRepeatedly(Return(words[i]));
     }
 
@@ -66,6 +59,7 @@ class FastIntersectorTest : public Test {
                                                vocabulary, 15, 1);
   }
 
+  vector<int> data;
   shared_ptr<MockDataArray> data_array;
   shared_ptr<MockSuffixArray> suffix_array;
   shared_ptr<MockPrecomputation> precomputation;
@@ -140,5 +134,71 @@ TEST_F(FastIntersectorTest, TestIntersectCheckEstimates) {
   EXPECT_EQ(PhraseLocation(10, 12), suffix_location);
 }
 
+class FastIntersectorWindowTest : public Test {
+ protected:
+  virtual void SetUp() {
+    // Two sentences: "a b a" and "b a a a b".
+    data = {2, 3, 2, 1, 3, 2, 2, 2, 3, 1};
+    data_array = make_shared<MockDataArray>();
+    EXPECT_CALL(*data_array, GetData()).WillRepeatedly(ReturnRef(data));
+    EXPECT_CALL(*data_array, GetWordId("a")).WillRepeatedly(Return(2));
+    EXPECT_CALL(*data_array, GetWordId("b")).WillRepeatedly(Return(3));
+
+    vocabulary = make_shared<MockVocabulary>();
+    EXPECT_CALL(*vocabulary, GetTerminalValue(2)).WillRepeatedly(Return("a"));
+    EXPECT_CALL(*vocabulary, GetTerminalValue(3)).WillRepeatedly(Return("b"));
+
+    suffix_array = make_shared<MockSuffixArray>();
+    EXPECT_CALL(*suffix_array, GetData()).WillRepeatedly(Return(data_array));
+
+    precomputation = make_shared<MockPrecomputation>();
+    EXPECT_CALL(*precomputation, Contains(_)).WillRepeatedly(Return(false));
+
+    phrase_builder = make_shared<PhraseBuilder>(vocabulary);
+    a_locations = {0, 2, 5, 6, 7};
+    b_locations = {1, 4, 8};
+  }
+
+  PhraseLocation Intersect(const vector<int>& symbols, int max_rule_span,
+                           const vector<int>& prefix_locs,
+                           const vector<int>& suffix_locs) {
+    FastIntersector intersector(suffix_array, precomputation, vocabulary,
+                                max_rule_span, 1);
+    PhraseLocation prefix_location(prefix_locs, 1);
+    PhraseLocation suffix_location(suffix_locs, 1);
+    return intersector.Intersect(prefix_location, suffix_location,
+                                 phrase_builder->Build(symbols));
+  }
+
+  vector<int> data, a_locations, b_locations;
+  shared_ptr<MockDataArray> data_array;
+  shared_ptr<MockSuffixArray> suffix_array;
+  shared_ptr<MockPrecomputation> precomputation;
+  shared_ptr<MockVocabulary> vocabulary;
+  shared_ptr<PhraseBuilder> phrase_builder;
+};
+
+TEST_F(FastIntersectorWindowTest, TestExtendPrefixWithinSentence) {
+  // b X a is found by extending the (less frequent) occurrences of b.
+  vector<int> expected_locs = {4, 6, 4, 7};
+  EXPECT_EQ(PhraseLocation(expected_locs, 2),
+            Intersect({3, -1, 2}, 15, b_locations, a_locations));
+
+  expected_locs = {4, 6};
+  EXPECT_EQ(PhraseLocation(expected_locs, 2),
+            Intersect({3, -1, 2}, 3, b_locations, a_locations));
+}
+
+TEST_F(FastIntersectorWindowTest, TestExtendSuffixWithinSentence) {
+  // a X b is found by extending the (less frequent) occurrences of b.
+  vector<int> expected_locs = {6, 8, 5, 8};
+  EXPECT_EQ(PhraseLocation(expected_locs, 2),
+            Intersect({2, -1, 3}, 15, a_locations, b_locations));
+
+  expected_locs = {6, 8};
+  EXPECT_EQ(PhraseLocation(expected_locs, 2),
+            Intersect({2, -1, 3}, 3, a_locations, b_locations));
+}
+
 } // namespace
 } // namespace extractor
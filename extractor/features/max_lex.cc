@@ -0,0 +1,36 @@
+#include "max_lex.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "data_array.h"
+#include "translation_table.h"
+
+namespace extractor {
+namespace features {
+
+double ScoreMaxLex(const FeatureContext& context,
+                   shared_ptr<TranslationTable> table,
+                   bool source_given_target) {
+  vector<string> source_words = context.source_phrase.GetWords();
+  vector<string> target_words = context.target_phrase.GetWords();
+  // The words being explained and the words explaining them (or NULL).
+  vector<string>& explained = source_given_target ? source_words : target_words;
+  vector<string>& given = source_given_target ? target_words : source_words;
+  given.push_back(DataArray::NULL_WORD_STR);
+
+  double score = 0;
+  for (const string& explained_word: explained) {
+    double max_score = 0;
+    for (const string& given_word: given) {
+      max_score = max(max_score, source_given_target ?
+          table->GetSourceGivenTargetScore(explained_word, given_word) :
+          table->GetTargetGivenSourceScore(given_word, explained_word));
+    }
+    score += max_score > 0 ? -log10(max_score) : Feature::MAX_SCORE;
+  }
+  return score;
+}
+
+} // namespace features
+} // namespace extractor
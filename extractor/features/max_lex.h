@@ -0,0 +1,27 @@
+#ifndef _MAX_LEX_H_
+#define _MAX_LEX_H_
+
+#include <memory>
+
+#include "feature.h"
+
+using namespace std;
+
+namespace extractor {
+
+class TranslationTable;
+
+namespace features {
+
+// Computes the max lex score of a phrase pair: p(f | e) if source_given_target
+// is true, where each source word is explained by its best target word or by
+// NULL, and p(e | f) otherwise. Shared by MaxLexSourceGivenTarget and
+// MaxLexTargetGivenSource.
+double ScoreMaxLex(const FeatureContext& context,
+                   shared_ptr<TranslationTable> table,
+                   bool source_given_target);
+
+} // namespace features
+} // namespace extractor
+
+#endif
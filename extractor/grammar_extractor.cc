@@ -6,7 +6,9 @@
 #include <unordered_set>
 
 #include "grammar.h"
+#include "online_bitext.h"
 #include "rule.h"
+#include "rule_extractor.h"
 #include "rule_factory.h"
 #include "vocabulary.h"
 #include "data_array.h"
@@ -22,25 +24,38 @@ GrammarExtractor::GrammarExtractor(
     shared_ptr<Scorer> scorer, shared_ptr<Vocabulary> vocabulary,
     int min_gap_size, int max_rule_span,
     int max_nonterminals, int max_rule_symbols, int max_samples,
-    bool require_tight_phrases) :
+    bool require_tight_phrases, shared_ptr<RuleCache> rule_cache,
+    shared_ptr<OnlineBitext> online_bitext) :
     vocabulary(vocabulary),
     rule_factory(make_shared<HieroCachingRuleFactory>(
         source_suffix_array, target_data_array, alignment, vocabulary,
         precomputation, scorer, min_gap_size, max_rule_span, max_nonterminals,
-        max_rule_symbols, max_samples, require_tight_phrases)) {}
+        max_rule_symbols, max_samples, require_tight_phrases, rule_cache)),
+    online_bitext(online_bitext) {}
 
 GrammarExtractor::GrammarExtractor(
     shared_ptr<Vocabulary> vocabulary,
-    shared_ptr<HieroCachingRuleFactory> rule_factory) :
+    shared_ptr<HieroCachingRuleFactory> rule_factory,
+    shared_ptr<OnlineBitext> online_bitext) :
     vocabulary(vocabulary),
-    rule_factory(rule_factory) {}
+    rule_factory(rule_factory),
+    online_bitext(online_bitext) {}
 
 Grammar GrammarExtractor::GetGrammar(
     const string& sentence,
     const unordered_set<int>& blacklisted_sentence_ids) {
   vector<string> words = TokenizeSentence(sentence);
   vector<int> word_ids = AnnotateWords(words);
-  return rule_factory->GetGrammar(word_ids, blacklisted_sentence_ids);
+  if (online_bitext == NULL || online_bitext->GetNumSentences() == 0) {
+    return rule_factory->GetGrammar(word_ids, blacklisted_sentence_ids);
+  }
+
+  map<Phrase, RuleStatistics> statistics =
+      rule_factory->GetStatistics(word_ids, blacklisted_sentence_ids);
+  for (const auto& entry: online_bitext->GetStatistics(word_ids)) {
+    statistics[entry.first].Merge(entry.second);
+  }
+  return rule_factory->ScoreRules(statistics);
 }
 
 vector<string> GrammarExtractor::TokenizeSentence(const string& sentence) {
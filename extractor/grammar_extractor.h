@@ -14,7 +14,9 @@ class Alignment;
 class DataArray;
 class Grammar;
 class HieroCachingRuleFactory;
+class OnlineBitext;
 class Precomputation;
+class RuleCache;
 class Scorer;
 class SuffixArray;
 class Vocabulary;
@@ -22,6 +24,10 @@ class Vocabulary;
 /**
  * Class wrapping all the logic for extracting the synchronous context free
  * grammars.
+ *
+ * If an OnlineBitext with sentence pairs is given, the rules are extracted from
+ * both the compiled data and the added sentence pairs, and their counts are
+ * merged before scoring (the rule cache is bypassed).
  */
 class GrammarExtractor {
  public:
@@ -37,11 +43,15 @@ class GrammarExtractor {
       int max_nonterminals,
       int max_rule_symbols,
       int max_samples,
-      bool require_tight_phrases);
+      bool require_tight_phrases,
+      shared_ptr<RuleCache> rule_cache = shared_ptr<RuleCache>(),
+      shared_ptr<OnlineBitext> online_bitext = shared_ptr<OnlineBitext>());
 
   // For testing only.
   GrammarExtractor(shared_ptr<Vocabulary> vocabulary,
-                   shared_ptr<HieroCachingRuleFactory> rule_factory);
+                   shared_ptr<HieroCachingRuleFactory> rule_factory,
+                   shared_ptr<OnlineBitext> online_bitext =
+                       shared_ptr<OnlineBitext>());
 
   // Converts the sentence to a vector of word ids and uses the RuleFactory to
   // extract the SCFG rules which may be used to decode the sentence.
@@ -58,6 +68,7 @@ class GrammarExtractor {
 
   shared_ptr<Vocabulary> vocabulary;
   shared_ptr<HieroCachingRuleFactory> rule_factory;
+  shared_ptr<OnlineBitext> online_bitext;
 };
 
 } // namespace extractor
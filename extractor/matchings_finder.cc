@@ -13,13 +13,14 @@ MatchingsFinder::MatchingsFinder() {}
 MatchingsFinder::~MatchingsFinder() {}
 
 PhraseLocation MatchingsFinder::Find(PhraseLocation& location,
-                                     const string& word, int offset) {
+                                     int word_id, int offset) {
   if (location.sa_low == -1 && location.sa_high == -1) {
     location.sa_low = 0;
     location.sa_high = suffix_array->GetSize();
   }
 
-  return suffix_array->Lookup(location.sa_low, location.sa_high, word, offset);
+  return suffix_array->Lookup(location.sa_low, location.sa_high, word_id,
+                              offset);
 }
 
 } // namespace extractor
@@ -2,7 +2,6 @@
 #define _MATCHINGS_FINDER_H_
 
 #include <memory>
-#include <string>
 
 using namespace std;
 
@@ -21,8 +20,10 @@ class MatchingsFinder {
   virtual ~MatchingsFinder();
 
   // Uses the suffix array to search only for the last word of the phrase
-  // starting from the range in which the prefix of the phrase occurs.
-  virtual PhraseLocation Find(PhraseLocation& location, const string& word,
+  // starting from the range in which the prefix of the phrase occurs. The word
+  // is given by its id in the data array of the suffix array (-1 if it doesn't
+  // occur in the data).
+  virtual PhraseLocation Find(PhraseLocation& location, int word_id,
                               int offset);
 
  protected:
@@ -16,7 +16,7 @@ class MatchingsFinderTest : public Test {
  protected:
   virtual void SetUp() {
     suffix_array = make_shared<MockSuffixArray>();
-    EXPECT_CALL(*suffix_array, Lookup(0, 10, _, _))
+    EXPECT_CALL(*suffix_array, Lookup(0, 10, 4, 2))
         .Times(1)
         .WillOnce(Return(PhraseLocation(3, 5)));
 
@@ -29,14 +29,14 @@ class MatchingsFinderTest : public Test {
 
 TEST_F(MatchingsFinderTest, TestFind) {
   PhraseLocation phrase_location(0, 10), expected_result(3, 5);
-  EXPECT_EQ(expected_result, matchings_finder->Find(phrase_location, "bla", 2));
+  EXPECT_EQ(expected_result, matchings_finder->Find(phrase_location, 4, 2));
 }
 
 TEST_F(MatchingsFinderTest, ResizeUnsetRange) {
   EXPECT_CALL(*suffix_array, GetSize()).Times(1).WillOnce(Return(10));
 
   PhraseLocation phrase_location, expected_result(3, 5);
-  EXPECT_EQ(expected_result, matchings_finder->Find(phrase_location, "bla", 2));
+  EXPECT_EQ(expected_result, matchings_finder->Find(phrase_location, 4, 2));
   EXPECT_EQ(PhraseLocation(0, 10), phrase_location);
 }
 
@@ -1,29 +1,54 @@
 #include "matchings_trie.h"
 
+#include <algorithm>
+
 namespace extractor {
 
-MatchingsTrie::MatchingsTrie() {
-  root = make_shared<TrieNode>();
+namespace {
+
+bool KeyLess(const pair<int, TrieNode*>& child, int key) {
+  return child.first < key;
 }
 
-MatchingsTrie::~MatchingsTrie() {
-  DeleteTree(root);
+} // namespace
+
+void TrieNode::AddChild(int key, TrieNode* child_node) {
+  auto it = lower_bound(children.begin(), children.end(), key, KeyLess);
+  if (it != children.end() && it->first == key) {
+    it->second = child_node;
+  } else {
+    children.insert(it, make_pair(key, child_node));
+  }
 }
 
-shared_ptr<TrieNode> MatchingsTrie::GetRoot() const {
-  return root;
+bool TrieNode::HasChild(int key) const {
+  auto it = lower_bound(children.begin(), children.end(), key, KeyLess);
+  return it != children.end() && it->first == key;
 }
 
-void MatchingsTrie::DeleteTree(shared_ptr<TrieNode> root) {
-  if (root != NULL) {
-    for (auto child: root->children) {
-      DeleteTree(child.second);
-    }
-    if (root->suffix_link != NULL) {
-      root->suffix_link.reset();
-    }
-    root.reset();
+TrieNode* TrieNode::GetChild(int key) const {
+  auto it = lower_bound(children.begin(), children.end(), key, KeyLess);
+  if (it != children.end() && it->first == key) {
+    return it->second;
   }
+  return NULL;
+}
+
+MatchingsTrie::MatchingsTrie() {
+  nodes.emplace_back();
+}
+
+MatchingsTrie::~MatchingsTrie() {}
+
+TrieNode* MatchingsTrie::GetRoot() {
+  return &nodes.front();
+}
+
+TrieNode* MatchingsTrie::CreateNode(TrieNode* suffix_link,
+                                    const Phrase& phrase,
+                                    const PhraseLocation& matchings) {
+  nodes.emplace_back(suffix_link, phrase, matchings);
+  return &nodes.back();
 }
 
 } // namespace extractor
@@ -1,8 +1,9 @@
 #ifndef _MATCHINGS_TRIE_
 #define _MATCHINGS_TRIE_
 
-#include <memory>
-#include <unordered_map>
+#include <deque>
+#include <utility>
+#include <vector>
 
 #include "phrase.h"
 #include "phrase_location.h"
@@ -14,36 +15,37 @@ namespace extractor {
 /**
  * Trie node containing all the occurrences of the corresponding phrase in the
  * source data.
+ *
+ * The nodes are owned by the MatchingsTrie they belong to. The children are
+ * kept in a vector sorted by key, since most nodes have very few of them.
  */
 struct TrieNode {
-  TrieNode(shared_ptr<TrieNode> suffix_link = shared_ptr<TrieNode>(),
+  TrieNode(TrieNode* suffix_link = NULL,
            Phrase phrase = Phrase(),
            PhraseLocation matchings = PhraseLocation()) :
       suffix_link(suffix_link), phrase(phrase), matchings(matchings) {}
 
-  // Adds a trie node as a child of the current node.
-  void AddChild(int key, shared_ptr<TrieNode> child_node) {
-    children[key] = child_node;
-  }
+  // Adds a trie node as a child of the current node. A NULL child marks a
+  // phrase without any occurrences in the source data.
+  void AddChild(int key, TrieNode* child_node);
 
   // Checks if a child exists for a given key.
-  bool HasChild(int key) {
-    return children.count(key);
-  }
+  bool HasChild(int key) const;
 
-  // Gets the child corresponding to the given key.
-  shared_ptr<TrieNode> GetChild(int key) {
-    return children[key];
-  }
+  // Gets the child corresponding to the given key (NULL if there is none).
+  TrieNode* GetChild(int key) const;
 
-  shared_ptr<TrieNode> suffix_link;
+  TrieNode* suffix_link;
   Phrase phrase;
   PhraseLocation matchings;
-  unordered_map<int, shared_ptr<TrieNode>> children;
+  vector<pair<int, TrieNode*>> children;
 };
 
 /**
  * Trie containing all the phrases that can be obtained from a sentence.
+ *
+ * The nodes are allocated in an arena and released all at once when the trie
+ * is destroyed.
  */
 class MatchingsTrie {
  public:
@@ -52,13 +54,19 @@ class MatchingsTrie {
   virtual ~MatchingsTrie();
 
   // Returns the root of the trie.
-  shared_ptr<TrieNode> GetRoot() const;
+  TrieNode* GetRoot();
+
+  // Creates a new node, which lives as long as the trie.
+  TrieNode* CreateNode(TrieNode* suffix_link,
+                       const Phrase& phrase = Phrase(),
+                       const PhraseLocation& matchings = PhraseLocation());
 
  private:
-  // Recursively deletes a subtree of the trie.
-  void DeleteTree(shared_ptr<TrieNode> root);
+  MatchingsTrie(const MatchingsTrie&);
+  MatchingsTrie& operator=(const MatchingsTrie&);
 
-  shared_ptr<TrieNode> root;
+  // A deque never moves its elements, so the nodes may point to each other.
+  deque<TrieNode> nodes;
 };
 
 } // namespace extractor
@@ -7,7 +7,7 @@ namespace extractor {
 
 class MockMatchingsFinder : public MatchingsFinder {
  public:
-  MOCK_METHOD3(Find, PhraseLocation(PhraseLocation&, const string&, int));
+  MOCK_METHOD3(Find, PhraseLocation(PhraseLocation&, int, int));
 };
 
 } // namespace extractor
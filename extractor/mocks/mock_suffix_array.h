@@ -17,7 +17,7 @@ class MockSuffixArray : public SuffixArray {
   MOCK_CONST_METHOD0(GetData, shared_ptr<DataArray>());
   MOCK_CONST_METHOD0(BuildLCPArray, vector<int>());
   MOCK_CONST_METHOD1(GetSuffix, int(int));
-  MOCK_CONST_METHOD4(Lookup, PhraseLocation(int, int, const string& word, int));
+  MOCK_CONST_METHOD4(Lookup, PhraseLocation(int, int, int, int));
 };
 
 } // namespace extractor
@@ -0,0 +1,89 @@
+#include "online_bitext.h"
+
+#include <iterator>
+#include <sstream>
+#include <unordered_set>
+
+#include "alignment.h"
+#include "data_array.h"
+#include "precomputation.h"
+#include "rule_extractor.h"
+#include "rule_factory.h"
+#include "suffix_array.h"
+#include "translation_table.h"
+
+namespace extractor {
+
+OnlineBitext::OnlineBitext(
+    shared_ptr<Vocabulary> vocabulary, shared_ptr<Scorer> scorer,
+    shared_ptr<TranslationTable> table, int min_gap_size, int max_rule_span,
+    int max_nonterminals, int max_rule_symbols, int max_samples,
+    bool require_tight_phrases) :
+    vocabulary(vocabulary),
+    scorer(scorer),
+    table(table),
+    min_gap_size(min_gap_size),
+    max_rule_span(max_rule_span),
+    max_nonterminals(max_nonterminals),
+    max_rule_symbols(max_rule_symbols),
+    max_samples(max_samples),
+    require_tight_phrases(require_tight_phrases) {}
+
+OnlineBitext::~OnlineBitext() {}
+
+bool OnlineBitext::AddSentencePair(const string& source_sentence,
+                                   const string& target_sentence,
+                                   const vector<pair<int, int>>& links) {
+  vector<string> source_words = TokenizeSentence(source_sentence);
+  vector<string> target_words = TokenizeSentence(target_sentence);
+  for (pair<int, int> link: links) {
+    if (link.first < 0 || link.first >= source_words.size() ||
+        link.second < 0 || link.second >= target_words.size()) {
+      return false;
+    }
+  }
+
+  source_sentences.push_back(source_sentence);
+  target_sentences.push_back(target_sentence);
+  alignments.push_back(links);
+  if (table != NULL) {
+    table->AddSentencePair(source_words, target_words, links);
+  }
+
+  // The index is rebuilt by the next call to GetStatistics, so that a run of
+  // added sentence pairs costs a single rebuild.
+  rule_factory.reset();
+  return true;
+}
+
+int OnlineBitext::GetNumSentences() const {
+  return source_sentences.size();
+}
+
+map<Phrase, RuleStatistics> OnlineBitext::GetStatistics(
+    const vector<int>& word_ids) {
+  if (source_sentences.empty()) {
+    return map<Phrase, RuleStatistics>();
+  }
+
+  if (rule_factory == NULL) {
+    // The precomputation of frequent patterns doesn't pay off for such little
+    // data, so the gapped phrases are always found by intersection.
+    shared_ptr<SuffixArray> source_suffix_array = make_shared<SuffixArray>(
+        make_shared<DataArray>(source_sentences));
+    rule_factory = make_shared<HieroCachingRuleFactory>(
+        source_suffix_array, make_shared<DataArray>(target_sentences),
+        make_shared<Alignment>(alignments), vocabulary,
+        make_shared<Precomputation>(), scorer, min_gap_size, max_rule_span,
+        max_nonterminals, max_rule_symbols, max_samples, require_tight_phrases);
+  }
+  return rule_factory->GetStatistics(word_ids, unordered_set<int>());
+}
+
+vector<string> OnlineBitext::TokenizeSentence(const string& sentence) const {
+  istringstream buffer(sentence);
+  return vector<string>(istream_iterator<string>(buffer),
+                        istream_iterator<string>());
+}
+
+} // namespace extractor
@@ -0,0 +1,85 @@
+#ifndef _ONLINE_BITEXT_H_
+#define _ONLINE_BITEXT_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "phrase.h"
+
+using namespace std;
+
+namespace extractor {
+
+class HieroCachingRuleFactory;
+struct RuleStatistics;
+class Scorer;
+class TranslationTable;
+class Vocabulary;
+
+/**
+ * Sentence pairs added to the parallel corpus after it has been compiled (e.g.
+ * the post-edited translations of an interactive session).
+ *
+ * The added sentence pairs have their own data arrays, alignment and source
+ * suffix array, which are rebuilt the first time rules are extracted after
+ * sentence pairs were added (the added data is expected to be small compared
+ * to the compiled corpus). Rules are extracted from them with the same
+ * settings as from the compiled corpus, so that the counts of the two can be
+ * merged before scoring. If a translation table is given, the links of the
+ * added sentence pairs are also counted in it.
+ *
+ * Sentence pairs must not be added while grammars are being extracted.
+ */
+class OnlineBitext {
+ public:
+  OnlineBitext(shared_ptr<Vocabulary> vocabulary,
+               shared_ptr<Scorer> scorer,
+               shared_ptr<TranslationTable> table,
+               int min_gap_size,
+               int max_rule_span,
+               int max_nonterminals,
+               int max_rule_symbols,
+               int max_samples,
+               bool require_tight_phrases);
+
+  virtual ~OnlineBitext();
+
+  // Adds a (tokenized) sentence pair and its word alignment. Returns false and
+  // leaves the bitext unchanged if one of the links is out of range.
+  bool AddSentencePair(const string& source_sentence,
+                       const string& target_sentence,
+                       const vector<pair<int, int>>& links);
+
+  // Returns the number of sentence pairs added so far.
+  int GetNumSentences() const;
+
+  // Counts the phrase pairs extracted from the added sentence pairs for each
+  // source phrase of the sentence (given as a vector of word ids).
+  map<Phrase, RuleStatistics> GetStatistics(const vector<int>& word_ids);
+
+ private:
+  // Splits the sentence in a vector of words.
+  vector<string> TokenizeSentence(const string& sentence) const;
+
+  shared_ptr<Vocabulary> vocabulary;
+  shared_ptr<Scorer> scorer;
+  shared_ptr<TranslationTable> table;
+  int min_gap_size;
+  int max_rule_span;
+  int max_nonterminals;
+  int max_rule_symbols;
+  int max_samples;
+  bool require_tight_phrases;
+
+  vector<string> source_sentences;
+  vector<string> target_sentences;
+  vector<vector<pair<int, int>>> alignments;
+  // Built from the sentence pairs above when it is first needed.
+  shared_ptr<HieroCachingRuleFactory> rule_factory;
+};
+
+} // namespace extractor
+
+#endif
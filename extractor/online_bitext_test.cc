@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alignment.h"
+#include "data_array.h"
+#include "features/count_source_target.h"
+#include "features/feature.h"
+#include "online_bitext.h"
+#include "phrase.h"
+#include "phrase_builder.h"
+#include "rule_extractor.h"
+#include "scorer.h"
+#include "translation_table.h"
+#include "vocabulary.h"
+
+using namespace std;
+using namespace ::testing;
+
+namespace extractor {
+namespace {
+
+class OnlineBitextTest : public Test {
+ protected:
+  virtual void SetUp() {
+    vocabulary = make_shared<Vocabulary>();
+    vector<shared_ptr<features::Feature>> features = {
+        make_shared<features::CountSourceTarget>()
+    };
+    vector<string> no_sentences;
+    table = make_shared<TranslationTable>(
+        make_shared<DataArray>(no_sentences),
+        make_shared<DataArray>(no_sentences), make_shared<Alignment>());
+    bitext = make_shared<OnlineBitext>(vocabulary, make_shared<Scorer>(features),
+                                       table, 1, 10, 2, 5, 300, true);
+    phrase_builder = make_shared<PhraseBuilder>(vocabulary);
+  }
+
+  vector<int> GetWordIds(const vector<string>& words) {
+    vector<int> word_ids;
+    for (const string& word: words) {
+      word_ids.push_back(vocabulary->GetTerminalIndex(word));
+    }
+    return word_ids;
+  }
+
+  shared_ptr<Vocabulary> vocabulary;
+  shared_ptr<TranslationTable> table;
+  shared_ptr<OnlineBitext> bitext;
+  shared_ptr<PhraseBuilder> phrase_builder;
+};
+
+TEST_F(OnlineBitextTest, TestEmpty) {
+  EXPECT_EQ(0, bitext->GetNumSentences());
+  EXPECT_TRUE(bitext->GetStatistics(GetWordIds({"a", "b"})).empty());
+}
+
+TEST_F(OnlineBitextTest, TestInvalidLinks) {
+  EXPECT_FALSE(bitext->AddSentencePair("a b", "x y", {make_pair(2, 0)}));
+  EXPECT_FALSE(bitext->AddSentencePair("a b", "x y", {make_pair(0, 2)}));
+  EXPECT_EQ(0, bitext->GetNumSentences());
+  EXPECT_EQ(-1, table->GetTargetGivenSourceScore("a", "x"));
+}
+
+TEST_F(OnlineBitextTest, TestAddSentencePairs) {
+  EXPECT_TRUE(bitext->AddSentencePair(
+      "a b", "x y", {make_pair(0, 0), make_pair(1, 1)}));
+  EXPECT_TRUE(bitext->AddSentencePair(
+      "a c", "x z", {make_pair(0, 0), make_pair(1, 1)}));
+  EXPECT_EQ(2, bitext->GetNumSentences());
+  EXPECT_EQ(1, table->GetTargetGivenSourceScore("a", "x"));
+  EXPECT_EQ(1, table->GetSourceGivenTargetScore("b", "y"));
+
+  map<Phrase, RuleStatistics> statistics =
+      bitext->GetStatistics(GetWordIds({"a", "b", "d"}));
+  Phrase a = phrase_builder->Build(GetWordIds({"a"}));
+  Phrase x = phrase_builder->Build(GetWordIds({"x"}));
+  Phrase a_b = phrase_builder->Build(GetWordIds({"a", "b"}));
+  Phrase d = phrase_builder->Build(GetWordIds({"d"}));
+  ASSERT_EQ(1, statistics.count(a));
+  EXPECT_EQ(2, statistics[a].num_samples);
+  PhraseAlignment alignment = {make_pair(0, 0)};
+  EXPECT_EQ(2, statistics[a].alignments_counter[a][x][alignment]);
+  ASSERT_EQ(1, statistics.count(a_b));
+  EXPECT_EQ(1, statistics[a_b].num_samples);
+  EXPECT_EQ(0, statistics.count(d));
+}
+
+TEST_F(OnlineBitextTest, TestAddAfterExtraction) {
+  EXPECT_TRUE(bitext->AddSentencePair("a b", "x y", {make_pair(0, 0)}));
+  Phrase a = phrase_builder->Build(GetWordIds({"a"}));
+  EXPECT_EQ(1, bitext->GetStatistics(GetWordIds({"a"}))[a].num_samples);
+
+  EXPECT_TRUE(bitext->AddSentencePair("c a", "z x", {make_pair(1, 1)}));
+  EXPECT_EQ(2, bitext->GetStatistics(GetWordIds({"a"}))[a].num_samples);
+}
+
+} // namespace
+} // namespace extractor
@@ -7,10 +7,9 @@ namespace extractor {
 PhraseLocation::PhraseLocation(int sa_low, int sa_high) :
     sa_low(sa_low), sa_high(sa_high), num_subpatterns(0) {}
 
-PhraseLocation::PhraseLocation(const vector<int>& matchings,
-                               int num_subpatterns) :
+PhraseLocation::PhraseLocation(vector<int> matchings, int num_subpatterns) :
     sa_low(0), sa_high(0),
-    matchings(make_shared<vector<int>>(matchings)),
+    matchings(make_shared<vector<int>>(move(matchings))),
     num_subpatterns(num_subpatterns) {}
 
 bool PhraseLocation::IsEmpty() const {
@@ -21,7 +21,7 @@ namespace extractor {
 struct PhraseLocation {
   PhraseLocation(int sa_low = -1, int sa_high = -1);
 
-  PhraseLocation(const vector<int>& matchings, int num_subpatterns);
+  PhraseLocation(vector<int> matchings, int num_subpatterns);
 
   // Checks if a phrase has any occurrences in the source data.
   bool IsEmpty() const;
@@ -24,7 +24,7 @@ class PrecomputationTest : public Test {
   virtual void SetUp() {
     data = {4, 2, 3, 5, 7, 2, 3, 5, 2, 3, 4, 2, 1};
     data_array = make_shared<MockDataArray>();
-    EXPECT_CALL(*data_array, GetData()).WillRepeatedly(Return(data));
+    EXPECT_CALL(*data_array, GetData()).WillRepeatedly(ReturnRef(data));
     for (size_t i = 0; i < data.size(); ++i) {
       EXPECT_CALL(*data_array, AtIndex(i)).WillRepeatedly(Return(data[i]));
     }
@@ -0,0 +1,120 @@
+#include "rule_cache.h"
+
+namespace extractor {
+
+namespace {
+
+long long GetPhraseSize(const Phrase& phrase) {
+  long long size = sizeof(Phrase) +
+      (phrase.GetNumSymbols() + phrase.Arity()) * sizeof(int);
+  for (const string& word: phrase.GetWords()) {
+    size += sizeof(string) + word.size();
+  }
+  return size;
+}
+
+} // namespace
+
+RuleCache::RuleCache(long long capacity) :
+    capacity(capacity), memory_usage(0), hits(0), misses(0) {}
+
+RuleCache::~RuleCache() {}
+
+bool RuleCache::Get(const vector<int>& phrase, PhraseLocation& matchings,
+                    shared_ptr<const vector<Rule>>& rules) {
+  bool found = false;
+  #pragma omp critical (rule_cache)
+  {
+    auto it = index.find(phrase);
+    if (it != index.end()) {
+      entries.splice(entries.begin(), entries, it->second);
+      matchings = it->second->matchings;
+      rules = it->second->rules;
+      found = true;
+      ++hits;
+    } else {
+      ++misses;
+    }
+  }
+  return found;
+}
+
+void RuleCache::Put(const vector<int>& phrase, const PhraseLocation& matchings,
+                    const shared_ptr<const vector<Rule>>& rules) {
+  long long size = GetEntrySize(phrase, matchings, *rules);
+  if (size > capacity) {
+    return;
+  }
+
+  #pragma omp critical (rule_cache)
+  {
+    auto it = index.find(phrase);
+    if (it != index.end()) {
+      // Another thread has added the phrase in the meantime.
+      entries.splice(entries.begin(), entries, it->second);
+    } else {
+      while (memory_usage + size > capacity) {
+        memory_usage -= entries.back().size;
+        index.erase(entries.back().phrase);
+        entries.pop_back();
+      }
+      entries.push_front(Entry(phrase, matchings, rules, size));
+      index[phrase] = entries.begin();
+      memory_usage += size;
+    }
+  }
+}
+
+int RuleCache::GetSize() {
+  int size = 0;
+  #pragma omp critical (rule_cache)
+  size = index.size();
+  return size;
+}
+
+long long RuleCache::GetMemoryUsage() {
+  long long result = 0;
+  #pragma omp critical (rule_cache)
+  result = memory_usage;
+  return result;
+}
+
+long long RuleCache::GetCapacity() const {
+  return capacity;
+}
+
+long long RuleCache::GetHits() {
+  long long result = 0;
+  #pragma omp critical (rule_cache)
+  result = hits;
+  return result;
+}
+
+long long RuleCache::GetMisses() {
+  long long result = 0;
+  #pragma omp critical (rule_cache)
+  result = misses;
+  return result;
+}
+
+long long RuleCache::GetEntrySize(const vector<int>& phrase,
+                                  const PhraseLocation& matchings,
+                                  const vector<Rule>& rules) {
+  // The entry, its list node and its index node (which has a copy of the
+  // phrase).
+  long long size = sizeof(Entry) + 4 * sizeof(void*) + sizeof(vector<int>) +
+      2 * phrase.size() * sizeof(int);
+  if (matchings.matchings != NULL) {
+    size += sizeof(vector<int>) + matchings.matchings->size() * sizeof(int);
+  }
+  size += sizeof(vector<Rule>);
+  for (const Rule& rule: rules) {
+    size += sizeof(Rule) + GetPhraseSize(rule.source_phrase) +
+        GetPhraseSize(rule.target_phrase) - 2 * sizeof(Phrase) +
+        rule.scores.size() * sizeof(double) +
+        rule.alignment.size() * sizeof(pair<int, int>);
+  }
+  return size;
+}
+
+} // namespace extractor
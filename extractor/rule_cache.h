@@ -0,0 +1,89 @@
+#ifndef _RULE_CACHE_H_
+#define _RULE_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include "phrase_location.h"
+#include "rule.h"
+
+using namespace std;
+
+namespace extractor {
+
+typedef boost::hash<vector<int>> VectorHash;
+
+/**
+ * Bounded cache of the source phrases analyzed while extracting the grammars
+ * of previous sentences.
+ *
+ * For each source phrase (identified by its symbols in the Vocabulary), the
+ * cache stores the occurrences of the phrase in the source data and the rules
+ * extracted from the sampled occurrences. The cache is bounded by the memory
+ * used by its entries, since the occurrences of a gapped phrase of frequent
+ * words can take much more memory than its rules: when a new phrase doesn't
+ * fit, the least recently used phrases are evicted. The cache is shared by all
+ * the extraction threads, so every operation is a critical region.
+ */
+class RuleCache {
+ public:
+  // The capacity is the number of bytes the entries may use.
+  RuleCache(long long capacity);
+
+  virtual ~RuleCache();
+
+  // Looks up a phrase. On a hit, sets the occurrences of the phrase and its
+  // rules, and marks the phrase as the most recently used one.
+  bool Get(const vector<int>& phrase, PhraseLocation& matchings,
+           shared_ptr<const vector<Rule>>& rules);
+
+  // Adds a phrase to the cache, evicting the least recently used phrases to
+  // make room for it. Phrases larger than the capacity are not added.
+  void Put(const vector<int>& phrase, const PhraseLocation& matchings,
+           const shared_ptr<const vector<Rule>>& rules);
+
+  // Returns the number of phrases in the cache.
+  int GetSize();
+
+  // Returns the number of bytes used by the phrases in the cache.
+  long long GetMemoryUsage();
+
+  long long GetCapacity() const;
+
+  // Returns the number of successful and unsuccessful lookups.
+  long long GetHits();
+
+  long long GetMisses();
+
+  // Returns the (approximate) number of bytes used by an entry of the cache.
+  static long long GetEntrySize(const vector<int>& phrase,
+                                const PhraseLocation& matchings,
+                                const vector<Rule>& rules);
+
+ private:
+  struct Entry {
+    Entry(const vector<int>& phrase, const PhraseLocation& matchings,
+          const shared_ptr<const vector<Rule>>& rules, long long size) :
+        phrase(phrase), matchings(matchings), rules(rules), size(size) {}
+
+    vector<int> phrase;
+    PhraseLocation matchings;
+    shared_ptr<const vector<Rule>> rules;
+    long long size;
+  };
+
+  long long capacity;
+  long long memory_usage;
+  // The most recently used phrases are at the front of the list.
+  list<Entry> entries;
+  unordered_map<vector<int>, list<Entry>::iterator, VectorHash> index;
+  long long hits, misses;
+};
+
+} // namespace extractor
+
+#endif
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "phrase.h"
+#include "phrase_location.h"
+#include "rule.h"
+#include "rule_cache.h"
+
+using namespace std;
+using namespace ::testing;
+
+namespace extractor {
+namespace {
+
+class RuleCacheTest : public Test {
+ protected:
+  virtual void SetUp() {
+    Phrase phrase;
+    vector<double> scores = {0.5};
+    vector<pair<int, int>> alignment = {make_pair(0, 0)};
+    rules = make_shared<vector<Rule>>(
+        2, Rule(phrase, phrase, scores, alignment));
+  }
+
+  shared_ptr<const vector<Rule>> rules;
+};
+
+TEST_F(RuleCacheTest, TestGetAndPut) {
+  RuleCache cache(1 << 20);
+  vector<int> phrase = {2, -1, 3};
+  PhraseLocation matchings;
+  shared_ptr<const vector<Rule>> cached_rules;
+  EXPECT_FALSE(cache.Get(phrase, matchings, cached_rules));
+
+  vector<int> locations = {1, 5, 10, 12};
+  cache.Put(phrase, PhraseLocation(locations, 2), rules);
+  EXPECT_TRUE(cache.Get(phrase, matchings, cached_rules));
+  EXPECT_EQ(PhraseLocation(locations, 2), matchings);
+  EXPECT_EQ(rules, cached_rules);
+
+  EXPECT_FALSE(cache.Get(vector<int>{2, 3}, matchings, cached_rules));
+  EXPECT_EQ(1, cache.GetSize());
+  EXPECT_EQ(1, cache.GetHits());
+  EXPECT_EQ(2, cache.GetMisses());
+}
+
+TEST_F(RuleCacheTest, TestEvictsLeastRecentlyUsed) {
+  // Room for two phrases.
+  RuleCache cache(
+      2 * RuleCache::GetEntrySize(vector<int>{2}, PhraseLocation(0, 1), *rules));
+  PhraseLocation matchings;
+  shared_ptr<const vector<Rule>> cached_rules;
+  cache.Put(vector<int>{2}, PhraseLocation(0, 1), rules);
+  cache.Put(vector<int>{3}, PhraseLocation(1, 2), rules);
+  // Makes {3} the least recently used phrase.
+  EXPECT_TRUE(cache.Get(vector<int>{2}, matchings, cached_rules));
+  cache.Put(vector<int>{4}, PhraseLocation(2, 3), rules);
+
+  EXPECT_EQ(2, cache.GetSize());
+  EXPECT_FALSE(cache.Get(vector<int>{3}, matchings, cached_rules));
+  EXPECT_TRUE(cache.Get(vector<int>{2}, matchings, cached_rules));
+  EXPECT_EQ(PhraseLocation(0, 1), matchings);
+  EXPECT_TRUE(cache.Get(vector<int>{4}, matchings, cached_rules));
+  EXPECT_EQ(PhraseLocation(2, 3), matchings);
+}
+
+TEST_F(RuleCacheTest, TestBoundedByMemory) {
+  long long small_size =
+      RuleCache::GetEntrySize(vector<int>{2}, PhraseLocation(0, 1), *rules);
+  PhraseLocation large(vector<int>(1000), 2);
+  long long large_size =
+      RuleCache::GetEntrySize(vector<int>{2, -1, 4}, large, *rules);
+  // Room for the large phrase, but not along with a small one.
+  RuleCache cache(large_size + small_size - 1);
+  PhraseLocation matchings;
+  shared_ptr<const vector<Rule>> cached_rules;
+  cache.Put(vector<int>{2}, PhraseLocation(0, 1), rules);
+  cache.Put(vector<int>{3}, PhraseLocation(1, 2), rules);
+  EXPECT_EQ(2 * small_size, cache.GetMemoryUsage());
+
+  // Too large for the cache.
+  cache.Put(vector<int>{2, -1, 3}, PhraseLocation(vector<int>(2000), 2), rules);
+  EXPECT_FALSE(cache.Get(vector<int>{2, -1, 3}, matchings, cached_rules));
+  EXPECT_EQ(2, cache.GetSize());
+
+  cache.Put(vector<int>{2, -1, 4}, large, rules);
+  EXPECT_TRUE(cache.Get(vector<int>{2, -1, 4}, matchings, cached_rules));
+  EXPECT_EQ(1, cache.GetSize());
+  EXPECT_EQ(large_size, cache.GetMemoryUsage());
+}
+
+TEST_F(RuleCacheTest, TestZeroCapacity) {
+  RuleCache cache(0);
+  PhraseLocation matchings;
+  shared_ptr<const vector<Rule>> cached_rules;
+  cache.Put(vector<int>{2}, PhraseLocation(0, 1), rules);
+  EXPECT_EQ(0, cache.GetSize());
+  EXPECT_FALSE(cache.Get(vector<int>{2}, matchings, cached_rules));
+}
+
+} // namespace
+} // namespace extractor
@@ -1,6 +1,7 @@
 #ifndef _RULE_EXTRACTOR_H_
 #define _RULE_EXTRACTOR_H_
 
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -38,6 +39,24 @@ struct Extract {
   PhraseAlignment alignment;
 };
 
+/**
+ * Counts of the source-target phrase pairs extracted from a set of occurrences
+ * of a source phrase, from which the rules and their feature scores are
+ * computed. The counts extracted from different parallel corpora (e.g. the
+ * compiled data and the sentence pairs added later) may be merged before
+ * scoring.
+ */
+struct RuleStatistics {
+  RuleStatistics() : num_samples(0) {}
+
+  // Adds the counts of other to these counts.
+  void Merge(const RuleStatistics& other);
+
+  int num_samples;
+  map<Phrase, double> source_phrase_counter;
+  map<Phrase, map<Phrase, map<PhraseAlignment, int>>> alignments_counter;
+};
+
 /**
  * Component for extracting SCFG rules.
  */
@@ -76,6 +95,15 @@ class RuleExtractor {
   virtual vector<Rule> ExtractRules(const Phrase& phrase,
                                     const PhraseLocation& location) const;
 
+  // Counts the phrase pairs extracted from a set of occurrences of the source
+  // phrase, without scoring them.
+  virtual RuleStatistics CollectStatistics(
+      const Phrase& phrase, const PhraseLocation& location) const;
+
+  // Computes the feature scores of the counted phrase pairs and their most
+  // frequent alignments.
+  virtual vector<Rule> ScoreRules(const RuleStatistics& statistics) const;
+
  protected:
   RuleExtractor();
 
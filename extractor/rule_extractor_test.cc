@@ -164,5 +164,30 @@ TEST_F(RuleExtractorTest, TestExtractRulesAddExtremities) {
   EXPECT_EQ(4, rules.size());
 }
 
+TEST_F(RuleExtractorTest, TestMergeStatistics) {
+  vector<int> symbols = {87};
+  Phrase phrase = phrase_builder->Build(symbols);
+  vector<int> matching = {2};
+  PhraseLocation phrase_location(matching, 1);
+
+  EXPECT_CALL(*helper, GetLinksSpans(_, _, _, _, _)).Times(2);
+  vector<pair<int, int>> gaps(3);
+  helper->SetUp(0, 0, 0, 0, true, gaps, gaps, 0, true, true);
+
+  RuleStatistics statistics =
+      extractor->CollectStatistics(phrase, phrase_location);
+  EXPECT_EQ(1, statistics.num_samples);
+  statistics.Merge(extractor->CollectStatistics(phrase, phrase_location));
+  EXPECT_EQ(2, statistics.num_samples);
+  ASSERT_EQ(1, statistics.alignments_counter.size());
+  const auto& target_phrases = statistics.alignments_counter.begin()->second;
+  ASSERT_EQ(1, target_phrases.size());
+  PhraseAlignment phrase_alignment = {make_pair(0, 0)};
+  EXPECT_EQ(2, target_phrases.begin()->second.at(phrase_alignment));
+
+  vector<Rule> rules = extractor->ScoreRules(statistics);
+  EXPECT_EQ(1, rules.size());
+}
+
 } // namespace
 } // namespace extractor
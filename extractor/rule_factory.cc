@@ -11,6 +11,7 @@
 #include "phrase.h"
 #include "phrase_builder.h"
 #include "rule.h"
+#include "rule_cache.h"
 #include "rule_extractor.h"
 #include "phrase_location_sampler.h"
 #include "sampler.h"
@@ -29,7 +30,7 @@ typedef high_resolution_clock Clock;
 
 struct State {
   State(int start, int end, const vector<int>& phrase,
-      const vector<int>& subpatterns_start, shared_ptr<TrieNode> node,
+      const vector<int>& subpatterns_start, TrieNode* node,
       bool starts_with_x) :
       start(start), end(end), phrase(phrase),
       subpatterns_start(subpatterns_start), node(node),
@@ -37,7 +38,7 @@ struct State {
 
   int start, end;
   vector<int> phrase, subpatterns_start;
-  shared_ptr<TrieNode> node;
+  TrieNode* node;
   bool starts_with_x;
 };
 
@@ -53,9 +54,12 @@ HieroCachingRuleFactory::HieroCachingRuleFactory(
     int max_nonterminals,
     int max_rule_symbols,
     int max_samples,
-    bool require_tight_phrases) :
+    bool require_tight_phrases,
+    shared_ptr<RuleCache> rule_cache) :
+    source_data_array(source_suffix_array->GetData()),
     vocabulary(vocabulary),
     scorer(scorer),
+    rule_cache(rule_cache),
     min_gap_size(min_gap_size),
     max_rule_span(max_rule_span),
     max_nonterminals(max_nonterminals),
@@ -74,6 +78,7 @@ HieroCachingRuleFactory::HieroCachingRuleFactory(
 }
 
 HieroCachingRuleFactory::HieroCachingRuleFactory(
+    shared_ptr<DataArray> source_data_array,
     shared_ptr<MatchingsFinder> finder,
     shared_ptr<FastIntersector> fast_intersector,
     shared_ptr<PhraseBuilder> phrase_builder,
@@ -85,7 +90,9 @@ HieroCachingRuleFactory::HieroCachingRuleFactory(
     int max_rule_span,
     int max_nonterminals,
     int max_chunks,
-    int max_rule_symbols) :
+    int max_rule_symbols,
+    shared_ptr<RuleCache> rule_cache) :
+    source_data_array(source_data_array),
     matchings_finder(finder),
     fast_intersector(fast_intersector),
     phrase_builder(phrase_builder),
@@ -93,6 +100,7 @@ HieroCachingRuleFactory::HieroCachingRuleFactory(
     vocabulary(vocabulary),
     sampler(sampler),
     scorer(scorer),
+    rule_cache(rule_cache),
     min_gap_size(min_gap_size),
     max_rule_span(max_rule_span),
     max_nonterminals(max_nonterminals),
@@ -106,16 +114,57 @@ HieroCachingRuleFactory::~HieroCachingRuleFactory() {}
 Grammar HieroCachingRuleFactory::GetGrammar(
     const vector<int>& word_ids,
     const unordered_set<int>& blacklisted_sentence_ids) {
+  vector<Rule> rules;
+  ExtractRules(word_ids, blacklisted_sentence_ids, rules, NULL);
+  return Grammar(rules, scorer->GetFeatureNames());
+}
+
+map<Phrase, RuleStatistics> HieroCachingRuleFactory::GetStatistics(
+    const vector<int>& word_ids,
+    const unordered_set<int>& blacklisted_sentence_ids) {
+  vector<Rule> rules;
+  map<Phrase, RuleStatistics> statistics;
+  ExtractRules(word_ids, blacklisted_sentence_ids, rules, &statistics);
+  return statistics;
+}
+
+Grammar HieroCachingRuleFactory::ScoreRules(
+    const map<Phrase, RuleStatistics>& statistics) {
+  vector<Rule> rules;
+  for (const auto& entry: statistics) {
+    vector<Rule> phrase_rules = rule_extractor->ScoreRules(entry.second);
+    rules.insert(rules.end(), phrase_rules.begin(), phrase_rules.end());
+  }
+  return Grammar(rules, scorer->GetFeatureNames());
+}
+
+void HieroCachingRuleFactory::ExtractRules(
+    const vector<int>& word_ids,
+    const unordered_set<int>& blacklisted_sentence_ids,
+    vector<Rule>& rules,
+    map<Phrase, RuleStatistics>* statistics) {
   Clock::time_point start_time = Clock::now();
   double total_extract_time = 0;
   double total_intersect_time = 0;
   double total_lookup_time = 0;
 
+  // Maps the words of the sentence to their ids in the source data array once,
+  // instead of converting them back to strings and looking them up in the data
+  // array for every phrase they end.
+  vector<int> source_word_ids;
+  for (int word_id: word_ids) {
+    source_word_ids.push_back(source_data_array->GetWordId(
+        vocabulary->GetTerminalValue(word_id)));
+  }
+
+  bool use_cache = rule_cache != NULL && blacklisted_sentence_ids.empty() &&
+      statistics == NULL;
+
   MatchingsTrie trie;
-  shared_ptr<TrieNode> root = trie.GetRoot();
+  TrieNode* root = trie.GetRoot();
 
   int first_x = vocabulary->GetNonterminalIndex(1);
-  shared_ptr<TrieNode> x_root(new TrieNode(root));
+  TrieNode* x_root = trie.CreateNode(root);
   root->AddChild(first_x, x_root);
 
   queue<State> states;
@@ -127,36 +176,40 @@ Grammar HieroCachingRuleFactory::GetGrammar(
         vector<int>(1, i), x_root, true));
   }
 
-  vector<Rule> rules;
   while (!states.empty()) {
     State state = states.front();
     states.pop();
 
-    shared_ptr<TrieNode> node = state.node;
+    TrieNode* node = state.node;
     vector<int> phrase = state.phrase;
     int word_id = word_ids[state.end];
     phrase.push_back(word_id);
     Phrase next_phrase = phrase_builder->Build(phrase);
-    shared_ptr<TrieNode> next_node;
+    TrieNode* next_node;
 
     if (CannotHaveMatchings(node, word_id)) {
       if (!node->HasChild(word_id)) {
-        node->AddChild(word_id, shared_ptr<TrieNode>());
+        node->AddChild(word_id, NULL);
       }
       continue;
     }
 
     if (RequiresLookup(node, word_id)) {
-      shared_ptr<TrieNode> next_suffix_link = node->suffix_link == NULL ?
+      shared_ptr<const vector<Rule>> phrase_rules;
+      TrieNode* next_suffix_link = node->suffix_link == NULL ?
           trie.GetRoot() : node->suffix_link->GetChild(word_id);
       if (state.starts_with_x) {
         // If the phrase starts with a non terminal, we simply use the matchings
         // from the suffix link.
-        next_node = make_shared<TrieNode>(
+        next_node = trie.CreateNode(
             next_suffix_link, next_phrase, next_suffix_link->matchings);
       } else {
         PhraseLocation phrase_location;
-        if (next_phrase.Arity() > 0) {
+        if (use_cache &&
+            rule_cache->Get(phrase, phrase_location, phrase_rules)) {
+          // The phrase has been analyzed for a previous sentence, so its
+          // occurrences and rules are taken from the cache.
+        } else if (next_phrase.Arity() > 0) {
           // For phrases containing a nonterminal, we use either the occurrences
           // of the prefix or the suffix to determine the occurrences of the
           // phrase.
@@ -172,7 +225,7 @@ Grammar HieroCachingRuleFactory::GetGrammar(
           Clock::time_point lookup_start = Clock::now();
           phrase_location = matchings_finder->Find(
               node->matchings,
-              vocabulary->GetTerminalValue(word_id),
+              source_word_ids[state.end],
               state.phrase.size());
           Clock::time_point lookup_stop = Clock::now();
           total_lookup_time += GetDuration(lookup_start, lookup_stop);
@@ -183,7 +236,7 @@ Grammar HieroCachingRuleFactory::GetGrammar(
         }
 
         // Create new trie node to store data about the current phrase.
-        next_node = make_shared<TrieNode>(
+        next_node = trie.CreateNode(
             next_suffix_link, next_phrase, phrase_location);
       }
       // Add the new trie node to the trie cache.
@@ -191,17 +244,27 @@ Grammar HieroCachingRuleFactory::GetGrammar(
 
       // Automatically adds a trailing non terminal if allowed. Simply copy the
       // matchings from the prefix node.
-      AddTrailingNonterminal(phrase, next_phrase, next_node,
+      AddTrailingNonterminal(trie, phrase, next_phrase, next_node,
                              state.starts_with_x);
 
       Clock::time_point extract_start = Clock::now();
-      if (!state.starts_with_x) {
-        // Extract rules for the sampled set of occurrences.
+      if (!state.starts_with_x && statistics != NULL) {
         PhraseLocation sample = sampler->Sample(
             next_node->matchings, blacklisted_sentence_ids);
-        vector<Rule> new_rules =
-            rule_extractor->ExtractRules(next_phrase, sample);
-        rules.insert(rules.end(), new_rules.begin(), new_rules.end());
+        (*statistics)[next_phrase] =
+            rule_extractor->CollectStatistics(next_phrase, sample);
+      } else if (!state.starts_with_x) {
+        if (phrase_rules == NULL) {
+          // Extract rules for the sampled set of occurrences.
+          PhraseLocation sample = sampler->Sample(
+              next_node->matchings, blacklisted_sentence_ids);
+          phrase_rules = make_shared<vector<Rule>>(
+              rule_extractor->ExtractRules(next_phrase, sample));
+          if (use_cache) {
+            rule_cache->Put(phrase, next_node->matchings, phrase_rules);
+          }
+        }
+        rules.insert(rules.end(), phrase_rules->begin(), phrase_rules->end());
       }
       Clock::time_point extract_stop = Clock::now();
       total_extract_time += GetDuration(extract_start, extract_stop);
@@ -226,28 +289,28 @@ Grammar HieroCachingRuleFactory::GetGrammar(
     cerr << "Intersect time = " << total_intersect_time << " seconds" << endl;
     cerr << "Lookup time = " << total_lookup_time << " seconds" << endl;
   }
-  return Grammar(rules, scorer->GetFeatureNames());
 }
 
 bool HieroCachingRuleFactory::CannotHaveMatchings(
-    shared_ptr<TrieNode> node, int word_id) {
+    TrieNode* node, int word_id) {
   if (node->HasChild(word_id) && node->GetChild(word_id) == NULL) {
     return true;
   }
 
-  shared_ptr<TrieNode> suffix_link = node->suffix_link;
+  TrieNode* suffix_link = node->suffix_link;
   return suffix_link != NULL && suffix_link->GetChild(word_id) == NULL;
 }
 
 bool HieroCachingRuleFactory::RequiresLookup(
-    shared_ptr<TrieNode> node, int word_id) {
+    TrieNode* node, int word_id) {
   return !node->HasChild(word_id);
 }
 
 void HieroCachingRuleFactory::AddTrailingNonterminal(
+    MatchingsTrie& trie,
     vector<int> symbols,
     const Phrase& prefix,
-    const shared_ptr<TrieNode>& prefix_node,
+    TrieNode* prefix_node,
     bool starts_with_x) {
   if (prefix.Arity() >= max_nonterminals) {
     return;
@@ -259,10 +322,10 @@ void HieroCachingRuleFactory::AddTrailingNonterminal(
 
   int suffix_var_id = vocabulary->GetNonterminalIndex(
       prefix.Arity() + (starts_with_x == 0));
-  shared_ptr<TrieNode> var_suffix_link =
+  TrieNode* var_suffix_link =
       prefix_node->suffix_link->GetChild(suffix_var_id);
 
-  prefix_node->AddChild(var_id, make_shared<TrieNode>(
+  prefix_node->AddChild(var_id, trie.CreateNode(
       var_suffix_link, var_phrase, prefix_node->matchings));
 }
 
@@ -271,7 +334,7 @@ vector<State> HieroCachingRuleFactory::ExtendState(
     const State& state,
     vector<int> symbols,
     const Phrase& phrase,
-    const shared_ptr<TrieNode>& node) {
+    TrieNode* node) {
   int span = state.end - state.start;
   vector<State> new_states;
   if (symbols.size() >= max_rule_symbols || state.end + 1 >= word_ids.size() ||
@@ -1,11 +1,13 @@
 #ifndef _RULE_FACTORY_H_
 #define _RULE_FACTORY_H_
 
+#include <map>
 #include <memory>
 #include <vector>
 #include <unordered_set>
 
 #include "matchings_trie.h"
+#include "phrase.h"
 
 using namespace std;
 
@@ -19,7 +21,9 @@ class MatchingsFinder;
 class PhraseBuilder;
 class Precomputation;
 class Rule;
+class RuleCache;
 class RuleExtractor;
+struct RuleStatistics;
 class Sampler;
 class Scorer;
 class State;
@@ -36,6 +40,11 @@ class Vocabulary;
  * occurrences to extract aligned source-target phrase pairs. A trie cache is
  * used to avoid unnecessary computations if a source phrase can be constructed
  * more than once (e.g. some words occur more than once in the sentence).
+ *
+ * If a RuleCache is given, the occurrences and the rules of the phrases
+ * analyzed for previous sentences are taken from it instead of being
+ * recomputed. The cache is not used when sentences are blacklisted (for
+ * leave-one-out extraction), because the samples depend on the blacklist.
  */
 class HieroCachingRuleFactory {
  public:
@@ -51,10 +60,12 @@ class HieroCachingRuleFactory {
       int max_nonterminals,
       int max_rule_symbols,
       int max_samples,
-      bool require_tight_phrases);
+      bool require_tight_phrases,
+      shared_ptr<RuleCache> rule_cache = shared_ptr<RuleCache>());
 
   // For testing only.
   HieroCachingRuleFactory(
+      shared_ptr<DataArray> source_data_array,
       shared_ptr<MatchingsFinder> finder,
       shared_ptr<FastIntersector> fast_intersector,
       shared_ptr<PhraseBuilder> phrase_builder,
@@ -66,7 +77,8 @@ class HieroCachingRuleFactory {
       int max_rule_span,
       int max_nonterminals,
       int max_chunks,
-      int max_rule_symbols);
+      int max_rule_symbols,
+      shared_ptr<RuleCache> rule_cache = shared_ptr<RuleCache>());
 
   virtual ~HieroCachingRuleFactory();
 
@@ -76,22 +88,42 @@ class HieroCachingRuleFactory {
       const vector<int>& word_ids,
       const unordered_set<int>& blacklisted_sentence_ids);
 
+  // Counts the phrase pairs extracted for each source phrase of the sentence
+  // occurring in the source data, without scoring them. The rule cache is not
+  // used.
+  virtual map<Phrase, RuleStatistics> GetStatistics(
+      const vector<int>& word_ids,
+      const unordered_set<int>& blacklisted_sentence_ids);
+
+  // Scores the phrase pairs counted by GetStatistics (possibly merged with the
+  // counts of other parallel data).
+  virtual Grammar ScoreRules(const map<Phrase, RuleStatistics>& statistics);
+
  protected:
   HieroCachingRuleFactory();
 
  private:
+  // Analyzes all the source phrases of the sentence. The rules of each source
+  // phrase are appended to rules or, if statistics is not NULL, the counts
+  // from which they are scored are stored in statistics instead.
+  void ExtractRules(const vector<int>& word_ids,
+                    const unordered_set<int>& blacklisted_sentence_ids,
+                    vector<Rule>& rules,
+                    map<Phrase, RuleStatistics>* statistics);
+
   // Checks if the phrase (if previously encountered) or its prefix have any
   // occurrences in the source data.
-  bool CannotHaveMatchings(shared_ptr<TrieNode> node, int word_id);
+  bool CannotHaveMatchings(TrieNode* node, int word_id);
 
   // Checks if the phrase has previously been analyzed.
-  bool RequiresLookup(shared_ptr<TrieNode> node, int word_id);
+  bool RequiresLookup(TrieNode* node, int word_id);
 
   // Creates a new state in the trie that corresponds to adding a trailing
   // nonterminal to the current phrase.
-  void AddTrailingNonterminal(vector<int> symbols,
+  void AddTrailingNonterminal(MatchingsTrie& trie,
+                              vector<int> symbols,
                               const Phrase& prefix,
-                              const shared_ptr<TrieNode>& prefix_node,
+                              TrieNode* prefix_node,
                               bool starts_with_x);
 
   // Extends the current state by possibly adding a nonterminal followed by a
@@ -100,8 +132,9 @@ class HieroCachingRuleFactory {
                             const State& state,
                             vector<int> symbols,
                             const Phrase& phrase,
-                            const shared_ptr<TrieNode>& node);
+                            TrieNode* node);
 
+  shared_ptr<DataArray> source_data_array;
   shared_ptr<MatchingsFinder> matchings_finder;
   shared_ptr<FastIntersector> fast_intersector;
   shared_ptr<PhraseBuilder> phrase_builder;
@@ -109,6 +142,7 @@ class HieroCachingRuleFactory {
   shared_ptr<Vocabulary> vocabulary;
   shared_ptr<Sampler> sampler;
   shared_ptr<Scorer> scorer;
+  shared_ptr<RuleCache> rule_cache;
   int min_gap_size;
   int max_rule_span;
   int max_nonterminals;
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "grammar.h"
+#include "mocks/mock_data_array.h"
 #include "mocks/mock_fast_intersector.h"
 #include "mocks/mock_matchings_finder.h"
 #include "mocks/mock_rule_extractor.h"
@@ -13,6 +14,7 @@
 #include "mocks/mock_vocabulary.h"
 #include "phrase_builder.h"
 #include "phrase_location.h"
+#include "rule_cache.h"
 #include "rule_factory.h"
 
 using namespace std;
@@ -24,6 +26,11 @@ namespace {
 class RuleFactoryTest : public Test {
  protected:
   virtual void SetUp() {
+    data_array = make_shared<MockDataArray>();
+    EXPECT_CALL(*data_array, GetWordId("a")).WillRepeatedly(Return(5));
+    EXPECT_CALL(*data_array, GetWordId("b")).WillRepeatedly(Return(6));
+    EXPECT_CALL(*data_array, GetWordId("c")).WillRepeatedly(Return(7));
+
     finder = make_shared<MockMatchingsFinder>();
     fast_intersector = make_shared<MockFastIntersector>();
 
@@ -46,13 +53,15 @@ class RuleFactoryTest : public Test {
     Phrase phrase;
     vector<double> scores = {0.5};
     vector<pair<int, int>> phrase_alignment = {make_pair(0, 0)};
-    vector<Rule> rules = {Rule(phrase, phrase, scores, phrase_alignment)};
+    rules = {Rule(phrase, phrase, scores, phrase_alignment)};
     extractor = make_shared<MockRuleExtractor>();
     EXPECT_CALL(*extractor, ExtractRules(_, _))
         .WillRepeatedly(Return(rules));
   }
 
   vector<string> feature_names;
+  vector<Rule> rules;
+  shared_ptr<MockDataArray> data_array;
   shared_ptr<MockMatchingsFinder> finder;
   shared_ptr<MockFastIntersector> fast_intersector;
   shared_ptr<MockVocabulary> vocabulary;
@@ -64,10 +73,11 @@ class RuleFactoryTest : public Test {
 };
 
 TEST_F(RuleFactoryTest, TestGetGrammarDifferentWords) {
-  factory = make_shared<HieroCachingRuleFactory>(finder, fast_intersector,
-      phrase_builder, extractor, vocabulary, sampler, scorer, 1, 10, 2, 3, 5);
+  factory = make_shared<HieroCachingRuleFactory>(data_array, finder,
+      fast_intersector, phrase_builder, extractor, vocabulary, sampler, scorer,
+      1, 10, 2, 3, 5);
 
-  EXPECT_CALL(*finder, Find(_, _, _))
+  EXPECT_CALL(*finder, Find(_, AnyOf(5, 6, 7), _))
       .Times(6)
       .WillRepeatedly(Return(PhraseLocation(0, 1)));
 
@@ -83,8 +93,9 @@ TEST_F(RuleFactoryTest, TestGetGrammarDifferentWords) {
 }
 
 TEST_F(RuleFactoryTest, TestGetGrammarRepeatingWords) {
-  factory = make_shared<HieroCachingRuleFactory>(finder, fast_intersector,
-      phrase_builder, extractor, vocabulary, sampler, scorer, 1, 10, 2, 3, 5);
+  factory = make_shared<HieroCachingRuleFactory>(data_array, finder,
+      fast_intersector, phrase_builder, extractor, vocabulary, sampler, scorer,
+      1, 10, 2, 3, 5);
 
   EXPECT_CALL(*finder, Find(_, _, _))
       .Times(12)
@@ -101,5 +112,59 @@ TEST_F(RuleFactoryTest, TestGetGrammarRepeatingWords) {
   EXPECT_EQ(28, grammar.GetRules().size());
 }
 
+TEST_F(RuleFactoryTest, TestGetGrammarWithRuleCache) {
+  shared_ptr<RuleCache> rule_cache = make_shared<RuleCache>(1 << 20);
+  factory = make_shared<HieroCachingRuleFactory>(data_array, finder,
+      fast_intersector, phrase_builder, extractor, vocabulary, sampler, scorer,
+      1, 10, 2, 3, 5, rule_cache);
+
+  // The phrases of the second sentence are all found in the cache.
+  EXPECT_CALL(*finder, Find(_, AnyOf(5, 6, 7), _))
+      .Times(6)
+      .WillRepeatedly(Return(PhraseLocation(0, 1)));
+
+  EXPECT_CALL(*fast_intersector, Intersect(_, _, _))
+      .Times(1)
+      .WillRepeatedly(Return(PhraseLocation(0, 1)));
+
+  EXPECT_CALL(*extractor, ExtractRules(_, _))
+      .Times(7)
+      .WillRepeatedly(Return(rules));
+
+  vector<int> word_ids = {2, 3, 4};
+  unordered_set<int> blacklisted_sentence_ids;
+  Grammar grammar = factory->GetGrammar(word_ids, blacklisted_sentence_ids);
+  EXPECT_EQ(7, grammar.GetRules().size());
+  EXPECT_EQ(0, rule_cache->GetHits());
+  EXPECT_EQ(7, rule_cache->GetSize());
+
+  grammar = factory->GetGrammar(word_ids, blacklisted_sentence_ids);
+  EXPECT_EQ(7, grammar.GetRules().size());
+  EXPECT_EQ(7, rule_cache->GetHits());
+}
+
+TEST_F(RuleFactoryTest, TestGetGrammarLeaveOneOutBypassesRuleCache) {
+  shared_ptr<RuleCache> rule_cache = make_shared<RuleCache>(1 << 20);
+  factory = make_shared<HieroCachingRuleFactory>(data_array, finder,
+      fast_intersector, phrase_builder, extractor, vocabulary, sampler, scorer,
+      1, 10, 2, 3, 5, rule_cache);
+
+  EXPECT_CALL(*finder, Find(_, AnyOf(5, 6, 7), _))
+      .Times(12)
+      .WillRepeatedly(Return(PhraseLocation(0, 1)));
+
+  EXPECT_CALL(*fast_intersector, Intersect(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(PhraseLocation(0, 1)));
+
+  vector<int> word_ids = {2, 3, 4};
+  unordered_set<int> blacklisted_sentence_ids = {0};
+  factory->GetGrammar(word_ids, blacklisted_sentence_ids);
+  Grammar grammar = factory->GetGrammar(word_ids, blacklisted_sentence_ids);
+  EXPECT_EQ(7, grammar.GetRules().size());
+  EXPECT_EQ(0, rule_cache->GetSize());
+  EXPECT_EQ(0, rule_cache->GetHits() + rule_cache->GetMisses());
+}
+
 } // namespace
 } // namespace extractor
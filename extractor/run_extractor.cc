@@ -28,6 +28,7 @@
 #include "grammar_extractor.h"
 #include "precomputation.h"
 #include "rule.h"
+#include "rule_cache.h"
 #include "scorer.h"
 #include "suffix_array.h"
 #include "time_util.h"
@@ -81,6 +82,9 @@ int main(int argc, char** argv) {
         "Maximum number of samples")
     ("tight_phrases", po::value<bool>()->default_value(true),
         "False if phrases may be loose (better, but slower)")
+    ("rule_cache_mb", po::value<int>()->default_value(0),
+        "Memory (in MB) for the occurrences and rules of the source phrases "
+        "cached across sentences (0 disables the cache)")
     ("leave_one_out", po::value<bool>()->zero_tokens(),
         "do leave-one-out estimation of grammars "
         "(e.g. for extracting grammars for the training set");
@@ -191,6 +195,13 @@ int main(int argc, char** argv) {
   };
   shared_ptr<Scorer> scorer = make_shared<Scorer>(features);
 
+  // Rules of the source phrases shared by several sentences.
+  shared_ptr<RuleCache> rule_cache;
+  if (vm["rule_cache_mb"].as<int>() > 0) {
+    rule_cache = make_shared<RuleCache>(
+        vm["rule_cache_mb"].as<int>() * (1LL << 20));
+  }
+
   // Sets up the grammar extractor.
   GrammarExtractor extractor(
       source_suffix_array,
@@ -204,7 +215,8 @@ int main(int argc, char** argv) {
       vm["max_nonterminals"].as<int>(),
       vm["max_rule_symbols"].as<int>(),
       vm["max_samples"].as<int>(),
-      vm["tight_phrases"].as<bool>());
+      vm["tight_phrases"].as<bool>(),
+      rule_cache);
 
   // Creates the grammars directory if it doesn't exist.
   fs::path grammar_path = vm["grammars"].as<string>();
@@ -248,6 +260,15 @@ int main(int argc, char** argv) {
          << i << "\"> " << sentences[i] << " </seg> " << suffixes[i] << endl;
   }
 
+  if (rule_cache != NULL) {
+    long long hits = rule_cache->GetHits();
+    long long lookups = hits + rule_cache->GetMisses();
+    cerr << "Rule cache: " << hits << " hits out of " << lookups
+         << " lookups (hit rate " << (lookups ? 100.0 * hits / lookups : 0)
+         << "%), " << rule_cache->GetSize() << " phrases cached in "
+         << rule_cache->GetMemoryUsage() / double(1 << 20) << " MB" << endl;
+  }
+
   Clock::time_point extraction_stop_time = Clock::now();
   cerr << "Overall extraction step took "
        << GetDuration(extraction_start_time, extraction_stop_time)
@@ -44,7 +44,10 @@ int main(int argc, char** argv) {
     ("max_phrase_len,p", po::value<int>()->default_value(4),
         "Maximum frequent phrase length")
     ("min_frequency", po::value<int>()->default_value(1000),
-        "Minimum number of occurrences for a pharse to be considered frequent");
+        "Minimum number of occurrences for a pharse to be considered frequent")
+    ("threads,t", po::value<int>()->default_value(1),
+        "Number of threads used for counting the links of the translation "
+        "table");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -172,7 +175,8 @@ int main(int argc, char** argv) {
 
   start_time = Clock::now();
   cerr << "Precomputing conditional probabilities..." << endl;
-  TranslationTable table(source_data_array, target_data_array, alignment);
+  TranslationTable table(source_data_array, target_data_array, alignment,
+                         vm["threads"].as<int>());
 
   start_write = Clock::now();
   string table_path = (output_dir / fs::path("bilex.bin")).string();
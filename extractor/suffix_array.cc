@@ -1,5 +1,6 @@
 #include "suffix_array.h"
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <iostream>
@@ -15,9 +16,20 @@ using namespace chrono;
 
 namespace extractor {
 
+namespace {
+
+// Every kSampleRate-th suffix has its keys stored in sampled_keys, for the
+// offsets 1 to kMaxSampledOffset (4 bytes of index per kSampleRate / 4
+// suffixes).
+const int kSampleRate = 16;
+const int kMaxSampledOffset = 4;
+
+} // namespace
+
 SuffixArray::SuffixArray(shared_ptr<DataArray> data_array) :
     data_array(data_array) {
   BuildSuffixArray();
+  BuildSampledKeys();
 }
 
 SuffixArray::SuffixArray() {}
@@ -185,9 +197,8 @@ shared_ptr<DataArray> SuffixArray::GetData() const {
   return data_array;
 }
 
-PhraseLocation SuffixArray::Lookup(int low, int high, const string& word,
+PhraseLocation SuffixArray::Lookup(int low, int high, int word_id,
                                    int offset) const {
-  int word_id = data_array->GetWordId(word);
   if (word_id == -1) {
     // Return empty phrase location.
     return PhraseLocation(0, 0);
@@ -203,11 +214,28 @@ PhraseLocation SuffixArray::Lookup(int low, int high, const string& word,
 
 int SuffixArray::LookupRangeStart(int low, int high, int word_id,
                                   int offset) const {
+  if (offset >= 1 && offset <= kMaxSampledOffset && high - low > kSampleRate &&
+      !sampled_keys.empty()) {
+    const vector<int>& keys = sampled_keys[offset - 1];
+    int sample_low = (low + kSampleRate - 1) / kSampleRate;
+    int sample_high = (high + kSampleRate - 1) / kSampleRate;
+    int sample = lower_bound(keys.begin() + sample_low,
+                             keys.begin() + sample_high, word_id) -
+                 keys.begin();
+    // The sampled suffix before is smaller than word_id, and the result is at
+    // most the rank of this one.
+    if (sample > sample_low) {
+      low = (sample - 1) * kSampleRate + 1;
+    }
+    if (sample < sample_high) {
+      high = sample * kSampleRate;
+    }
+  }
+
   int result = high;
   while (low < high) {
     int middle = low + (high - low) / 2;
-    if (suffix_array[middle] + offset >= data_array->GetSize() ||
-        data_array->AtIndex(suffix_array[middle] + offset) < word_id) {
+    if (GetKey(middle, offset) < word_id) {
       low = middle + 1;
     } else {
       result = middle;
@@ -217,6 +245,21 @@ int SuffixArray::LookupRangeStart(int low, int high, int word_id,
   return result;
 }
 
+int SuffixArray::GetKey(int rank, int offset) const {
+  int position = suffix_array[rank] + offset;
+  return position < data_array->GetSize() ? data_array->AtIndex(position) : -1;
+}
+
+void SuffixArray::BuildSampledKeys() {
+  int num_samples = (suffix_array.size() + kSampleRate - 1) / kSampleRate;
+  sampled_keys.assign(kMaxSampledOffset, vector<int>(num_samples));
+  for (int offset = 1; offset <= kMaxSampledOffset; ++offset) {
+    for (int i = 0; i < num_samples; ++i) {
+      sampled_keys[offset - 1][i] = GetKey(i * kSampleRate, offset);
+    }
+  }
+}
+
 bool SuffixArray::operator==(const SuffixArray& other) const {
   return *data_array == *other.data_array &&
          suffix_array == other.suffix_array &&
@@ -39,9 +39,10 @@ class SuffixArray {
   // Returns the i-th suffix.
   virtual int GetSuffix(int rank) const;
 
-  // Given the range in which a phrase is located and the next word, returns the
+  // Given the range in which a phrase is located and the id of the next word
+  // in the data array (-1 if the word doesn't occur in the data), returns the
   // range corresponding to the phrase extended with the next word.
-  virtual PhraseLocation Lookup(int low, int high, const string& word,
+  virtual PhraseLocation Lookup(int low, int high, int word_id,
                                 int offset) const;
 
   bool operator==(const SuffixArray& other) const;
@@ -66,6 +67,14 @@ class SuffixArray {
   // offset value is greater or equal to word_id.
   int LookupRangeStart(int low, int high, int word_id, int offset) const;
 
+  // Returns the word at the given offset in the suffix of the given rank, or -1
+  // if the suffix is shorter.
+  int GetKey(int rank, int offset) const;
+
+  // Stores the keys of every kSampleRate-th suffix for small offsets (see
+  // sampled_keys).
+  void BuildSampledKeys();
+
   friend class boost::serialization::access;
 
   template<class Archive> void save(Archive& ar, unsigned int) const {
@@ -79,6 +88,7 @@ class SuffixArray {
     ar >> *data_array;
     ar >> suffix_array;
     ar >> word_start;
+    BuildSampledKeys();
   }
 
   BOOST_SERIALIZATION_SPLIT_MEMBER();
@@ -86,6 +96,12 @@ class SuffixArray {
   shared_ptr<DataArray> data_array;
   vector<int> suffix_array;
   vector<int> word_start;
+  // sampled_keys[offset - 1][i] = GetKey(i * kSampleRate, offset). The binary
+  // search in LookupRangeStart first narrows the range down to kSampleRate
+  // suffixes using these contiguous arrays, instead of following two pointers
+  // (into the suffix array and into the data array) at every step. They are
+  // not serialized, but rebuilt after loading.
+  vector<vector<int>> sampled_keys;
 };
 
 } // namespace extractor
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <boost/archive/binary_iarchive.hpp>
@@ -21,9 +22,12 @@ class SuffixArrayTest : public Test {
   virtual void SetUp() {
     data = {6, 4, 1, 2, 4, 5, 3, 4, 6, 6, 4, 1, 2};
     data_array = make_shared<MockDataArray>();
-    EXPECT_CALL(*data_array, GetData()).WillRepeatedly(Return(data));
+    EXPECT_CALL(*data_array, GetData()).WillRepeatedly(ReturnRef(data));
     EXPECT_CALL(*data_array, GetVocabularySize()).WillRepeatedly(Return(7));
     EXPECT_CALL(*data_array, GetSize()).WillRepeatedly(Return(13));
+    for (size_t i = 0; i < data.size(); ++i) {
+      EXPECT_CALL(*data_array, AtIndex(i)).WillRepeatedly(Return(data[i]));
+    }
     suffix_array = SuffixArray(data_array);
   }
 
@@ -51,27 +55,51 @@ TEST_F(SuffixArrayTest, TestBuildLCP) {
 }
 
 TEST_F(SuffixArrayTest, TestLookup) {
+  EXPECT_EQ(PhraseLocation(11, 14), suffix_array.Lookup(0, 14, 6, 0));
+  EXPECT_EQ(PhraseLocation(0, 0), suffix_array.Lookup(0, 14, -1, 0));
+  EXPECT_EQ(PhraseLocation(11, 13), suffix_array.Lookup(11, 14, 4, 1));
+  EXPECT_EQ(PhraseLocation(11, 13), suffix_array.Lookup(11, 13, 1, 2));
+  EXPECT_EQ(PhraseLocation(11, 13), suffix_array.Lookup(11, 13, 2, 3));
+  EXPECT_EQ(PhraseLocation(12, 13), suffix_array.Lookup(11, 13, 4, 4));
+  EXPECT_EQ(PhraseLocation(11, 11), suffix_array.Lookup(11, 13, 2, 1));
+}
+
+TEST(SuffixArrayLookupTest, TestLookupLongRanges) {
+  // Long enough for the lookups to narrow the ranges using the sampled keys.
+  vector<int> data;
+  for (int i = 0; i < 100; ++i) {
+    data.push_back(2 + (i * i + i / 7) % 2);
+  }
+  shared_ptr<MockDataArray> data_array = make_shared<MockDataArray>();
+  EXPECT_CALL(*data_array, GetData()).WillRepeatedly(ReturnRef(data));
+  EXPECT_CALL(*data_array, GetVocabularySize()).WillRepeatedly(Return(4));
+  EXPECT_CALL(*data_array, GetSize()).WillRepeatedly(Return(data.size()));
   for (size_t i = 0; i < data.size(); ++i) {
     EXPECT_CALL(*data_array, AtIndex(i)).WillRepeatedly(Return(data[i]));
   }
-
-  EXPECT_CALL(*data_array, GetWordId("word1")).WillRepeatedly(Return(6));
-  EXPECT_EQ(PhraseLocation(11, 14), suffix_array.Lookup(0, 14, "word1", 0));
-
-  EXPECT_CALL(*data_array, GetWordId("word2")).WillRepeatedly(Return(-1));
-  EXPECT_EQ(PhraseLocation(0, 0), suffix_array.Lookup(0, 14, "word2", 0));
-
-  EXPECT_CALL(*data_array, GetWordId("word3")).WillRepeatedly(Return(4));
-  EXPECT_EQ(PhraseLocation(11, 13), suffix_array.Lookup(11, 14, "word3", 1));
-
-  EXPECT_CALL(*data_array, GetWordId("word4")).WillRepeatedly(Return(1));
-  EXPECT_EQ(PhraseLocation(11, 13), suffix_array.Lookup(11, 13, "word4", 2));
-
-  EXPECT_CALL(*data_array, GetWordId("word5")).WillRepeatedly(Return(2));
-  EXPECT_EQ(PhraseLocation(11, 13), suffix_array.Lookup(11, 13, "word5", 3));
-
-  EXPECT_EQ(PhraseLocation(12, 13), suffix_array.Lookup(11, 13, "word3", 4));
-  EXPECT_EQ(PhraseLocation(11, 11), suffix_array.Lookup(11, 13, "word5", 1));
+  SuffixArray suffix_array(data_array);
+
+  // Looks up every phrase of up to 6 words in the data and checks that the
+  // range contains exactly its occurrences.
+  for (size_t start = 0; start < data.size(); ++start) {
+    PhraseLocation location(0, suffix_array.GetSize());
+    for (size_t len = 1; len <= 6 && start + len <= data.size(); ++len) {
+      location = suffix_array.Lookup(location.sa_low, location.sa_high,
+                                     data[start + len - 1], len - 1);
+      int num_occurrences = 0;
+      for (size_t i = 0; i + len <= data.size(); ++i) {
+        num_occurrences += equal(data.begin() + i, data.begin() + i + len,
+                                 data.begin() + start);
+      }
+      EXPECT_EQ(num_occurrences, location.sa_high - location.sa_low);
+      for (int rank = location.sa_low; rank < location.sa_high; ++rank) {
+        int suffix = suffix_array.GetSuffix(rank);
+        ASSERT_LE(suffix + len, data.size());
+        EXPECT_TRUE(equal(data.begin() + start, data.begin() + start + len,
+                          data.begin() + suffix));
+      }
+    }
+  }
 }
 
 TEST_F(SuffixArrayTest, TestSerialization) {
@@ -1,10 +1,11 @@
 #include "translation_table.h"
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <string>
 #include <vector>
 
-#include <boost/functional/hash.hpp>
-
 #include "alignment.h"
 #include "data_array.h"
 
@@ -14,116 +15,280 @@ namespace extractor {
 
 TranslationTable::TranslationTable(shared_ptr<DataArray> source_data_array,
                                    shared_ptr<DataArray> target_data_array,
-                                   shared_ptr<Alignment> alignment) :
+                                   shared_ptr<Alignment> alignment,
+                                   int num_threads) :
     source_data_array(source_data_array), target_data_array(target_data_array) {
+  // Each thread counts the links of a contiguous shard of sentences.
+  long long num_sentences = source_data_array->GetNumSentences();
+  vector<vector<pair<uint64_t, int>>> shard_links_count(num_threads);
+  #pragma omp parallel for schedule(static, 1) num_threads(num_threads)
+  for (int shard = 0; shard < num_threads; ++shard) {
+    shard_links_count[shard] = CountLinks(alignment,
+        num_sentences * shard / num_threads,
+        num_sentences * (shard + 1) / num_threads);
+  }
+
+  // Merges the sorted counts of the shards.
+  vector<pair<uint64_t, int>> links_count;
+  for (const auto& shard_count: shard_links_count) {
+    vector<pair<uint64_t, int>> merged_count;
+    merged_count.reserve(links_count.size() + shard_count.size());
+    size_t i = 0, j = 0;
+    while (i < links_count.size() || j < shard_count.size()) {
+      if (j == shard_count.size() ||
+          (i < links_count.size() &&
+           links_count[i].first < shard_count[j].first)) {
+        merged_count.push_back(links_count[i++]);
+      } else if (i == links_count.size() ||
+                 shard_count[j].first < links_count[i].first) {
+        merged_count.push_back(shard_count[j++]);
+      } else {
+        merged_count.push_back(make_pair(links_count[i].first,
+            links_count[i].second + shard_count[j].second));
+        ++i, ++j;
+      }
+    }
+    links_count.swap(merged_count);
+  }
+
+  int num_source_words = 0, num_target_words = 0;
+  for (pair<uint64_t, int> link_count: links_count) {
+    num_source_words = max(num_source_words,
+                           static_cast<int>(link_count.first >> 32) + 1);
+    num_target_words = max(num_target_words,
+                           static_cast<int>(link_count.first) + 1);
+  }
+  source_links_count.resize(num_source_words);
+  target_links_count.resize(num_target_words);
+  for (pair<uint64_t, int> link_count: links_count) {
+    source_links_count[link_count.first >> 32] += link_count.second;
+    target_links_count[static_cast<int>(link_count.first)] +=
+        link_count.second;
+  }
+
+  // Calculating:
+  //   p(e | f) = count(e, f) / count(f)
+  //   p(f | e) = count(e, f) / count(e)
+  // The counts are sorted by source word and target word, so the entries of
+  // each source word are contiguous.
+  source_offsets.assign(num_source_words + 1, 0);
+  target_ids.reserve(links_count.size());
+  translation_probabilities.reserve(links_count.size());
+  for (pair<uint64_t, int> link_count: links_count) {
+    int source_word = link_count.first >> 32;
+    int target_word = static_cast<int>(link_count.first);
+    double score1 = 1.0 * link_count.second / source_links_count[source_word];
+    double score2 = 1.0 * link_count.second / target_links_count[target_word];
+    ++source_offsets[source_word + 1];
+    target_ids.push_back(target_word);
+    translation_probabilities.push_back(make_pair(score1, score2));
+  }
+  partial_sum(source_offsets.begin(), source_offsets.end(),
+              source_offsets.begin());
+}
+
+vector<pair<uint64_t, int>> TranslationTable::CountLinks(
+    shared_ptr<Alignment> alignment, int begin, int end) const {
   const vector<int>& source_data = source_data_array->GetData();
   const vector<int>& target_data = target_data_array->GetData();
 
-  unordered_map<int, int> source_links_count;
-  unordered_map<int, int> target_links_count;
-  unordered_map<pair<int, int>, int, PairHash> links_count;
-
   // For each pair of aligned source target words increment their link count by
   // 1. Unaligned words are paired with the NULL token.
-  for (size_t i = 0; i < source_data_array->GetNumSentences(); ++i) {
+  unordered_map<uint64_t, int> keys_count;
+  for (int i = begin; i < end; ++i) {
     vector<pair<int, int>> links = alignment->GetLinks(i);
     int source_start = source_data_array->GetSentenceStart(i);
     int target_start = target_data_array->GetSentenceStart(i);
     // Ignore END_OF_LINE markers.
-    int next_source_start = source_data_array->GetSentenceStart(i + 1) - 1;
-    int next_target_start = target_data_array->GetSentenceStart(i + 1) - 1;
-    vector<int> source_sentence(source_data.begin() + source_start,
-        source_data.begin() + next_source_start);
-    vector<int> target_sentence(target_data.begin() + target_start,
-        target_data.begin() + next_target_start);
-    vector<int> source_linked_words(source_sentence.size());
-    vector<int> target_linked_words(target_sentence.size());
+    int source_length =
+        source_data_array->GetSentenceStart(i + 1) - 1 - source_start;
+    int target_length =
+        target_data_array->GetSentenceStart(i + 1) - 1 - target_start;
+    vector<int> source_linked_words(source_length);
+    vector<int> target_linked_words(target_length);
 
     for (pair<int, int> link: links) {
       source_linked_words[link.first] = 1;
       target_linked_words[link.second] = 1;
-      IncrementLinksCount(source_links_count, target_links_count, links_count,
-          source_sentence[link.first], target_sentence[link.second]);
+      ++keys_count[GetKey(source_data[source_start + link.first],
+                          target_data[target_start + link.second])];
     }
 
-    for (size_t i = 0; i < source_sentence.size(); ++i) {
-      if (!source_linked_words[i]) {
-        IncrementLinksCount(source_links_count, target_links_count, links_count,
-                            source_sentence[i], DataArray::NULL_WORD);
+    for (size_t j = 0; j < source_length; ++j) {
+      if (!source_linked_words[j]) {
+        ++keys_count[GetKey(source_data[source_start + j],
+                            DataArray::NULL_WORD)];
       }
     }
 
-    for (size_t i = 0; i < target_sentence.size(); ++i) {
-      if (!target_linked_words[i]) {
-        IncrementLinksCount(source_links_count, target_links_count, links_count,
-                            DataArray::NULL_WORD, target_sentence[i]);
+    for (size_t j = 0; j < target_length; ++j) {
+      if (!target_linked_words[j]) {
+        ++keys_count[GetKey(DataArray::NULL_WORD,
+                            target_data[target_start + j])];
       }
     }
   }
 
-  // Calculating:
-  //   p(e | f) = count(e, f) / count(f)
-  //   p(f | e) = count(e, f) / count(e)
-  for (pair<pair<int, int>, int> link_count: links_count) {
-    int source_word = link_count.first.first;
-    int target_word = link_count.first.second;
-    double score1 = 1.0 * link_count.second / source_links_count[source_word];
-    double score2 = 1.0 * link_count.second / target_links_count[target_word];
-    translation_probabilities[link_count.first] = make_pair(score1, score2);
-  }
+  // Only the distinct pairs are sorted.
+  vector<pair<uint64_t, int>> links_count(keys_count.begin(),
+                                          keys_count.end());
+  sort(links_count.begin(), links_count.end());
+  return links_count;
 }
 
 TranslationTable::TranslationTable() {}
 
+void TranslationTable::SetEntries(
+    vector<pair<pair<int, int>, pair<double, double>>> entries) {
+  sort(entries.begin(), entries.end());
+  int num_source_words = entries.empty() ? 0 : entries.back().first.first + 1;
+  source_offsets.assign(num_source_words + 1, 0);
+  target_ids.clear();
+  translation_probabilities.clear();
+  for (const auto& entry: entries) {
+    ++source_offsets[entry.first.first + 1];
+    target_ids.push_back(entry.first.second);
+    translation_probabilities.push_back(entry.second);
+  }
+  partial_sum(source_offsets.begin(), source_offsets.end(),
+              source_offsets.begin());
+}
+
 TranslationTable::~TranslationTable() {}
 
-void TranslationTable::IncrementLinksCount(
-    unordered_map<int, int>& source_links_count,
-    unordered_map<int, int>& target_links_count,
-    unordered_map<pair<int, int>, int, PairHash>& links_count,
-    int source_word_id,
-    int target_word_id) const {
-  ++source_links_count[source_word_id];
-  ++target_links_count[target_word_id];
-  ++links_count[make_pair(source_word_id, target_word_id)];
+void TranslationTable::AddSentencePair(const vector<string>& source_sentence,
+                                       const vector<string>& target_sentence,
+                                       const vector<pair<int, int>>& links) {
+  vector<int> source_linked_words(source_sentence.size());
+  vector<int> target_linked_words(target_sentence.size());
+  for (pair<int, int> link: links) {
+    source_linked_words[link.first] = 1;
+    target_linked_words[link.second] = 1;
+    IncrementLinksCount(source_sentence[link.first],
+                        target_sentence[link.second]);
+  }
+
+  for (size_t i = 0; i < source_sentence.size(); ++i) {
+    if (!source_linked_words[i]) {
+      IncrementLinksCount(source_sentence[i], DataArray::NULL_WORD_STR);
+    }
+  }
+
+  for (size_t i = 0; i < target_sentence.size(); ++i) {
+    if (!target_linked_words[i]) {
+      IncrementLinksCount(DataArray::NULL_WORD_STR, target_sentence[i]);
+    }
+  }
+}
+
+void TranslationTable::IncrementLinksCount(const string& source_word,
+                                           const string& target_word) {
+  ++online_source_links_count[source_word];
+  ++online_target_links_count[target_word];
+  ++online_links_count[make_pair(source_word, target_word)];
 }
 
 double TranslationTable::GetTargetGivenSourceScore(
     const string& source_word, const string& target_word) {
   int source_id = source_data_array->GetWordId(source_word);
   int target_id = target_data_array->GetWordId(target_word);
+  if (!online_links_count.empty()) {
+    return GetMergedScore(source_word, target_word, source_id, target_id,
+                          true);
+  }
   if (source_id == -1 || target_id == -1) {
     return -1;
   }
 
-  auto entry = make_pair(source_id, target_id);
-  auto it = translation_probabilities.find(entry);
-  if (it == translation_probabilities.end()) {
+  int entry = FindEntry(source_id, target_id);
+  if (entry == -1) {
     return 0;
   }
-  return it->second.first;
+  return translation_probabilities[entry].first;
 }
 
 double TranslationTable::GetSourceGivenTargetScore(
     const string& source_word, const string& target_word) {
   int source_id = source_data_array->GetWordId(source_word);
   int target_id = target_data_array->GetWordId(target_word);
+  if (!online_links_count.empty()) {
+    return GetMergedScore(source_word, target_word, source_id, target_id,
+                          false);
+  }
   if (source_id == -1 || target_id == -1) {
     return -1;
   }
 
-  auto entry = make_pair(source_id, target_id);
-  auto it = translation_probabilities.find(entry);
-  if (it == translation_probabilities.end()) {
+  int entry = FindEntry(source_id, target_id);
+  if (entry == -1) {
     return 0;
   }
-  return it->second.second;
+  return translation_probabilities[entry].second;
+}
+
+int TranslationTable::FindEntry(int source_id, int target_id) const {
+  if (source_id < 0 || source_id + 1 >= source_offsets.size()) {
+    return -1;
+  }
+  auto begin = target_ids.begin() + source_offsets[source_id];
+  auto end = target_ids.begin() + source_offsets[source_id + 1];
+  auto it = lower_bound(begin, end, target_id);
+  if (it == end || *it != target_id) {
+    return -1;
+  }
+  return it - target_ids.begin();
+}
+
+double TranslationTable::GetMergedScore(
+    const string& source_word, const string& target_word,
+    int source_id, int target_id, bool target_given_source) const {
+  int word_id = target_given_source ? source_id : target_id;
+  const vector<int>& links_count =
+      target_given_source ? source_links_count : target_links_count;
+  const unordered_map<string, int>& online_word_links_count =
+      target_given_source ? online_source_links_count
+                          : online_target_links_count;
+
+  double word_links = 0, pair_links = 0;
+  auto online_word_entry = online_word_links_count.find(
+      target_given_source ? source_word : target_word);
+  if (online_word_entry != online_word_links_count.end()) {
+    word_links += online_word_entry->second;
+  }
+  auto online_pair_entry = online_links_count.find(
+      make_pair(source_word, target_word));
+  if (online_pair_entry != online_links_count.end()) {
+    pair_links += online_pair_entry->second;
+  }
+
+  if (word_id >= 0 && word_id < links_count.size()) {
+    word_links += links_count[word_id];
+    int entry = FindEntry(source_id, target_id);
+    if (source_id != -1 && target_id != -1 && entry != -1) {
+      const pair<double, double>& scores = translation_probabilities[entry];
+      double score = target_given_source ? scores.first : scores.second;
+      pair_links += round(score * links_count[word_id]);
+    }
+  }
+
+  if (word_links == 0) {
+    return -1;
+  }
+  return pair_links / word_links;
+}
+
+bool TranslationTable::HasLinksCount() const {
+  return !source_links_count.empty();
 }
 
 bool TranslationTable::operator==(const TranslationTable& other) const {
   return *source_data_array == *other.source_data_array &&
          *target_data_array == *other.target_data_array &&
-         translation_probabilities == other.translation_probabilities;
+         source_offsets == other.source_offsets &&
+         target_ids == other.target_ids &&
+         translation_probabilities == other.translation_probabilities &&
+         source_links_count == other.source_links_count &&
+         target_links_count == other.target_links_count;
 }
 
 } // namespace extractor
@@ -2,34 +2,49 @@
 #define _TRANSLATION_TABLE_
 
 #include <memory>
+#include <stdint.h>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/functional/hash.hpp>
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 
 using namespace std;
 
 namespace extractor {
 
-typedef boost::hash<pair<int, int>> PairHash;
+typedef boost::hash<pair<string, string>> StringPairHash;
 
 class Alignment;
 class DataArray;
 
 /**
  * Bilexical table with conditional probabilities.
+ *
+ * The probabilities are stored in flat arrays sorted by source word id and
+ * target word id, with the entries of each source word delimited by an array of
+ * offsets (indexed by the source word id), so a lookup is a binary search among
+ * the words linked to the source word. The links are counted in parallel over
+ * shards of sentences.
+ *
+ * The links of sentence pairs added after the table was constructed (see
+ * AddSentencePair) are counted separately, by word, and merged with the links
+ * of the original data when the scores are queried.
  */
 class TranslationTable {
  public:
   // Constructs a translation table from source data, target data and the
-  // corresponding alignment.
+  // corresponding alignment, using the given number of threads.
   TranslationTable(
       shared_ptr<DataArray> source_data_array,
       shared_ptr<DataArray> target_data_array,
-      shared_ptr<Alignment> alignment);
+      shared_ptr<Alignment> alignment,
+      int num_threads = 1);
 
   // Creates empty translation table.
   TranslationTable();
@@ -44,41 +59,98 @@ class TranslationTable {
   virtual double GetSourceGivenTargetScore(const string& source_word,
                                            const string& target_word);
 
+  // Counts the links of a sentence pair added to the parallel corpus (with
+  // the same conventions as the constructor). Must not be called while scores
+  // are being queried by other threads.
+  void AddSentencePair(const vector<string>& source_sentence,
+                       const vector<string>& target_sentence,
+                       const vector<pair<int, int>>& links);
+
+  // Returns true if the number of links of each word of the original data is
+  // known, which AddSentencePair needs to merge the links. Tables read from
+  // archives written before the counts were stored (version 0) do not know it.
+  bool HasLinksCount() const;
+
   bool operator==(const TranslationTable& other) const;
 
  private:
+  // Packs the (f, e) word pair in a key ordered by f and then by e.
+  static uint64_t GetKey(int source_id, int target_id) {
+    return static_cast<uint64_t>(source_id) << 32 |
+           static_cast<uint32_t>(target_id);
+  }
+
+  // Counts the links of the sentences in [begin, end) as sorted (source word,
+  // target word) keys with their number of occurrences.
+  vector<pair<uint64_t, int>> CountLinks(
+      shared_ptr<Alignment> alignment, int begin, int end) const;
+
+  // Returns the position of the (f, e) word pair in the flat arrays or -1 if
+  // the words have never been linked.
+  int FindEntry(int source_id, int target_id) const;
+
+  // Stores the ((f, e), (p(e | f), p(f | e))) entries of an archive written
+  // before version 2 in the flat arrays.
+  void SetEntries(
+      vector<pair<pair<int, int>, pair<double, double>>> entries);
+
   // Increment links count for the given (f, e) word pair.
-  void IncrementLinksCount(
-      unordered_map<int, int>& source_links_count,
-      unordered_map<int, int>& target_links_count,
-      unordered_map<pair<int, int>, int, PairHash>& links_count,
-      int source_word_id,
-      int target_word_id) const;
+  void IncrementLinksCount(const string& source_word,
+                           const string& target_word);
+
+  // Returns p(e | f) if target_given_source is true and p(f | e) otherwise,
+  // merging the links of the original data with the links of the added
+  // sentence pairs. The number of links of the original word pair is
+  // recovered from its conditional probability.
+  double GetMergedScore(const string& source_word, const string& target_word,
+                        int source_id, int target_id,
+                        bool target_given_source) const;
 
   friend class boost::serialization::access;
 
   template<class Archive> void save(Archive& ar, unsigned int) const {
     ar << *source_data_array << *target_data_array;
-
-    int num_entries = translation_probabilities.size();
-    ar << num_entries;
-    for (auto entry: translation_probabilities) {
-      ar << entry;
-    }
+    ar << source_offsets << target_ids << translation_probabilities;
+    ar << source_links_count << target_links_count;
   }
 
-  template<class Archive> void load(Archive& ar, unsigned int) {
+  template<class Archive> void load(Archive& ar, unsigned int version) {
     source_data_array = make_shared<DataArray>();
     ar >> *source_data_array;
     target_data_array = make_shared<DataArray>();
     ar >> *target_data_array;
 
+    if (version >= 2) {
+      ar >> source_offsets >> target_ids >> translation_probabilities;
+      ar >> source_links_count >> target_links_count;
+      return;
+    }
+
     int num_entries;
     ar >> num_entries;
-    for (size_t i = 0; i < num_entries; ++i) {
-      pair<pair<int, int>, pair<double, double>> entry;
+    vector<pair<pair<int, int>, pair<double, double>>> entries(num_entries);
+    for (auto& entry: entries) {
       ar >> entry;
-      translation_probabilities.insert(entry);
+    }
+    SetEntries(entries);
+    if (version == 1) {
+      LoadLinksCount(ar, source_links_count);
+      LoadLinksCount(ar, target_links_count);
+    }
+  }
+
+  // Reads the (word id, number of links) pairs of a version 1 archive.
+  template<class Archive> static void LoadLinksCount(
+      Archive& ar, vector<int>& links_count) {
+    int num_entries;
+    ar >> num_entries;
+    for (size_t i = 0; i < num_entries; ++i) {
+      int word_id, count;
+      ar >> word_id >> count;
+      if (word_id >= links_count.size()) {
+        links_count.resize(word_id + 1);
+      }
+      links_count[word_id] = count;
     }
   }
 
@@ -86,10 +158,25 @@ class TranslationTable {
 
   shared_ptr<DataArray> source_data_array;
   shared_ptr<DataArray> target_data_array;
-  unordered_map<pair<int, int>, pair<double, double>, PairHash>
-      translation_probabilities;
+  // The linked word pairs and their probabilities (p(e | f), p(f | e)). The
+  // pairs of source word f are the entries [source_offsets[f],
+  // source_offsets[f + 1]), sorted by target word id.
+  vector<int> source_offsets;
+  vector<int> target_ids;
+  vector<pair<double, double>> translation_probabilities;
+  // Number of links of each source (target) word in the original data.
+  vector<int> source_links_count;
+  vector<int> target_links_count;
+  // Links of the added sentence pairs.
+  unordered_map<string, int> online_source_links_count;
+  unordered_map<string, int> online_target_links_count;
+  unordered_map<pair<string, string>, int, StringPairHash> online_links_count;
 };
 
 } // namespace extractor
 
+// Version 1 stores the number of links of each word and version 2 stores the
+// table in flat arrays.
+BOOST_CLASS_VERSION(extractor::TranslationTable, 2)
+
 #endif
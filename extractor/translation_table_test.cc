@@ -16,6 +16,51 @@ using namespace std;
 using namespace ::testing;
 namespace ar = boost::archive;
 
+namespace extractor {
+
+// The layout of the archives written before the table was stored in flat
+// arrays (version 0).
+struct TranslationTableV0 {
+  template<class Archive> void serialize(Archive& ar, unsigned int) {
+    ar & source_data_array & target_data_array;
+    int num_entries = entries.size();
+    ar & num_entries;
+    for (auto& entry: entries) {
+      ar & entry;
+    }
+  }
+
+  DataArray source_data_array;
+  DataArray target_data_array;
+  vector<pair<pair<int, int>, pair<double, double>>> entries;
+};
+
+// Version 1 adds the number of links of each word.
+struct TranslationTableV1 {
+  template<class Archive> void serialize(Archive& ar, unsigned int version) {
+    table.serialize(ar, version);
+    SerializeLinksCount(ar, source_links_count);
+    SerializeLinksCount(ar, target_links_count);
+  }
+
+  template<class Archive> static void SerializeLinksCount(
+      Archive& ar, vector<pair<int, int>>& links_count) {
+    int num_entries = links_count.size();
+    ar & num_entries;
+    for (auto& entry: links_count) {
+      ar & entry.first & entry.second;
+    }
+  }
+
+  TranslationTableV0 table;
+  vector<pair<int, int>> source_links_count;
+  vector<pair<int, int>> target_links_count;
+};
+
+} // namespace extractor
+
+BOOST_CLASS_VERSION(extractor::TranslationTableV1, 1)
+
 namespace extractor {
 namespace {
 
@@ -24,11 +69,11 @@ class TranslationTableTest : public Test {
   virtual void SetUp() {
     vector<string> words = {"a", "b", "c"};
 
-    vector<int> source_data = {2, 3, 2, 3, 4, 0, 2, 3, 6, 0, 2, 3, 6, 0};
+    source_data = {2, 3, 2, 3, 4, 0, 2, 3, 6, 0, 2, 3, 6, 0};
     vector<int> source_sentence_start = {0, 6, 10, 14};
-    shared_ptr<MockDataArray> source_data_array = make_shared<MockDataArray>();
+    source_data_array = make_shared<MockDataArray>();
     EXPECT_CALL(*source_data_array, GetData())
-        .WillRepeatedly(Return(source_data));
+        .WillRepeatedly(ReturnRef(source_data));
     EXPECT_CALL(*source_data_array, GetNumSentences())
         .WillRepeatedly(Return(3));
     for (size_t i = 0; i < source_sentence_start.size(); ++i) {
@@ -41,11 +86,11 @@ class TranslationTableTest : public Test {
     }
     EXPECT_CALL(*source_data_array, GetWordId("d")).WillRepeatedly(Return(-1));
 
-    vector<int> target_data = {2, 3, 2, 3, 4, 5, 0, 3, 6, 0, 2, 7, 0};
+    target_data = {2, 3, 2, 3, 4, 5, 0, 3, 6, 0, 2, 7, 0};
     vector<int> target_sentence_start = {0, 7, 10, 13};
-    shared_ptr<MockDataArray> target_data_array = make_shared<MockDataArray>();
+    target_data_array = make_shared<MockDataArray>();
     EXPECT_CALL(*target_data_array, GetData())
-        .WillRepeatedly(Return(target_data));
+        .WillRepeatedly(ReturnRef(target_data));
     for (size_t i = 0; i < target_sentence_start.size(); ++i) {
       EXPECT_CALL(*target_data_array, GetSentenceStart(i))
           .WillRepeatedly(Return(target_sentence_start[i]));
@@ -62,7 +107,7 @@ class TranslationTableTest : public Test {
     };
     vector<pair<int, int>> links2 = {make_pair(1, 0), make_pair(2, 1)};
     vector<pair<int, int>> links3 = {make_pair(0, 0), make_pair(2, 1)};
-    shared_ptr<MockAlignment> alignment = make_shared<MockAlignment>();
+    alignment = make_shared<MockAlignment>();
     EXPECT_CALL(*alignment, GetLinks(0)).WillRepeatedly(Return(links1));
     EXPECT_CALL(*alignment, GetLinks(1)).WillRepeatedly(Return(links2));
     EXPECT_CALL(*alignment, GetLinks(2)).WillRepeatedly(Return(links3));
@@ -70,6 +115,11 @@ class TranslationTableTest : public Test {
     table = TranslationTable(source_data_array, target_data_array, alignment);
   }
 
+  vector<int> source_data;
+  vector<int> target_data;
+  shared_ptr<MockDataArray> source_data_array;
+  shared_ptr<MockDataArray> target_data_array;
+  shared_ptr<MockAlignment> alignment;
   TranslationTable table;
 };
 
@@ -85,6 +135,31 @@ TEST_F(TranslationTableTest, TestScores) {
   EXPECT_EQ(-1, table.GetSourceGivenTargetScore("c", "d"));
 }
 
+TEST_F(TranslationTableTest, TestMultipleThreads) {
+  for (int num_threads = 2; num_threads <= 4; ++num_threads) {
+    TranslationTable sharded_table(source_data_array, target_data_array,
+                                   alignment, num_threads);
+    EXPECT_EQ(table, sharded_table);
+  }
+}
+
+TEST_F(TranslationTableTest, TestAddSentencePair) {
+  vector<string> source_sentence = {"a", "d"};
+  vector<string> target_sentence = {"a", "d"};
+  vector<pair<int, int>> links = {make_pair(0, 0), make_pair(1, 1)};
+  table.AddSentencePair(source_sentence, target_sentence, links);
+
+  EXPECT_DOUBLE_EQ(0.8, table.GetTargetGivenSourceScore("a", "a"));
+  EXPECT_EQ(0, table.GetTargetGivenSourceScore("a", "d"));
+  EXPECT_EQ(1, table.GetTargetGivenSourceScore("d", "d"));
+  EXPECT_EQ(0, table.GetTargetGivenSourceScore("c", "d"));
+
+  EXPECT_EQ(1, table.GetSourceGivenTargetScore("a", "a"));
+  EXPECT_EQ(1, table.GetSourceGivenTargetScore("c", "c"));
+  EXPECT_EQ(1, table.GetSourceGivenTargetScore("d", "d"));
+  EXPECT_EQ(0, table.GetSourceGivenTargetScore("d", "c"));
+}
+
 TEST_F(TranslationTableTest, TestSerialization) {
   stringstream stream(ios_base::binary | ios_base::out | ios_base::in);
   ar::binary_oarchive output_stream(stream, ar::no_header);
@@ -97,5 +172,48 @@ TEST_F(TranslationTableTest, TestSerialization) {
   EXPECT_EQ(table, table_copy);
 }
 
+TEST_F(TranslationTableTest, TestLoadOldVersions) {
+  EXPECT_TRUE(table.HasLinksCount());
+
+  TranslationTableV0 old_table;
+  old_table.source_data_array = DataArray(vector<string>{"a b"});
+  old_table.target_data_array = DataArray(vector<string>{"x y"});
+  old_table.entries = {
+      make_pair(make_pair(2, 2), make_pair(0.5, 1.0)),
+      make_pair(make_pair(2, 3), make_pair(0.5, 1.0)),
+      make_pair(make_pair(3, 0), make_pair(1.0, 1.0))
+  };
+  TranslationTableV1 links_count_table;
+  links_count_table.table = old_table;
+  links_count_table.source_links_count = {make_pair(2, 2), make_pair(3, 1)};
+  links_count_table.target_links_count = {
+      make_pair(0, 1), make_pair(2, 1), make_pair(3, 1)};
+
+  for (int version = 0; version <= 1; ++version) {
+    stringstream stream(ios_base::binary | ios_base::out | ios_base::in);
+    ar::binary_oarchive output_stream(stream, ar::no_header);
+    if (version == 0) {
+      output_stream << old_table;
+    } else {
+      output_stream << links_count_table;
+    }
+
+    TranslationTable table_copy;
+    ar::binary_iarchive input_stream(stream, ar::no_header);
+    input_stream >> table_copy;
+    EXPECT_EQ(version == 1, table_copy.HasLinksCount());
+    EXPECT_EQ(0.5, table_copy.GetTargetGivenSourceScore("a", "y"));
+    EXPECT_EQ(1, table_copy.GetSourceGivenTargetScore("a", "x"));
+    EXPECT_EQ(0, table_copy.GetTargetGivenSourceScore("b", "y"));
+    EXPECT_EQ(1, table_copy.GetTargetGivenSourceScore(
+        "b", DataArray::NULL_WORD_STR));
+    if (version == 1) {
+      vector<pair<int, int>> links = {make_pair(0, 0)};
+      table_copy.AddSentencePair({"a"}, {"x"}, links);
+      EXPECT_DOUBLE_EQ(2.0 / 3, table_copy.GetTargetGivenSourceScore("a", "x"));
+    }
+  }
+}
+
 } // namespace
 } // namespace extractor
@@ -15,7 +15,6 @@
 using namespace std;
 
 extern const char* meteor_jar_path;
-extern void setup_child_process_handler();
 
 map<string, boost::shared_ptr<ScoreServer> > ScoreServerManager::servers_;
 
@@ -46,91 +45,18 @@ ScoreServer* ScoreServerManager::Instance(const string& score_type) {
   return s.get();
 }
 
-ScoreServer::ScoreServer(const string& cmd) {
-  setup_child_process_handler();
-  cerr << "Invoking " << cmd << " ..." << endl;
-  if (pipe(p2c) < 0) { perror("pipe"); exit(1); }
-  if (pipe(c2p) < 0) { perror("pipe"); exit(1); }
-  pid_t cpid = fork();
-  if (cpid < 0) { perror("fork"); exit(1); }
-  if (cpid == 0) {  // child
-    close(p2c[1]);
-    close(c2p[0]);
-    dup2(p2c[0], 0);
-    close(p2c[0]);
-    dup2(c2p[1], 1);
-    close(c2p[1]);
-    cerr << "Exec'ing from child " << cmd << endl;
-    vector<string> vargs;
-    SplitOnWhitespace(cmd, &vargs);
-    const char** cargv = static_cast<const char**>(malloc(sizeof(const char*) * (vargs.size() + 1)));
-    for (unsigned i = 0; i < vargs.size(); i++) cargv[i] = vargs[i].c_str();
-    cargv[vargs.size()] = NULL;
-    execvp(*cargv, (char* const*)cargv);
-  } else { // parent
-    close(c2p[1]);
-    close(p2c[0]);
-  }
-  string dummy;
-  RequestResponse("SCORE ||| Reference initialization string . ||| Testing initialization string .", &dummy);
-  assert(dummy.size() > 0);
-  cerr << "Connection established.\n";
-}
+ScoreServer::ScoreServer(const string& cmd) : impl_(cmd) {}
 
 ScoreServer::~ScoreServer() {
   cerr << "ScoreServer::~ScoreServer()\n";
-  // TODO close stuff, join stuff
 }
 
 float ScoreServer::ComputeScore(const vector<float>& fields) {
-  ostringstream os;
-  os << "EVAL |||";
-  for (unsigned i = 0; i < fields.size(); ++i)
-    os << ' ' << fields[i];
-  string sres;
-  RequestResponse(os.str(), &sres);
-  return strtod(sres.c_str(), NULL);
+  return impl_.ComputeScore(fields);
 }
 
 void ScoreServer::Evaluate(const vector<vector<WordID> >& refs, const vector<WordID>& hyp, vector<float>* fields) {
-  ostringstream os;
-  os << "SCORE";
-  for (unsigned i = 0; i < refs.size(); ++i) {
-    os << " |||";
-    for (unsigned j = 0; j < refs[i].size(); ++j) {
-      os << ' ' << TD::Convert(refs[i][j]);
-    }
-  }
-  os << " |||";
-  for (unsigned i = 0; i < hyp.size(); ++i) {
-    os << ' ' << TD::Convert(hyp[i]);
-  }
-  string sres;
-  RequestResponse(os.str(), &sres);
-  istringstream is(sres);
-  float val;
-  fields->clear();
-  while(is >> val)
-    fields->push_back(val);
-}
-
-#define MAX_BUF 16000
-
-void ScoreServer::RequestResponse(const string& request, string* response) {
-//  cerr << "@SERVER: " << request << endl;
-  string x = request + "\n";
-  write(p2c[1], x.c_str(), x.size());
-  char buf[MAX_BUF];
-  size_t n = read(c2p[0], buf, MAX_BUF);
-  while (n < MAX_BUF && buf[n-1] != '\n')
-    n += read(c2p[0], &buf[n], MAX_BUF - n);
-
-  buf[n-1] = 0;
-  if (n < 2) {
-    cerr << "Malformed response: " << buf << endl;
-  }
-  *response = Trim(buf, " \t\n");
-//  cerr << "@RESPONSE: '" << *response << "'\n";
+  impl_.Evaluate(refs, hyp, fields);
 }
 
 struct ExternalScore : public ScoreBase<ExternalScore> {
@@ -7,6 +7,7 @@
 #include <boost/shared_ptr.hpp>
 
 #include "scorer.h"
+#include "ns_ext.h"
 
 class ScoreServer {
   friend class ScoreServerManager;
@@ -19,9 +20,7 @@ class ScoreServer {
   void Evaluate(const std::vector<std::vector<WordID> >& refs, const std::vector<WordID>& hyp, std::vector<float>* fields);
 
  private:
-  void RequestResponse(const std::string& request, std::string* response);
-  int p2c[2];
-  int c2p[2];
+  NScoreServer impl_;
 };
 
 class ScoreServerManager {
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <vector>
+#include <cassert>
+#include <cstdlib>
+#include <chrono>
+
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "stringlib.h"
+#include "filelib.h"
+#include "tdict.h"
+#include "ns.h"
+#include "ns_docscorer.h"
+
+using namespace std;
+namespace po = boost::program_options;
+
+// Measures how many hypotheses per second a metric's SegmentEvaluator can
+// score. For every reference set, a synthetic k-best list is generated by
+// randomly dropping, substituting and swapping words of the first reference,
+// which is roughly what a decoder's k-best list looks like to the metric.
+
+void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
+  po::options_description opts("Configuration options");
+  opts.add_options()
+        ("reference,r",po::value<vector<string> >(), "Reference translation(s) in tokenized text files [default: test_data/re.txt.*]")
+        ("evaluation_metric,m",po::value<string>()->default_value("IBM_BLEU"), "Evaluation metric (ibm_bleu, koehn_bleu, nist_bleu, ter, etc.)")
+        ("k_best_size,k",po::value<unsigned>()->default_value(1000), "Number of hypotheses per reference set")
+        ("passes,p",po::value<unsigned>()->default_value(20), "Number of passes over the data")
+        ("random_seed,S",po::value<unsigned>()->default_value(1), "Random seed")
+        ("help,h", "Help");
+  po::options_description dcmdline_options;
+  dcmdline_options.add(opts);
+  po::store(parse_command_line(argc, argv, dcmdline_options), *conf);
+  if (conf->count("help")) {
+    cerr << dcmdline_options << endl;
+    exit(1);
+  }
+}
+
+static void Perturb(const vector<WordID>& ref, const vector<WordID>& vocab, vector<WordID>* hyp) {
+  hyp->clear();
+  for (unsigned i = 0; i < ref.size(); ++i) {
+    const int r = rand() % 10;
+    if (r == 0) continue;  // deletion
+    if (r == 1) hyp->push_back(vocab[rand() % vocab.size()]);  // substitution
+    else hyp->push_back(ref[i]);
+    if (r == 2) hyp->push_back(vocab[rand() % vocab.size()]);  // insertion
+  }
+  if (hyp->size() > 1) {
+    const unsigned i = rand() % (hyp->size() - 1);
+    swap((*hyp)[i], (*hyp)[i + 1]);
+  }
+}
+
+int main(int argc, char** argv) {
+  po::variables_map conf;
+  InitCommandLine(argc, argv, &conf);
+  vector<string> ref_files;
+  if (conf.count("reference")) {
+    ref_files = conf["reference"].as<vector<string> >();
+  } else {
+    for (unsigned i = 0; i < 4; ++i)
+      ref_files.push_back(string(TEST_DATA) + "/re.txt." + static_cast<char>('0' + i));
+  }
+  const string metric_name = UppercaseString(conf["evaluation_metric"].as<string>());
+  EvaluationMetric* metric = EvaluationMetric::Instance(metric_name);
+  DocumentScorer ds(metric, ref_files);
+  const unsigned k = conf["k_best_size"].as<unsigned>();
+  const unsigned passes = conf["passes"].as<unsigned>();
+  srand(conf["random_seed"].as<unsigned>());
+
+  // the references themselves are reread to build the k-best lists
+  vector<vector<WordID> > first_refs;
+  vector<WordID> vocab;
+  {
+    ReadFile rf(ref_files[0]);
+    string line;
+    while (getline(*rf.stream(), line)) {
+      first_refs.push_back(vector<WordID>());
+      TD::ConvertSentence(line, &first_refs.back());
+      vocab.insert(vocab.end(), first_refs.back().begin(), first_refs.back().end());
+    }
+  }
+  assert(first_refs.size() == static_cast<size_t>(ds.size()));
+  vector<vector<vector<WordID> > > kbests(ds.size());
+  for (unsigned i = 0; i < ds.size(); ++i) {
+    kbests[i].resize(k);
+    for (unsigned j = 0; j < k; ++j)
+      Perturb(first_refs[i], vocab, &kbests[i][j]);
+  }
+
+  // each k-best list is scored with one batched call, as the tuners do
+  vector<SufficientStats> stats;
+  SufficientStats total;
+  const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (unsigned p = 0; p < passes; ++p) {
+    for (unsigned i = 0; i < ds.size(); ++i) {
+      ds[i]->EvaluateBatch(kbests[i], &stats);
+      if (p == 0)
+        for (unsigned j = 0; j < k; ++j) total += stats[j];
+    }
+  }
+  const double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  const double evals = static_cast<double>(passes) * ds.size() * k;
+  cerr << metric->DetailedScore(total) << endl;
+  cout << metric_name << ": " << evals << " evaluations in " << secs << " s ("
+       << (secs > 0 ? evals / secs : 0) << " evaluations/s)" << endl;
+  return 0;
+}
@@ -0,0 +1,125 @@
+#ifndef _NGRAM_TABLE_H_
+#define _NGRAM_TABLE_H_
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include "wordid.h"
+
+// NGramTable stores the (max over references) counts of all reference n-grams
+// up to some order in a flat open-addressing table. N-grams are identified by
+// a 64-bit hash that is extended one word at a time, so the n-grams starting
+// at a given position can be looked up in order of increasing length without
+// materializing them. Hash collisions are resolved by comparing the words
+// against the reference, which is stored once in a contiguous buffer.
+//
+// Every entry carries a second "current" count that is reset lazily by
+// bumping a generation counter; this is used both to compute per-reference
+// counts while building the table and to clip matches while evaluating a
+// hypothesis, so no per-hypothesis clearing or allocation is needed.
+class NGramTable {
+ public:
+  struct Entry {
+    Entry() : hash(), start(), len(), ref_count(), cur_count(), stamp() {}
+    uint64_t hash;
+    unsigned start;     // offset of the first occurrence in words_
+    unsigned len;       // 0 marks an empty slot
+    int ref_count;      // max count in any one reference
+    int cur_count;      // count in the current reference / hypothesis
+    unsigned stamp;     // generation cur_count belongs to
+  };
+
+  NGramTable() : order_(), mask_(), gen_() {}
+
+  static inline uint64_t Extend(uint64_t h, WordID w) {
+    h ^= static_cast<uint32_t>(w) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h * 0xff51afd7ed558ccdULL;
+  }
+
+  // builds the table from all n-grams of length <= order in refs
+  void Init(const std::vector<std::vector<WordID> >& refs, unsigned order) {
+    order_ = order;
+    words_.clear();
+    size_t max_entries = 0;
+    for (unsigned i = 0; i < refs.size(); ++i) {
+      words_.insert(words_.end(), refs[i].begin(), refs[i].end());
+      max_entries += refs[i].size() * order;
+    }
+    size_t size = 16;
+    while (size < 2 * max_entries) size <<= 1;
+    table_.clear();
+    table_.resize(size);
+    mask_ = size - 1;
+    gen_ = 0;
+    unsigned offset = 0;
+    for (unsigned r = 0; r < refs.size(); ++r) {
+      NextGeneration();
+      const int s = refs[r].size();
+      for (int j = 0; j < s; ++j) {
+        const int k = std::min<int>(order_, s - j);
+        uint64_t h = 0;
+        for (int i = 1; i <= k; ++i) {
+          h = Extend(h, words_[offset + j + i - 1]);
+          Entry& e = FindOrInsert(offset + j, i, h);
+          const int c = ++CurrentCount(e);
+          if (c > e.ref_count) e.ref_count = c;
+        }
+      }
+      offset += s;
+    }
+  }
+
+  // starts a new set of "current" counts (e.g., for the next hypothesis)
+  void NextGeneration() {
+    if (++gen_ == 0) {  // wrapped around, stale stamps could collide
+      for (unsigned i = 0; i < table_.size(); ++i) table_[i].stamp = 0;
+      gen_ = 1;
+    }
+  }
+
+  int& CurrentCount(Entry& e) {
+    if (e.stamp != gen_) { e.stamp = gen_; e.cur_count = 0; }
+    return e.cur_count;
+  }
+
+  // returns NULL if the n-gram w[0..len) with hash h is not in the table
+  const Entry* Find(const WordID* w, unsigned len, uint64_t h) const {
+    for (size_t i = Slot(h); ; i = (i + 1) & mask_) {
+      const Entry& e = table_[i];
+      if (!e.len) return NULL;
+      if (e.hash == h && e.len == len && std::equal(w, w + len, &words_[e.start]))
+        return &e;
+    }
+  }
+  Entry* Find(const WordID* w, unsigned len, uint64_t h) {
+    return const_cast<Entry*>(static_cast<const NGramTable*>(this)->Find(w, len, h));
+  }
+
+  unsigned Order() const { return order_; }
+
+ private:
+  size_t Slot(uint64_t h) const { return (h ^ (h >> 29)) & mask_; }
+
+  Entry& FindOrInsert(unsigned start, unsigned len, uint64_t h) {
+    const WordID* w = &words_[start];
+    for (size_t i = Slot(h); ; i = (i + 1) & mask_) {
+      Entry& e = table_[i];
+      if (!e.len) {
+        e.hash = h;
+        e.start = start;
+        e.len = len;
+        return e;
+      }
+      if (e.hash == h && e.len == len && std::equal(w, w + len, &words_[e.start]))
+        return e;
+    }
+  }
+
+  unsigned order_;
+  size_t mask_;
+  unsigned gen_;
+  std::vector<WordID> words_;
+  std::vector<Entry> table_;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#define BOOST_TEST_MODULE NGramTableTest
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "ngram_table.h"
+#include "ns.h"
+#include "tdict.h"
+
+using namespace std;
+
+typedef map<vector<WordID>, int> NGramCounts;
+
+// counts of all the n-grams of sent of length <= order
+static NGramCounts Count(const vector<WordID>& sent, unsigned order) {
+  NGramCounts counts;
+  for (unsigned j = 0; j < sent.size(); ++j)
+    for (unsigned i = 1; i <= order && j + i <= sent.size(); ++i)
+      ++counts[vector<WordID>(sent.begin() + j, sent.begin() + j + i)];
+  return counts;
+}
+
+// the max count of each n-gram in any one reference
+static NGramCounts MaxRefCounts(const vector<vector<WordID> >& refs, unsigned order) {
+  NGramCounts max_counts;
+  for (unsigned r = 0; r < refs.size(); ++r) {
+    const NGramCounts counts = Count(refs[r], order);
+    for (NGramCounts::const_iterator it = counts.begin(); it != counts.end(); ++it)
+      max_counts[it->first] = max(max_counts[it->first], it->second);
+  }
+  return max_counts;
+}
+
+// the BLEU sufficient statistics as computed before the n-gram table, with
+// the hypothesis counts clipped by the max counts in the references
+static vector<float> MapStats(const vector<WordID>& hyp, const vector<vector<WordID> >& refs) {
+  const unsigned N = 4;
+  const NGramCounts ref_counts = MaxRefCounts(refs, N);
+  const NGramCounts hyp_counts = Count(hyp, N);
+  vector<float> stats(2 * N);
+  for (NGramCounts::const_iterator it = hyp_counts.begin(); it != hyp_counts.end(); ++it) {
+    const unsigned n = it->first.size();
+    NGramCounts::const_iterator r = ref_counts.find(it->first);
+    if (r != ref_counts.end()) stats[n - 1] += min(it->second, r->second);
+    stats[N + n - 1] += it->second;
+  }
+  return stats;
+}
+
+static void CheckStats(const vector<WordID>& hyp, const vector<vector<WordID> >& refs) {
+  boost::shared_ptr<SegmentEvaluator> eval = EvaluationMetric::Instance("IBM_BLEU")->CreateSegmentEvaluator(refs);
+  SufficientStats stats;
+  eval->Evaluate(hyp, &stats);
+  const vector<float> expected = MapStats(hyp, refs);
+  for (unsigned i = 0; i < expected.size(); ++i)
+    BOOST_CHECK_EQUAL(stats.fields[i], expected[i]);
+  // the clipping counts of the previous hypothesis must not leak
+  eval->Evaluate(hyp, &stats);
+  for (unsigned i = 0; i < expected.size(); ++i)
+    BOOST_CHECK_EQUAL(stats.fields[i], expected[i]);
+}
+
+static vector<WordID> Sentence(const string& s) {
+  vector<WordID> sent;
+  TD::ConvertSentence(s, &sent);
+  return sent;
+}
+
+BOOST_AUTO_TEST_CASE(TestClippingAgainstReferences) {
+  vector<vector<WordID> > refs;
+  refs.push_back(Sentence("the cat sat on the mat"));
+  refs.push_back(Sentence("the the cat is on a mat mat"));
+  refs.push_back(Sentence("on the mat the cat the cat sat"));
+  // "the" is clipped to 3 (the third reference), "the cat" to 2, "mat" to 2
+  CheckStats(Sentence("the the the the cat cat sat on the mat mat mat"), refs);
+  CheckStats(Sentence("the cat the cat the cat"), refs);
+  CheckStats(Sentence("on the mat the cat the cat sat"), refs);
+  CheckStats(Sentence("a dog"), refs);
+  CheckStats(Sentence("mat"), refs);
+  CheckStats(vector<WordID>(), refs);
+}
+
+BOOST_AUTO_TEST_CASE(TestRandomSentences) {
+  // a small vocabulary, so that the n-grams repeat within and across the
+  // sentences and the probe sequences of the table are long
+  const char* vocab[] = { "a", "b", "c", "d", "e" };
+  srand(17);
+  for (int t = 0; t < 200; ++t) {
+    vector<vector<WordID> > refs(1 + rand() % 4);
+    for (unsigned r = 0; r < refs.size(); ++r)
+      for (int i = rand() % 30; i > 0; --i)
+        refs[r].push_back(TD::Convert(vocab[rand() % 5]));
+    vector<WordID> hyp;
+    for (int i = rand() % 30; i > 0; --i)
+      hyp.push_back(TD::Convert(vocab[rand() % 5]));
+    CheckStats(hyp, refs);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestTableCounts) {
+  vector<vector<WordID> > refs;
+  refs.push_back(Sentence("a b a b a b c"));
+  refs.push_back(Sentence("b a b a c c c c"));
+  NGramTable table;
+  table.Init(refs, 4);
+  const NGramCounts expected = MaxRefCounts(refs, 4);
+  for (NGramCounts::const_iterator it = expected.begin(); it != expected.end(); ++it) {
+    const vector<WordID>& w = it->first;
+    uint64_t h = 0;
+    for (unsigned i = 0; i < w.size(); ++i) h = NGramTable::Extend(h, w[i]);
+    const NGramTable::Entry* e = table.Find(&w[0], w.size(), h);
+    BOOST_REQUIRE(e);
+    BOOST_CHECK_EQUAL(e->ref_count, it->second);
+  }
+  const vector<WordID> missing = Sentence("c a b");
+  uint64_t h = 0;
+  for (unsigned i = 0; i < missing.size(); ++i) h = NGramTable::Extend(h, missing[i]);
+  BOOST_CHECK(!table.Find(&missing[0], missing.size(), h));
+}
+
+BOOST_AUTO_TEST_CASE(TestHashCollisions) {
+  // an n-gram whose hash collides with that of a reference n-gram (or that
+  // is a prefix of it) must not be taken for it
+  vector<vector<WordID> > refs(1, Sentence("a b c d"));
+  NGramTable table;
+  table.Init(refs, 4);
+  const vector<WordID>& ref = refs[0];
+  uint64_t h = 0;
+  for (unsigned i = 0; i < ref.size(); ++i) h = NGramTable::Extend(h, ref[i]);
+  BOOST_REQUIRE(table.Find(&ref[0], 4, h));
+  const vector<WordID> other = Sentence("d c b a");
+  BOOST_CHECK(!table.Find(&other[0], 4, h));
+  BOOST_CHECK(!table.Find(&ref[0], 3, h));
+}
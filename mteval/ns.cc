@@ -5,6 +5,7 @@
 #include "ns_cer.h"
 #include "ns_wer.h"
 #include "ns_ssk.h"
+#include "ngram_table.h"
 
 #include <cstdio>
 #include <cassert>
@@ -26,6 +27,12 @@ extern const char* meteor_jar_path;
 SegmentEvaluator::~SegmentEvaluator() {}
 EvaluationMetric::~EvaluationMetric() {}
 
+void SegmentEvaluator::EvaluateBatch(const vector<vector<WordID> >& hyps, vector<SufficientStats>* out) const {
+  out->resize(hyps.size());
+  for (unsigned i = 0; i < hyps.size(); ++i)
+    Evaluate(hyps[i], &(*out)[i]);
+}
+
 bool EvaluationMetric::IsErrorMetric() const {
   return false;
 }
@@ -36,6 +43,11 @@ struct DefaultSegmentEvaluator : public SegmentEvaluator {
     em_->ComputeSufficientStatistics(hyp, refs_, out);
     out->id_ = em_->MetricId();
   }
+  void EvaluateBatch(const vector<vector<WordID> >& hyps, vector<SufficientStats>* out) const {
+    em_->ComputeSufficientStatisticsBatch(hyps, refs_, out);
+    for (unsigned i = 0; i < out->size(); ++i)
+      (*out)[i].id_ = em_->MetricId();
+  }
   const vector<vector<WordID> > refs_;
   const EvaluationMetric* em_;
 };
@@ -56,6 +68,14 @@ void EvaluationMetric::ComputeSufficientStatistics(const vector<WordID>&,
   abort();
 }
 
+void EvaluationMetric::ComputeSufficientStatisticsBatch(const vector<vector<WordID> >& hyps,
+                                                        const vector<vector<WordID> >& refs,
+                                                        vector<SufficientStats>* out) const {
+  out->resize(hyps.size());
+  for (unsigned i = 0; i < hyps.size(); ++i)
+    ComputeSufficientStatistics(hyps[i], refs, &(*out)[i]);
+}
+
 string EvaluationMetric::DetailedScore(const SufficientStats& stats) const {
   ostringstream os;
   os << MetricId() << "=" << ComputeScore(stats);
@@ -74,8 +94,8 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
       lengths_.push_back(ci->size());
       tot += lengths_.back();
       if (lengths_.back() < smallest) smallest = lengths_.back();
-      CountRef(*ci);
     }
+    ngrams_.Init(refs, N);
     if (BrevityType == Koehn)
       lengths_[0] = tot / refs.size();
     if (BrevityType == NIST)
@@ -106,71 +126,36 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
     }
   }
 
-  struct NGramCompare {
-    int operator() (const vector<WordID>& a, const vector<WordID>& b) const {
-      const size_t as = a.size();
-      const size_t bs = b.size();
-      const size_t s = (as < bs ? as : bs);
-      for (size_t i = 0; i < s; ++i) {
-         int d = a[i] - b[i];
-         if (d < 0) return true;
-         if (d > 0) return false;
-      }
-      return as < bs;
-    }
-  };
-  typedef map<vector<WordID>, pair<int,int>, NGramCompare> NGramCountMap;
-
-  void CountRef(const vector<WordID>& ref) {
-    NGramCountMap tc;
-    vector<WordID> ngram(N);
-    int s = ref.size();
-    for (int j=0; j<s; ++j) {
-      int remaining = s-j;
-      int k = (N < remaining ? N : remaining);
-      ngram.clear();
-      for (int i=1; i<=k; ++i) {
-        ngram.push_back(ref[j + i - 1]);
-        tc[ngram].first++;
-      }
-    }
-    for (typename NGramCountMap::iterator i = tc.begin(); i != tc.end(); ++i) {
-      pair<int,int>& p = ngrams_[i->first];
-      if (p.first < i->second.first)
-        p = i->second;
-    }
-  }
-
   void ComputeNgramStats(const vector<WordID>& sent,
                          float* correct,  // N elements reserved
                          float* hyp,      // N elements reserved
                          bool clip_counts = true) const {
-    // clear clipping stats
-    for (typename NGramCountMap::iterator it = ngrams_.begin(); it != ngrams_.end(); ++it)
-      it->second.second = 0;
+    // clipping counts are reset by starting a new generation
+    ngrams_.NextGeneration();
 
-    vector<WordID> ngram(N);
     *correct *= 0;
     *hyp *= 0;
     int s = sent.size();
     for (int j=0; j<s; ++j) {
       int remaining = s-j;
       int k = (N < remaining ? N : remaining);
-      ngram.clear();
+      uint64_t h = 0;
       for (int i=1; i<=k; ++i) {
-        ngram.push_back(sent[j + i - 1]);
-        pair<int,int>& p = ngrams_[ngram];
+        h = NGramTable::Extend(h, sent[j + i - 1]);
+        NGramTable::Entry* p = ngrams_.Find(&sent[j], i, h);
         if(clip_counts){
-          if (p.second < p.first) {
-            ++p.second;
-            correct[i-1]++;
+          if (p) {
+            int& matched = ngrams_.CurrentCount(*p);
+            if (matched < p->ref_count) {
+              ++matched;
+              correct[i-1]++;
+            }
           }
         } else {
-          ++p.second;
           correct[i-1]++;
         }
         // if the 1 gram isn't found, don't try to match don't need to match any 2- 3- .. grams:
-        if (!p.first) {
+        if (!p) {
           for (; i<=k; ++i)
             hyp[i-1]++;
         } else {
@@ -182,7 +167,7 @@ struct BleuSegmentEvaluator : public SegmentEvaluator {
 
   const EvaluationMetric* evaluation_metric;
   vector<float> lengths_;
-  mutable NGramCountMap ngrams_;
+  mutable NGramTable ngrams_;
 };
 
 template <unsigned int N = 4u, BleuType BrevityType = IBM>
@@ -271,13 +256,19 @@ EvaluationMetric* EvaluationMetric::Instance(const string& imetric_id) {
       m = new SSKMetric;
     } else if (metric_id == "TER") {
       m = new TERMetric;
-    } else if (metric_id == "METEOR") {
+    } else if (metric_id == "METEOR" || metric_id.find("METEOR:") == 0) {
+      // METEOR:<n> runs a pool of n METEOR processes
 #if HAVE_METEOR
       if (!FileExists(meteor_jar_path)) {
         cerr << meteor_jar_path << " not found!\n";
         abort();
       }
-      m = new ExternalMetric("METEOR", string("java -Xmx1536m -jar ") + meteor_jar_path + " - - -mira -lower -t tune -l en");
+      const int workers = metric_id.size() > 7 ? atoi(metric_id.c_str() + 7) : 1;
+      if (workers < 1) {
+        cerr << "Bad number of METEOR workers in " << metric_id << endl;
+        abort();
+      }
+      m = new ExternalMetric(metric_id, string("java -Xmx1536m -jar ") + meteor_jar_path + " - - -mira -lower -t tune -l en", workers);
 #else
       cerr << "cdec was not built with the --with-meteor option." << endl;
       abort();
@@ -78,6 +78,11 @@ inline const SufficientStats operator-(const SufficientStats& a, const Sufficien
 struct SegmentEvaluator {
   virtual ~SegmentEvaluator();
   virtual void Evaluate(const std::vector<WordID>& hyp, SufficientStats* out) const = 0;
+  // evaluates many hypotheses (e.g., a k-best list) against the same
+  // references. The default calls Evaluate for each one, but evaluators
+  // backed by external processes override this to keep many requests in flight
+  virtual void EvaluateBatch(const std::vector<std::vector<WordID> >& hyps,
+                             std::vector<SufficientStats>* out) const;
   std::string src; // this may not always be available
 };
 
@@ -111,6 +116,11 @@ class EvaluationMetric {
   virtual void ComputeSufficientStatistics(const std::vector<WordID>& hyp,
                                            const std::vector<std::vector<WordID> >& refs,
                                            SufficientStats* out) const;
+  // batch version of the above, used by the default SegmentEvaluator's
+  // EvaluateBatch. The default calls the single-hypothesis version for each
+  virtual void ComputeSufficientStatisticsBatch(const std::vector<std::vector<WordID> >& hyps,
+                                                const std::vector<std::vector<WordID> >& refs,
+                                                std::vector<SufficientStats>* out) const;
 
  private:
   static std::map<std::string, EvaluationMetric*> instances_;
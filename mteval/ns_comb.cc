@@ -56,6 +56,26 @@ struct CombinationSegmentEvaluator : public SegmentEvaluator {
       }
     }
   }
+  // scores the whole batch with each component, so components that are
+  // backed by external processes see the entire batch at once
+  virtual void EvaluateBatch(const vector<vector<WordID> >& hyps, vector<SufficientStats>* out) const {
+    out->resize(hyps.size());
+    for (unsigned h = 0; h < hyps.size(); ++h) {
+      (*out)[h].id_ = id_;
+      (*out)[h].fields.resize(total_size_);
+    }
+    vector<SufficientStats> t;
+    for (unsigned i = 0; i < component_evaluators_.size(); ++i) {
+      component_evaluators_[i]->EvaluateBatch(hyps, &t);
+      for (unsigned h = 0; h < hyps.size(); ++h) {
+        for (unsigned j = 0; j < t[h].fields.size(); ++j) {
+          unsigned op = j + offsets_[i];
+          assert(op < (*out)[h].fields.size());
+          (*out)[h].fields[op] = t[h][j];
+        }
+      }
+    }
+  }
   const string& id_;
   const vector<unsigned>& offsets_;
   const unsigned total_size_;
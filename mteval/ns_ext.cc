@@ -4,6 +4,9 @@
 #include <cstdlib>
 #include <cstring>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
 #include <signal.h>
 #include <sys/wait.h>
 #include <sstream>
@@ -55,52 +58,67 @@ void setup_child_process_handler() {
   }
 }
 
-struct NScoreServer {
-  NScoreServer(const std::string& cmd);
-  ~NScoreServer();
-
-  float ComputeScore(const std::vector<float>& fields);
-  void Evaluate(const std::vector<std::vector<WordID> >& refs, const std::vector<WordID>& hyp, std::vector<float>* fields);
-
- private:
-  void RequestResponse(const std::string& request, std::string* response);
-  int p2c[2];
-  int c2p[2];
-};
-
-NScoreServer::NScoreServer(const string& cmd) {
+NScoreServer::NScoreServer(const string& cmd, unsigned num_workers) : workers_(num_workers) {
+  assert(num_workers > 0);
+  pthread_mutex_init(&mutex_, NULL);
   setup_child_process_handler();
-  cerr << "Invoking " << cmd << " ..." << endl;
-  if (pipe(p2c) < 0) { perror("pipe"); exit(1); }
-  if (pipe(c2p) < 0) { perror("pipe"); exit(1); }
-  pid_t cpid = fork();
-  if (cpid < 0) { perror("fork"); exit(1); }
-  if (cpid == 0) {  // child
-    close(p2c[1]);
-    close(c2p[0]);
-    dup2(p2c[0], 0);
-    close(p2c[0]);
-    dup2(c2p[1], 1);
-    close(c2p[1]);
-    cerr << "Exec'ing from child " << cmd << endl;
-    vector<string> vargs;
-    SplitOnWhitespace(cmd, &vargs);
-    const char** cargv = static_cast<const char**>(malloc(sizeof(const char*) * vargs.size()));
-    for (unsigned i = 1; i < vargs.size(); ++i) cargv[i-1] = vargs[i].c_str();
-    cargv[vargs.size() - 1] = NULL;
-    execvp(vargs[0].c_str(), (char* const*)cargv);
-  } else { // parent
+  vector<string> vargs;
+  SplitOnWhitespace(cmd, &vargs);
+  assert(vargs.size() > 0);
+  for (unsigned w = 0; w < num_workers; ++w) {
+    cerr << "Invoking " << cmd << " (worker " << (w + 1) << " of " << num_workers << ") ..." << endl;
+    int p2c[2];
+    int c2p[2];
+    if (pipe(p2c) < 0) { perror("pipe"); exit(1); }
+    if (pipe(c2p) < 0) { perror("pipe"); exit(1); }
+    pid_t cpid = fork();
+    if (cpid < 0) { perror("fork"); exit(1); }
+    if (cpid == 0) {  // child
+      close(p2c[1]);
+      close(c2p[0]);
+      dup2(p2c[0], 0);
+      close(p2c[0]);
+      dup2(c2p[1], 1);
+      close(c2p[1]);
+      // don't inherit the pipes of the workers started before this one
+      for (unsigned i = 0; i < w; ++i) {
+        close(workers_[i].to_child);
+        close(workers_[i].from_child);
+      }
+      cerr << "Exec'ing from child " << cmd << endl;
+      const char** cargv = static_cast<const char**>(malloc(sizeof(const char*) * (vargs.size() + 1)));
+      for (unsigned i = 0; i < vargs.size(); ++i) cargv[i] = vargs[i].c_str();
+      cargv[vargs.size()] = NULL;
+      execvp(cargv[0], (char* const*)cargv);
+      perror("execvp");
+      _exit(1);
+    }
+    // parent
     close(c2p[1]);
     close(p2c[0]);
+    // writes must not block, since a worker may be waiting for us to read
+    // its responses while we are still sending it requests
+    fcntl(p2c[1], F_SETFL, fcntl(p2c[1], F_GETFL) | O_NONBLOCK);
+    workers_[w].pid = cpid;
+    workers_[w].to_child = p2c[1];
+    workers_[w].from_child = c2p[0];
   }
-  string dummy;
-  RequestResponse("SCORE ||| Reference initialization string . ||| Testing initialization string .", &dummy);
-  assert(dummy.size() > 0);
+  // one initialization request per worker, so they all start up in parallel
+  vector<string> init(num_workers, "SCORE ||| Reference initialization string . ||| Testing initialization string .");
+  vector<string> dummy;
+  RequestResponses(init, &dummy);
+  for (unsigned w = 0; w < num_workers; ++w)
+    assert(dummy[w].size() > 0);
   cerr << "Connection established.\n";
 }
 
 NScoreServer::~NScoreServer() {
-  // TODO close stuff, join stuff
+  // closing stdin tells the workers to exit, the SIGCHLD handler reaps them
+  for (unsigned w = 0; w < workers_.size(); ++w) {
+    close(workers_[w].to_child);
+    close(workers_[w].from_child);
+  }
+  pthread_mutex_destroy(&mutex_);
 }
 
 float NScoreServer::ComputeScore(const vector<float>& fields) {
@@ -113,7 +131,7 @@ float NScoreServer::ComputeScore(const vector<float>& fields) {
   return strtod(sres.c_str(), NULL);
 }
 
-void NScoreServer::Evaluate(const vector<vector<WordID> >& refs, const vector<WordID>& hyp, vector<float>* fields) {
+static void WriteScoreRequest(const vector<vector<WordID> >& refs, const vector<WordID>& hyp, string* request) {
   ostringstream os;
   os << "SCORE";
   for (unsigned i = 0; i < refs.size(); ++i) {
@@ -126,32 +144,135 @@ void NScoreServer::Evaluate(const vector<vector<WordID> >& refs, const vector<Wo
   for (unsigned i = 0; i < hyp.size(); ++i) {
     os << ' ' << TD::Convert(hyp[i]);
   }
-  string sres;
-  RequestResponse(os.str(), &sres);
-  istringstream is(sres);
+  *request = os.str();
+}
+
+static void ReadFields(const string& response, vector<float>* fields) {
+  istringstream is(response);
   float val;
   fields->clear();
   while(is >> val)
     fields->push_back(val);
 }
 
-#define MAX_BUF 16000
+void NScoreServer::Evaluate(const vector<vector<WordID> >& refs, const vector<WordID>& hyp, vector<float>* fields) {
+  string request;
+  WriteScoreRequest(refs, hyp, &request);
+  string sres;
+  RequestResponse(request, &sres);
+  ReadFields(sres, fields);
+}
+
+void NScoreServer::EvaluateBatch(const vector<vector<WordID> >& refs,
+                                 const vector<vector<WordID> >& hyps,
+                                 vector<vector<float> >* fields) {
+  vector<string> requests(hyps.size());
+  for (unsigned i = 0; i < hyps.size(); ++i)
+    WriteScoreRequest(refs, hyps[i], &requests[i]);
+  vector<string> responses;
+  RequestResponses(requests, &responses);
+  fields->resize(hyps.size());
+  for (unsigned i = 0; i < hyps.size(); ++i)
+    ReadFields(responses[i], &(*fields)[i]);
+}
 
 void NScoreServer::RequestResponse(const string& request, string* response) {
-//  cerr << "@SERVER: " << request << endl;
-  string x = request + "\n";
-  write(p2c[1], x.c_str(), x.size());
-  char buf[MAX_BUF];
-  size_t n = read(c2p[0], buf, MAX_BUF);
-  while (n < MAX_BUF && buf[n-1] != '\n')
-    n += read(c2p[0], &buf[n], MAX_BUF - n);
-
-  buf[n-1] = 0;
-  if (n < 2) {
-    cerr << "Malformed response: " << buf << endl;
+  vector<string> responses;
+  RequestResponses(vector<string>(1, request), &responses);
+  response->swap(responses[0]);
+}
+
+namespace {
+  struct ServerLock {
+    explicit ServerLock(pthread_mutex_t* m) : mutex(m) { pthread_mutex_lock(mutex); }
+    ~ServerLock() { pthread_mutex_unlock(mutex); }
+    pthread_mutex_t* mutex;
+  };
+}
+
+void NScoreServer::RequestResponses(const vector<string>& requests, vector<string>* responses) {
+  ServerLock lock(&mutex_);
+  const unsigned nw = workers_.size();
+  responses->clear();
+  responses->resize(requests.size());
+  // per worker: bytes still to be written, partial response line read so
+  // far, and the requests it still owes a response for (in order)
+  vector<string> out(nw);
+  vector<size_t> out_pos(nw, 0);
+  vector<string> in(nw);
+  vector<vector<unsigned> > pending(nw);
+  vector<unsigned> next(nw, 0);
+  for (unsigned i = 0; i < requests.size(); ++i) {
+    const unsigned w = i % nw;
+    out[w] += requests[i];
+    out[w] += '\n';
+    pending[w].push_back(i);
+  }
+  unsigned outstanding = requests.size();
+  vector<struct pollfd> fds;
+  vector<unsigned> fd2worker;
+  char buf[65536];
+  while (outstanding > 0) {
+    fds.clear();
+    fd2worker.clear();
+    for (unsigned w = 0; w < nw; ++w) {
+      if (out_pos[w] < out[w].size()) {
+        struct pollfd p = { workers_[w].to_child, POLLOUT, 0 };
+        fds.push_back(p);
+        fd2worker.push_back(w);
+      }
+      if (next[w] < pending[w].size()) {
+        struct pollfd p = { workers_[w].from_child, POLLIN, 0 };
+        fds.push_back(p);
+        fd2worker.push_back(w);
+      }
+    }
+    if (poll(&fds[0], fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;  // e.g., SIGCHLD
+      perror("poll");
+      exit(1);
+    }
+    for (unsigned i = 0; i < fds.size(); ++i) {
+      const unsigned w = fd2worker[i];
+      if (fds[i].events == POLLOUT && fds[i].revents) {
+        const ssize_t n = write(fds[i].fd, out[w].data() + out_pos[w], out[w].size() - out_pos[w]);
+        if (n < 0) {
+          if (errno == EAGAIN || errno == EINTR) continue;
+          perror("write to external scorer");
+          exit(1);
+        }
+        out_pos[w] += n;
+      } else if (fds[i].events == POLLIN && fds[i].revents) {
+        const ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+        if (n < 0) {
+          if (errno == EINTR) continue;
+          perror("read from external scorer");
+          exit(1);
+        }
+        if (n == 0) {
+          cerr << "External scorer (worker " << (w + 1) << ") closed its output with "
+               << (pending[w].size() - next[w]) << " requests outstanding\n";
+          exit(1);
+        }
+        in[w].append(buf, n);
+        size_t start = 0;
+        size_t nl;
+        while ((nl = in[w].find('\n', start)) != string::npos) {
+          if (next[w] == pending[w].size()) {
+            cerr << "Unexpected response from external scorer: " << in[w].substr(start, nl - start) << endl;
+            break;
+          }
+          const string line = in[w].substr(start, nl - start);
+          if (line.empty())
+            cerr << "Malformed (empty) response from external scorer\n";
+          (*responses)[pending[w][next[w]++]] = Trim(line, " \t\n");
+          --outstanding;
+          start = nl + 1;
+        }
+        in[w].erase(0, start);
+      }
+    }
   }
-  *response = Trim(buf, " \t\n");
-//  cerr << "@RESPONSE: '" << *response << "'\n";
 }
 
 void ExternalMetric::ComputeSufficientStatistics(const std::vector<WordID>& hyp,
@@ -160,13 +281,23 @@ void ExternalMetric::ComputeSufficientStatistics(const std::vector<WordID>& hyp,
   eval_server->Evaluate(refs, hyp, &out->fields);
 }
 
+void ExternalMetric::ComputeSufficientStatisticsBatch(const std::vector<std::vector<WordID> >& hyps,
+                                                      const std::vector<std::vector<WordID> >& refs,
+                                                      std::vector<SufficientStats>* out) const {
+  vector<vector<float> > fields;
+  eval_server->EvaluateBatch(refs, hyps, &fields);
+  out->resize(hyps.size());
+  for (unsigned i = 0; i < hyps.size(); ++i)
+    (*out)[i].fields.swap(fields[i]);
+}
+
 float ExternalMetric::ComputeScore(const SufficientStats& stats) const {
   return eval_server->ComputeScore(stats.fields);
 }
 
-ExternalMetric::ExternalMetric(const string& metric_name, const std::string& command) :
+ExternalMetric::ExternalMetric(const string& metric_name, const std::string& command, unsigned num_workers) :
     EvaluationMetric(metric_name),
-    eval_server(new NScoreServer(command)) {}
+    eval_server(new NScoreServer(command, num_workers)) {}
 
 ExternalMetric::~ExternalMetric() {
   delete eval_server;
@@ -1,17 +1,57 @@
 #ifndef _NS_EXTERNAL_SCORER_H_
 #define _NS_EXTERNAL_SCORER_H_
 
+#include <string>
+#include <vector>
+#include <pthread.h>
 #include "ns.h"
 
-struct NScoreServer;
+// NScoreServer manages a pool of persistent external scorer processes that
+// speak the line protocol described in README.protocol:
+//   SCORE ||| ref1 ||| ref2 ... ||| hyp  -->  sufficient statistics
+//   EVAL ||| stat1 stat2 ...             -->  score
+// Batched requests are distributed round-robin over the workers and written
+// without waiting for the responses, so many segments are in flight at once
+// and throughput approaches that of the external tool rather than being
+// bound by round-trip latency. Calls from several threads are serialized,
+// i.e. the workers are shared but each call waits for its own responses.
+class NScoreServer {
+ public:
+  NScoreServer(const std::string& cmd, unsigned num_workers = 1);
+  ~NScoreServer();
+
+  float ComputeScore(const std::vector<float>& fields);
+  void Evaluate(const std::vector<std::vector<WordID> >& refs, const std::vector<WordID>& hyp, std::vector<float>* fields);
+  void EvaluateBatch(const std::vector<std::vector<WordID> >& refs,
+                     const std::vector<std::vector<WordID> >& hyps,
+                     std::vector<std::vector<float> >* fields);
+  unsigned NumWorkers() const { return workers_.size(); }
+
+ private:
+  struct Worker {
+    int pid;
+    int to_child;
+    int from_child;
+  };
+  void RequestResponse(const std::string& request, std::string* response);
+  // request i is sent to worker (i % NumWorkers()); responses are returned in
+  // the order of the requests
+  void RequestResponses(const std::vector<std::string>& requests, std::vector<std::string>* responses);
+  std::vector<Worker> workers_;
+  pthread_mutex_t mutex_;
+};
+
 class ExternalMetric : public EvaluationMetric {
  public:
-  ExternalMetric(const std::string& metricid, const std::string& command);
+  ExternalMetric(const std::string& metricid, const std::string& command, unsigned num_workers = 1);
   ~ExternalMetric();
 
   virtual void ComputeSufficientStatistics(const std::vector<WordID>& hyp,
                                            const std::vector<std::vector<WordID> >& refs,
                                            SufficientStats* out) const;
+  virtual void ComputeSufficientStatisticsBatch(const std::vector<std::vector<WordID> >& hyps,
+                                                const std::vector<std::vector<WordID> >& refs,
+                                                std::vector<SufficientStats>* out) const;
   virtual float ComputeScore(const SufficientStats& stats) const;
 
  protected:
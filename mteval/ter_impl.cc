@@ -0,0 +1,386 @@
+#include "ter_impl.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+#include "tdict.h"
+
+using namespace std;
+
+static const int ter_short_circuit_long_sentences = -1;
+
+struct COSTS {
+  static const float substitution;
+  static const float deletion;
+  static const float insertion;
+  static const float shift;
+};
+const float COSTS::substitution = 1.0f;
+const float COSTS::deletion = 1.0f;
+const float COSTS::insertion = 1.0f;
+const float COSTS::shift = 1.0f;
+
+static const int MAX_SHIFT_SIZE = 10;
+static const int MAX_SHIFT_DIST = 50;
+
+TERScorerImpl::TERScorerImpl(const vector<WordID>& ref) :
+    ref_(ref),
+    code2word_(ref),
+    blocks_((ref.size() + 63) / 64) {
+  sort(code2word_.begin(), code2word_.end());
+  code2word_.erase(unique(code2word_.begin(), code2word_.end()), code2word_.end());
+  // code 0 is reserved for words that are not in the reference
+  code2word_.insert(code2word_.begin(), 0);
+  code2pos_.resize(code2word_.size());
+  peq_.resize(code2word_.size() * blocks_);
+  ref_codes_.resize(ref.size());
+  for (unsigned i = 0; i < ref.size(); ++i) {
+    const int c = lower_bound(code2word_.begin() + 1, code2word_.end(), ref[i]) - code2word_.begin();
+    ref_codes_[i] = c;
+    code2pos_[c].push_back(i);
+    peq_[c * blocks_ + i / 64] |= 1ULL << (i % 64);
+  }
+}
+
+float TERScorerImpl::MinimumEditDistance(const vector<int>& hyp, vector<TransType>* path) const {
+  const int n = hyp.size();
+  const int m = ref_codes_.size();
+  const int w = m + 1;
+  bmat_.resize((n + 1) * w);
+  dp_.resize(2 * w);
+  int* prev = &dp_[0];
+  int* cur = &dp_[w];
+  for (int j = 0; j <= m; ++j)
+    prev[j] = j;
+  for (int i = 1; i <= n; ++i) {
+    const int hw = hyp[i-1];
+    char* b = &bmat_[i * w];
+    cur[0] = i;
+    for (int j = 1; j <= m; ++j) {
+      int c;
+      if (ref_codes_[j-1] == hw) {
+        c = prev[j-1];
+        b[j] = MATCH;
+      } else {
+        c = prev[j-1] + 1;
+        b[j] = SUBSTITUTION;
+      }
+      if (c > prev[j] + 1) {
+        c = prev[j] + 1;
+        b[j] = INSERTION;
+      }
+      if (c > cur[j-1] + 1) {
+        c = cur[j-1] + 1;
+        b[j] = DELETION;
+      }
+      cur[j] = c;
+    }
+    swap(prev, cur);
+  }
+
+  // trace back along the best path and record the transition types
+  path->clear();
+  int i = n;
+  int j = m;
+  while (i > 0 || j > 0) {
+    if (j == 0) {
+      --i;
+      path->push_back(INSERTION);
+    } else if (i == 0) {
+      --j;
+      path->push_back(DELETION);
+    } else {
+      TransType t = static_cast<TransType>(bmat_[i * w + j]);
+      path->push_back(t);
+      switch (t) {
+        case SUBSTITUTION:
+        case MATCH:
+          --i; --j; break;
+        case INSERTION:
+          --i; break;
+        case DELETION:
+          --j; break;
+      }
+    }
+  }
+  reverse(path->begin(), path->end());
+  return prev[m];
+}
+
+// one 64-row block of one column of the bit-parallel edit distance; hin and
+// the return value are the horizontal deltas entering the top of the block
+// and leaving its row top_bit
+static inline int AdvanceBlock(uint64_t* pv, uint64_t* mv, uint64_t eq, int hin, int top_bit) {
+  const uint64_t Pv = *pv, Mv = *mv;
+  const uint64_t hin_neg = hin < 0 ? 1 : 0;
+  const uint64_t Xv = eq | Mv;
+  eq |= hin_neg;
+  const uint64_t Xh = (((eq & Pv) + Pv) ^ Pv) | eq;
+  uint64_t Ph = Mv | ~(Xh | Pv);
+  uint64_t Mh = Pv & Xh;
+  const int hout = static_cast<int>((Ph >> top_bit) & 1) - static_cast<int>((Mh >> top_bit) & 1);
+  Ph <<= 1;
+  Mh <<= 1;
+  Mh |= hin_neg;
+  Ph |= hin > 0 ? 1 : 0;
+  *pv = Mh | ~(Xv | Ph);
+  *mv = Ph & Xv;
+  return hout;
+}
+
+void TERScorerImpl::ComputeColumns(const vector<int>& hyp) const {
+  const int n = hyp.size();
+  const unsigned stride = 2 * blocks_;
+  col_scores_.resize(n + 1);
+  if (!blocks_) {  // empty reference
+    for (int i = 0; i <= n; ++i) col_scores_[i] = i;
+    return;
+  }
+  cols_.resize((n + 1) * stride);
+  for (unsigned b = 0; b < blocks_; ++b) {
+    cols_[2 * b] = ~0ULL;
+    cols_[2 * b + 1] = 0;
+  }
+  col_scores_[0] = ref_codes_.size();
+  const int last_bit = (ref_codes_.size() + 63) % 64;
+  for (int i = 0; i < n; ++i) {
+    uint64_t* col = &cols_[(i + 1) * stride];
+    copy(&cols_[i * stride], &cols_[i * stride] + stride, col);
+    const uint64_t* eq = &peq_[hyp[i] * blocks_];
+    int h = 1;
+    for (unsigned b = 0; b < blocks_; ++b)
+      h = AdvanceBlock(&col[2 * b], &col[2 * b + 1], eq[b], h, b + 1 == blocks_ ? last_bit : 63);
+    col_scores_[i + 1] = col_scores_[i] + h;
+  }
+}
+
+int TERScorerImpl::EditDistanceFrom(const vector<int>& hyp, int from) const {
+  const int n = hyp.size();
+  if (!blocks_) return n;
+  const unsigned stride = 2 * blocks_;
+  col_.assign(&cols_[from * stride], &cols_[from * stride] + stride);
+  uint64_t* col = &col_[0];
+  int score = col_scores_[from];
+  const int last_bit = (ref_codes_.size() + 63) % 64;
+  for (int i = from; i < n; ++i) {
+    const uint64_t* eq = &peq_[hyp[i] * blocks_];
+    int h = 1;
+    for (unsigned b = 0; b < blocks_; ++b)
+      h = AdvanceBlock(&col[2 * b], &col[2 * b + 1], eq[b], h, b + 1 == blocks_ ? last_bit : 63);
+    score += h;
+  }
+  return score;
+}
+
+void TERScorerImpl::PerformShift(const vector<int>& in,
+  int start, int end, int moveto, vector<int>* out) {
+  out->clear();
+  if (moveto == -1) {
+    out->insert(out->end(), in.begin() + start, in.begin() + end + 1);
+    out->insert(out->end(), in.begin(), in.begin() + start);
+    out->insert(out->end(), in.begin() + end + 1, in.end());
+  } else if (moveto < start) {
+    out->insert(out->end(), in.begin(), in.begin() + moveto + 1);
+    out->insert(out->end(), in.begin() + start, in.begin() + end + 1);
+    out->insert(out->end(), in.begin() + moveto + 1, in.begin() + start);
+    out->insert(out->end(), in.begin() + end + 1, in.end());
+  } else if (moveto > end) {
+    out->insert(out->end(), in.begin(), in.begin() + start);
+    out->insert(out->end(), in.begin() + end + 1, in.begin() + moveto + 1);
+    out->insert(out->end(), in.begin() + start, in.begin() + end + 1);
+    out->insert(out->end(), in.begin() + moveto + 1, in.end());
+  } else {
+    const int mid = min<int>(in.size(), end + (moveto - start) + 1);
+    out->insert(out->end(), in.begin(), in.begin() + start);
+    out->insert(out->end(), in.begin() + end + 1, in.begin() + max(mid, end + 1));
+    out->insert(out->end(), in.begin() + start, in.begin() + end + 1);
+    out->insert(out->end(), in.begin() + max(mid, end + 1), in.end());
+  }
+  assert(out->size() == in.size());
+}
+
+void TERScorerImpl::GetAllPossibleShifts(const vector<int>& hyp,
+    const vector<int>& ralign,
+    const vector<bool>& herr,
+    const vector<bool>& rerr,
+    const int min_size,
+    vector<vector<Shift> >* shifts) const {
+  // reference positions of the phrase hyp[start..end], which is extended one
+  // word at a time; these are exactly the phrases of up to MAX_SHIFT_SIZE
+  // words that occur in both the hypothesis and the reference
+  vector<int> matches;
+  for (int start = 0; start < hyp.size(); ++start) {
+    const vector<int>& positions = code2pos_[hyp[start]];
+    if (positions.empty()) continue;
+    bool ok = false;
+    for (unsigned i = 0; i < positions.size(); ++i) {
+      int rm = ralign[positions[i]];
+      ok = (start != rm &&
+            (rm - start) < MAX_SHIFT_DIST &&
+            (start - rm - 1) < MAX_SHIFT_DIST);
+      if (ok) break;
+    }
+    if (!ok) continue;
+    matches = positions;
+    for (int end = start + min_size - 1;
+         ok && end < hyp.size() && end < (start + MAX_SHIFT_SIZE); ++end) {
+      vector<Shift>& sshifts = (*shifts)[end - start];
+      ok = false;
+      if (end > start) {  // keep the matches that extend to hyp[end]
+        const int len = end - start;
+        unsigned k = 0;
+        for (unsigned i = 0; i < matches.size(); ++i)
+          if (matches[i] + len < ref_codes_.size() && ref_codes_[matches[i] + len] == hyp[end])
+            matches[k++] = matches[i];
+        matches.resize(k);
+      }
+      if (matches.empty()) break;
+      bool any_herr = false;
+      for (int i = start; i <= end && !any_herr; ++i)
+        any_herr = herr[i];
+      if (!any_herr) {
+        ok = true;
+        continue;
+      }
+      for (unsigned mi = 0; mi < matches.size(); ++mi) {
+        int moveto = matches[mi];
+        int rm = ralign[moveto];
+        if (! ((rm != start) &&
+              ((rm < start) || (rm > end)) &&
+              (rm - start <= MAX_SHIFT_DIST) &&
+              ((start - rm - 1) <= MAX_SHIFT_DIST))) continue;
+        ok = true;
+        bool any_rerr = false;
+        for (int i = 0; (i <= end - start) && (!any_rerr); ++i)
+          any_rerr = rerr[moveto+i];
+        if (!any_rerr) continue;
+        for (int roff = 0; roff <= (end - start); ++roff) {
+          int rmr = ralign[moveto+roff];
+          if ((start != rmr) && ((roff == 0) || (rmr != ralign[moveto])))
+            sshifts.push_back(Shift(start, end, moveto + roff));
+        }
+      }
+    }
+  }
+}
+
+bool TERScorerImpl::CalculateBestShift(const vector<int>& cur,
+                                       float curerr,
+                                       const vector<TransType>& path,
+                                       vector<int>* new_hyp,
+                                       float* newerr,
+                                       vector<TransType>* new_path) const {
+  vector<bool> herr, rerr;
+  vector<int> ralign;
+  int hpos = -1;
+  for (int i = 0; i < path.size(); ++i) {
+    switch (path[i]) {
+      case MATCH:
+        ++hpos;
+        herr.push_back(false);
+        rerr.push_back(false);
+        ralign.push_back(hpos);
+        break;
+      case SUBSTITUTION:
+        ++hpos;
+        herr.push_back(true);
+        rerr.push_back(true);
+        ralign.push_back(hpos);
+        break;
+      case INSERTION:
+        ++hpos;
+        herr.push_back(true);
+        break;
+      case DELETION:
+        rerr.push_back(true);
+        ralign.push_back(hpos);
+        break;
+    }
+  }
+
+  vector<vector<Shift> > shifts(MAX_SHIFT_SIZE + 1);
+  GetAllPossibleShifts(cur, ralign, herr, rerr, 1, &shifts);
+  float cur_best_shift_cost = 0;
+  *newerr = curerr;
+
+  // the shifted hypotheses share a prefix with cur, so the edit distance is
+  // resumed from cur's columns; the path is only computed for the winner
+  ComputeColumns(cur);
+  vector<int> shifted(cur.size());
+  bool res = false;
+  for (int i = shifts.size() - 1; i >=0; --i) {
+    float curfix = curerr - (cur_best_shift_cost + *newerr);
+    float maxfix = 2.0f * (1 + i) - COSTS::shift;
+    if ((curfix > maxfix) || ((cur_best_shift_cost == 0) && (curfix == maxfix))) break;
+    for (int j = 0; j < shifts[i].size(); ++j) {
+      const Shift& s = shifts[i][j];
+      curfix = curerr - (cur_best_shift_cost + *newerr);
+      maxfix = 2.0f * (1 + i) - COSTS::shift;
+      if ((curfix > maxfix) || ((cur_best_shift_cost == 0) && (curfix == maxfix))) continue;
+      PerformShift(cur, s.begin, s.end, ralign[s.moveto], &shifted);
+      const int from = mismatch(cur.begin(), cur.end(), shifted.begin()).first - cur.begin();
+      float try_cost = EditDistanceFrom(shifted, from);
+      float gain = (*newerr + cur_best_shift_cost) - (try_cost + COSTS::shift);
+      if (gain > 0.0f || ((cur_best_shift_cost == 0.0f) && (gain == 0.0f))) {
+        *newerr = try_cost;
+        cur_best_shift_cost = COSTS::shift;
+        new_hyp->swap(shifted);
+        shifted.resize(cur.size());
+        res = true;
+      }
+    }
+  }
+  if (res) {
+    const float cost = MinimumEditDistance(*new_hyp, new_path);
+    assert(cost == *newerr);
+    (void) cost;
+  }
+  return res;
+}
+
+void TERScorerImpl::GetPathStats(const vector<TransType>& path, int* subs, int* ins, int* dels) {
+  *subs = *ins = *dels = 0;
+  for (int i = 0; i < path.size(); ++i) {
+    switch (path[i]) {
+      case SUBSTITUTION:
+        ++(*subs);
+      case MATCH:
+        break;
+      case INSERTION:
+        ++(*ins); break;
+      case DELETION:
+        ++(*dels); break;
+    }
+  }
+}
+
+float TERScorerImpl::Calculate(const vector<WordID>& hyp,
+    int* subs, int* ins, int* dels, int* shifts) const {
+  vector<int> cur(hyp.size());
+  for (unsigned i = 0; i < hyp.size(); ++i) {
+    vector<WordID>::const_iterator it = lower_bound(code2word_.begin() + 1, code2word_.end(), hyp[i]);
+    cur[i] = (it != code2word_.end() && *it == hyp[i]) ? it - code2word_.begin() : 0;
+  }
+  vector<TransType> path;
+  float med_cost = MinimumEditDistance(cur, &path);
+  float edits = 0;
+  *shifts = 0;
+  if (ter_short_circuit_long_sentences < 0 ||
+      ref_.size() < ter_short_circuit_long_sentences) {
+    vector<int> new_hyp;
+    vector<TransType> new_path;
+    while (true) {
+      float new_med_cost;
+      if (!CalculateBestShift(cur, med_cost, path, &new_hyp, &new_med_cost, &new_path))
+        break;
+      edits += COSTS::shift;
+      ++(*shifts);
+      med_cost = new_med_cost;
+      path.swap(new_path);
+      cur.swap(new_hyp);
+    }
+  }
+  GetPathStats(path, subs, ins, dels);
+  return med_cost + edits;
+}
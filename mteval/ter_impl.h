@@ -0,0 +1,81 @@
+#ifndef _TER_IMPL_H_
+#define _TER_IMPL_H_
+
+#include <vector>
+#include <stdint.h>
+#include "wordid.h"
+
+// TERScorerImpl computes TER (Snover et al., 2006) against a single
+// reference with the greedy shift search of tercom; it is shared by
+// TERScorer (ter.h) and TERMetric (ns_ter.h).
+//
+// Most of the time goes into scoring candidate shifts, so:
+//  - words are mapped to dense codes (0 = not in the reference), and the
+//    reference occurrences of the candidate phrases are found by filtering
+//    the positions of their first word instead of hashing every phrase,
+//  - the cost of a shifted hypothesis is computed with the bit-parallel
+//    edit distance of Myers (1999) in 64-row blocks (Hyyro, 2003), resuming
+//    from the columns of the unshifted hypothesis up to the first position
+//    the shift changes,
+//  - the full DP with backtrace is only run for the shifts that are kept.
+// The search, its tie breaking and the alignments are unchanged, so the
+// statistics are identical to those of the straightforward implementation.
+class TERScorerImpl {
+ public:
+  enum TransType { MATCH, SUBSTITUTION, INSERTION, DELETION };
+
+  explicit TERScorerImpl(const std::vector<WordID>& ref);
+
+  float Calculate(const std::vector<WordID>& hyp, int* subs, int* ins, int* dels, int* shifts) const;
+
+  inline int GetRefLength() const {
+    return ref_.size();
+  }
+
+ private:
+  struct Shift {
+    Shift(int b, int e, int m) : begin(b), end(e), moveto(m) {}
+    int begin;
+    int end;
+    int moveto;
+  };
+
+  // edit distance and transitions of the best path from hyp to the reference
+  float MinimumEditDistance(const std::vector<int>& hyp, std::vector<TransType>* path) const;
+  // column states of the bit-parallel edit distance after each prefix of hyp
+  void ComputeColumns(const std::vector<int>& hyp) const;
+  // edit distance of hyp to the reference, given that its first from words
+  // are the same as those passed to ComputeColumns
+  int EditDistanceFrom(const std::vector<int>& hyp, int from) const;
+
+  static void PerformShift(const std::vector<int>& in, int start, int end, int moveto, std::vector<int>* out);
+  void GetAllPossibleShifts(const std::vector<int>& hyp,
+                            const std::vector<int>& ralign,
+                            const std::vector<bool>& herr,
+                            const std::vector<bool>& rerr,
+                            const int min_size,
+                            std::vector<std::vector<Shift> >* shifts) const;
+  bool CalculateBestShift(const std::vector<int>& cur,
+                          float curerr,
+                          const std::vector<TransType>& path,
+                          std::vector<int>* new_hyp,
+                          float* newerr,
+                          std::vector<TransType>* new_path) const;
+  static void GetPathStats(const std::vector<TransType>& path, int* subs, int* ins, int* dels);
+
+  std::vector<WordID> ref_;
+  std::vector<int> ref_codes_;
+  std::vector<WordID> code2word_;          // sorted distinct reference words
+  std::vector<std::vector<int> > code2pos_; // reference positions of each code
+  unsigned blocks_;                         // 64-bit words per column
+  std::vector<uint64_t> peq_;               // match masks, blocks_ per code
+
+  // scratch space, reused across calls
+  mutable std::vector<uint64_t> cols_;  // (Pv, Mv) per block after each prefix
+  mutable std::vector<int> col_scores_;
+  mutable std::vector<uint64_t> col_;
+  mutable std::vector<int> dp_;
+  mutable std::vector<char> bmat_;
+};
+
+#endif
@@ -12,6 +12,13 @@ struct ConditionalLikelihoodObserver : public DecoderObserver {
     acc_obj = 0;
     trg_words = 0;
   }
+
+  // adds the totals of another observer (e.g. of another decoder thread)
+  ConditionalLikelihoodObserver& operator+=(const ConditionalLikelihoodObserver& o) {
+    acc_obj += o.acc_obj;
+    trg_words += o.trg_words;
+    return *this;
+  }
  
   virtual void NotifyDecodingStart(const SentenceMetadata&);
   virtual void NotifyTranslationForest(const SentenceMetadata&, Hypergraph* hg);
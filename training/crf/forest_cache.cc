@@ -0,0 +1,169 @@
+#include "forest_cache.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <stdint.h>
+
+#include "filelib.h"
+#include "hg.h"
+#include "sentence_metadata.h"
+
+using namespace std;
+
+namespace {
+
+template <typename T>
+inline void Write(const T& x, ostream* out) {
+  out->write(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+template <typename T>
+inline void Read(istream* in, T* x) {
+  in->read(reinterpret_cast<char*>(x), sizeof(T));
+}
+
+// nodes, then for each node its incoming edges (tail nodes and features), in
+// the order of the in_edges_ so that the sums of inside-outside are the same
+void WriteForest(const Hypergraph& hg, ostream* out) {
+  Write<uint32_t>(hg.nodes_.size(), out);
+  for (unsigned i = 0; i < hg.nodes_.size(); ++i) {
+    const Hypergraph::Node& node = hg.nodes_[i];
+    Write<uint32_t>(node.in_edges_.size(), out);
+    for (unsigned j = 0; j < node.in_edges_.size(); ++j) {
+      const Hypergraph::Edge& edge = hg.edges_[node.in_edges_[j]];
+      Write<uint32_t>(edge.tail_nodes_.size(), out);
+      for (unsigned k = 0; k < edge.tail_nodes_.size(); ++k)
+        Write<uint32_t>(edge.tail_nodes_[k], out);
+      Write<uint32_t>(edge.feature_values_.size(), out);
+      for (SparseVector<weight_t>::const_iterator it = edge.feature_values_.begin();
+           it != edge.feature_values_.end(); ++it) {
+        Write<int32_t>(it->first, out);
+        Write<weight_t>(it->second, out);
+      }
+    }
+  }
+}
+
+void ReadForest(istream* in, Hypergraph* hg) {
+  hg->clear();
+  uint32_t num_nodes = 0;
+  Read(in, &num_nodes);
+  for (unsigned i = 0; i < num_nodes; ++i)
+    hg->AddNode(0);
+  Hypergraph::TailNodeVector tail;
+  for (unsigned i = 0; i < num_nodes; ++i) {
+    uint32_t num_edges = 0;
+    Read(in, &num_edges);
+    for (unsigned j = 0; j < num_edges; ++j) {
+      uint32_t arity = 0;
+      Read(in, &arity);
+      tail.resize(arity);
+      for (unsigned k = 0; k < arity; ++k) {
+        uint32_t t;
+        Read(in, &t);
+        tail[k] = t;
+      }
+      Hypergraph::Edge* edge = hg->AddEdge(TRulePtr(), tail);
+      uint32_t num_feats = 0;
+      Read(in, &num_feats);
+      for (unsigned k = 0; k < num_feats; ++k) {
+        int32_t fid;
+        weight_t val;
+        Read(in, &fid);
+        Read(in, &val);
+        edge->feature_values_.set_value(fid, val);
+      }
+      hg->ConnectEdgeToHeadNode(edge, i);
+    }
+  }
+  if (!*in) {
+    cerr << "ForestCache: error reading cached forest\n";
+    abort();
+  }
+}
+
+}
+
+ForestCache::ForestCache(const string& path) : path_(path), observer_() {
+  if (!path_.empty()) out_.reset(new WriteFile(path_));
+}
+
+ForestCache::~ForestCache() {}
+
+void ForestCache::Store(const Hypergraph& hg, boost::shared_ptr<Hypergraph>* forest) {
+  if (out_) {
+    WriteForest(hg, out_->stream());
+  } else {
+    forest->reset(new Hypergraph(hg));
+    for (unsigned i = 0; i < (*forest)->edges_.size(); ++i)
+      (*forest)->edges_[i].rule_.reset();
+  }
+}
+
+void ForestCache::NotifyDecodingStart(const SentenceMetadata& smeta) {
+  assert(out_ || path_.empty());  // no more sentences after a Replay
+  sents_.resize(sents_.size() + 1);
+  sents_.back().id = smeta.GetSentenceId();
+  if (smeta.HasReference()) sents_.back().ref = smeta.GetReference();
+  if (observer_) observer_->NotifyDecodingStart(smeta);
+}
+
+void ForestCache::NotifySourceParseFailure(const SentenceMetadata& smeta) {
+  sents_.back().parse_failed = true;
+  if (observer_) observer_->NotifySourceParseFailure(smeta);
+}
+
+void ForestCache::NotifyTranslationForest(const SentenceMetadata& smeta, Hypergraph* hg) {
+  Sentence& s = sents_.back();
+  s.src_len = smeta.GetSourceLength();
+  s.has_forest = true;
+  Store(*hg, &s.forest);
+  if (observer_) observer_->NotifyTranslationForest(smeta, hg);
+}
+
+void ForestCache::NotifyAlignmentFailure(const SentenceMetadata& smeta) {
+  sents_.back().alignment_failed = true;
+  if (observer_) observer_->NotifyAlignmentFailure(smeta);
+}
+
+void ForestCache::NotifyAlignmentForest(const SentenceMetadata& smeta, Hypergraph* hg) {
+  Sentence& s = sents_.back();
+  s.has_ref_forest = true;
+  Store(*hg, &s.ref_forest);
+  if (observer_) observer_->NotifyAlignmentForest(smeta, hg);
+}
+
+void ForestCache::NotifyDecodingComplete(const SentenceMetadata& smeta) {
+  if (observer_) observer_->NotifyDecodingComplete(smeta);
+}
+
+void ForestCache::Replay(const vector<weight_t>& weights, DecoderObserver* observer) {
+  boost::shared_ptr<ReadFile> in;
+  if (!path_.empty()) {
+    out_.reset();  // flushes and closes the file
+    in.reset(new ReadFile(path_));
+  }
+  Hypergraph file_forest;
+  for (unsigned i = 0; i < sents_.size(); ++i) {
+    const Sentence& s = sents_[i];
+    SentenceMetadata smeta(s.id, s.ref);
+    smeta.SetSourceLength(s.src_len);
+    observer->NotifyDecodingStart(smeta);
+    if (s.parse_failed) observer->NotifySourceParseFailure(smeta);
+    if (s.has_forest) {
+      Hypergraph* hg = s.forest.get();
+      if (in) { ReadForest(in->stream(), &file_forest); hg = &file_forest; }
+      hg->Reweight(weights);
+      observer->NotifyTranslationForest(smeta, hg);
+    }
+    if (s.alignment_failed) observer->NotifyAlignmentFailure(smeta);
+    if (s.has_ref_forest) {
+      Hypergraph* hg = s.ref_forest.get();
+      if (in) { ReadForest(in->stream(), &file_forest); hg = &file_forest; }
+      hg->Reweight(weights);
+      observer->NotifyAlignmentForest(smeta, hg);
+    }
+    observer->NotifyDecodingComplete(smeta);
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef _FOREST_CACHE_H_
+#define _FOREST_CACHE_H_
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "decoder.h"
+#include "lattice.h"
+#include "weights.h"
+
+class Hypergraph;
+class WriteFile;
+
+// ForestCache records the translation and reference (alignment) forests of a
+// corpus while it is decoded, and can then replay the notifications of the
+// decoder to an observer for a new weight vector by just reweighting them.
+// This is only valid if the forests do not depend on the weights, i.e. with a
+// fixed grammar and no (cube) pruning.
+//
+// Only the structure and the feature values of the forests are kept: the
+// rules are dropped, so grammars extracted per sentence can be freed. The
+// forests are either kept in memory or written to a (gzipped) binary file
+// that is read back sequentially on each replay.
+class ForestCache : public DecoderObserver {
+ public:
+  // if path is empty, the forests are kept in memory
+  explicit ForestCache(const std::string& path = "");
+  ~ForestCache();
+
+  // while a corpus is decoded with the cache as the observer, all the
+  // notifications are forwarded to observer (if not NULL)
+  void SetObserver(DecoderObserver* observer) { observer_ = observer; }
+
+  virtual void NotifyDecodingStart(const SentenceMetadata& smeta);
+  virtual void NotifySourceParseFailure(const SentenceMetadata& smeta);
+  virtual void NotifyTranslationForest(const SentenceMetadata& smeta, Hypergraph* hg);
+  virtual void NotifyAlignmentFailure(const SentenceMetadata& smeta);
+  virtual void NotifyAlignmentForest(const SentenceMetadata& smeta, Hypergraph* hg);
+  virtual void NotifyDecodingComplete(const SentenceMetadata& smeta);
+
+  // notifies observer of all recorded sentences, in order, as the decoder
+  // would have with the given weights
+  void Replay(const std::vector<weight_t>& weights, DecoderObserver* observer);
+
+  size_t size() const { return sents_.size(); }
+
+ private:
+  struct Sentence {
+    Sentence() : id(), src_len(-1), parse_failed(), alignment_failed(), has_forest(), has_ref_forest() {}
+    int id;
+    int src_len;
+    Lattice ref;
+    bool parse_failed;
+    bool alignment_failed;
+    bool has_forest;
+    bool has_ref_forest;
+    // NULL if the forests are stored in the file
+    boost::shared_ptr<Hypergraph> forest;
+    boost::shared_ptr<Hypergraph> ref_forest;
+  };
+  void Store(const Hypergraph& hg, boost::shared_ptr<Hypergraph>* forest);
+
+  const std::string path_;
+  DecoderObserver* observer_;
+  std::vector<Sentence> sents_;
+  boost::shared_ptr<WriteFile> out_;
+};
+
+#endif
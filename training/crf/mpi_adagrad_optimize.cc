@@ -19,6 +19,7 @@
 #include "inside_outside.h"
 #include "ff_register.h"
 #include "decoder.h"
+#include "decoder_threads.h"
 #include "filelib.h"
 #include "online_optimizer.h"
 #include "fdict.h"
@@ -47,6 +48,7 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("max_passes", po::value<double>()->default_value(20.0), "Maximum number of passes through the data")
         ("max_walltime", po::value<unsigned>(), "Walltime to run (in minutes)")
         ("write_every_n_minibatches", po::value<unsigned>()->default_value(100), "Write weights every N minibatches processed")
+        ("threads,j", po::value<int>()->default_value(1), "Number of decoding threads per process (each thread loads its own copy of the models, so the memory used grows with it)")
         ("random_seed,S", po::value<uint32_t>(), "Random seed")
         ("regularization,r", po::value<string>()->default_value("none"),
             "Regularization 'none', 'l1', or 'l2'")
@@ -97,6 +99,14 @@ struct TrainingObserver : public DecoderObserver {
     total_complete = 0;
   } 
 
+  // adds the totals of another observer (e.g. of another decoder thread)
+  TrainingObserver& operator+=(const TrainingObserver& o) {
+    acc_grad += o.acc_grad;
+    acc_obj += o.acc_obj;
+    total_complete += o.total_complete;
+    return *this;
+  }
+
   virtual void NotifyDecodingStart(const SentenceMetadata&) {
     cur_model_exp.clear();
     cur_obj = 0;
@@ -294,7 +304,7 @@ int main(int argc, char** argv) {
     return 1;
 
   ReadFile ini_rf(conf["decoder_config"].as<string>());
-  Decoder decoder(ini_rf.stream());
+  DecoderThreads decoders(ini_rf.stream(), conf["threads"].as<int>());
 
   // load initial weights
   vector<weight_t> init_weights;
@@ -343,7 +353,7 @@ int main(int argc, char** argv) {
   unsigned timeout = 0;
   if (conf.count("max_walltime"))
     timeout = 60 * conf["max_walltime"].as<unsigned>();
-  vector<weight_t>& lambdas = decoder.CurrentWeightVector();
+  vector<weight_t>& lambdas = decoders.CurrentWeightVector();
   if (init_weights.size()) {
     lambdas.swap(init_weights);
     init_weights.clear();
@@ -356,7 +366,12 @@ int main(int argc, char** argv) {
   int iter = -1;
   bool converged = false;
 
-  TrainingObserver observer;
+  // one observer per decoder thread, summed into the first one
+  vector<TrainingObserver> observers(decoders.size());
+  vector<DecoderObserver*> observer_ptrs;
+  for (unsigned t = 0; t < observers.size(); ++t)
+    observer_ptrs.push_back(&observers[t]);
+  TrainingObserver& observer = observers[0];
   ConditionalLikelihoodObserver cllh_observer;
 
   const time_t start_time = time(NULL);
@@ -372,7 +387,8 @@ int main(int argc, char** argv) {
           Weights::ShowLargestFeatures(lambdas);
         }
       }
-      observer.Reset();
+      for (unsigned t = 0; t < observers.size(); ++t)
+        observers[t].Reset();
       if (rank == 0) {
         converged = (iter == max_iteration);
         string fname = "weights.cur.gz";
@@ -393,12 +409,11 @@ int main(int argc, char** argv) {
         Weights::WriteToFile(fname, lambdas, true, &svv);
       }
 
-      for (int i = 0; i < size_per_proc; ++i) {
-        int ei = corpus.size() * rng->next();
-        int id = ids[ei];
-        decoder.SetId(id);
-        decoder.Decode(corpus[ei], &observer);
-      }
+      vector<unsigned> minibatch(size_per_proc);
+      for (int i = 0; i < size_per_proc; ++i)
+        minibatch[i] = corpus.size() * rng->next();
+      decoders.Decode(corpus, ids, minibatch, observer_ptrs);
+      TreeReduce(&observers);
       SparseVector<double> local_grad, g;
       observer.GetGradient(&local_grad);
 #ifdef HAVE_MPI
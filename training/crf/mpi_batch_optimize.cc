@@ -3,11 +3,14 @@
 #include <vector>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 
 #include "config.h"
 #ifdef HAVE_MPI
 #include <boost/mpi/timer.hpp>
 #include <boost/mpi.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
 namespace mpi = boost::mpi;
 #endif
 
@@ -17,6 +20,9 @@ namespace mpi = boost::mpi;
 
 #include "sentence_metadata.h"
 #include "cllh_observer.h"
+#include "forest_cache.h"
+#include "decoder_threads.h"
+#include "vector_ops.h"
 #include "verbose.h"
 #include "hg.h"
 #include "prob.h"
@@ -45,7 +51,10 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
 	("correction_buffers,M", po::value<int>()->default_value(10), "Number of gradients for LBFGS to maintain in memory")
         ("gaussian_prior,p","Use a Gaussian prior on the weights")
         ("sigma_squared", po::value<double>()->default_value(1.0), "Sigma squared term for spherical Gaussian prior")
-        ("means,u", po::value<string>(), "(optional) file containing the means for Gaussian prior");
+        ("means,u", po::value<string>(), "(optional) file containing the means for Gaussian prior")
+        ("cache_forests,C", "Decode the training (and test) data only once and compute the objective and gradient in later iterations by reweighting the cached forests. Only valid if the forests do not depend on the weights (fixed grammar, no pruning)")
+        ("forest_cache_dir", po::value<string>(), "With --cache_forests, keep the forests in files in this directory instead of in memory")
+        ("threads,j", po::value<int>()->default_value(1), "Number of decoding threads per process (each thread loads its own copy of the models, so the memory used grows with it)");
   po::options_description clo("Command line options");
   clo.add_options()
         ("config", po::value<string>(), "Configuration file")
@@ -91,10 +100,22 @@ struct TrainingObserver : public DecoderObserver {
     trg_words = 0;
   } 
 
-  void SetLocalGradientAndObjective(vector<double>* g, double* o) const {
-    *o = acc_obj;
+  // adds the totals of another observer (e.g. of another decoder thread)
+  TrainingObserver& operator+=(const TrainingObserver& o) {
+    acc_grad += o.acc_grad;
+    acc_obj += o.acc_obj;
+    total_complete += o.total_complete;
+    trg_words += o.trg_words;
+    return *this;
+  }
+
+  // the accumulated gradient as (feature id, value) pairs, sorted by id
+  void GetLocalGradient(vector<pair<unsigned, double> >* g) const {
+    g->clear();
+    g->reserve(acc_grad.size());
     for (SparseVector<prob_t>::const_iterator it = acc_grad.begin(); it != acc_grad.end(); ++it)
-      (*g)[it->first] = it->second.as_float();
+      g->push_back(make_pair(it->first, it->second.as_float()));
+    sort(g->begin(), g->end());
   }
 
   virtual void NotifyDecodingStart(const SentenceMetadata&) {
@@ -182,6 +203,49 @@ void StoreConfig(const vector<string>& cfg, istringstream* o) {
   o->str(os.str());
 }
 
+// a gradient as (feature id, value) pairs, sorted by feature id
+struct SparseGradient {
+  typedef vector<pair<unsigned, double> >::const_iterator const_iterator;
+  vector<pair<unsigned, double> > v;
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned) { ar & v; }
+};
+
+// sums two gradients by merging their lists
+struct SparseGradientPlus : public binary_function<SparseGradient, SparseGradient, SparseGradient> {
+  SparseGradient operator()(const SparseGradient& a, const SparseGradient& b) const {
+    SparseGradient sum;
+    vector<pair<unsigned, double> >& c = sum.v;
+    c.reserve(a.v.size() + b.v.size());
+    SparseGradient::const_iterator i = a.v.begin(), j = b.v.begin();
+    while (i != a.v.end() && j != b.v.end()) {
+      if (i->first < j->first) {
+        c.push_back(*i++);
+      } else if (j->first < i->first) {
+        c.push_back(*j++);
+      } else {
+        c.push_back(make_pair(i->first, i->second + j->second));
+        ++i; ++j;
+      }
+    }
+    c.insert(c.end(), i, a.v.end());
+    c.insert(c.end(), j, b.v.end());
+    return sum;
+  }
+};
+
+// bytes sent per gradient entry: a (feature id, value) pair of a sparse
+// list, or a slot of the dense array
+static const size_t kSPARSE_ENTRY_BYTES = sizeof(unsigned) + sizeof(double);
+static const size_t kDENSE_ENTRY_BYTES = sizeof(double);
+
+#ifdef HAVE_MPI
+namespace boost { namespace mpi {
+  template<>
+  struct is_commutative<SparseGradientPlus, SparseGradient> : mpl::true_ { };
+} } // end namespace boost::mpi
+#endif
+
 template <typename T>
 struct VectorPlus : public binary_function<vector<T>, vector<T>, vector<T> >  {
   vector<T> operator()(const vector<int>& a, const vector<int>& b) const {
@@ -214,8 +278,10 @@ int main(int argc, char** argv) {
   istringstream ini;
   StoreConfig(cdec_ini, &ini);
   if (rank == 0) cerr << "Loading grammar...\n";
-  Decoder* decoder = new Decoder(&ini);
-  if (decoder->GetConf()["input"].as<string>() != "-") {
+  DecoderThreads decoders(&ini, conf["threads"].as<int>());
+  const int num_threads = decoders.size();
+  SetVectorOpsThreads(num_threads);  // the LBFGS updates of long weight vectors
+  if (decoders[0].GetConf()["input"].as<string>() != "-") {
     cerr << "cdec.ini must not set an input file\n";
     return 1;
   }
@@ -223,7 +289,7 @@ int main(int argc, char** argv) {
 
   // load initial weights
   if (rank == 0) { cerr << "Loading weights...\n"; }
-  vector<weight_t>& lambdas = decoder->CurrentWeightVector();
+  vector<weight_t>& lambdas = decoders.CurrentWeightVector();
   Weights::InitFromFile(conf["input_weights"].as<string>(), &lambdas);
   if (rank == 0) { cerr << "Done loading weights.\n"; }
 
@@ -254,9 +320,11 @@ int main(int argc, char** argv) {
     cerr << "Optimizer: " << o->Name() << endl;
   }
   double objective = 0;
-  vector<double> gradient(num_feats, 0.0);
+  // the dense gradient is only needed by the optimizer on rank 0 (and for
+  // a dense reduction, see below)
+  vector<double> gradient(rank == 0 ? num_feats : 0, 0.0);
   vector<double> rcv_grad;
-  rcv_grad.clear();
+  SparseGradient local_grad, rcv_sparse_grad;
   bool converged = false;
 
   vector<string> corpus, test_corpus;
@@ -265,11 +333,41 @@ int main(int argc, char** argv) {
   if (conf.count("test_data"))
     ReadTrainingCorpus(conf["test_data"].as<string>(), rank, size, &test_corpus);
 
-  TrainingObserver observer;
-  ConditionalLikelihoodObserver cllh_observer;
+  // one observer (and forest cache) per decoder thread; their totals are
+  // summed into the first one after decoding
+  vector<TrainingObserver> observers(num_threads);
+  vector<ConditionalLikelihoodObserver> cllh_observers(num_threads);
+  TrainingObserver& observer = observers[0];
+  ConditionalLikelihoodObserver& cllh_observer = cllh_observers[0];
+  vector<DecoderObserver*> train_observers, test_observers;
+  const bool cache_forests = conf.count("cache_forests");
+  vector<boost::shared_ptr<ForestCache> > train_caches, test_caches;
+  for (int t = 0; t < num_threads; ++t) {
+    if (cache_forests) {
+      string prefix;
+      if (conf.count("forest_cache_dir")) {
+        ostringstream os;
+        os << conf["forest_cache_dir"].as<string>() << '/' << rank << '.';
+        if (num_threads > 1) os << t << '.';
+        prefix = os.str();
+      }
+      train_caches.push_back(boost::shared_ptr<ForestCache>(new ForestCache(prefix.empty() ? prefix : prefix + "train.bin.gz")));
+      test_caches.push_back(boost::shared_ptr<ForestCache>(new ForestCache(prefix.empty() ? prefix : prefix + "test.bin.gz")));
+      train_caches[t]->SetObserver(&observers[t]);
+      test_caches[t]->SetObserver(&cllh_observers[t]);
+      train_observers.push_back(train_caches[t].get());
+      test_observers.push_back(test_caches[t].get());
+    } else {
+      train_observers.push_back(&observers[t]);
+      test_observers.push_back(&cllh_observers[t]);
+    }
+  }
+  bool forests_cached = false;
   while (!converged) {
-    observer.Reset();
-    cllh_observer.Reset();
+    for (int t = 0; t < num_threads; ++t) {
+      observers[t].Reset();
+      cllh_observers[t].Reset();
+    }
 #ifdef HAVE_MPI
     mpi::timer timer;
     world.barrier();
@@ -278,31 +376,72 @@ int main(int argc, char** argv) {
       cerr << "Starting decoding... (~" << corpus.size() << " sentences / proc)\n";
       cerr << "  Testset size: " << test_corpus.size() << " sentences / proc)\n";
     }
-    for (int i = 0; i < corpus.size(); ++i)
-      decoder->Decode(corpus[i], &observer);
+    if (forests_cached) {
+#pragma omp parallel for num_threads(num_threads)
+      for (int t = 0; t < num_threads; ++t)
+        train_caches[t]->Replay(lambdas, &observers[t]);
+    } else {
+      decoders.Decode(corpus, train_observers);
+    }
+    TreeReduce(&observers);
     cerr << "  process " << rank << '/' << size << " done\n";
-    fill(gradient.begin(), gradient.end(), 0);
-    observer.SetLocalGradientAndObjective(&gradient, &objective);
+    observer.GetLocalGradient(&local_grad.v);
+    objective = observer.acc_obj;
 
     unsigned total_words = 0;
 #ifdef HAVE_MPI
     double to = 0;
-    rcv_grad.resize(num_feats, 0.0);
-    mpi::reduce(world, &gradient[0], gradient.size(), &rcv_grad[0], plus<double>(), 0);
-    swap(gradient, rcv_grad);
-    rcv_grad.clear();
+    // Each process only has the features that fire in its shard, so the
+    // gradients are summed as sorted sparse lists (merged up the reduction
+    // tree), unless the (id, value) pairs of some process would already take
+    // more space than the plain array.
+    mpi::timer reduce_timer;
+    size_t local_nnz = local_grad.v.size(), max_nnz = 0;
+    mpi::all_reduce(world, local_nnz, max_nnz, mpi::maximum<size_t>());
+    const bool dense_reduce = max_nnz * kSPARSE_ENTRY_BYTES > num_feats * kDENSE_ENTRY_BYTES;
+    if (dense_reduce) {
+      gradient.resize(num_feats);
+      fill(gradient.begin(), gradient.end(), 0);
+      for (SparseGradient::const_iterator it = local_grad.v.begin(); it != local_grad.v.end(); ++it)
+        gradient[it->first] = it->second;
+      rcv_grad.resize(num_feats, 0.0);
+      mpi::reduce(world, &gradient[0], gradient.size(), &rcv_grad[0], plus<double>(), 0);
+      swap(gradient, rcv_grad);
+      rcv_grad.clear();
+    } else {
+      mpi::reduce(world, local_grad, rcv_sparse_grad, SparseGradientPlus(), 0);
+      if (rank == 0) {
+        fill(gradient.begin(), gradient.end(), 0);
+        for (SparseGradient::const_iterator it = rcv_sparse_grad.v.begin(); it != rcv_sparse_grad.v.end(); ++it)
+          gradient[it->first] = it->second;
+      }
+      rcv_sparse_grad.v.clear();
+    }
+    if (rank == 0)
+      cerr << "  GRADIENT REDUCTION: " << (dense_reduce ? "dense" : "sparse") << ", at most " << max_nnz
+           << " non-zeros per process, " << reduce_timer.elapsed() << " s\n";
 
     reduce(world, observer.trg_words, total_words, std::plus<unsigned>(), 0);
     mpi::reduce(world, objective, to, plus<double>(), 0);
     objective = to;
 #else
+    fill(gradient.begin(), gradient.end(), 0);
+    for (SparseGradient::const_iterator it = local_grad.v.begin(); it != local_grad.v.end(); ++it)
+      gradient[it->first] = it->second;
     total_words = observer.trg_words;
 #endif
     if (rank == 0)
       cerr << "TRAINING CORPUS: ln p(f|e)=" << objective << "\t log_2 p(f|e) = " << (objective/log(2)) << "\t cond. entropy = " << (objective/log(2) / total_words) << "\t ppl = " << pow(2, (objective/log(2) / total_words)) << endl;
 
-    for (int i = 0; i < test_corpus.size(); ++i)
-      decoder->Decode(test_corpus[i], &cllh_observer);
+    if (forests_cached) {
+#pragma omp parallel for num_threads(num_threads)
+      for (int t = 0; t < num_threads; ++t)
+        test_caches[t]->Replay(lambdas, &cllh_observers[t]);
+    } else {
+      decoders.Decode(test_corpus, test_observers);
+      forests_cached = cache_forests;
+    }
+    TreeReduce(&cllh_observers);
 
     double test_objective = 0;
     unsigned test_total_words = 0;
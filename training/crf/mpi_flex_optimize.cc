@@ -16,6 +16,8 @@
 #include "inside_outside.h"
 #include "ff_register.h"
 #include "decoder.h"
+#include "decoder_threads.h"
+#include "vector_ops.h"
 #include "filelib.h"
 #include "optimize.h"
 #include "fdict.h"
@@ -43,6 +45,7 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("iterations,I", po::value<unsigned>()->default_value(50), "Number of passes through the training data before termination")
         ("regularization_strength,C", po::value<double>()->default_value(0.2), "Regularization strength")
         ("time_series_strength,T", po::value<double>()->default_value(0.0), "Time series regularization strength")
+        ("threads,j", po::value<int>()->default_value(1), "Number of decoding (and inside-outside) threads per process (each thread loads its own copy of the models, so the memory used grows with it)")
         ("random_seed,S", po::value<uint32_t>(), "Random seed (if not specified, /dev/random will be used)")
         ("lbfgs_memory_buffers,M", po::value<unsigned>()->default_value(10), "Number of memory buffers for LBFGS history");
   po::options_description clo("Command line options");
@@ -233,7 +236,9 @@ int main(int argc, char** argv) {
   // initialize decoder (loads hash functions if necessary)
   istringstream ins;
   ReadConfig(conf["cdec_config"].as<string>(), &ins);
-  Decoder decoder(&ins);
+  DecoderThreads decoders(&ins, conf["threads"].as<int>());
+  const int num_threads = decoders.size();
+  SetVectorOpsThreads(num_threads);  // the LBFGS updates of long weight vectors
 
   // load initial weights
   vector<weight_t> prev_weights;
@@ -255,12 +260,16 @@ int main(int argc, char** argv) {
   if (rank == 0)
     cerr << "Total corpus size: " << total_corpus_size << endl;
 
-  CopyHGsObserver observer;
+  // one observer per minibatch sentence
+  vector<CopyHGsObserver> observers(size_per_proc);
+  vector<DecoderObserver*> observer_ptrs;
+  for (unsigned i = 0; i < size_per_proc; ++i)
+    observer_ptrs.push_back(&observers[i]);
 
   int write_weights_every_ith = 100; // TODO configure
   int titer = -1;
 
-  vector<weight_t>& cur_weights = decoder.CurrentWeightVector();
+  vector<weight_t>& cur_weights = decoders.CurrentWeightVector();
   if (use_time_series_reg) {
     cur_weights = prev_weights;
   } else {
@@ -292,13 +301,12 @@ int main(int argc, char** argv) {
 
       vector<Hypergraph> hgs(size_per_proc);
       vector<Hypergraph> gold_hgs(size_per_proc);
+      vector<unsigned> minibatch(size_per_proc);
       for (int i = 0; i < size_per_proc; ++i) {
-        int ei = corpus.size() * rng->next();
-        int id = ids[ei];
-        observer.SetCurrentHypergraphs(&hgs[i], &gold_hgs[i]);
-        decoder.SetId(id);
-        decoder.Decode(corpus[ei], &observer);
+        minibatch[i] = corpus.size() * rng->next();
+        observers[i].SetCurrentHypergraphs(&hgs[i], &gold_hgs[i]);
       }
+      decoders.Decode(corpus, ids, minibatch, observer_ptrs);
 
       SparseVector<double> local_grad, g;
       double local_obj = 0;
@@ -308,7 +316,14 @@ int main(int argc, char** argv) {
         g.clear();
         local_obj = 0;
 
-        for (unsigned i = 0; i < size_per_proc; ++i) {
+        // each thread accumulates its own gradient and objective
+        vector<SparseVector<double> > thread_grads(num_threads);
+        vector<double> thread_objs(num_threads, 0.0);
+        bool diff_err = false;
+#pragma omp parallel for schedule(static, 1) num_threads(num_threads)
+        for (int i = 0; i < size_per_proc; ++i) {
+          SparseVector<double>& grad = thread_grads[i % num_threads];
+          double& obj = thread_objs[i % num_threads];
           Hypergraph& hg = hgs[i];
           Hypergraph& hg_gold = gold_hgs[i];
           if (hg.edges_.size() < 2) continue;
@@ -320,25 +335,34 @@ int main(int argc, char** argv) {
                                          EdgeProb,
                                          SparseVector<prob_t>,
                                          EdgeFeaturesAndProbWeightFunction>(hg, &model_exp);
-          local_obj += log(z);
+          obj += log(z);
           model_exp /= z;
-          AddGrad(model_exp, 1.0, &local_grad);
+          AddGrad(model_exp, 1.0, &grad);
           model_exp.clear();
 
           const prob_t goldz = InsideOutside<prob_t,
                                          EdgeProb,
                                          SparseVector<prob_t>,
                                          EdgeFeaturesAndProbWeightFunction>(hg_gold, &gold_exp);
-          local_obj -= log(goldz);
+          obj -= log(goldz);
 
           if (log(z) - log(goldz) < kMINUS_EPSILON) {
-            cerr << "DIFF. ERR! log_model_z < log_gold_z: " << log(z) << " " << log(goldz) << endl;
-            return 1;
+#pragma omp critical (stderr_write)
+            {
+              cerr << "DIFF. ERR! log_model_z < log_gold_z: " << log(z) << " " << log(goldz) << endl;
+              diff_err = true;
+            }
+            continue;
           }
 
           gold_exp /= goldz;
-          AddGrad(gold_exp, -1.0, &local_grad);
+          AddGrad(gold_exp, -1.0, &grad);
         }
+        if (diff_err) return 1;
+        TreeReduce(&thread_grads);
+        local_grad.swap(thread_grads[0]);
+        for (int t = 0; t < num_threads; ++t)
+          local_obj += thread_objs[t];
 
         double obj = 0;
 #ifdef HAVE_MPI
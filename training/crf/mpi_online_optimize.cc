@@ -17,6 +17,7 @@
 #include "inside_outside.h"
 #include "ff_register.h"
 #include "decoder.h"
+#include "decoder_threads.h"
 #include "filelib.h"
 #include "online_optimizer.h"
 #include "fdict.h"
@@ -43,6 +44,7 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("minibatch_size_per_proc,s", po::value<unsigned>()->default_value(5), "Number of training instances evaluated per processor in each minibatch")
         ("optimization_method,m", po::value<string>()->default_value("sgd"), "Optimization method (sgd)")
         ("max_walltime", po::value<unsigned>(), "Maximum walltime to run (in minutes)")
+        ("threads,j", po::value<int>()->default_value(1), "Number of decoding threads per process (each thread loads its own copy of the models, so the memory used grows with it)")
         ("random_seed,S", po::value<uint32_t>(), "Random seed (if not specified, /dev/random will be used)")
         ("eta_0,e", po::value<double>()->default_value(0.2), "Initial learning rate for SGD (eta_0)")
         ("L1,1","Use L1 regularization")
@@ -100,6 +102,14 @@ struct TrainingObserver : public DecoderObserver {
       (*g)[it->first] = it->second.as_float();
   }
 
+  // adds the totals of another observer (e.g. of another decoder thread)
+  TrainingObserver& operator+=(const TrainingObserver& o) {
+    acc_grad += o.acc_grad;
+    acc_obj += o.acc_obj;
+    total_complete += o.total_complete;
+    return *this;
+  }
+
   virtual void NotifyDecodingStart(const SentenceMetadata& smeta) {
     cur_model_exp.clear();
     cur_obj = 0;
@@ -301,7 +311,6 @@ int main(int argc, char** argv) {
 
   SparseVector<double> x;
   Weights::InitSparseVector(init_weights, &x);
-  TrainingObserver observer;
 
   int write_weights_every_ith = 100; // TODO configure
   int titer = -1;
@@ -316,8 +325,16 @@ int main(int argc, char** argv) {
       cerr << "STARTING TRAINING EPOCH " << (ai+1) << ". CONFIG=" << cur_config << endl;
     // load cdec.ini and set up decoder
     ReadFile ini_rf(cur_config);
-    Decoder decoder(ini_rf.stream());
-    vector<weight_t>& lambdas = decoder.CurrentWeightVector();
+    DecoderThreads decoders(ini_rf.stream(), conf["threads"].as<int>());
+    vector<weight_t>& lambdas = decoders.CurrentWeightVector();
+
+    // one observer per decoder thread, summed into the first one
+    vector<TrainingObserver> observers(decoders.size());
+    vector<DecoderObserver*> observer_ptrs;
+    for (unsigned t = 0; t < observers.size(); ++t)
+      observer_ptrs.push_back(&observers[t]);
+    TrainingObserver& observer = observers[0];
+
     if (ai == 0) { lambdas.swap(init_weights); init_weights.clear(); }
 
     if (rank == 0)
@@ -331,7 +348,8 @@ int main(int argc, char** argv) {
 #endif
       x.init_vector(&lambdas);
       ++iter; ++titer;
-      observer.Reset();
+      for (unsigned t = 0; t < observers.size(); ++t)
+        observers[t].Reset();
       if (rank == 0) {
         converged = (iter == max_iteration);
         Weights::SanityCheck(lambdas);
@@ -354,12 +372,11 @@ int main(int argc, char** argv) {
         Weights::WriteToFile(fname, lambdas, true, &svv);
       }
 
-      for (int i = 0; i < size_per_proc; ++i) {
-        int ei = corpus.size() * rng->next();
-        int id = ids[ei];
-        decoder.SetId(id);
-        decoder.Decode(corpus[ei], &observer);
-      }
+      vector<unsigned> minibatch(size_per_proc);
+      for (int i = 0; i < size_per_proc; ++i)
+        minibatch[i] = corpus.size() * rng->next();
+      decoders.Decode(corpus, ids, minibatch, observer_ptrs);
+      TreeReduce(&observers);
       SparseVector<double> local_grad, g;
       observer.GetGradient(&local_grad);
 #ifdef HAVE_MPI
@@ -44,6 +44,7 @@ my $best_weights;
 my $max_iterations = 15;
 my $optimization_iters = 6;
 my $jobs = $default_jobs;   # number of decode nodes
+my $mapper_threads = 1;     # threads per line search mapper
 my $pmem = "9g";
 my $disable_clean = 0;
 my %seen_weights;
@@ -66,6 +67,7 @@ if (GetOptions(
 	"weights=s" => \$initialWeights,
         "devset=s" => \$devset,
 	"jobs=i" => \$jobs,
+	"mapper-threads=i" => \$mapper_threads,
 	"pass-suffix=s" => \$pass_suffix,
 	"help" => \$help,
 	"qsub" => \$useqsub,
@@ -306,7 +308,7 @@ while (1){
 			$mapoutput =~ s/mapinput/mapoutput/;
 			push @mapoutputs, "$dir/splag.$im1/$mapoutput";
 			$o2i{"$dir/splag.$im1/$mapoutput"} = "$dir/splag.$im1/$shard";
-			my $script = "$MAPPER -s $srcFile -m $metric $refs < $dir/splag.$im1/$shard | sort -t \$'\\t' -k 1 > $dir/splag.$im1/$mapoutput";
+			my $script = "$MAPPER -s $srcFile -m $metric -j $mapper_threads $refs < $dir/splag.$im1/$shard | sort -t \$'\\t' -k 1 > $dir/splag.$im1/$mapoutput";
 			if ($use_make) {
 				my $script_file = "$dir/scripts/map.$shard";
 				open F, ">$script_file" or die "Can't write $script_file: $!";
@@ -545,6 +547,10 @@ Job control options:
 	--jobs <I>
 		Number of decoder processes to run in parallel. [default=$default_jobs]
 
+	--mapper-threads <I>
+		Number of threads each line search mapper uses to compute the
+		convex hulls of the search directions of a forest. [default=1]
+
 	--qsub
 		Use qsub to run jobs in parallel (qsub must be configured in
 		environment/LocalEnvironment.pm)
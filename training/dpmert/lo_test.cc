@@ -40,15 +40,16 @@ BOOST_AUTO_TEST_CASE( TestCheckNaN) {
 }
 
 BOOST_AUTO_TEST_CASE(TestConvexHull) {
-  boost::shared_ptr<MERTPoint> a1(new MERTPoint(-1, 0));
-  boost::shared_ptr<MERTPoint> b1(new MERTPoint(1, 0));
-  boost::shared_ptr<MERTPoint> a2(new MERTPoint(-1, 1));
-  boost::shared_ptr<MERTPoint> b2(new MERTPoint(1, -1));
-  vector<boost::shared_ptr<MERTPoint> > sa; sa.push_back(a1); sa.push_back(b1);
-  vector<boost::shared_ptr<MERTPoint> > sb; sb.push_back(a2); sb.push_back(b2);
-  ConvexHull a(sa);
+  boost::shared_ptr<MERTPointPool> pool(new MERTPointPool);
+  MERTPoint* a1 = pool->Create(MERTPoint(-1, 0));
+  MERTPoint* b1 = pool->Create(MERTPoint(1, 0));
+  MERTPoint* a2 = pool->Create(MERTPoint(-1, 1));
+  MERTPoint* b2 = pool->Create(MERTPoint(1, -1));
+  vector<MERTPoint*> sa; sa.push_back(a1); sa.push_back(b1);
+  vector<MERTPoint*> sb; sb.push_back(a2); sb.push_back(b2);
+  ConvexHull a(pool, sa);
   cerr << a << endl;
-  ConvexHull b(sb);
+  ConvexHull b(pool, sb);
   ConvexHull c = a;
   c *= b;
   cerr << a << " (*) " << b << " = " << c << endl;
@@ -77,7 +78,7 @@ BOOST_AUTO_TEST_CASE(TestConvexHullInside) {
   ConvexHullWeightFunction wf(wts, dir);
   ConvexHull env = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
   cerr << env << endl;
-  const vector<boost::shared_ptr<MERTPoint> >& segs = env.GetSortedSegs();
+  const vector<MERTPoint*>& segs = env.GetSortedSegs();
   dir *= segs[1]->x;
   wts += dir;
   hg.Reweight(wts);
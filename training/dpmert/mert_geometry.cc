@@ -1,15 +1,72 @@
 #include "mert_geometry.h"
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 
 using namespace std;
 
-ConvexHull::ConvexHull(int i) {
+MERTPointPool::~MERTPointPool() {
+  for (unsigned i = 0; i < chunks_.size(); ++i)
+    delete[] chunks_[i];
+}
+
+namespace {
+
+struct SlopeCompare {
+  bool operator() (const MERTPoint* a, const MERTPoint* b) const {
+    return a->m < b->m;
+  }
+};
+
+// adds the line p to the upper envelope (*env)[start, env->size()), all of
+// whose lines have a slope that is not larger than p's, and sets p->x if it
+// becomes part of it
+void PushSegment(MERTPoint* p, size_t start, vector<MERTPoint*>* env) {
+  double x = kMinusInfinity;
+  if (env->size() > start) {
+    if (env->back()->m == p->m) {   // lines are parallel
+      if (p->b <= env->back()->b) return;
+      env->pop_back();
+    }
+    while (env->size() > start) {
+      const MERTPoint& prev = *env->back();
+      x = (p->b - prev.b) / (prev.m - p->m);
+      if (prev.x < x) break;
+      env->pop_back();
+    }
+    if (env->size() == start) x = kMinusInfinity;
+  }
+  p->x = x;
+  env->push_back(p);
+}
+
+// appends the upper envelope of the envelopes [a, a_end) and [b, b_end) to
+// env in time linear in their sizes
+void MergeEnvelopes(vector<MERTPoint*>::const_iterator a,
+                    vector<MERTPoint*>::const_iterator a_end,
+                    vector<MERTPoint*>::const_iterator b,
+                    vector<MERTPoint*>::const_iterator b_end,
+                    vector<MERTPoint*>* env) {
+  const size_t start = env->size();
+  while (a != a_end && b != b_end) {
+    if ((*b)->m < (*a)->m)
+      PushSegment(*b++, start, env);
+    else
+      PushSegment(*a++, start, env);
+  }
+  for (; a != a_end; ++a) PushSegment(*a, start, env);
+  for (; b != b_end; ++b) PushSegment(*b, start, env);
+}
+
+}
+
+ConvexHull::ConvexHull(int i) : is_sorted(true) {
   if (i == 0) {
     // do nothing - <>
   } else if (i == 1) {
-    points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(0, 0, 0, boost::shared_ptr<MERTPoint>(), boost::shared_ptr<MERTPoint>())));
+    pool.reset(new MERTPointPool);
+    points.push_back(pool->Create(MERTPoint(0, 0, 0, NULL, NULL)));
     assert(this->IsMultiplicativeIdentity());
   } else {
     cerr << "Only can create ConvexHull semiring 0 and 1 with this constructor!\n";
@@ -17,68 +74,72 @@ ConvexHull::ConvexHull(int i) {
   }
 }
 
+ConvexHull::ConvexHull(const boost::shared_ptr<MERTPointPool>& p, const vector<MERTPoint*>& s) : is_sorted(true), pool(p) {
+  vector<MERTPoint*> sorted(s);
+  stable_sort(sorted.begin(), sorted.end(), SlopeCompare());
+  for (unsigned i = 0; i < sorted.size(); ++i)
+    PushSegment(sorted[i], 0, &points);
+}
+
 const ConvexHull ConvexHullWeightFunction::operator()(const Hypergraph::Edge& e) const {
   const double m = direction.dot(e.feature_values_);
   const double b = origin.dot(e.feature_values_);
-  MERTPoint* point = new MERTPoint(m, b, e);
-  return ConvexHull(1, point);
+  return ConvexHull(pool, pool->Create(MERTPoint(m, b, e)));
 }
 
 ostream& operator<<(ostream& os, const ConvexHull& env) {
   os << '<';
-  const vector<boost::shared_ptr<MERTPoint> >& points = env.GetSortedSegs();
+  const vector<MERTPoint*>& points = env.GetSortedSegs();
   for (int i = 0; i < points.size(); ++i)
     os << (i==0 ? "" : "|") << "x=" << points[i]->x << ",b=" << points[i]->b << ",m=" << points[i]->m << ",p1=" << points[i]->p1 << ",p2=" << points[i]->p2;
   return os << '>';
 }
 
-#define ORIGINAL_MERT_IMPLEMENTATION 1
-#ifdef ORIGINAL_MERT_IMPLEMENTATION
-
-struct SlopeCompare {
-  bool operator() (const boost::shared_ptr<MERTPoint>& a, const boost::shared_ptr<MERTPoint>& b) const {
-    return a->m < b->m;
-  }
-};
-
+// the envelopes are only appended here; Sort() merges them when the result
+// is needed
 const ConvexHull& ConvexHull::operator+=(const ConvexHull& other) {
+  if (other.points.empty()) return *this;
   if (!other.is_sorted) other.Sort();
+  assert(!pool || !other.pool || pool == other.pool);
+  if (!pool) pool = other.pool;
   if (points.empty()) {
     points = other.points;
     return *this;
   }
-  is_sorted = false;
-  int j = points.size();
-  points.resize(points.size() + other.points.size());
-  for (int i = 0; i < other.points.size(); ++i)
-    points[j++] = other.points[i];
-  assert(j == points.size());
+  if (is_sorted) {
+    runs.assign(1, 0);
+    is_sorted = false;
+  }
+  runs.push_back(points.size());
+  points.insert(points.end(), other.points.begin(), other.points.end());
   return *this;
 }
 
+// merges the envelopes pairwise, so every segment takes part in at most
+// log2(runs.size()) linear-time merges and the segments that are not on the
+// upper envelope of a pair are discarded early
 void ConvexHull::Sort() const {
-  sort(points.begin(), points.end(), SlopeCompare());
-  const int k = points.size();
-  int j = 0;
-  for (int i = 0; i < k; ++i) {
-    MERTPoint l = *points[i];
-    l.x = kMinusInfinity;
-    // cerr << "m=" << l.m << endl;
-    if (0 < j) {
-      if (points[j-1]->m == l.m) {   // lines are parallel
-        if (l.b <= points[j-1]->b) continue;
-        --j;
-      }
-      while(0 < j) {
-        l.x = (l.b - points[j-1]->b) / (points[j-1]->m - l.m);
-        if (points[j-1]->x < l.x) break;
-        --j;
+  vector<MERTPoint*> merged;
+  vector<unsigned> merged_runs;
+  while (runs.size() > 1) {
+    merged.clear();
+    merged_runs.clear();
+    runs.push_back(points.size());
+    const unsigned num_runs = runs.size() - 1;
+    for (unsigned r = 0; r < num_runs; r += 2) {
+      merged_runs.push_back(merged.size());
+      if (r + 1 == num_runs) {
+        merged.insert(merged.end(), points.begin() + runs[r], points.end());
+      } else {
+        MergeEnvelopes(points.begin() + runs[r], points.begin() + runs[r + 1],
+                       points.begin() + runs[r + 1], points.begin() + runs[r + 2],
+                       &merged);
       }
-      if (0 == j) l.x = kMinusInfinity;
     }
-    *points[j++] = l;
+    points.swap(merged);
+    runs.swap(merged_runs);
   }
-  points.resize(j);
+  runs.clear();
   is_sorted = true;
 }
 
@@ -88,30 +149,33 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
 
   if (!is_sorted) Sort();
   if (!other.is_sorted) other.Sort();
+  assert(!pool || !other.pool || pool == other.pool);
+  if (!pool) pool = other.pool;
 
   if (this->IsEdgeEnvelope()) {
 //    if (other.size() > 1)
 //      cerr << *this << " (TIMES) " << other << endl;
-    boost::shared_ptr<MERTPoint> edge_parent = points[0];
-    const double& edge_b = edge_parent->b;
-    const double& edge_m = edge_parent->m;
-    points.clear();
+    const MERTPoint* edge_parent = points[0];
+    const double edge_b = edge_parent->b;
+    const double edge_m = edge_parent->m;
+    points.resize(other.points.size());
     for (int i = 0; i < other.points.size(); ++i) {
       const MERTPoint& p = *other.points[i];
       const double m = p.m + edge_m;
       const double b = p.b + edge_b;
       const double& x = p.x;       // x's don't change with *
-      points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(x, m, b, edge_parent, other.points[i])));
-      assert(points.back()->p1->edge);
+      points[i] = pool->Create(MERTPoint(x, m, b, edge_parent, other.points[i]));
+      assert(points[i]->p1->edge);
     }
 //    if (other.size() > 1)
 //      cerr << " = " << *this << endl;
   } else {
-    vector<boost::shared_ptr<MERTPoint> > new_points;
+    vector<MERTPoint*> new_points;
     int this_i = 0;
     int other_i = 0;
     const int this_size  = points.size();
     const int other_size = other.points.size();
+    new_points.reserve(this_size + other_size);
     double cur_x = kMinusInfinity;   // moves from left to right across the
                                      // real numbers, stopping for all inter-
                                      // sections
@@ -123,7 +187,7 @@ const ConvexHull& ConvexHull::operator*=(const ConvexHull& other) {
       const double m = this_point.m + other_point.m;
       const double b = this_point.b + other_point.b;
  
-      new_points.push_back(boost::shared_ptr<MERTPoint>(new MERTPoint(cur_x, m, b, points[this_i], other.points[other_i])));
+      new_points.push_back(pool->Create(MERTPoint(cur_x, m, b, points[this_i], other.points[other_i])));
       int comp = 0;
       if (this_next_val < other_next_val) comp = -1; else
         if (this_next_val > other_next_val) comp = 1;
@@ -158,7 +222,7 @@ void MERTPoint::ConstructTranslation(vector<WordID>* trans) const {
   while(!cur->edge) {
     ant_trans.resize(ant_trans.size() + 1);
     cur->p2->ConstructTranslation(&ant_trans.back());
-    cur = cur->p1.get();
+    cur = cur->p1;
   }
   size_t ant_size = ant_trans.size();
   vector<const vector<WordID>*> pants(ant_size);
@@ -176,10 +240,3 @@ void MERTPoint::CollectEdgesUsed(std::vector<bool>* edges_used) const {
   if (p1) p1->CollectEdgesUsed(edges_used);
   if (p2) p2->CollectEdgesUsed(edges_used);
 }
-
-#else
-
-// THIS IS THE NEW FASTER IMPLEMENTATION OF THE MERT SEMIRING OPERATIONS
-
-#endif
-
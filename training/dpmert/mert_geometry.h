@@ -12,22 +12,23 @@ static const double kMinusInfinity = -std::numeric_limits<double>::infinity();
 static const double kPlusInfinity = std::numeric_limits<double>::infinity();
 
 struct MERTPoint {
-  MERTPoint() : x(), m(), b(), edge() {}
+  MERTPoint() : x(), m(), b(), p1(), p2(), edge() {}
   MERTPoint(double _m, double _b) :
-    x(kMinusInfinity), m(_m), b(_b), edge() {}
-  MERTPoint(double _x, double _m, double _b, const boost::shared_ptr<MERTPoint>& p1_, const boost::shared_ptr<MERTPoint>& p2_) :
+    x(kMinusInfinity), m(_m), b(_b), p1(), p2(), edge() {}
+  MERTPoint(double _x, double _m, double _b, const MERTPoint* p1_, const MERTPoint* p2_) :
     x(_x), m(_m), b(_b), p1(p1_), p2(p2_), edge() {}
   MERTPoint(double _m, double _b, const Hypergraph::Edge& edge) :
-    x(kMinusInfinity), m(_m), b(_b), edge(&edge) {}
+    x(kMinusInfinity), m(_m), b(_b), p1(), p2(), edge(&edge) {}
 
   double x;                   // x intersection with previous segment in env, or -inf if none
   double m;                   // this line's slope
   double b;                   // intercept with y-axis
 
   // we keep a pointer to the "parents" of this segment so we can reconstruct
-  // the Viterbi translation corresponding to this segment
-  boost::shared_ptr<MERTPoint> p1;
-  boost::shared_ptr<MERTPoint> p2;
+  // the Viterbi translation corresponding to this segment; they are owned by
+  // the MERTPointPool this segment was allocated from
+  const MERTPoint* p1;
+  const MERTPoint* p2;
 
   // only MERTPoints created from an edge using the ConvexHullWeightFunction
   // have rules
@@ -41,21 +42,49 @@ struct MERTPoint {
   void CollectEdgesUsed(std::vector<bool>* edges_used) const;
 };
 
+// allocates the MERTPoints of the hulls computed over one forest in large
+// chunks; they are all freed together when the last ConvexHull (or
+// ConvexHullWeightFunction) referring to the pool goes away
+class MERTPointPool {
+ public:
+  MERTPointPool() : used_(kChunkSize) {}
+  ~MERTPointPool();
+  MERTPoint* Create(const MERTPoint& p) {
+    if (used_ == kChunkSize) {
+      chunks_.push_back(new MERTPoint[kChunkSize]);
+      used_ = 0;
+    }
+    MERTPoint* res = &chunks_.back()[used_++];
+    *res = p;
+    return res;
+  }
+  size_t size() const { return chunks_.size() * kChunkSize - (kChunkSize - used_); }
+
+ private:
+  MERTPointPool(const MERTPointPool&);
+  void operator=(const MERTPointPool&);
+  static const unsigned kChunkSize = 4096;
+  std::vector<MERTPoint*> chunks_;
+  unsigned used_;
+};
+
 // this is the semiring value type,
 // it defines constructors for 0, 1, and the operations + and *
+// All hulls that are combined must share one MERTPointPool (the one of the
+// ConvexHullWeightFunction that created their edge hulls).
 struct ConvexHull {
   // create semiring zero
   ConvexHull() : is_sorted(true) {}  // zero
   // for debugging:
-  ConvexHull(const std::vector<boost::shared_ptr<MERTPoint> >& s) : points(s) { Sort(); }
+  ConvexHull(const boost::shared_ptr<MERTPointPool>& p, const std::vector<MERTPoint*>& s);
   // create semiring 1 or 0
   explicit ConvexHull(int i);
-  ConvexHull(int n, MERTPoint* point) : is_sorted(true), points(n, boost::shared_ptr<MERTPoint>(point)) {}
+  ConvexHull(const boost::shared_ptr<MERTPointPool>& p, MERTPoint* point) : is_sorted(true), pool(p), points(1, point) {}
   const ConvexHull& operator+=(const ConvexHull& other);
   const ConvexHull& operator*=(const ConvexHull& other);
   bool IsMultiplicativeIdentity() const {
     return size() == 1 && (points[0]->b == 0.0 && points[0]->m == 0.0) && (!points[0]->edge) && (!points[0]->p1) && (!points[0]->p2); }
-  const std::vector<boost::shared_ptr<MERTPoint> >& GetSortedSegs() const {
+  const std::vector<MERTPoint*>& GetSortedSegs() const {
     if (!is_sorted) Sort();
     return points;
   }
@@ -64,18 +93,24 @@ struct ConvexHull {
  private:
   bool IsEdgeEnvelope() const {
     return points.size() == 1 && points[0]->edge; }
+  // merges the envelopes accumulated by operator+=
   void Sort() const;
   mutable bool is_sorted;
-  mutable std::vector<boost::shared_ptr<MERTPoint> > points;
+  boost::shared_ptr<MERTPointPool> pool;
+  // if !is_sorted, points holds the (sorted) envelopes that were added, the
+  // i-th of which starts at runs[i]
+  mutable std::vector<MERTPoint*> points;
+  mutable std::vector<unsigned> runs;
 };
 std::ostream& operator<<(std::ostream& os, const ConvexHull& env);
 
 struct ConvexHullWeightFunction {
   ConvexHullWeightFunction(const SparseVector<double>& ori,
-                           const SparseVector<double>& dir) : origin(ori), direction(dir) {}
+                           const SparseVector<double>& dir) : origin(ori), direction(dir), pool(new MERTPointPool) {}
   const ConvexHull operator()(const Hypergraph::Edge& e) const;
   const SparseVector<double> origin;
   const SparseVector<double> direction;
+  const boost::shared_ptr<MERTPointPool> pool;
 };
 
 #endif
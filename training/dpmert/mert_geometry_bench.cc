@@ -0,0 +1,66 @@
+// measures the throughput of the convex hull (Viterbi envelope) computation
+// of mr_dpmert_map on the forests in test_data:
+//   mert_geometry_bench [path-to-test_data] [number of random directions]
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include "fdict.h"
+#include "filelib.h"
+#include "hg.h"
+#include "hg_io.h"
+#include "inside_outside.h"
+#include "line_optimizer.h"
+#include "mert_geometry.h"
+
+using namespace std;
+
+int main(int argc, char** argv) {
+  const string path(argc > 1 ? argv[1] : TEST_DATA);
+  const int num_random = argc > 2 ? boost::lexical_cast<int>(argv[2]) : 200;
+
+  SparseVector<double> wts;
+  wts.set_value(FD::Convert("WordPenalty"), 4.25);
+  wts.set_value(FD::Convert("LanguageModel"), -1.1165);
+  wts.set_value(FD::Convert("PhraseModel_0"), -0.96);
+  wts.set_value(FD::Convert("PhraseModel_1"), -0.65);
+  wts.set_value(FD::Convert("PhraseModel_2"), -0.77);
+  wts.set_value(FD::Convert("PassThrough"), -10.0);
+  vector<int> to_optimize;
+  to_optimize.push_back(FD::Convert("WordPenalty"));
+  to_optimize.push_back(FD::Convert("LanguageModel"));
+  to_optimize.push_back(FD::Convert("PhraseModel_0"));
+  to_optimize.push_back(FD::Convert("PhraseModel_1"));
+  to_optimize.push_back(FD::Convert("PhraseModel_2"));
+
+  RandomNumberGenerator<boost::mt19937> rng(1);  // the same directions in every run
+  vector<SparseVector<double> > axes;
+  LineOptimizer::CreateOptimizationDirections(to_optimize, num_random, &rng, &axes);
+
+  const char* forests[] = { "0.json.gz", "1.json.gz" };
+  for (unsigned f = 0; f < 2; ++f) {
+    Hypergraph hg;
+    ReadFile rf(path + "/" + forests[f]);
+    HypergraphIO::ReadFromJSON(rf.stream(), &hg);
+    size_t segments = 0;
+    size_t points = 0;
+    const clock_t t_start = clock();
+    for (unsigned i = 0; i < axes.size(); ++i) {
+      const ConvexHullWeightFunction wf(wts, axes[i]);
+      const ConvexHull env = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
+      segments += env.GetSortedSegs().size();
+      points += wf.pool->size();
+    }
+    const double secs = static_cast<double>(clock() - t_start) / CLOCKS_PER_SEC;
+    cout << forests[f] << ": " << hg.nodes_.size() << " nodes, " << hg.edges_.size() << " edges, "
+         << axes.size() << " directions" << endl
+         << "  segments per envelope: " << static_cast<double>(segments) / axes.size()
+         << ", points allocated per envelope: " << static_cast<double>(points) / axes.size() << endl
+         << "  " << secs << " s, " << (secs > 0 ? axes.size() / secs : 0) << " envelopes/s, "
+         << (secs > 0 ? axes.size() * hg.edges_.size() / secs : 0) << " edges/s" << endl;
+  }
+  return 0;
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -28,6 +29,7 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("source,s",po::value<string>(), "Source file (ignored, except for AER)")
         ("evaluation_metric,m",po::value<string>()->default_value("ibm_bleu"), "Evaluation metric being optimized")
         ("input,i",po::value<string>()->default_value("-"), "Input file to map (- is STDIN)")
+        ("jobs,j",po::value<int>()->default_value(1), "Number of threads used to compute the convex hulls of the search directions of each forest")
         ("help,h", "Help");
   po::options_description dcmdline_options;
   dcmdline_options.add(opts);
@@ -65,6 +67,50 @@ bool ReadSparseVectorString(const string& s, SparseVector<double>* v) {
 #endif
 }
 
+struct MapperInput {
+  int sent_id;
+  string s_origin;
+  string s_direction;
+  SparseVector<double> origin;
+  SparseVector<double> direction;
+};
+
+// computes the error surfaces for all the lines (origin and direction) that
+// refer to the forest hg. The forest is only read, so the convex hulls of up
+// to jobs directions are computed in parallel; the error surfaces are then
+// computed in order since the segment evaluators are not thread safe. A hull
+// keeps the back-pointers of all its segments alive, so only jobs of them
+// exist at a time.
+void MapForest(const Hypergraph& hg,
+               const vector<MapperInput>& lines,
+               const DocumentScorer& ds,
+               const EvaluationMetric* metric,
+               int jobs) {
+  vector<ConvexHull> hulls(jobs);
+  for (unsigned first = 0; first < lines.size(); first += jobs) {
+    const int n = min<int>(jobs, lines.size() - first);
+#pragma omp parallel for schedule(dynamic) num_threads(jobs)
+    for (int i = 0; i < n; ++i) {
+      const MapperInput& line = lines[first + i];
+      const ConvexHullWeightFunction wf(line.origin, line.direction);
+      hulls[i] = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
+    }
+    for (int i = 0; i < n; ++i) {
+      const MapperInput& line = lines[first + i];
+      ErrorSurface es;
+      ComputeErrorSurface(*ds[line.sent_id], hulls[i], &es, metric, hg);
+      hulls[i] = ConvexHull();
+      //cerr << "Viterbi envelope has " << ve.size() << " segments\n";
+      // cerr << "Error surface has " << es.size() << " segments\n";
+      string val;
+      es.Serialize(&val);
+      cout << 'M' << ' ' << line.s_origin << ' ' << line.s_direction << '\t';
+      B64::b64encode(val.c_str(), val.size(), &cout);
+      cout << endl << flush;
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
@@ -72,41 +118,34 @@ int main(int argc, char** argv) {
   EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
   DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
   cerr << "Loaded " << ds.size() << " references for scoring with " << evaluation_metric << endl;
+  const int jobs = max(1, conf["jobs"].as<int>());
   Hypergraph hg;
   string last_file;
+  // consecutive lines that refer to the same forest (the mapper input lists
+  // all search directions of a sentence together) are mapped as one batch
+  vector<MapperInput> lines;
   ReadFile in_read(conf["input"].as<string>());
   istream &in=*in_read.stream();
-  while(in) {
-    string line;
-    getline(in, line);
+  string line;
+  while(getline(in, line)) {
     if (line.empty()) continue;
     istringstream is(line);
-    int sent_id;
-    string file, s_origin, s_direction;
+    MapperInput cur;
+    string file;
     // path-to-file (JSON) sent_ed starting-point search-direction
-    is >> file >> sent_id >> s_origin >> s_direction;
-    SparseVector<double> origin;
-    ReadSparseVectorString(s_origin, &origin);
-    SparseVector<double> direction;
-    ReadSparseVectorString(s_direction, &direction);
-    // cerr << "File: " << file << "\nDir: " << direction << "\n   X: " << origin << endl;
+    is >> file >> cur.sent_id >> cur.s_origin >> cur.s_direction;
+    ReadSparseVectorString(cur.s_origin, &cur.origin);
+    ReadSparseVectorString(cur.s_direction, &cur.direction);
+    // cerr << "File: " << file << "\nDir: " << cur.direction << "\n   X: " << cur.origin << endl;
     if (last_file != file) {
+      MapForest(hg, lines, ds, metric, jobs);
+      lines.clear();
       last_file = file;
       ReadFile rf(file);
       HypergraphIO::ReadFromJSON(rf.stream(), &hg);
     }
-    const ConvexHullWeightFunction wf(origin, direction);
-    const ConvexHull hull = Inside<ConvexHull, ConvexHullWeightFunction>(hg, NULL, wf);
-
-    ErrorSurface es;
-    ComputeErrorSurface(*ds[sent_id], hull, &es, metric, hg);
-    //cerr << "Viterbi envelope has " << ve.size() << " segments\n";
-    // cerr << "Error surface has " << es.size() << " segments\n";
-    string val;
-    es.Serialize(&val);
-    cout << 'M' << ' ' << s_origin << ' ' << s_direction << '\t';
-    B64::b64encode(val.c_str(), val.size(), &cout);
-    cout << endl << flush;
+    lines.push_back(cur);
   }
+  MapForest(hg, lines, ds, metric, jobs);
   return 0;
 }
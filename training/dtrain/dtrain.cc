@@ -45,7 +45,11 @@ dtrain_init(int argc, char** argv, po::variables_map* cfg)
     ("batch",             po::value<bool>()->zero_tokens(),                                               "do batch optimization")
     ("repeat",            po::value<unsigned>()->default_value(1),          "repeat optimization over kbest list this number of times")
     ("check",             po::value<bool>()->zero_tokens(),                                  "produce list of loss differentials")
-    ("noup",              po::value<bool>()->zero_tokens(),                                               "do not update weights");
+    ("noup",              po::value<bool>()->zero_tokens(),                                               "do not update weights")
+    ("threads",           po::value<unsigned>()->default_value(1),     "train on this many shards of the input in parallel")
+    ("mix_every",         po::value<unsigned>()->default_value(0),  "mix shard weights after X inputs per shard (0: epoch)")
+    ("mix_select_k",      po::value<unsigned>()->default_value(0),   "keep top k features (by norm over shards) when mixing")
+    ("mix_norm",          po::value<string>()->default_value("l2"),          "norm for mix_select_k: 'l0', 'l1', 'l2', 'linfty'");
   po::options_description cl("Command Line Options");
   cl.add_options()
     ("config,c",         po::value<string>(),              "dtrain config file")
@@ -97,9 +101,340 @@ dtrain_init(int argc, char** argv, po::variables_map* cfg)
     cerr << "Wrong 'select_weights' param: '" << (*cfg)["select_weights"].as<string>() << "', use 'last' or 'best'." << endl;
     return false;
   }
+  if ((*cfg)["threads"].as<unsigned>() == 0) {
+    cerr << "The number of threads must be > 0!" << endl;
+    return false;
+  }
+  if ((*cfg)["threads"].as<unsigned>() > 1 && (cfg->count("check") || cfg->count("verbose"))) {
+    cerr << "'check' and 'verbose' only work with a single thread." << endl;
+    return false;
+  }
+  if ((*cfg)["mix_norm"].as<string>() != "l0" && (*cfg)["mix_norm"].as<string>() != "l1" &&
+        (*cfg)["mix_norm"].as<string>() != "l2" && (*cfg)["mix_norm"].as<string>() != "linfty") {
+    cerr << "Wrong 'mix_norm' param: '" << (*cfg)["mix_norm"].as<string>() << "', use 'l0', 'l1', 'l2' or 'linfty'." << endl;
+    return false;
+  }
   return true;
 }
 
+LocalScorer*
+make_scorer(const string& scorer_str, const unsigned N, const score_t approx_bleu_d)
+{
+  LocalScorer* scorer = 0;
+  if (scorer_str == "bleu") {
+    scorer = static_cast<BleuScorer*>(new BleuScorer);
+  } else if (scorer_str == "stupid_bleu") {
+    scorer = static_cast<StupidBleuScorer*>(new StupidBleuScorer);
+  } else if (scorer_str == "fixed_stupid_bleu") {
+    scorer = static_cast<FixedStupidBleuScorer*>(new FixedStupidBleuScorer);
+  } else if (scorer_str == "smooth_bleu") {
+    scorer = static_cast<SmoothBleuScorer*>(new SmoothBleuScorer);
+  } else if (scorer_str == "sum_bleu") {
+    scorer = static_cast<SumBleuScorer*>(new SumBleuScorer);
+  } else if (scorer_str == "sumexp_bleu") {
+    scorer = static_cast<SumExpBleuScorer*>(new SumExpBleuScorer);
+  } else if (scorer_str == "sumwhatever_bleu") {
+    scorer = static_cast<SumWhateverBleuScorer*>(new SumWhateverBleuScorer);
+  } else if (scorer_str == "approx_bleu") {
+    scorer = static_cast<ApproxBleuScorer*>(new ApproxBleuScorer(N, approx_bleu_d));
+  } else if (scorer_str == "lc_bleu") {
+    scorer = static_cast<LinearBleuScorer*>(new LinearBleuScorer(N));
+  }
+  return scorer;
+}
+
+// settings of the learner, shared by all shards
+struct LearnParams
+{
+  bool verbose, noup, rescale, check, batch, scale_bleu_diff, faster_perceptron;
+  bool l1naive, l1clip, l1cumul;
+  string pair_sampling, pclr;
+  score_t pair_threshold;
+  float hi_lo;
+  unsigned max_pairs;
+  int repeat;
+  weight_t gamma, loss_margin, l1_reg;
+};
+
+// a shard of the input, learned with its own decoder, sampler and weights;
+// with threads > 1 the shards are learned in parallel and their weights
+// are mixed after each epoch (or every mix_every inputs)
+struct Shard
+{
+  boost::shared_ptr<Decoder> decoder;
+  LocalScorer* scorer;
+  MT19937* rng; // only for forest sampling
+  HypSampler* observer;
+  vector<unsigned> inputs;
+  SparseVector<weight_t> lambdas, cumulative_penalties, learning_rates, batch_updates;
+  weight_t eta;
+  // stats of the current epoch
+  score_t score_sum, model_sum, batch_loss;
+  unsigned ii, rank_errors, margin_violations, npairs, f_count, list_sz, kbest_loss_improve;
+
+  void
+  reset_stats()
+  {
+    score_sum = model_sum = batch_loss = 0.;
+    ii = rank_errors = margin_violations = npairs = f_count = list_sz = kbest_loss_improve = 0;
+  }
+};
+
+inline void
+progress(const unsigned ii)
+{
+  if (ii % (20*DTRAIN_DOTS) == 0) cerr << " ";
+  if ((ii+1) % (DTRAIN_DOTS) == 0) {
+    cerr << ".";
+    cerr.flush();
+  }
+  if ((ii+1) % (20*DTRAIN_DOTS) == 0) cerr << " " << ii+1 << endl;
+}
+
+// decode one input and update the weights of the shard
+void
+learn(Shard& sh, const string& in, vector<WordID>& ref_ids, const LearnParams& p)
+{
+  const unsigned ii = sh.ii;
+  SparseVector<weight_t>& lambdas = sh.lambdas;
+  SparseVector<weight_t>& learning_rates = sh.learning_rates;
+  SparseVector<weight_t>& cumulative_penalties = sh.cumulative_penalties;
+  weight_t& eta = sh.eta;
+  const int repeat = p.repeat;
+
+  // weights
+  lambdas.init_vector(&sh.decoder->CurrentWeightVector());
+
+  sh.observer->SetRef(ref_ids);
+  sh.decoder->Decode(in, sh.observer);
+
+  // get (scored) samples
+  vector<ScoredHyp>* samples = sh.observer->GetSamples();
+
+  if (p.verbose) {
+    cerr << "--- ref for " << ii << ": ";
+    printWordIDVec(ref_ids);
+    cerr << endl;
+    for (unsigned u = 0; u < samples->size(); u++) {
+      cerr << _p2 << _np << "[" << u << ". '";
+      printWordIDVec((*samples)[u].w);
+      cerr << "'" << endl;
+      cerr << "SCORE=" << (*samples)[u].score << ",model="<< (*samples)[u].model << endl;
+      cerr << "F{" << (*samples)[u].f << "} ]" << endl << endl;
+    }
+  }
+
+  if (repeat == 1) {
+    sh.score_sum += (*samples)[0].score; // stats for 1best
+    sh.model_sum += (*samples)[0].model;
+  }
+
+  sh.f_count += sh.observer->get_f_count();
+  sh.list_sz += sh.observer->get_sz();
+
+  // weight updates
+  if (!p.noup) {
+    // get pairs
+    vector<pair<ScoredHyp,ScoredHyp> > pairs;
+    if (p.pair_sampling == "all")
+      all_pairs(samples, pairs, p.pair_threshold, p.max_pairs, p.faster_perceptron);
+    if (p.pair_sampling == "XYX")
+      partXYX(samples, pairs, p.pair_threshold, p.max_pairs, p.faster_perceptron, p.hi_lo);
+    if (p.pair_sampling == "PRO")
+      PROsampling(samples, pairs, p.pair_threshold, p.max_pairs);
+    int cur_npairs = pairs.size();
+    sh.npairs += cur_npairs;
+
+    score_t kbest_loss_first = 0.0, kbest_loss_last = 0.0;
+
+    vector<float> losses; // for check
+
+    for (vector<pair<ScoredHyp,ScoredHyp> >::iterator it = pairs.begin();
+         it != pairs.end(); it++) {
+      score_t model_diff = it->first.model - it->second.model;
+      score_t loss = max(0.0, -1.0 * model_diff);
+      losses.push_back(loss);
+      kbest_loss_first += loss;
+    }
+
+    score_t kbest_loss = 0.0;
+    for (int ki=0; ki < repeat; ki++) {
+
+    SparseVector<weight_t> lambdas_copy; // for l1 regularization
+    SparseVector<weight_t> sum_up; // for pclr
+    if (p.l1naive||p.l1clip||p.l1cumul) lambdas_copy = lambdas;
+
+    unsigned pair_idx = 0; // for check
+    for (vector<pair<ScoredHyp,ScoredHyp> >::iterator it = pairs.begin();
+         it != pairs.end(); it++) {
+      score_t model_diff = it->first.model - it->second.model;
+      score_t loss = max(0.0, -1.0 * model_diff);
+
+      if (p.check && ki==repeat-1) cout << losses[pair_idx] - loss << endl;
+      pair_idx++;
+
+      if (repeat > 1) {
+        model_diff = lambdas.dot(it->first.f) - lambdas.dot(it->second.f);
+        kbest_loss += loss;
+      }
+      bool rank_error = false;
+      score_t margin;
+      if (p.faster_perceptron) { // we only have considering misranked pairs
+        rank_error = true; // pair sampling already did this for us
+        margin = std::numeric_limits<float>::max();
+      } else {
+        rank_error = model_diff<=0.0;
+        margin = fabs(model_diff);
+        if (!rank_error && margin < p.loss_margin) sh.margin_violations++;
+      }
+      if (rank_error && ki==0) sh.rank_errors++;
+      if (p.scale_bleu_diff) eta = it->first.score - it->second.score;
+      if (rank_error || margin < p.loss_margin) {
+        SparseVector<weight_t> diff_vec = it->first.f - it->second.f;
+        if (p.batch) {
+          sh.batch_loss += max(0., -1.0 * model_diff);
+          sh.batch_updates += diff_vec;
+          continue;
+        }
+        if (p.pclr != "no") {
+          sum_up += diff_vec;
+        } else {
+          lambdas.plus_eq_v_times_s(diff_vec, eta);
+          if (p.gamma) lambdas.plus_eq_v_times_s(lambdas, -2*p.gamma*eta*(1./cur_npairs));
+        }
+      }
+    }
+
+    // per-coordinate learning rate
+    if (p.pclr != "no") {
+      SparseVector<weight_t>::iterator it = sum_up.begin();
+      for (; it != sum_up.end(); ++it) {
+        if (p.pclr == "simple") {
+         lambdas[it->first] += it->second / max(1.0, learning_rates[it->first]);
+         learning_rates[it->first]++;
+        } else if (p.pclr == "adagrad") {
+          if (learning_rates[it->first] == 0) {
+           lambdas[it->first] +=  it->second * eta;
+          } else {
+           lambdas[it->first] +=  it->second * eta * learning_rates[it->first];
+          }
+          learning_rates[it->first] += pow(it->second, 2.0);
+        }
+      }
+    }
+
+    // l1 regularization
+    // please note that this regularizations happen
+    // after a _sentence_ -- not after each example/pair!
+    if (p.l1naive) {
+      SparseVector<weight_t>::iterator it = lambdas.begin();
+      for (; it != lambdas.end(); ++it) {
+        if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
+            it->second *= max(0.0000001, eta/(eta+learning_rates[it->first])); // FIXME
+            learning_rates[it->first]++;
+          it->second -= sign(it->second) * p.l1_reg;
+        }
+      }
+    } else if (p.l1clip) {
+      SparseVector<weight_t>::iterator it = lambdas.begin();
+      for (; it != lambdas.end(); ++it) {
+        if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
+          if (it->second != 0) {
+            weight_t v = it->second;
+            if (v > 0) {
+              it->second = max(0., v - p.l1_reg);
+            } else {
+              it->second = min(0., v + p.l1_reg);
+            }
+          }
+        }
+      }
+    } else if (p.l1cumul) {
+      weight_t acc_penalty = (ii+1) * p.l1_reg; // ii is the index of the current input
+      SparseVector<weight_t>::iterator it = lambdas.begin();
+      for (; it != lambdas.end(); ++it) {
+        if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
+          if (it->second != 0) {
+            weight_t v = it->second;
+            weight_t penalized = 0.;
+            if (v > 0) {
+              penalized = max(0., v-(acc_penalty + cumulative_penalties.get(it->first)));
+            } else {
+              penalized = min(0., v+(acc_penalty - cumulative_penalties.get(it->first)));
+            }
+            it->second = penalized;
+            cumulative_penalties.set_value(it->first, cumulative_penalties.get(it->first)+penalized);
+          }
+        }
+      }
+    }
+
+    if (ki==repeat-1) { // done
+      kbest_loss_last = kbest_loss;
+      if (repeat > 1) {
+        score_t best_model = -std::numeric_limits<score_t>::max();
+        unsigned best_idx = 0;
+        for (unsigned i=0; i < samples->size(); i++) {
+          score_t s = lambdas.dot((*samples)[i].f);
+          if (s > best_model) {
+            best_idx = i;
+            best_model = s;
+          }
+        }
+        sh.score_sum += (*samples)[best_idx].score;
+        sh.model_sum += best_model;
+      }
+    }
+  } // repeat
+
+  if ((kbest_loss_first - kbest_loss_last) >= 0) sh.kbest_loss_improve++;
+
+  } // noup
+
+  if (p.rescale) lambdas /= lambdas.l2norm();
+
+  ++sh.ii;
+}
+
+// mix the weights of the shards (iterative parameter mixing): average them,
+// keeping only the select_k features with the largest norm of their weights
+// over the shards if select_k > 0 (like lplp.rb)
+void
+mix_weights(vector<Shard>& shards, const unsigned select_k, const string& norm)
+{
+  SparseVector<weight_t> sum, col_norm;
+  for (unsigned s = 0; s < shards.size(); s++) {
+    SparseVector<weight_t>::iterator it = shards[s].lambdas.begin();
+    for (; it != shards[s].lambdas.end(); ++it) {
+      const weight_t v = it->second;
+      if (v == 0) continue;
+      sum[it->first] += v;
+      if (norm == "l0")
+        col_norm[it->first] += 1;
+      else if (norm == "l1")
+        col_norm[it->first] += fabs(v);
+      else if (norm == "l2")
+        col_norm[it->first] += v*v; // same order as the l2 norm
+      else
+        col_norm[it->first] = max(col_norm[it->first], fabs(v));
+    }
+  }
+  SparseVector<weight_t> mixed;
+  if (select_k > 0 && sum.size() > select_k) {
+    vector<pair<weight_t, unsigned> > by_norm;
+    for (SparseVector<weight_t>::iterator it = col_norm.begin(); it != col_norm.end(); ++it)
+      by_norm.push_back(make_pair(-it->second, it->first));
+    sort(by_norm.begin(), by_norm.end());
+    for (unsigned i = 0; i < select_k; i++)
+      mixed.set_value(by_norm[i].second, sum.get(by_norm[i].second));
+  } else {
+    mixed = sum;
+  }
+  mixed /= (weight_t)shards.size();
+  for (unsigned s = 0; s < shards.size(); s++)
+    shards[s].lambdas = mixed;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -145,57 +480,57 @@ main(int argc, char** argv)
   vector<string> print_weights;
   if (cfg.count("print_weights"))
     boost::split(print_weights, cfg["print_weights"].as<string>(), boost::is_any_of(" "));
+  const unsigned num_shards = cfg["threads"].as<unsigned>();
+  const unsigned mix_every = cfg["mix_every"].as<unsigned>();
+  const unsigned mix_select_k = cfg["mix_select_k"].as<unsigned>();
+  const string mix_norm = cfg["mix_norm"].as<string>();
 
   // setup decoder
   register_feature_functions();
   SetSilent(true);
-  ReadFile ini_rf(cfg["decoder_config"].as<string>());
   if (!quiet)
     cerr << setw(25) << "cdec cfg " << "'" << cfg["decoder_config"].as<string>() << "'" << endl;
-  Decoder decoder(ini_rf.stream());
+  if (num_shards > 1) {
+    TD::SetThreadSafe();
+    FD::SetThreadSafe();
+  }
+  // every shard has its own decoder (with its own copy of the models)
+  vector<Shard> shards(num_shards);
+  for (unsigned s = 0; s < num_shards; s++) {
+    ReadFile ini_rf(cfg["decoder_config"].as<string>());
+    shards[s].decoder.reset(new Decoder(ini_rf.stream()));
+  }
 
   // scoring metric/scorer
   string scorer_str = cfg["scorer"].as<string>();
-  LocalScorer* scorer;
-  if (scorer_str == "bleu") {
-    scorer = static_cast<BleuScorer*>(new BleuScorer);
-  } else if (scorer_str == "stupid_bleu") {
-    scorer = static_cast<StupidBleuScorer*>(new StupidBleuScorer);
-  } else if (scorer_str == "fixed_stupid_bleu") {
-    scorer = static_cast<FixedStupidBleuScorer*>(new FixedStupidBleuScorer);
-  } else if (scorer_str == "smooth_bleu") {
-    scorer = static_cast<SmoothBleuScorer*>(new SmoothBleuScorer);
-  } else if (scorer_str == "sum_bleu") {
-    scorer = static_cast<SumBleuScorer*>(new SumBleuScorer);
-  } else if (scorer_str == "sumexp_bleu") {
-    scorer = static_cast<SumExpBleuScorer*>(new SumExpBleuScorer);
-  } else if (scorer_str == "sumwhatever_bleu") {
-    scorer = static_cast<SumWhateverBleuScorer*>(new SumWhateverBleuScorer);
-  } else if (scorer_str == "approx_bleu") {
-    scorer = static_cast<ApproxBleuScorer*>(new ApproxBleuScorer(N, approx_bleu_d));
-  } else if (scorer_str == "lc_bleu") {
-    scorer = static_cast<LinearBleuScorer*>(new LinearBleuScorer(N));
-  } else {
-    cerr << "Don't know scoring metric: '" << scorer_str << "', exiting." << endl;
-    exit(1);
-  }
   vector<score_t> bleu_weights;
-  scorer->Init(N, bleu_weights);
+  for (unsigned s = 0; s < num_shards; s++) {
+    shards[s].scorer = make_scorer(scorer_str, N, approx_bleu_d);
+    if (!shards[s].scorer) {
+      cerr << "Don't know scoring metric: '" << scorer_str << "', exiting." << endl;
+      exit(1);
+    }
+    shards[s].scorer->Init(N, bleu_weights);
+  }
 
   // setup decoder observer
-  MT19937 rng; // random number generator, only for forest sampling
-  HypSampler* observer;
-  if (sample_from == "kbest")
-    observer = static_cast<KBestGetter*>(new KBestGetter(k, filter_type));
-  else
-    observer = static_cast<KSampler*>(new KSampler(k, &rng));
-  observer->SetScorer(scorer);
+  for (unsigned s = 0; s < num_shards; s++) {
+    shards[s].rng = new MT19937; // random number generator, only for forest sampling
+    if (sample_from == "kbest")
+      shards[s].observer = static_cast<KBestGetter*>(new KBestGetter(k, filter_type));
+    else
+      shards[s].observer = static_cast<KSampler*>(new KSampler(k, shards[s].rng));
+    shards[s].observer->SetScorer(shards[s].scorer);
+  }
 
   // init weights
-  vector<weight_t>& decoder_weights = decoder.CurrentWeightVector();
-  SparseVector<weight_t> lambdas, cumulative_penalties, w_average;
+  vector<weight_t>& decoder_weights = shards[0].decoder->CurrentWeightVector();
+  SparseVector<weight_t>& lambdas = shards[0].lambdas;
+  SparseVector<weight_t> w_average;
   if (cfg.count("input_weights")) Weights::InitFromFile(cfg["input_weights"].as<string>(), &decoder_weights);
   Weights::InitSparseVector(decoder_weights, &lambdas);
+  for (unsigned s = 1; s < num_shards; s++)
+    shards[s].lambdas = lambdas;
 
   // meta params for perceptron, SVM
   weight_t eta = cfg["learning_rate"].as<weight_t>();
@@ -218,6 +553,29 @@ main(int argc, char** argv)
     l1_reg = cfg["l1_reg_strength"].as<weight_t>();
   }
 
+  LearnParams p;
+  p.verbose = verbose;
+  p.noup = noup;
+  p.rescale = rescale;
+  p.check = check;
+  p.batch = batch;
+  p.scale_bleu_diff = scale_bleu_diff;
+  p.faster_perceptron = faster_perceptron;
+  p.l1naive = l1naive;
+  p.l1clip = l1clip;
+  p.l1cumul = l1cumul;
+  p.pair_sampling = pair_sampling;
+  p.pclr = pclr;
+  p.pair_threshold = pair_threshold;
+  p.hi_lo = hi_lo;
+  p.max_pairs = max_pairs;
+  p.repeat = check ? 2 : repeat;
+  p.gamma = gamma;
+  p.loss_margin = loss_margin;
+  p.l1_reg = l1_reg;
+  for (unsigned s = 0; s < num_shards; s++)
+    shards[s].eta = eta;
+
   // output
   string output_fn = cfg["output"].as<string>();
   // input
@@ -230,17 +588,42 @@ main(int argc, char** argv)
     input_fn = cfg["input"].as<string>();
   }
   ReadFile input(input_fn);
-  // buffer input for t > 0
-  vector<string> src_str_buf;          // source strings (decoder takes only strings)
-  vector<vector<WordID> > ref_ids_buf; // references as WordID vecs
   ReadFile refs;
   string refs_fn;
   if (!read_bitext) {
     refs_fn = cfg["refs"].as<string>();
     refs.Init(refs_fn);
   }
+  // buffer input; the references are converted to WordID vecs in the first epoch
+  vector<string> src_str_buf;          // source strings (decoder takes only strings)
+  vector<string> ref_str_buf;
+  bool stopped = false;
+  string in, ref;
+  while (getline(*input, in)) {
+    // stop after X sentences
+    if (stop_after > 0 && src_str_buf.size() == stop_after) {
+      stopped = true;
+      break;
+    }
+    if (read_bitext) {
+      vector<string> strs;
+      boost::algorithm::split_regex(strs, in, boost::regex(" \\|\\|\\| "));
+      in = strs[0];
+      ref = strs[1];
+    } else {
+      getline(*refs, ref);
+    }
+    src_str_buf.push_back(in);
+    ref_str_buf.push_back(ref);
+  }
+  vector<vector<WordID> > ref_ids_buf(src_str_buf.size()); // references as WordID vecs
+  const unsigned in_sz = src_str_buf.size();
+  // shard s gets inputs s, s+num_shards, ...
+  for (unsigned i = 0; i < in_sz; i++)
+    shards[i % num_shards].inputs.push_back(i);
+  const unsigned shard_sz = shards[0].inputs.size(); // the largest
+  const unsigned mix_step = (mix_every > 0 && num_shards > 1) ? mix_every : max(shard_sz, 1u);
 
-  unsigned in_sz = std::numeric_limits<unsigned>::max(); // input index, input size
   vector<pair<score_t, score_t> > all_scores;
   score_t max_score = 0.;
   unsigned best_it = 0;
@@ -287,296 +670,73 @@ main(int argc, char** argv)
       cerr << setw(25) << "weights in " << "'" << cfg["input_weights"].as<string>() << "'" << endl;
     if (stop_after > 0)
       cerr << setw(25) << "stop_after " << stop_after << endl;
-    if (!verbose) cerr << "(a dot represents " << DTRAIN_DOTS << " inputs)" << endl;
+    if (num_shards > 1) {
+      cerr << setw(25) << "threads " << num_shards << endl;
+      cerr << setw(25) << "mix every " << mix_every << endl;
+      if (mix_select_k > 0)
+        cerr << setw(25) << "mix select k " << mix_select_k << " '" << mix_norm << "'" << endl;
+    }
+    if (!verbose) cerr << "(a dot represents " << DTRAIN_DOTS << " inputs" << (num_shards > 1 ? " of the first shard" : "") << ")" << endl;
   }
 
-  // pclr
-  SparseVector<weight_t> learning_rates;
-  // batch
-  SparseVector<weight_t> batch_updates;
-  score_t batch_loss;
-
   for (unsigned t = 0; t < T; t++) // T epochs
   {
 
   time_t start, end;
   time(&start);
-  score_t score_sum = 0.;
-  score_t model_sum(0);
-  unsigned ii = 0, rank_errors = 0, margin_violations = 0, npairs = 0, f_count = 0, list_sz = 0, kbest_loss_improve = 0;
-  batch_loss = 0.;
+  for (unsigned s = 0; s < num_shards; s++) shards[s].reset_stats();
   if (!quiet) cerr << "Iteration #" << t+1 << " of " << T << "." << endl;
 
-  while(true)
-  {
-
-    string in;
-    string ref;
-    bool next = false, stop = false; // next iteration or premature stop
-    if (t == 0) {
-      if(!getline(*input, in)) next = true;
-      if(read_bitext) {
-        vector<string> strs;
-        boost::algorithm::split_regex(strs, in, boost::regex(" \\|\\|\\| "));
-        in = strs[0];
-        ref = strs[1];
-      }
-    } else {
-      if (ii == in_sz) next = true; // stop if we reach the end of our input
-    }
-    // stop after X sentences (but still go on for those)
-    if (stop_after > 0 && stop_after == ii && !next) stop = true;
-
-    // produce some pretty output
-    if (!quiet && !verbose) {
-      if (ii == 0) cerr << " ";
-      if ((ii+1) % (DTRAIN_DOTS) == 0) {
-        cerr << ".";
-        cerr.flush();
-      }
-      if ((ii+1) % (20*DTRAIN_DOTS) == 0) {
-        cerr << " " << ii+1 << endl;
-        if (!next && !stop) cerr << " ";
-      }
-      if (stop) {
-        if (ii % (20*DTRAIN_DOTS) != 0) cerr << " " << ii << endl;
-        cerr << "Stopping after " << stop_after << " input sentences." << endl;
-      } else {
-        if (next) {
-          if (ii % (20*DTRAIN_DOTS) != 0) cerr << " " << ii << endl;
+  for (unsigned from = 0; from < shard_sz; from += mix_step) {
+    const unsigned to = min(from + mix_step, shard_sz);
+#pragma omp parallel for schedule(static, 1) num_threads(num_shards)
+    for (int s = 0; s < (int)num_shards; s++) {
+      Shard& sh = shards[s];
+      for (unsigned i = from; i < to && i < sh.inputs.size(); i++) {
+        // produce some pretty output
+        if (s == 0 && !quiet && !verbose) progress(sh.ii);
+        const unsigned j = sh.inputs[i];
+        if (t == 0) {
+          vector<string> ref_tok;
+          boost::split(ref_tok, ref_str_buf[j], boost::is_any_of(" "));
+          register_and_convert(ref_tok, ref_ids_buf[j]);
         }
+        learn(sh, src_str_buf[j], ref_ids_buf[j], p);
       }
     }
-
-    // next iteration
-    if (next || stop) break;
-
-    // weights
-    lambdas.init_vector(&decoder_weights);
-
-    // getting input
-    vector<WordID> ref_ids; // reference as vector<WordID>
-    if (t == 0) {
-      if (!read_bitext) {
-        getline(*refs, ref);
-      }
-      vector<string> ref_tok;
-      boost::split(ref_tok, ref, boost::is_any_of(" "));
-      register_and_convert(ref_tok, ref_ids);
-      ref_ids_buf.push_back(ref_ids);
-      src_str_buf.push_back(in);
-    } else {
-      ref_ids = ref_ids_buf[ii];
-    }
-    observer->SetRef(ref_ids);
-    if (t == 0)
-      decoder.Decode(in, observer);
-    else
-      decoder.Decode(src_str_buf[ii], observer);
-
-    // get (scored) samples
-    vector<ScoredHyp>* samples = observer->GetSamples();
-
-    if (verbose) {
-      cerr << "--- ref for " << ii << ": ";
-      if (t > 0) printWordIDVec(ref_ids_buf[ii]);
-      else printWordIDVec(ref_ids);
-      cerr << endl;
-      for (unsigned u = 0; u < samples->size(); u++) {
-        cerr << _p2 << _np << "[" << u << ". '";
-        printWordIDVec((*samples)[u].w);
-        cerr << "'" << endl;
-        cerr << "SCORE=" << (*samples)[u].score << ",model="<< (*samples)[u].model << endl;
-        cerr << "F{" << (*samples)[u].f << "} ]" << endl << endl;
-      }
-    }
-
-    if (repeat == 1) {
-      score_sum += (*samples)[0].score; // stats for 1best
-      model_sum += (*samples)[0].model;
+    if (num_shards > 1 && to < shard_sz && !noup) mix_weights(shards, mix_select_k, mix_norm);
+  }
+  if (!quiet && !verbose) {
+    if (shards[0].ii % (20*DTRAIN_DOTS) != 0) cerr << " " << shards[0].ii << endl;
+    if (t == 0 && stopped) cerr << "Stopping after " << stop_after << " input sentences." << endl;
+  }
+  if (t == 0) ref_str_buf.clear();
+
+  // sum up the stats of the shards
+  score_t score_sum = 0., model_sum = 0., batch_loss = 0.;
+  unsigned rank_errors = 0, margin_violations = 0, npairs = 0, f_count = 0, list_sz = 0, kbest_loss_improve = 0;
+  for (unsigned s = 0; s < num_shards; s++) {
+    Shard& sh = shards[s];
+    if (batch) {
+      sh.lambdas.plus_eq_v_times_s(sh.batch_updates, sh.eta);
+      if (gamma) sh.lambdas.plus_eq_v_times_s(sh.lambdas, -2*gamma*sh.eta*(1./sh.npairs));
+      sh.batch_updates.clear();
     }
-
-    f_count += observer->get_f_count();
-    list_sz += observer->get_sz();
-
-    // weight updates
-    if (!noup) {
-      // get pairs
-      vector<pair<ScoredHyp,ScoredHyp> > pairs;
-      if (pair_sampling == "all")
-        all_pairs(samples, pairs, pair_threshold, max_pairs, faster_perceptron);
-      if (pair_sampling == "XYX")
-        partXYX(samples, pairs, pair_threshold, max_pairs, faster_perceptron, hi_lo);
-      if (pair_sampling == "PRO")
-        PROsampling(samples, pairs, pair_threshold, max_pairs);
-      int cur_npairs = pairs.size();
-      npairs += cur_npairs;
-
-      score_t kbest_loss_first = 0.0, kbest_loss_last = 0.0;
-
-      if (check) repeat = 2;
-      vector<float> losses; // for check
-
-      for (vector<pair<ScoredHyp,ScoredHyp> >::iterator it = pairs.begin();
-           it != pairs.end(); it++) {
-        score_t model_diff = it->first.model - it->second.model;
-        score_t loss = max(0.0, -1.0 * model_diff);
-        losses.push_back(loss);
-        kbest_loss_first += loss;
-      }
-
-      score_t kbest_loss = 0.0;
-      for (int ki=0; ki < repeat; ki++) {
-
-      SparseVector<weight_t> lambdas_copy; // for l1 regularization
-      SparseVector<weight_t> sum_up; // for pclr
-      if (l1naive||l1clip||l1cumul) lambdas_copy = lambdas;
-
-      unsigned pair_idx = 0; // for check
-      for (vector<pair<ScoredHyp,ScoredHyp> >::iterator it = pairs.begin();
-           it != pairs.end(); it++) {
-        score_t model_diff = it->first.model - it->second.model;
-        score_t loss = max(0.0, -1.0 * model_diff);
-
-        if (check && ki==repeat-1) cout << losses[pair_idx] - loss << endl;
-        pair_idx++;
-
-        if (repeat > 1) {
-          model_diff = lambdas.dot(it->first.f) - lambdas.dot(it->second.f);
-          kbest_loss += loss;
-        }
-        bool rank_error = false;
-        score_t margin;
-        if (faster_perceptron) { // we only have considering misranked pairs
-          rank_error = true; // pair sampling already did this for us
-          margin = std::numeric_limits<float>::max();
-        } else {
-          rank_error = model_diff<=0.0;
-          margin = fabs(model_diff);
-          if (!rank_error && margin < loss_margin) margin_violations++;
-        }
-        if (rank_error && ki==0) rank_errors++;
-        if (scale_bleu_diff) eta = it->first.score - it->second.score;
-        if (rank_error || margin < loss_margin) {
-          SparseVector<weight_t> diff_vec = it->first.f - it->second.f;
-          if (batch) {
-            batch_loss += max(0., -1.0 * model_diff);
-            batch_updates += diff_vec;
-            continue;
-          }
-          if (pclr != "no") {
-            sum_up += diff_vec;
-          } else {
-            lambdas.plus_eq_v_times_s(diff_vec, eta);
-            if (gamma) lambdas.plus_eq_v_times_s(lambdas, -2*gamma*eta*(1./cur_npairs));
-          }
-        }
-      }
-
-      // per-coordinate learning rate
-      if (pclr != "no") {
-        SparseVector<weight_t>::iterator it = sum_up.begin();
-        for (; it != sum_up.end(); ++it) {
-          if (pclr == "simple") {
-           lambdas[it->first] += it->second / max(1.0, learning_rates[it->first]);
-           learning_rates[it->first]++;
-          } else if (pclr == "adagrad") {
-            if (learning_rates[it->first] == 0) {
-             lambdas[it->first] +=  it->second * eta;
-            } else {
-             lambdas[it->first] +=  it->second * eta * learning_rates[it->first];
-            }
-            learning_rates[it->first] += pow(it->second, 2.0);
-          }
-        }
-      }
-
-      // l1 regularization
-      // please note that this regularizations happen
-      // after a _sentence_ -- not after each example/pair!
-      if (l1naive) {
-        SparseVector<weight_t>::iterator it = lambdas.begin();
-        for (; it != lambdas.end(); ++it) {
-          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
-              it->second *= max(0.0000001, eta/(eta+learning_rates[it->first])); // FIXME
-              learning_rates[it->first]++;
-            it->second -= sign(it->second) * l1_reg;
-          }
-        }
-      } else if (l1clip) {
-        SparseVector<weight_t>::iterator it = lambdas.begin();
-        for (; it != lambdas.end(); ++it) {
-          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
-            if (it->second != 0) {
-              weight_t v = it->second;
-              if (v > 0) {
-                it->second = max(0., v - l1_reg);
-              } else {
-                it->second = min(0., v + l1_reg);
-              }
-            }
-          }
-        }
-      } else if (l1cumul) {
-        weight_t acc_penalty = (ii+1) * l1_reg; // ii is the index of the current input
-        SparseVector<weight_t>::iterator it = lambdas.begin();
-        for (; it != lambdas.end(); ++it) {
-          if (!lambdas_copy.get(it->first) || lambdas_copy.get(it->first)!=it->second) {
-            if (it->second != 0) {
-              weight_t v = it->second;
-              weight_t penalized = 0.;
-              if (v > 0) {
-                penalized = max(0., v-(acc_penalty + cumulative_penalties.get(it->first)));
-              } else {
-                penalized = min(0., v+(acc_penalty - cumulative_penalties.get(it->first)));
-              }
-              it->second = penalized;
-              cumulative_penalties.set_value(it->first, cumulative_penalties.get(it->first)+penalized);
-            }
-          }
-        }
-      }
-
-      if (ki==repeat-1) { // done
-        kbest_loss_last = kbest_loss;
-        if (repeat > 1) {
-          score_t best_model = -std::numeric_limits<score_t>::max();
-          unsigned best_idx = 0;
-          for (unsigned i=0; i < samples->size(); i++) {
-            score_t s = lambdas.dot((*samples)[i].f);
-            if (s > best_model) {
-              best_idx = i;
-              best_model = s;
-            }
-          }
-          score_sum += (*samples)[best_idx].score;
-          model_sum += best_model;
-        }
-      }
-    } // repeat
-
-    if ((kbest_loss_first - kbest_loss_last) >= 0) kbest_loss_improve++;
-
-    } // noup
-
-    if (rescale) lambdas /= lambdas.l2norm();
-
-    ++ii;
-
-  } // input loop
-
-  if (t == 0) in_sz = ii; // remember size of input (# lines)
-
-
-  if (batch) {
-    lambdas.plus_eq_v_times_s(batch_updates, eta);
-    if (gamma) lambdas.plus_eq_v_times_s(lambdas, -2*gamma*eta*(1./npairs));
-    batch_updates.clear();
+    if (scorer_str == "approx_bleu" || scorer_str == "lc_bleu") sh.scorer->Reset();
+    score_sum += sh.score_sum;
+    model_sum += sh.model_sum;
+    batch_loss += sh.batch_loss;
+    rank_errors += sh.rank_errors;
+    margin_violations += sh.margin_violations;
+    npairs += sh.npairs;
+    f_count += sh.f_count;
+    list_sz += sh.list_sz;
+    kbest_loss_improve += sh.kbest_loss_improve;
   }
 
-  if (average) w_average += lambdas;
+  if (num_shards > 1 && !noup) mix_weights(shards, mix_select_k, mix_norm);
 
-  if (scorer_str == "approx_bleu" || scorer_str == "lc_bleu") scorer->Reset();
+  if (average) w_average += lambdas;
 
   // print some stats
   score_t score_avg = score_sum/(score_t)in_sz;
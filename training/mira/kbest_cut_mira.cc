@@ -17,14 +17,19 @@
 #include "verbose.h"
 #include "viterbi.h"
 #include "hg.h"
+#include "apply_models.h"
+#include "ffset.h"
+#include "ff_forest_bleu.h"
 #include "prob.h"
 #include "kbest.h"
 #include "ff_register.h"
 #include "decoder.h"
+#include "decoder_threads.h"
 #include "filelib.h"
 #include "fdict.h"
 #include "time.h"
 #include "sampler.h"
+#include "vector_ops.h"
 
 #include "weights.h"
 #include "sparse_vector.h"
@@ -48,6 +53,10 @@ bool pseudo_doc;
 bool sent_approx;
 bool checkloss;
 bool stream;
+bool forest_hope_fear;
+double linear_bleu_precision;
+double linear_bleu_ratio;
+int forest_pop_limit;
 
 struct FComp {
   const vector<double>& w_;
@@ -92,7 +101,13 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
     ("k_best_size,k", po::value<int>()->default_value(500), "Size of hypothesis list to search for oracles")
     ("update_k_best,b", po::value<int>()->default_value(1), "Size of good, bad lists to perform update with")
     ("unique_k_best,u", "Unique k-best translation list")
+    ("forest_hope_fear,F", "Search the whole forest for the hope and fear translations with a linear BLEU approximation instead of using the k-best list")
+    ("linear_bleu_precision", po::value<double>()->default_value(0.8), "Unigram precision p of the linear BLEU approximation used by --forest_hope_fear")
+    ("linear_bleu_ratio", po::value<double>()->default_value(0.6), "Ratio r between the precisions of successive n-gram orders of the linear BLEU approximation used by --forest_hope_fear")
+    ("forest_pop_limit", po::value<int>()->default_value(200), "Cube pruning pop limit used to rescore the forest with linear BLEU (--forest_hope_fear)")
     ("stream,t", "Stream mode (used for realtime)")
+    ("batch_size,B", po::value<int>()->default_value(1), "Decode this many sentences with the same weights (in parallel, see --threads), then update on all of them at once (optimizers 2-5 solve for the constraints of the whole batch jointly)")
+    ("threads,j", po::value<int>()->default_value(1), "Number of decoder threads used for a batch (--batch_size); each thread loads its own copy of the models, so the memory used grows with it")
     ("weights_output,O",po::value<string>(),"Directory to write weights to")
     ("output_dir,D",po::value<string>(),"Directory to place output in")
     ("decoder_config,c",po::value<string>(),"Decoder configuration file")
@@ -120,6 +135,12 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
     cerr << dcmdline_options << endl;
     return false;
   }
+  if (conf->count("stream") || conf->count("pseudo_doc")) {
+    if ((*conf)["batch_size"].as<int>() > 1) {
+      cerr << "--batch_size cannot be used with --stream or --pseudo_doc\n";
+      return false;
+    }
+  }
   return true;
 }
 
@@ -131,10 +152,11 @@ static const double EPSILON = 0.000001;
 static const double SMO_EPSILON = 0.0001;
 static const double PSEUDO_SCALE = 0.95;
 static const int MAX_SMO = 10;
+static const int MAX_HILDRETH = 100;
 int cur_pass;
 
 struct HypothesisInfo {
-  HypothesisInfo() : mt_metric(), hope(), fear(), alpha(), oracle_loss() {}
+  HypothesisInfo() : mt_metric(), hope(), fear(), alpha(), oracle_loss(), model() {}
   SparseVector<double> features;
   vector<WordID> hyp;
   double mt_metric;
@@ -142,6 +164,7 @@ struct HypothesisInfo {
   double fear;
   double alpha;
   double oracle_loss;
+  double model;  // features.dot(dense_w_local) when the hypothesis was selected
   SparseVector<double> oracle_feat_diff;
   boost::shared_ptr<HypothesisInfo> oracleN;
 };
@@ -170,7 +193,7 @@ bool FearCompareB(const HI& h1, const HI& h2 )
 
 bool FearComparePred(const HI& h1, const HI& h2 ) 
 {
-  return h1->features.dot(dense_w_local) > h2->features.dot(dense_w_local);
+  return h1->model > h2->model;
 };
 
 bool HypothesisCompareG(const HI& h1, const HI& h2 ) 
@@ -316,6 +339,84 @@ vector<boost::shared_ptr<HypothesisInfo> > SelectPair(vector<boost::shared_ptr<H
 
 }
 
+// a constraint of the joint update of a batch: the hope translation of a
+// sentence must outscore one of its fear translations by their difference
+// in metric
+struct BatchConstraint {
+  unsigned sent;               // position of the sentence in the batch
+  SparseVector<double> diff;   // hope features - fear features
+  double loss;                 // hope metric - fear metric
+};
+
+// Joint MIRA update of a batch (--batch_size): maximizes the dual
+//   sum_c alpha_c (loss_c - diff_c.w) - 1/2 |sum_c alpha_c diff_c|^2
+// subject to alpha_c >= 0 and, for each sentence, sum of its alpha_c <= C,
+// by dual coordinate ascent (Hildreth's algorithm), then adds
+// sum_c alpha_c diff_c to lambdas. The difference vectors are the rows of a
+// dense matrix over the features they use, so the margins and the Gram
+// matrix are dense dot products and the ascent itself only touches the
+// Gram matrix. Returns the value of the dual objective.
+double BatchUpdate(const vector<BatchConstraint>& constraints, unsigned num_sents, double max_step_size, const vector<weight_t>& dense_weights, SparseVector<double>* lambdas) {
+  const unsigned n = constraints.size();
+  vector<int> fids;
+  for (unsigned c = 0; c < n; ++c)
+    for (SparseVector<double>::const_iterator it = constraints[c].diff.begin(); it != constraints[c].diff.end(); ++it)
+      fids.push_back(it->first);
+  sort(fids.begin(), fids.end());
+  fids.erase(unique(fids.begin(), fids.end()), fids.end());
+  const unsigned d = fids.size();
+  if (d == 0) return 0;
+
+  vector<double> rows(n * d), w(d);
+  for (unsigned c = 0; c < n; ++c)
+    for (SparseVector<double>::const_iterator it = constraints[c].diff.begin(); it != constraints[c].diff.end(); ++it)
+      rows[c * d + (lower_bound(fids.begin(), fids.end(), it->first) - fids.begin())] = it->second;
+  for (unsigned j = 0; j < d; ++j)
+    if (fids[j] < dense_weights.size()) w[j] = dense_weights[fids[j]];
+
+  vector<double> margin(n), gram(n * n);
+  for (unsigned c = 0; c < n; ++c) {
+    margin[c] = VecDot(d, &rows[c * d], &w[0]);
+    for (unsigned e = 0; e <= c; ++e)
+      gram[c * n + e] = gram[e * n + c] = VecDot(d, &rows[c * d], &rows[e * d]);
+  }
+  const vector<double> margin0 = margin;
+
+  // margin[c] is kept equal to diff_c.(w + sum_e alpha_e diff_e)
+  vector<double> alpha(n), budget(num_sents, max_step_size);
+  int iter = 0;
+  for (; iter < MAX_HILDRETH; ++iter) {
+    double max_change = 0;
+    for (unsigned c = 0; c < n; ++c) {
+      const double g = gram[c * n + c];
+      if (g <= 0) continue;
+      const unsigned s = constraints[c].sent;
+      double a = alpha[c] + (constraints[c].loss - margin[c]) / g;
+      a = max(0.0, min(a, alpha[c] + budget[s]));
+      const double delta = a - alpha[c];
+      if (delta == 0) continue;
+      alpha[c] = a;
+      budget[s] -= delta;
+      VecAxpy(n, delta, &gram[c * n], &margin[0]);
+      max_change = max(max_change, fabs(delta));
+    }
+    if (max_change <= SMO_EPSILON * max_step_size) break;
+  }
+
+  vector<double> u(d);
+  double dual = 0;
+  for (unsigned c = 0; c < n; ++c) {
+    if (alpha[c] == 0) continue;
+    VecAxpy(d, alpha[c], &rows[c * d], &u[0]);
+    dual += alpha[c] * (constraints[c].loss - margin0[c]);
+  }
+  dual -= 0.5 * VecDot(d, &u[0], &u[0]);
+  for (unsigned j = 0; j < d; ++j)
+    if (u[j]) lambdas->add_value(fids[j], u[j]);
+  cerr << "Batch update with " << n << " constraints, " << d << " features, " << iter << " iterations" << endl;
+  return dual;
+}
+
 struct GoodBadOracle {
   vector<boost::shared_ptr<HypothesisInfo> > good;
   vector<boost::shared_ptr<HypothesisInfo> > bad;
@@ -345,6 +446,7 @@ struct TrainingObserver : public DecoderObserver {
                    const DocScorer& d,
                    vector<GoodBadOracle>* o,
                    vector<ScoreP>* cbs) : ds(d), oracles(*o), corpus_bleu_sent_stats(*cbs), kbest_size(k) {
+    if (forest_hope_fear) forest_bleu.reset(new ForestBLEU(""));
     if(!pseudo_doc && !sent_approx) {
       if(cur_pass > 0) {    //calculate corpus bleu score from previous iterations 1-best for BLEU gain
         ScoreP acc;
@@ -367,6 +469,8 @@ struct TrainingObserver : public DecoderObserver {
   int cur_sent;
   ScoreP corpus_bleu_stats;
   float corpus_bleu_score;
+  // one per observer, since it holds the references of the current sentence
+  boost::shared_ptr<ForestBLEU> forest_bleu;
 
   float corpus_src_length;
   float curr_src_length;
@@ -397,9 +501,9 @@ struct TrainingObserver : public DecoderObserver {
     curr_src_length = (float) smeta.GetSourceLength();
 
     if(unique_kbest)
-      UpdateOracles<KBest::FilterUnique>(smeta.GetSentenceID(), *hg);
+      UpdateOracles<KBest::FilterUnique>(smeta, *hg);
     else
-      UpdateOracles<KBest::NoFilter<std::vector<WordID> > >(smeta.GetSentenceID(), *hg);
+      UpdateOracles<KBest::NoFilter<std::vector<WordID> > >(smeta, *hg);
     forest = *hg;
     
   }
@@ -412,9 +516,70 @@ struct TrainingObserver : public DecoderObserver {
     return h;
   }
 
+  // the k-best derivations of the forest, in order
+  template <class Filter>
+  void GetKBestCandidates(const Hypergraph& forest, vector<vector<WordID> >* yields, vector<SparseVector<double> >* feats) {
+    typedef KBest::KBestDerivations<vector<WordID>, ESentenceTraversal,Filter> K;
+    K kbest(forest,kbest_size);
+    for (int i = 0; i < kbest_size; ++i) {
+      typename K::Derivation *d =
+        kbest.LazyKthBest(forest.nodes_.size() - 1, i);
+      if (!d) break;
+      yields->push_back(d->yield);
+      feats->push_back(d->feature_values);
+    }
+  }
+
+  // the model-best derivation followed by the hope (model + BLEU) and fear
+  // (model - BLEU) derivations of the whole forest, where BLEU is the linear
+  // approximation of Tromble et al. (2008) computed by ForestBLEU; the
+  // candidates are rescored with the exact metric by the caller
+  void GetForestCandidates(const SentenceMetadata& smeta, const Hypergraph& forest, int sent_id, vector<vector<WordID> >* yields, vector<SparseVector<double> >* feats) {
+    const vector<vector<WordID> >& refs = ds[sent_id]->refs;
+    forest_bleu->SetReferences(refs);
+    double ref_len = 0;
+    for (unsigned i = 0; i < refs.size(); ++i) ref_len += refs[i].size();
+    if (!refs.empty()) ref_len /= refs.size();
+    if (ref_len < 1) ref_len = 1;
+
+    // the metric is scaled like the sentence-level scores below, and divided
+    // by the reference length since linear BLEU grows with it
+    SparseVector<double> theta;
+    forest_bleu->AddLinearBLEUWeights(mt_metric_scale / ref_len, linear_bleu_precision, linear_bleu_ratio, &theta);
+
+    // the states of ForestBLEU (the boundary words of each yield) split the
+    // nodes far too much for a full intersection, so the hope and fear
+    // forests are each cube pruned under their own weights
+    vector<weight_t> model_w(dense_w_local);
+    model_w.resize(FD::NumFeats());
+    Hypergraph model_forest(forest);
+    model_forest.Reweight(model_w);
+    vector<const FeatureFunction*> ffs(1, forest_bleu.get());
+    const double signs[] = { 0.0, 1.0, -1.0 };
+    for (int i = 0; i < 3; ++i) {
+      vector<weight_t> w(model_w);
+      for (SparseVector<double>::iterator it = theta.begin(); it != theta.end(); ++it)
+        w[it->first] += signs[i] * it->second;
+      yields->push_back(vector<WordID>());
+      if (signs[i] == 0.0) {
+        ViterbiESentence(model_forest, &yields->back());
+        feats->push_back(ViterbiFeatures(model_forest));
+        continue;
+      }
+      ModelSet models(w, ffs);
+      Hypergraph bleu_forest;
+      ApplyModelSet(model_forest, smeta, models, IntersectionConfiguration(IntersectionConfiguration::CUBE, forest_pop_limit), &bleu_forest);
+      bleu_forest.Reweight(w);
+      ViterbiESentence(bleu_forest, &yields->back());
+      feats->push_back(ViterbiFeatures(bleu_forest));
+      forest_bleu->RemoveFeatures(&feats->back());
+    }
+  }
+
   template <class Filter>  
-  void UpdateOracles(int sent_id, const Hypergraph& forest) {
+  void UpdateOracles(const SentenceMetadata& smeta, const Hypergraph& forest) {
 
+    int sent_id = smeta.GetSentenceID();
     if (stream) sent_id = 0;
     bool PRINT_LIST= false;
     assert(sent_id < oracles.size());
@@ -427,19 +592,20 @@ struct TrainingObserver : public DecoderObserver {
 
     vector<boost::shared_ptr<HypothesisInfo> > all_hyp;
 
-    typedef KBest::KBestDerivations<vector<WordID>, ESentenceTraversal,Filter> K;
-    K kbest(forest,kbest_size);
-    
-    for (int i = 0; i < kbest_size; ++i) {
+    vector<vector<WordID> > yields;
+    vector<SparseVector<double> > feats;
+    if (forest_hope_fear)
+      GetForestCandidates(smeta, forest, sent_id, &yields, &feats);
+    else
+      GetKBestCandidates<Filter>(forest, &yields, &feats);
 
-      typename K::Derivation *d =
-        kbest.LazyKthBest(forest.nodes_.size() - 1, i);
-      if (!d) break;
+    for (int i = 0; i < yields.size(); ++i) {
+      const vector<WordID>& yield = yields[i];
 
       float sentscore;
 	  if(cur_pass > 0 && !pseudo_doc && !sent_approx)
 	    {
-	      ScoreP sent_stats = ds[sent_id]->ScoreCandidate(d->yield);
+	      ScoreP sent_stats = ds[sent_id]->ScoreCandidate(yield);
 	      ScoreP corpus_no_best = corpus_bleu_stats->GetZero();
 
 	      corpus_bleu_stats->Subtract(*corpus_bleu_sent_stats[sent_id], &*corpus_no_best);
@@ -451,7 +617,7 @@ struct TrainingObserver : public DecoderObserver {
 	  else if(pseudo_doc)   //pseudo-corpus smoothing 
 	    {
 	      float src_scale = corpus_src_length + curr_src_length;
-	      ScoreP sent_stats = ds[sent_id]->ScoreCandidate(d->yield);
+	      ScoreP sent_stats = ds[sent_id]->ScoreCandidate(yield);
 	      if(!corpus_bleu_stats){ corpus_bleu_stats = sent_stats->GetZero();}
 	      
 	      sent_stats->PlusEquals(*corpus_bleu_stats);
@@ -460,17 +626,17 @@ struct TrainingObserver : public DecoderObserver {
 	    }
 	  else //use sentence-level smoothing ( used when cur_pass=0 if not pseudo_doc)
 	    {
-	      sentscore = mt_metric_scale * (ds[sent_id]->ScoreCandidate(d->yield)->ComputeScore());
+	      sentscore = mt_metric_scale * (ds[sent_id]->ScoreCandidate(yield)->ComputeScore());
 	    }
 	
       if (invert_score) sentscore *= -1.0;
       
       if (i < update_list_size){ 
-	if(PRINT_LIST)cerr << TD::GetString(d->yield) << " ||| " << d->score << " ||| " << sentscore << endl; 
-	cur_best.push_back( MakeHypothesisInfo(d->feature_values, sentscore, d->yield));
+	if(PRINT_LIST)cerr << TD::GetString(yield) << " ||| " << feats[i].dot(dense_w_local) << " ||| " << sentscore << endl; 
+	cur_best.push_back( MakeHypothesisInfo(feats[i], sentscore, yield));
       }
       
-      all_hyp.push_back(MakeHypothesisInfo(d->feature_values, sentscore,d->yield));   //store all hyp to extract hope and fear         
+      all_hyp.push_back(MakeHypothesisInfo(feats[i], sentscore,yield));   //store all hyp to extract hope and fear         
     }
     
     if(pseudo_doc){
@@ -489,6 +655,11 @@ struct TrainingObserver : public DecoderObserver {
       cerr << "ps corpus size: " << corpus_src_length << " " << curr_src_length << "\n" << details << "\n" << details2 << endl;
     }
 
+    // the model scores are used by the hope and fear selections below (and
+    // by the sorts, so they are computed once rather than per comparison)
+    for (int u = 0; u != all_hyp.size(); u++)
+      all_hyp[u]->model = all_hyp[u]->features.dot(dense_w_local);
+
     //figure out how many hyps we can keep maximum
     int temp_update_size = update_list_size;
     if (all_hyp.size() < update_list_size){ temp_update_size = all_hyp.size();}
@@ -497,7 +668,7 @@ struct TrainingObserver : public DecoderObserver {
     sort(all_hyp.begin(),all_hyp.end(),HypothesisCompareB);
     
     if(PRINT_LIST){  cerr << "Sorting " << endl; for(int u=0;u!=all_hyp.size();u++)  
-						   cerr << all_hyp[u]->mt_metric << " " << all_hyp[u]->features.dot(dense_w_local) << endl; }
+						   cerr << all_hyp[u]->mt_metric << " " << all_hyp[u]->model << endl; }
     
     if(hope_select == 1)
       {
@@ -505,7 +676,7 @@ struct TrainingObserver : public DecoderObserver {
 	if (PRINT_LIST) cerr << "HOPE " << endl;
 	for(int u=0;u!=all_hyp.size();u++)	
 	  { 
-	    double t_score = all_hyp[u]->features.dot(dense_w_local);
+	    double t_score = all_hyp[u]->model;
 	    all_hyp[u]->hope = all_hyp[u]->mt_metric + t_score;
 	    if (PRINT_LIST) cerr << all_hyp[u]->mt_metric << " H:" << all_hyp[u]->hope << " S:" << t_score << endl; 
 	    
@@ -524,12 +695,12 @@ struct TrainingObserver : public DecoderObserver {
 
     if(fear_select == 1){   //compute fear hyps with model - bleu
       if (PRINT_LIST) cerr << "FEAR " << endl;
-      double hope_score = oracleN->features.dot(dense_w_local);
+      double hope_score = oracleN->model;
 
       if (PRINT_LIST) cerr << "hope score " << hope_score << endl;
       for(int u=0;u!=all_hyp.size();u++)	
 	{ 
-	  double t_score = all_hyp[u]->features.dot(dense_w_local);
+	  double t_score = all_hyp[u]->model;
 
 	  all_hyp[u]->fear = -1*all_hyp[u]->mt_metric + 1*oracleN->mt_metric - hope_score + t_score; //relative loss
 	  all_hyp[u]->oracle_loss = -1*all_hyp[u]->mt_metric + 1*oracleN->mt_metric;
@@ -636,6 +807,10 @@ int main(int argc, char** argv) {
   stream = conf.count("stream");
   pseudo_doc = conf.count("pseudo_doc");
   sent_approx = conf.count("sent_approx");
+  forest_hope_fear = conf.count("forest_hope_fear");
+  linear_bleu_precision = conf["linear_bleu_precision"].as<double>();
+  linear_bleu_ratio = conf["linear_bleu_ratio"].as<double>();
+  forest_pop_limit = conf["forest_pop_limit"].as<int>();
   cerr << "Using pseudo-doc:" << pseudo_doc << " Sent:" << sent_approx << endl;
   if(pseudo_doc)
     mt_metric_scale=1;
@@ -670,8 +845,10 @@ int main(int argc, char** argv) {
   
   cerr << "Using optimizer:" << optimizer << endl;
     
+  const unsigned batch_size = max(1, conf["batch_size"].as<int>());
   ReadFile ini_rf(conf["decoder_config"].as<string>());
-  Decoder decoder(ini_rf.stream());
+  DecoderThreads decoders(ini_rf.stream(), batch_size > 1 ? max(1, conf["threads"].as<int>()) : 1);
+  Decoder& decoder = decoders[0];
 
   vector<weight_t>& dense_weights = decoder.CurrentWeightVector();
   
@@ -691,7 +868,13 @@ int main(int argc, char** argv) {
   vector<GoodBadOracle> oracles(ds->size());
 
   BasicObserver bobs;
-  TrainingObserver observer(conf["k_best_size"].as<int>(), *ds, &oracles, &corpus_bleu_sent_stats);
+  // one observer per sentence of a batch
+  vector<boost::shared_ptr<TrainingObserver> > observers(batch_size);
+  vector<DecoderObserver*> observer_ptrs(batch_size);
+  for (unsigned i = 0; i < batch_size; ++i) {
+    observers[i].reset(new TrainingObserver(conf["k_best_size"].as<int>(), *ds, &oracles, &corpus_bleu_sent_stats));
+    observer_ptrs[i] = observers[i].get();
+  }
 
   int cur_sent = 0;
   int lcount = 0;
@@ -700,16 +883,23 @@ int main(int argc, char** argv) {
   int dots = 0;
   SparseVector<double> tot;
   SparseVector<double> final_tot;
+  int tot_count = 0;  // number of weight vectors summed in tot
 
   SparseVector<double> old_lambdas = lambdas;
   tot.clear();
   tot += lambdas;
+  ++tot_count;
   cerr << "PASS " << cur_pass << " " << endl << lambdas << endl; 
   ScoreP acc, acc_h, acc_f;
   
-  while(*in) {
-      getline(*in, buf);
-      if (buf.empty()) continue;
+  vector<string> batch;
+  vector<BatchConstraint> batch_constraints;
+  unsigned next_in_batch = 0;  // the first sentence of batch not updated on yet
+  while(*in || next_in_batch < batch.size()) {
+      if (next_in_batch == batch.size()) {
+        getline(*in, buf);
+        if (buf.empty()) continue;
+      }
       if (stream) {
     	  cur_sent = 0;
     	  int delim = buf.find(" ||| ");
@@ -749,11 +939,30 @@ int main(int argc, char** argv) {
     	  }
       }
       // Regular mode or LEARN line from stream mode
-      //TODO: allow batch updating
       lambdas.init_vector(&dense_weights);
       dense_w_local = dense_weights;
-      decoder.SetId(cur_sent);
-      decoder.Decode(buf, &observer);  // decode the sentence, calling Notify to get the hope,fear, and model best hyps. 
+      if (next_in_batch == batch.size()) {
+        // with --batch_size, the next sentences are decoded along with this
+        // one, in parallel and with the same weights, and the update is made
+        // once the last of them is seen (see BatchUpdate)
+        batch.assign(1, buf);
+        while (batch.size() < batch_size && getline(*in, buf))
+          if (!buf.empty()) batch.push_back(buf);
+        next_in_batch = 0;
+        if (batch.size() == 1) {
+          decoder.SetId(cur_sent);
+          decoder.Decode(batch[0], observer_ptrs[0]);  // decode the sentence, calling Notify to get the hope,fear, and model best hyps. 
+        } else {
+          vector<int> ids(batch.size());
+          vector<unsigned> which(batch.size());
+          for (unsigned i = 0; i < batch.size(); ++i) {
+            ids[i] = cur_sent + i;
+            which[i] = i;
+          }
+          decoders.Decode(batch, ids, which, observer_ptrs);
+        }
+      }
+      TrainingObserver& observer = *observers[next_in_batch++];
 
       cur_sent = observer.GetCurrentSent();
       cerr << "SENT: " << cur_sent << endl;
@@ -780,7 +989,22 @@ int main(int argc, char** argv) {
       if (!acc_f) { acc_f = fear_sentscore->GetZero(); }
       acc_f->PlusEquals(*fear_sentscore);
       
-      if(optimizer == 4) { //passive-aggresive update (single dual coordinate step)
+      if (batch.size() > 1 && optimizer != 1) { //joint MIRA update of the batch: the hope vs. each fear translation (-b) of each of its sentences
+	for (unsigned u = 0; u < cur_bad_v.size(); ++u) {
+	  batch_constraints.push_back(BatchConstraint());
+	  BatchConstraint& c = batch_constraints.back();
+	  c.sent = next_in_batch - 1;
+	  c.diff = cur_good.features - cur_bad_v[u]->features;
+	  c.loss = cur_good.mt_metric - cur_bad_v[u]->mt_metric;
+	}
+	if (next_in_batch == batch.size()) {
+	  const double batch_objective = BatchUpdate(batch_constraints, batch.size(), max_step_size, dense_weights, &lambdas);
+	  objective += batch_objective;
+	  cerr << "BATCH OBJ: " << batch_objective << " NEW OBJ: " << objective << endl;
+	  batch_constraints.clear();
+	}
+      }
+      else if(optimizer == 4) { //passive-aggresive update (single dual coordinate step)
       
 	  double margin = cur_bad.features.dot(dense_weights) - cur_good.features.dot(dense_weights);
 	  double mt_loss = (cur_good.mt_metric - cur_bad.mt_metric);
@@ -951,10 +1175,12 @@ int main(int argc, char** argv) {
 			    if(DEBUG_SMO) cerr<< "Decoding with new weights -- now orac are " << oracles[cur_sent].good.size() << endl;
 			    Hypergraph hg = observer.GetCurrentForest();
 			    hg.Reweight(dense_weights);
+			    const Lattice no_ref;
+			    const SentenceMetadata smeta(cur_sent, no_ref);
 			    if(unique_kbest)
-                              observer.UpdateOracles<KBest::FilterUnique>(cur_sent, hg);
+                              observer.UpdateOracles<KBest::FilterUnique>(smeta, hg);
                             else
-                              observer.UpdateOracles<KBest::NoFilter<std::vector<WordID> > >(cur_sent, hg);			    
+                              observer.UpdateOracles<KBest::NoFilter<std::vector<WordID> > >(smeta, hg);			    
 			  }
 		      }
 		  }
@@ -978,7 +1204,12 @@ int main(int argc, char** argv) {
       
     
       if ((cur_sent * 40 / ds->size()) > dots) { ++dots; cerr << '.'; }
-      tot += lambdas;
+      // the weights are averaged over the updates, so a batch updated on
+      // jointly counts once
+      if (batch.size() == 1 || optimizer == 1 || next_in_batch == batch.size()) {
+        tot += lambdas;
+        ++tot_count;
+      }
       ++lcount;
       cur_sent++;
 
@@ -1005,7 +1236,7 @@ int main(int argc, char** argv) {
 		Weights::WriteToFile(os.str(), dense_weights, true, &msg);
     
 		SparseVector<double> x = tot;
-		x /= lcount+1;
+		x /= tot_count;
 		ostringstream sa;
 		string msga = "# MIRA tuned weights AVERAGED ||| " + boost::lexical_cast<std::string>(node_id) + " ||| " + boost::lexical_cast<std::string>(lcount);
 		sa << weights_dir << "/weights.mira-pass" << (cur_pass < 10 ? "0" : "") << cur_pass << "." << node_id << "-avg.gz";
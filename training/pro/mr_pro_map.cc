@@ -3,12 +3,11 @@
 #include <fstream>
 #include <vector>
 
-#include <boost/functional/hash.hpp>
-#include <boost/shared_ptr.hpp>
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 
 #include "candidate_set.h"
+#include "candidate_pool.h"
 #include "sampler.h"
 #include "filelib.h"
 #include "stringlib.h"
@@ -17,14 +16,11 @@
 #include "hg_io.h"
 #include "ns.h"
 #include "ns_docscorer.h"
-
-// This is Figure 4 (Algorithm Sampler) from Hopkins&May (2011)
+#include "pro_sampler.h"
 
 using namespace std;
 namespace po = boost::program_options;
 
-boost::shared_ptr<MT19937> rng;
-
 void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
   po::options_description opts("Configuration options");
   opts.add_options()
@@ -57,117 +53,16 @@ void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
   }
 }
 
-struct ThresholdAlpha {
-  explicit ThresholdAlpha(double t = 0.05) : threshold(t) {}
-  double operator()(double mag) const {
-    if (mag < threshold) return 0.0; else return 1.0;
-  }
-  const double threshold;
-};
-
-struct TrainingInstance {
-  TrainingInstance(const SparseVector<weight_t>& feats, bool positive, float diff) : x(feats), y(positive), gdiff(diff) {}
-  SparseVector<weight_t> x;
-#undef DEBUGGING_PRO
-#ifdef DEBUGGING_PRO
-  vector<WordID> a;
-  vector<WordID> b;
-#endif
-  bool y;
-  float gdiff;
-};
-#ifdef DEBUGGING_PRO
-ostream& operator<<(ostream& os, const TrainingInstance& d) {
-  return os << d.gdiff << " y=" << d.y << "\tA:" << TD::GetString(d.a) << "\n\tB: " << TD::GetString(d.b) << "\n\tX: " << d.x;
-}
-#endif
-
-struct DiffOrder {
-  bool operator()(const TrainingInstance& a, const TrainingInstance& b) const {
-    return a.gdiff > b.gdiff;
-  }
-};
-
-double LengthDifferenceStdDev(const training::CandidateSet& J_i, int n) {
-  double sum = 0;
-  for (int i = 0; i < n; ++i) {
-    const size_t a = rng->inclusive(0, J_i.size() - 1)();
-    const size_t b = rng->inclusive(0, J_i.size() - 1)();
-    if (a == b) { --i; continue; }
-    double p = J_i[a].ewords.size();
-    p -= J_i[b].ewords.size();
-    sum += p * p;  // mean is 0 by construction
-  }
-  return max(sqrt(sum / n), 2.0);
-};
-
-void Sample(const int gamma,
-            const unsigned xi,
-            const training::CandidateSet& J_i,
-            const EvaluationMetric* metric,
-            vector<TrainingInstance>* pv) {
-  const double len_stddev = LengthDifferenceStdDev(J_i, 5000);
-  const bool invert_score = metric->IsErrorMetric();
-  vector<TrainingInstance> v1, v2;
-  float avg_diff = 0;
-  const double z_score_threshold=2;
-  for (int i = 0; i < gamma; ++i) {
-    const size_t a = rng->inclusive(0, J_i.size() - 1)();
-    const size_t b = rng->inclusive(0, J_i.size() - 1)();
-    if (a == b) { --i; continue; }
-    double z_score = fabs(((int)J_i[a].ewords.size() - (int)J_i[b].ewords.size()) / len_stddev);
-    // variation on Nakov et al. (2011)
-    if (z_score > z_score_threshold) { --i; continue; }
-    float ga = metric->ComputeScore(J_i[a].eval_feats);
-    float gb = metric->ComputeScore(J_i[b].eval_feats);
-    bool positive = gb < ga;
-    if (invert_score) positive = !positive;
-    const float gdiff = fabs(ga - gb);
-    //cerr << ((int)J_i[a].ewords.size() - (int)J_i[b].ewords.size()) << endl;
-    //cerr << (ga - gb) << endl;
-    if (!gdiff) continue;
-    avg_diff += gdiff;
-    SparseVector<weight_t> xdiff = (J_i[a].fmap - J_i[b].fmap).erase_zeros();
-    if (xdiff.empty()) {
-      cerr << "Empty diff:\n  " << TD::GetString(J_i[a].ewords) << endl << "x=" << J_i[a].fmap << endl;
-      cerr << "  " << TD::GetString(J_i[b].ewords) << endl << "x=" << J_i[b].fmap << endl;
-      continue;
-    }
-    v1.push_back(TrainingInstance(xdiff, positive, gdiff));
-#ifdef DEBUGGING_PRO
-    v1.back().a = J_i[a].hyp;
-    v1.back().b = J_i[b].hyp;
-    cerr << "N: " << v1.back() << endl;
-#endif
-  }
-  avg_diff /= v1.size();
-
-  for (unsigned i = 0; i < v1.size(); ++i) {
-    double p = 1.0 / (1.0 + exp(-avg_diff - v1[i].gdiff));
-    // cerr << "avg_diff=" << avg_diff << "  gdiff=" << v1[i].gdiff << "  p=" << p << endl;
-    if (rng->next() < p) v2.push_back(v1[i]);
-  }
-  vector<TrainingInstance>::iterator mid = v2.begin() + xi;
-  if (xi > v2.size()) mid = v2.end();
-  partial_sort(v2.begin(), mid, v2.end(), DiffOrder());
-  copy(v2.begin(), mid, back_inserter(*pv));
-#ifdef DEBUGGING_PRO
-  if (v2.size() >= 5) {
-    for (int i =0; i < (mid - v2.begin()); ++i) {
-      cerr << v2[i] << endl;
-    }
-    cerr << pv->back() << endl;
-  }
-#endif
-}
-
 int main(int argc, char** argv) {
   po::variables_map conf;
   InitCommandLine(argc, argv, &conf);
+  // every sentence is sampled with its own sequence, so the pairs do not
+  // depend on how the input is split into shards
+  uint32_t seed = 0;
   if (conf.count("random_seed"))
-    rng.reset(new MT19937(conf["random_seed"].as<uint32_t>()));
-  else
-    rng.reset(new MT19937);
+    seed = conf["random_seed"].as<uint32_t>();
+  if (!seed)
+    seed = MT19937::GetTrulyRandomSeed();
   const string evaluation_metric = conf["evaluation_metric"].as<string>();
 
   EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
@@ -186,6 +81,10 @@ int main(int argc, char** argv) {
   Weights::InitFromFile(weightsf, &weights);
   string kbest_repo = conf["kbest_repository"].as<string>();
   MkDirP(kbest_repo);
+  // features are written in a canonical order and with full precision, so
+  // that the reducer reads exactly the instances that were sampled
+  cout.precision(17);
+  vector<pair<string, weight_t> > feats;
   while(in) {
     vector<TrainingInstance> v;
     string line;
@@ -198,21 +97,35 @@ int main(int argc, char** argv) {
     is >> file >> sent_id;
     ReadFile rf(file);
     ostringstream os;
-    training::CandidateSet J_i;
-    os << kbest_repo << "/kbest." << sent_id << ".txt.gz";
-    const string kbest_file = os.str();
-    if (FileExists(kbest_file))
-      J_i.ReadFromFile(kbest_file);
+    os << kbest_repo << "/kbest." << sent_id;
+    const string kbest_file = os.str() + ".bin";
+    const string text_kbest_file = os.str() + ".txt.gz";
+    const bool import_text = !FileExists(kbest_file) && FileExists(text_kbest_file);
+    // the pool only grows, new candidates are appended to the file
+    training::CandidatePool J_i(kbest_file);
+    if (import_text) {  // repository of an older version
+      training::CandidateSet cs;
+      cs.ReadFromFile(text_kbest_file);
+      for (unsigned i = 0; i < cs.size(); ++i)
+        J_i.Add(cs[i]);
+    }
     HypergraphIO::ReadFromJSON(rf.stream(), &hg);
     hg.Reweight(weights);
     J_i.AddKBestCandidates(hg, kbest_size, ds[sent_id]);
-    J_i.WriteToFile(kbest_file);
+    J_i.Flush();
 
-    Sample(gamma, xi, J_i, metric, &v);
+    MT19937 rng(SentenceSeed(seed, sent_id));
+    Sample(gamma, xi, J_i, metric, &rng, &v);
     for (unsigned i = 0; i < v.size(); ++i) {
       const TrainingInstance& vi = v[i];
-      cout << vi.y << "\t" << vi.x << endl;
-      cout << (!vi.y) << "\t" << (vi.x * -1.0) << endl;
+      SortFeaturesByName(vi.x, &feats);
+      cout << vi.y << "\t";
+      for (unsigned j = 0; j < feats.size(); ++j)
+        cout << (j ? " " : "") << feats[j].first << '=' << feats[j].second;
+      cout << endl << (!vi.y) << "\t";
+      for (unsigned j = 0; j < feats.size(); ++j)
+        cout << (j ? " " : "") << feats[j].first << '=' << -feats[j].second;
+      cout << endl;
     }
   }
   return 0;
@@ -0,0 +1,261 @@
+#include "pro_classifier.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+#include "fdict.h"
+#include "liblbfgs/lbfgs++.h"
+
+using namespace std;
+
+void ParseSparseVector(string& line, size_t cur, SparseVector<weight_t>* out) {
+  SparseVector<weight_t>& x = *out;
+  size_t last_start = cur;
+  size_t last_comma = string::npos;
+  while(cur <= line.size()) {
+    if (line[cur] == ' ' || cur == line.size()) {
+      if (!(cur > last_start && last_comma != string::npos && cur > last_comma)) {
+        cerr << "[ERROR] " << line << endl << "  position = " << cur << endl;
+        exit(1);
+      }
+      const int fid = FD::Convert(line.substr(last_start, last_comma - last_start));
+      if (cur < line.size()) line[cur] = 0;
+      const weight_t val = strtod(&line[last_comma + 1], NULL);
+      x.set_value(fid, val);
+
+      last_comma = string::npos;
+      last_start = cur+1;
+    } else {
+      if (line[cur] == '=')
+        last_comma = cur;
+    }
+    ++cur;
+  }
+}
+
+void ReadCorpus(istream* pin, PairwiseCorpus* corpus) {
+  istream& in = *pin;
+  corpus->clear();
+  bool flag = false;
+  int lc = 0;
+  string line;
+  SparseVector<weight_t> x;
+  while(getline(in, line)) {
+    ++lc;
+    if (lc % 1000 == 0) { cerr << '.'; flag = true; }
+    if (lc % 40000 == 0) { cerr << " [" << lc << "]\n"; flag = false; }
+    if (line.empty()) continue;
+    const size_t ks = line.find("\t");
+    assert(string::npos != ks);
+    assert(ks == 1);
+    const bool y = line[0] == '1';
+    x.clear();
+    ParseSparseVector(line, ks + 1, &x);
+    corpus->push_back(make_pair(y, x));
+  }
+  if (flag) cerr << endl;
+}
+
+namespace {
+
+// the corpus by feature: entries[start[f] .. start[f+1]) are the (example,
+// value) pairs of feature f, in the order of the examples
+struct FeatureColumns {
+  FeatureColumns(const PairwiseCorpus& corpus, size_t num_feats) : start(num_feats + 1, 0) {
+    for (unsigned i = 0; i < corpus.size(); ++i) {
+      const SparseVector<weight_t>& x = corpus[i].second;
+      for (SparseVector<weight_t>::const_iterator it = x.begin(); it != x.end(); ++it) {
+        assert(it->first > 0 && it->first < num_feats);
+        ++start[it->first + 1];
+      }
+    }
+    for (size_t f = 1; f <= num_feats; ++f)
+      start[f] += start[f - 1];
+    entries.resize(start[num_feats]);
+    vector<size_t> pos(start.begin(), start.end() - 1);
+    for (unsigned i = 0; i < corpus.size(); ++i) {
+      const SparseVector<weight_t>& x = corpus[i].second;
+      for (SparseVector<weight_t>::const_iterator it = x.begin(); it != x.end(); ++it)
+        entries[pos[it->first]++] = make_pair(i, it->second);
+    }
+  }
+  vector<size_t> start;
+  vector<pair<unsigned, weight_t> > entries;
+};
+
+double ApplyRegularizationTerms(const double C,
+                                const double T,
+                                const vector<weight_t>& weights,
+                                const vector<weight_t>& prev_weights,
+                                weight_t* g) {
+  double reg = 0;
+  for (size_t i = 0; i < weights.size(); ++i) {
+    const double prev_w_i = (i < prev_weights.size() ? prev_weights[i] : 0.0);
+    const double& w_i = weights[i];
+    reg += C * w_i * w_i;
+    g[i] += 2 * C * w_i;
+
+    const double diff_i = w_i - prev_w_i;
+    reg += T * diff_i * diff_i;
+    g[i] += 2 * T * diff_i;
+  }
+  return reg;
+}
+
+double TrainingInference(const vector<weight_t>& x,
+                         const PairwiseCorpus& corpus,
+                         const FeatureColumns& columns,
+                         const int threads,
+                         weight_t* g = NULL) {
+  const int n = corpus.size();
+  // per example: the negative log likelihood, and the derivative of the
+  // log likelihood with respect to the score (the coefficient of the
+  // example's features in the gradient)
+  vector<double> loss(n), coef(n);
+#pragma omp parallel for schedule(static) num_threads(threads)
+  for (int i = 0; i < n; ++i) {
+    const double dotprod = corpus[i].second.dot(x) + (x.size() ? x[0] : weight_t()); // x[0] is bias
+    double lp_false = dotprod;
+    double lp_true = -dotprod;
+    if (0 < lp_true) {
+      lp_true += log1p(exp(-lp_true));
+      lp_false = log1p(exp(lp_false));
+    } else {
+      lp_true = log1p(exp(lp_true));
+      lp_false += log1p(exp(-lp_false));
+    }
+    lp_true*=-1;
+    lp_false*=-1;
+    if (corpus[i].first) {  // true label
+      loss[i] = lp_true;
+      coef[i] = -exp(lp_false);
+    } else {                  // false label
+      loss[i] = lp_false;
+      coef[i] = exp(lp_true);
+    }
+  }
+  double cll = 0;
+  for (int i = 0; i < n; ++i) {
+    cll -= loss[i];
+    if (g) g[0] += coef[i]; // bias
+  }
+  if (g) {
+    const int num_feats = columns.start.size() - 1;
+#pragma omp parallel for schedule(dynamic, 256) num_threads(threads)
+    for (int f = 1; f < num_feats; ++f) {
+      double gf = g[f];
+      for (size_t j = columns.start[f]; j < columns.start[f + 1]; ++j)
+        gf += columns.entries[j].second * coef[columns.entries[j].first];
+      g[f] = gf;
+    }
+  }
+  return cll;
+}
+
+struct ProLoss {
+  ProLoss(const PairwiseCorpus& tr,
+          const PairwiseCorpus& te,
+          const double c,
+          const double t,
+          const int j,
+          const vector<weight_t>& px) : training(tr), testing(te), C(c), T(t), threads(j), prev_x(px),
+                                        training_columns(tr, px.size()), testing_columns(te, px.size()) {}
+  double operator()(const vector<double>& x, double* g) const {
+    fill(g, g + x.size(), 0.0);
+    double cll = TrainingInference(x, training, training_columns, threads, g);
+    tppl = 0;
+    if (testing.size())
+      tppl = pow(2.0, TrainingInference(x, testing, testing_columns, threads, g) / (log(2) * testing.size()));
+    double ppl = cll / log(2);
+    ppl /= training.size();
+    ppl = pow(2.0, ppl);
+    double reg = ApplyRegularizationTerms(C, T, x, prev_x, g);
+    return cll + reg;
+  }
+  const PairwiseCorpus& training, testing;
+  const double C, T;
+  const int threads;
+  const vector<double>& prev_x;
+  const FeatureColumns training_columns, testing_columns;
+  mutable double tppl;
+};
+
+}
+
+double LearnParameters(const PairwiseCorpus& training,
+                       const PairwiseCorpus& testing,
+                       const double C,
+                       const double C1,
+                       const double T,
+                       const unsigned memory_buffers,
+                       const int threads,
+                       const vector<weight_t>& prev_x,
+                       vector<weight_t>* px) {
+  assert(px->size() == prev_x.size());
+  ProLoss loss(training, testing, C, T, threads, prev_x);
+  LBFGS<ProLoss> lbfgs(px, loss, memory_buffers, C1);
+  lbfgs.MinimizeFunction();
+  return loss.tppl;
+}
+
+double TuneRegularizer(const PairwiseCorpus& training,
+                       const PairwiseCorpus& testing,
+                       const double min_reg,
+                       const double max_reg,
+                       const double C1,
+                       const double T,
+                       const unsigned memory_buffers,
+                       const int threads,
+                       const vector<weight_t>& prev_x,
+                       vector<weight_t>* px,
+                       vector<pair<double, double> >* psweep,
+                       vector<double>* psmoothed) {
+  vector<pair<double, double> >& sp = *psweep;
+  vector<double>& smoothed = *psmoothed;
+  double C = min_reg;
+  const double steps = 18;
+  double sweep_factor = exp((log(max_reg) - log(min_reg)) / steps);
+  cerr << "SWEEP FACTOR: " << sweep_factor << endl;
+  while(C < max_reg) {
+    cerr << "C=" << C << "\tT=" <<T << endl;
+    const double tppl = LearnParameters(training, testing, C, C1, T, memory_buffers, threads, prev_x, px);
+    sp.push_back(make_pair(C, tppl));
+    C *= sweep_factor;
+  }
+  smoothed.resize(sp.size(), 0);
+  smoothed[0] = sp[0].second;
+  smoothed.back() = sp.back().second;
+  for (int i = 1; i < sp.size()-1; ++i) {
+    double prev = sp[i-1].second;
+    double next = sp[i+1].second;
+    double cur = sp[i].second;
+    smoothed[i] = (prev*0.2) + cur * 0.6 + (0.2*next);
+  }
+  double best_ppl = 9999999;
+  unsigned best_i = 0;
+  for (unsigned i = 0; i < sp.size(); ++i) {
+    if (smoothed[i] < best_ppl) {
+      best_ppl = smoothed[i];
+      best_i = i;
+    }
+  }
+  return sp[best_i].first;
+}
+
+void WriteTrainingSummary(const double C,
+                          const double tppl,
+                          const vector<pair<double, double> >& sp,
+                          const vector<double>& smoothed,
+                          ostream* pout) {
+  ostream& out = *pout;
+  out.precision(15);
+  out << "# C=" << C << "\theld out perplexity=";
+  if (tppl) { out << tppl << endl; } else { out << "N/A\n"; }
+  if (sp.size()) {
+    out << "# Parameter sweep:\n";
+    for (int i = 0; i < sp.size(); ++i) {
+      out << "# " << sp[i].first << "\t" << sp[i].second << "\t" << smoothed[i] << endl;
+    }
+  }
+}
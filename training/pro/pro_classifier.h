@@ -0,0 +1,64 @@
+#ifndef _PRO_CLASSIFIER_H_
+#define _PRO_CLASSIFIER_H_
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sparse_vector.h"
+#include "weights.h"
+
+// The pairwise ranking classifier of PRO (logistic regression on feature
+// differences, trained with LBFGS), shared by mr_pro_reduce and
+// pro_iteration.
+//
+// The gradient is computed by several threads, but in the same order of
+// summation as serially: the losses and their derivatives are computed per
+// example, and each component of the gradient is then accumulated by a
+// single thread over the examples that have the feature, in the order of
+// the corpus. The learned weights therefore do not depend on the number of
+// threads.
+
+typedef std::vector<std::pair<bool, SparseVector<weight_t> > > PairwiseCorpus;
+
+// parses the feature=value pairs of line from position cur (line is modified)
+void ParseSparseVector(std::string& line, size_t cur, SparseVector<weight_t>* out);
+// reads lines of the form label<TAB>feature=value ... (the mapper output)
+void ReadCorpus(std::istream* in, PairwiseCorpus* corpus);
+
+// trains x (which starts from prev_x) and returns the held-out perplexity
+double LearnParameters(const PairwiseCorpus& training,
+                       const PairwiseCorpus& testing,
+                       const double C,
+                       const double C1,
+                       const double T,
+                       const unsigned memory_buffers,
+                       const int threads,
+                       const std::vector<weight_t>& prev_x,
+                       std::vector<weight_t>* px);
+
+// returns the l2 regularization strength in [min_reg, max_reg) with the
+// lowest (smoothed) held-out perplexity; sweep and smoothed are the
+// perplexities of the strengths that were tried
+double TuneRegularizer(const PairwiseCorpus& training,
+                       const PairwiseCorpus& testing,
+                       const double min_reg,
+                       const double max_reg,
+                       const double C1,
+                       const double T,
+                       const unsigned memory_buffers,
+                       const int threads,
+                       const std::vector<weight_t>& prev_x,
+                       std::vector<weight_t>* px,
+                       std::vector<std::pair<double, double> >* sweep,
+                       std::vector<double>* smoothed);
+
+// writes the comment lines that precede the weights in the reducer output
+void WriteTrainingSummary(const double C,
+                          const double tppl,
+                          const std::vector<std::pair<double, double> >& sweep,
+                          const std::vector<double>& smoothed,
+                          std::ostream* out);
+
+#endif
@@ -0,0 +1,234 @@
+#include <sstream>
+#include <iostream>
+#include <vector>
+
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; }
+#endif
+
+#include <boost/program_options.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "candidate_set.h"
+#include "candidate_pool.h"
+#include "sampler.h"
+#include "filelib.h"
+#include "weights.h"
+#include "hg.h"
+#include "hg_io.h"
+#include "tdict.h"
+#include "fdict.h"
+#include "ns.h"
+#include "ns_docscorer.h"
+#include "pro_sampler.h"
+#include "pro_classifier.h"
+
+// One iteration of PRO in a single process: the k-best lists of the
+// sentences are updated and sampled by several threads, and the pairwise
+// classifier is trained with a multithreaded gradient. Given the same seed
+// (and k-best repository), the weights are the same as those of
+//   mr_pro_map -S seed ... < agenda | mr_pro_reduce ...
+// for any number of threads.
+
+using namespace std;
+namespace po = boost::program_options;
+
+void InitCommandLine(int argc, char** argv, po::variables_map* conf) {
+  po::options_description opts("Configuration options");
+  opts.add_options()
+        ("reference,r",po::value<vector<string> >(), "[REQD] Reference translation (tokenized text)")
+        ("weights,w",po::value<string>(), "[REQD] Weights files from current iterations")
+        ("kbest_repository,K",po::value<string>()->default_value("./kbest"),"K-best list repository (directory)")
+        ("input,i",po::value<string>()->default_value("-"), "Input file (mapper input, - is STDIN)")
+        ("evaluation_metric,m",po::value<string>()->default_value("IBM_BLEU"), "Evaluation metric (ibm_bleu, koehn_bleu, nist_bleu, ter, meteor, etc.)")
+        ("kbest_size,k",po::value<unsigned>()->default_value(1500u), "Top k-hypotheses to extract")
+        ("candidate_pairs,G", po::value<unsigned>()->default_value(5000u), "Number of pairs to sample per hypothesis (Gamma)")
+        ("best_pairs,X", po::value<unsigned>()->default_value(50u), "Number of pairs, ranked by magnitude of objective delta, to retain (Xi)")
+        ("random_seed,S", po::value<uint32_t>(), "Random seed (if not specified, /dev/random will be used)")
+        ("regularization_strength,C",po::value<double>()->default_value(500.0), "l2 regularization strength")
+        ("l1",po::value<double>()->default_value(0.0), "l1 regularization strength")
+        ("regularize_to_weights,y",po::value<double>()->default_value(5000.0), "Differences in learned weights to previous weights are penalized with an l2 penalty with this strength; 0.0 = no effect")
+        ("memory_buffers",po::value<unsigned>()->default_value(100), "Number of memory buffers (LBFGS)")
+        ("interpolate_with_weights",po::value<double>()->default_value(1.0), "[deprecated] Output weights are p*w + (1-p)*w_prev; 1.0 = no effect")
+        ("threads,j",po::value<int>()->default_value(1), "Number of threads")
+        ("help,h", "Help");
+  po::options_description dcmdline_options;
+  dcmdline_options.add(opts);
+  po::store(parse_command_line(argc, argv, dcmdline_options), *conf);
+  bool flag = false;
+  if (!conf->count("reference")) {
+    cerr << "Please specify one or more references using -r <REF.TXT>\n";
+    flag = true;
+  }
+  if (!conf->count("weights")) {
+    cerr << "Please specify weights using -w <WEIGHTS.TXT>\n";
+    flag = true;
+  }
+  if (flag || conf->count("help")) {
+    cerr << dcmdline_options << endl;
+    exit(1);
+  }
+}
+
+struct SampledPair {
+  bool y;
+  vector<pair<string, weight_t> > x;  // sorted by feature name
+};
+
+// updates the k-best list of the sentence in the repository and samples
+// its training pairs
+void SampleSentence(const string& file,
+                    const int sent_id,
+                    const vector<weight_t>& weights,
+                    const string& kbest_repo,
+                    const unsigned kbest_size,
+                    const unsigned gamma,
+                    const unsigned xi,
+                    const uint32_t seed,
+                    const DocumentScorer& ds,
+                    const EvaluationMetric* metric,
+                    vector<SampledPair>* pairs) {
+  ReadFile rf(file);
+  ostringstream os;
+  os << kbest_repo << "/kbest." << sent_id;
+  const string kbest_file = os.str() + ".bin";
+  const string text_kbest_file = os.str() + ".txt.gz";
+  const bool import_text = !FileExists(kbest_file) && FileExists(text_kbest_file);
+  training::CandidatePool J_i(kbest_file);
+  if (import_text) {  // repository of an older version
+    training::CandidateSet cs;
+    cs.ReadFromFile(text_kbest_file);
+    for (unsigned i = 0; i < cs.size(); ++i)
+      J_i.Add(cs[i]);
+  }
+  Hypergraph hg;
+  HypergraphIO::ReadFromJSON(rf.stream(), &hg);
+  hg.Reweight(weights);
+  J_i.AddKBestCandidates(hg, kbest_size, ds[sent_id]);
+  J_i.Flush();
+
+  vector<TrainingInstance> v;
+  MT19937 rng(SentenceSeed(seed, sent_id));
+  Sample(gamma, xi, J_i, metric, &rng, &v);
+  pairs->resize(v.size());
+  for (unsigned i = 0; i < v.size(); ++i) {
+    (*pairs)[i].y = v[i].y;
+    SortFeaturesByName(v[i].x, &(*pairs)[i].x);
+  }
+}
+
+// assigns ids to the features in the order in which mr_pro_reduce sees
+// them, which is the order of the sums in the objective
+struct LocalFeatures {
+  LocalFeatures() : names(1) {}  // 0 is the bias
+  int Convert(const string& name) {
+    unordered_map<string, int>::iterator it = ids.find(name);
+    if (it != ids.end()) return it->second;
+    ids[name] = names.size();
+    names.push_back(name);
+    return names.size() - 1;
+  }
+  vector<string> names;
+  unordered_map<string, int> ids;
+};
+
+int main(int argc, char** argv) {
+  po::variables_map conf;
+  InitCommandLine(argc, argv, &conf);
+  const int threads = max(1, conf["threads"].as<int>());
+  uint32_t seed = 0;
+  if (conf.count("random_seed"))
+    seed = conf["random_seed"].as<uint32_t>();
+  if (!seed)
+    seed = MT19937::GetTrulyRandomSeed();
+  const double C = conf["regularization_strength"].as<double>();
+  const double C1 = conf["l1"].as<double>();
+  const double T = conf["regularize_to_weights"].as<double>();
+  assert(C >= 0.0);
+  const double psi = conf["interpolate_with_weights"].as<double>();
+  if (psi < 0.0 || psi > 1.0) { cerr << "Invalid interpolation weight: " << psi << endl; return 1; }
+  const string evaluation_metric = conf["evaluation_metric"].as<string>();
+
+  EvaluationMetric* metric = EvaluationMetric::Instance(evaluation_metric);
+  DocumentScorer ds(metric, conf["reference"].as<vector<string> >());
+  cerr << "Loaded " << ds.size() << " references for scoring with " << evaluation_metric << endl;
+
+  vector<string> files;
+  vector<int> sent_ids;
+  {
+    ReadFile in_read(conf["input"].as<string>());
+    istream &in=*in_read.stream();
+    string line;
+    while(getline(in, line)) {
+      if (line.empty()) continue;
+      istringstream is(line);
+      int sent_id;
+      string file;
+      // path-to-file (JSON) sent_id
+      is >> file >> sent_id;
+      files.push_back(file);
+      sent_ids.push_back(sent_id);
+    }
+  }
+  const unsigned kbest_size = conf["kbest_size"].as<unsigned>();
+  const unsigned gamma = conf["candidate_pairs"].as<unsigned>();
+  const unsigned xi = conf["best_pairs"].as<unsigned>();
+  vector<weight_t> weights;
+  vector<string> weight_names;
+  Weights::InitFromFile(conf["weights"].as<string>(), &weights, &weight_names);
+  const string kbest_repo = conf["kbest_repository"].as<string>();
+  MkDirP(kbest_repo);
+
+  TD::SetThreadSafe();
+  FD::SetThreadSafe();
+  vector<vector<SampledPair> > pairs(files.size());
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+  for (int i = 0; i < files.size(); ++i)
+    SampleSentence(files[i], sent_ids[i], weights, kbest_repo, kbest_size, gamma, xi, seed, ds, metric, &pairs[i]);
+
+  // the corpus the reducer would read from the mapper output, followed by
+  // the features that are only in the weights file
+  LocalFeatures feats;
+  PairwiseCorpus training, testing;
+  SparseVector<weight_t> x, negx;
+  for (unsigned i = 0; i < pairs.size(); ++i) {
+    for (unsigned j = 0; j < pairs[i].size(); ++j) {
+      const SampledPair& p = pairs[i][j];
+      x.clear();
+      negx.clear();
+      for (unsigned k = 0; k < p.x.size(); ++k) {
+        const int fid = feats.Convert(p.x[k].first);
+        x.set_value(fid, p.x[k].second);
+        negx.set_value(fid, -p.x[k].second);
+      }
+      training.push_back(make_pair(p.y, x));
+      training.push_back(make_pair(!p.y, negx));
+    }
+    vector<SampledPair>().swap(pairs[i]);
+  }
+  vector<weight_t> prev_x(feats.names.size());
+  for (unsigned i = 0; i < weight_names.size(); ++i) {
+    const int fid = feats.Convert(weight_names[i]);
+    prev_x.resize(feats.names.size());
+    prev_x[fid] = weights[FD::Convert(weight_names[i])];
+  }
+  vector<weight_t> x_out = prev_x;  // x[0] is bias
+  cerr << "         Number of features: " << x_out.size() << endl;
+  cerr << "Number of training examples: " << training.size() << endl;
+
+  const double tppl = LearnParameters(training, testing, C, C1, T, conf["memory_buffers"].as<unsigned>(), threads, prev_x, &x_out);
+  for (int i = 1; i < x_out.size(); ++i)
+    x_out[i] = (x_out[i] * psi) + prev_x[i] * (1.0 - psi);
+  WriteTrainingSummary(C, tppl, vector<pair<double, double> >(), vector<double>(), &cout);
+  vector<weight_t> w(FD::NumFeats());
+  for (unsigned i = 1; i < x_out.size(); ++i) {
+    const int fid = FD::Convert(feats.names[i]);
+    w.resize(FD::NumFeats());
+    w[fid] = x_out[i];
+  }
+  Weights::WriteToFile("-", w);
+  return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/sh
+# pro_iteration must learn the same weights as the map/reduce pipeline it
+# replaces, given the same seed, with one thread or several.
+# The k-best lists and references are those of the dpmert tests.
+srcdir=${srcdir:-.}
+DATA=$srcdir/../dpmert/test_data
+WEIGHTS=$srcdir/test_data/weights
+TMP=`mktemp -d ${TMPDIR:-/tmp}/pro_iteration_test.XXXXXX` || exit 1
+trap 'rm -rf $TMP' 0
+
+for i in 0 1; do echo "$DATA/$i.json.gz $i"; done > $TMP/agenda
+REFS="-r $DATA/c2e.txt.0 -r $DATA/c2e.txt.1"
+OPTS="-k 300 -S 7"
+LEARN="-C 500 -y 5000"
+
+./mr_pro_map $REFS -w $WEIGHTS -K $TMP/kbest_mr $OPTS < $TMP/agenda 2> /dev/null | \
+  ./mr_pro_reduce -w $WEIGHTS $LEARN 2> /dev/null | sort > $TMP/mr || exit 1
+for j in 1 2; do
+  ./pro_iteration $REFS -w $WEIGHTS -K $TMP/kbest_$j $OPTS $LEARN -j $j < $TMP/agenda 2> /dev/null | \
+    sort > $TMP/it$j || exit 1
+  if ! cmp -s $TMP/mr $TMP/it$j; then
+    echo "pro_iteration -j $j and mr_pro_map | mr_pro_reduce learned different weights:"
+    diff $TMP/mr $TMP/it$j
+    exit 1
+  fi
+done
+test `grep -vc '^#' $TMP/mr` -gt 0 || exit 1
+echo "pro_iteration learned the weights of mr_pro_map | mr_pro_reduce"
@@ -0,0 +1,127 @@
+#include "pro_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+
+#include "candidate_pool.h"
+#include "fdict.h"
+#include "ns.h"
+#include "tdict.h"
+
+using namespace std;
+
+struct DiffOrder {
+  bool operator()(const TrainingInstance& a, const TrainingInstance& b) const {
+    return a.gdiff > b.gdiff;
+  }
+};
+
+#ifdef DEBUGGING_PRO
+ostream& operator<<(ostream& os, const TrainingInstance& d) {
+  return os << d.gdiff << " y=" << d.y << "\tA:" << TD::GetString(d.a) << "\n\tB: " << TD::GetString(d.b) << "\n\tX: " << d.x;
+}
+#endif
+
+uint32_t SentenceSeed(uint32_t seed, int sent_id) {
+  // finalizer of splitmix64, so that neighbouring sentences get unrelated
+  // sequences
+  uint64_t z = (static_cast<uint64_t>(seed) << 32) | static_cast<uint32_t>(sent_id);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  const uint32_t s = static_cast<uint32_t>(z);
+  return s ? s : 1;  // 0 would ask MT19937 for a truly random seed
+}
+
+double LengthDifferenceStdDev(const training::CandidatePool& J_i, int n, MT19937* rng) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    const size_t a = rng->inclusive(0, J_i.size() - 1)();
+    const size_t b = rng->inclusive(0, J_i.size() - 1)();
+    if (a == b) { --i; continue; }
+    double p = J_i.Length(a);
+    p -= J_i.Length(b);
+    sum += p * p;  // mean is 0 by construction
+  }
+  return max(sqrt(sum / n), 2.0);
+};
+
+void Sample(const int gamma,
+            const unsigned xi,
+            const training::CandidatePool& J_i,
+            const EvaluationMetric* metric,
+            MT19937* rng,
+            vector<TrainingInstance>* pv) {
+  const double len_stddev = LengthDifferenceStdDev(J_i, 5000, rng);
+  const bool invert_score = metric->IsErrorMetric();
+  vector<TrainingInstance> v1, v2;
+  float avg_diff = 0;
+  const double z_score_threshold=2;
+  SufficientStats sa, sb;
+  SparseVector<weight_t> fa, fb;
+  for (int i = 0; i < gamma; ++i) {
+    const size_t a = rng->inclusive(0, J_i.size() - 1)();
+    const size_t b = rng->inclusive(0, J_i.size() - 1)();
+    if (a == b) { --i; continue; }
+    double z_score = fabs(((int)J_i.Length(a) - (int)J_i.Length(b)) / len_stddev);
+    // variation on Nakov et al. (2011)
+    if (z_score > z_score_threshold) { --i; continue; }
+    J_i.Stats(a, &sa);
+    J_i.Stats(b, &sb);
+    float ga = metric->ComputeScore(sa);
+    float gb = metric->ComputeScore(sb);
+    bool positive = gb < ga;
+    if (invert_score) positive = !positive;
+    const float gdiff = fabs(ga - gb);
+    //cerr << ((int)J_i.Length(a) - (int)J_i.Length(b)) << endl;
+    //cerr << (ga - gb) << endl;
+    if (!gdiff) continue;
+    avg_diff += gdiff;
+    J_i.Features(a, &fa);
+    J_i.Features(b, &fb);
+    SparseVector<weight_t> xdiff = (fa - fb).erase_zeros();
+    if (xdiff.empty()) {
+      vector<WordID> ea, eb;
+      J_i.Yield(a, &ea);
+      J_i.Yield(b, &eb);
+      cerr << "Empty diff:\n  " << TD::GetString(ea) << endl << "x=" << fa << endl;
+      cerr << "  " << TD::GetString(eb) << endl << "x=" << fb << endl;
+      continue;
+    }
+    v1.push_back(TrainingInstance(xdiff, positive, gdiff));
+#ifdef DEBUGGING_PRO
+    J_i.Yield(a, &v1.back().a);
+    J_i.Yield(b, &v1.back().b);
+    cerr << "N: " << v1.back() << endl;
+#endif
+  }
+  avg_diff /= v1.size();
+
+  for (unsigned i = 0; i < v1.size(); ++i) {
+    double p = 1.0 / (1.0 + exp(-avg_diff - v1[i].gdiff));
+    // cerr << "avg_diff=" << avg_diff << "  gdiff=" << v1[i].gdiff << "  p=" << p << endl;
+    if (rng->next() < p) v2.push_back(v1[i]);
+  }
+  vector<TrainingInstance>::iterator mid = v2.begin() + xi;
+  if (xi > v2.size()) mid = v2.end();
+  partial_sort(v2.begin(), mid, v2.end(), DiffOrder());
+  copy(v2.begin(), mid, back_inserter(*pv));
+#ifdef DEBUGGING_PRO
+  if (v2.size() >= 5) {
+    for (int i =0; i < (mid - v2.begin()); ++i) {
+      cerr << v2[i] << endl;
+    }
+    cerr << pv->back() << endl;
+  }
+#endif
+}
+
+void SortFeaturesByName(const SparseVector<weight_t>& x,
+                        vector<pair<string, weight_t> >* feats) {
+  feats->clear();
+  for (SparseVector<weight_t>::const_iterator it = x.begin(); it != x.end(); ++it)
+    feats->push_back(make_pair(FD::Convert(it->first), it->second));
+  sort(feats->begin(), feats->end());
+}
@@ -0,0 +1,50 @@
+#ifndef _PRO_SAMPLER_H_
+#define _PRO_SAMPLER_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sampler.h"
+#include "sparse_vector.h"
+#include "weights.h"
+
+class EvaluationMetric;
+namespace training { class CandidatePool; }
+
+// This is Figure 4 (Algorithm Sampler) from Hopkins&May (2011), shared by
+// mr_pro_map and pro_iteration.
+
+struct TrainingInstance {
+  TrainingInstance(const SparseVector<weight_t>& feats, bool positive, float diff) : x(feats), y(positive), gdiff(diff) {}
+  SparseVector<weight_t> x;
+#undef DEBUGGING_PRO
+#ifdef DEBUGGING_PRO
+  std::vector<WordID> a;
+  std::vector<WordID> b;
+#endif
+  bool y;
+  float gdiff;
+};
+
+// the random sequence of sentence sent_id; it depends only on the seed and
+// the sentence, not on the order (or the process) in which the sentences
+// are sampled
+uint32_t SentenceSeed(uint32_t seed, int sent_id);
+
+double LengthDifferenceStdDev(const training::CandidatePool& J_i, int n, MT19937* rng);
+
+// appends the (at most xi) sampled pairs of J_i to pv
+void Sample(const int gamma,
+            const unsigned xi,
+            const training::CandidatePool& J_i,
+            const EvaluationMetric* metric,
+            MT19937* rng,
+            std::vector<TrainingInstance>* pv);
+
+// the features of x ordered by name, which is the order in which they are
+// written to (and so read back from) the mapper output
+void SortFeaturesByName(const SparseVector<weight_t>& x,
+                        std::vector<std::pair<std::string, weight_t> >* feats);
+
+#endif
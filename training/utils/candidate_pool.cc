@@ -0,0 +1,355 @@
+#include "candidate_pool.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "verbose.h"
+#include "tdict.h"
+#include "fdict.h"
+#include "hg.h"
+#include "kbest.h"
+#include "murmur_hash3.h"
+#include "viterbi.h"
+
+using namespace std;
+
+namespace training {
+
+// File layout (native byte order), one chunk per Flush():
+//   uint32 magic, uint32 #words, uint32 #features, uint32 #candidates,
+//   uint64 size of the rest of the chunk,
+//   metric id, words, feature names (each a NUL-terminated string),
+//   candidates: uint64 hash, uint32 #words, uint32 #features, uint32 #stats,
+//               uint32 word ids, (uint32 feature id, double value) pairs,
+//               float stats
+// Word and feature ids are positions in the tables of all previous chunks.
+// The hash is the first half of MurmurHash3_x64_128 (seed kHashSeed) of the
+// uint32 word ids followed by the (uint32 feature id, rounded double value)
+// pairs, so it does not change with the platform or the boost version.
+static const uint32_t kMagic = 0x4c504443;  // "CDPL"
+static const size_t kChunkHeaderSize = 4 * sizeof(uint32_t) + sizeof(uint64_t);
+static const size_t kRecordHeaderSize = sizeof(uint64_t) + 3 * sizeof(uint32_t);
+static const size_t kFeatureSize = sizeof(uint32_t) + sizeof(double);
+static const uint32_t kHashSeed = 0x9e3779b9;
+
+template <typename T>
+static inline T Peek(const char* p) {
+  T x;
+  memcpy(&x, p, sizeof(T));
+  return x;
+}
+
+template <typename T>
+static inline void Put(const T& x, string* out) {
+  out->append(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+CandidatePool::CandidatePool(const string& file) :
+    file_(file),
+    map_(NULL),
+    map_size_(),
+    valid_size_(),
+    flushed_(),
+    flushed_words_(),
+    flushed_feats_() {
+  Map();
+}
+
+CandidatePool::~CandidatePool() {
+  if (map_) munmap(const_cast<char*>(map_), map_size_);
+}
+
+void CandidatePool::Map() {
+  const int fd = open(file_.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    cerr << "Can't stat " << file_ << endl;
+    exit(1);
+  }
+  map_size_ = st.st_size;
+  if (map_size_ > 0) {
+    void* m = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) {
+      cerr << "Can't map " << file_ << endl;
+      exit(1);
+    }
+    map_ = static_cast<const char*>(m);
+  }
+  close(fd);
+
+  size_t pos = 0;
+  while (pos < map_size_) {
+    const size_t len = ReadChunk(pos);
+    if (!len) break;
+    pos += len;
+  }
+  valid_size_ = pos;
+  flushed_words_ = words_.size();
+  flushed_feats_ = feats_.size();
+  if (valid_size_ < map_size_)
+    cerr << "Ignoring incomplete data at the end of " << file_ << endl;
+  if (!SILENT) cerr << "Mapped " << records_.size() << " candidates from " << file_ << endl;
+}
+
+// returns the size of the chunk at pos, or 0 if it is incomplete
+size_t CandidatePool::ReadChunk(size_t pos) {
+  if (map_size_ - pos < kChunkHeaderSize) return 0;
+  const char* p = map_ + pos;
+  if (Peek<uint32_t>(p) != kMagic) return 0;
+  const unsigned num_words = Peek<uint32_t>(p + 4);
+  const unsigned num_feats = Peek<uint32_t>(p + 8);
+  const unsigned num_cands = Peek<uint32_t>(p + 12);
+  const uint64_t len = Peek<uint64_t>(p + 16);
+  if (map_size_ - pos - kChunkHeaderSize < len) return 0;
+  p += kChunkHeaderSize;
+
+  metric_id_ = p;
+  p += metric_id_.size() + 1;
+  for (unsigned i = 0; i < num_words; ++i) {
+    const WordID w = TD::Convert(p);
+    local_words_[w] = words_.size();
+    words_.push_back(w);
+    p += strlen(p) + 1;
+  }
+  for (unsigned i = 0; i < num_feats; ++i) {
+    const int fid = FD::Convert(p);
+    local_feats_[fid] = feats_.size();
+    feats_.push_back(fid);
+    p += strlen(p) + 1;
+  }
+  for (unsigned i = 0; i < num_cands; ++i) {
+    Record r;
+    const uint64_t hash = Peek<uint64_t>(p);
+    r.num_words = Peek<uint32_t>(p + 8);
+    r.num_feats = Peek<uint32_t>(p + 12);
+    r.num_stats = Peek<uint32_t>(p + 16);
+    r.words = p + kRecordHeaderSize;
+    index_.insert(make_pair(hash, records_.size()));
+    records_.push_back(r);
+    p = r.words + r.num_words * sizeof(uint32_t) + r.num_feats * kFeatureSize + r.num_stats * sizeof(float);
+  }
+  return kChunkHeaderSize + len;
+}
+
+unsigned CandidatePool::Length(size_t i) const {
+  if (i < records_.size()) return records_[i].num_words;
+  return added_[i - records_.size()].words.size();
+}
+
+void CandidatePool::Yield(size_t i, vector<WordID>* ewords) const {
+  if (i < records_.size()) {
+    const Record& r = records_[i];
+    ewords->resize(r.num_words);
+    for (unsigned j = 0; j < r.num_words; ++j)
+      (*ewords)[j] = words_[Peek<uint32_t>(r.words + j * sizeof(uint32_t))];
+  } else {
+    const Entry& e = added_[i - records_.size()];
+    ewords->resize(e.words.size());
+    for (unsigned j = 0; j < e.words.size(); ++j)
+      (*ewords)[j] = words_[e.words[j]];
+  }
+}
+
+void CandidatePool::Features(size_t i, SparseVector<double>* fmap) const {
+  fmap->clear();
+  if (i < records_.size()) {
+    const Record& r = records_[i];
+    const char* p = r.words + r.num_words * sizeof(uint32_t);
+    for (unsigned j = 0; j < r.num_feats; ++j, p += kFeatureSize)
+      fmap->set_value(feats_[Peek<uint32_t>(p)], Peek<double>(p + sizeof(uint32_t)));
+  } else {
+    const Entry& e = added_[i - records_.size()];
+    for (unsigned j = 0; j < e.feats.size(); ++j)
+      fmap->set_value(feats_[e.feats[j].first], e.feats[j].second);
+  }
+}
+
+void CandidatePool::Stats(size_t i, SufficientStats* stats) const {
+  stats->id_ = metric_id_;
+  if (i < records_.size()) {
+    const Record& r = records_[i];
+    const char* p = r.words + r.num_words * sizeof(uint32_t) + r.num_feats * kFeatureSize;
+    stats->fields.resize(r.num_stats);
+    if (r.num_stats) memcpy(&stats->fields[0], p, r.num_stats * sizeof(float));
+  } else {
+    stats->fields = added_[i - records_.size()].stats;
+  }
+}
+
+void CandidatePool::Get(size_t i, Candidate* c) const {
+  Yield(i, &c->ewords);
+  Features(i, &c->fmap);
+  Stats(i, &c->eval_feats);
+}
+
+void CandidatePool::Encode(const vector<WordID>& ewords, const SparseVector<double>& fmap, Entry* e) {
+  e->words.resize(ewords.size());
+  for (unsigned i = 0; i < ewords.size(); ++i) {
+    pair<unordered_map<WordID, unsigned>::iterator, bool> r =
+      local_words_.insert(make_pair(ewords[i], words_.size()));
+    if (r.second) words_.push_back(ewords[i]);
+    e->words[i] = r.first->second;
+  }
+  e->feats.clear();
+  for (SparseVector<double>::const_iterator it = fmap.begin(); it != fmap.end(); ++it) {
+    if (!it->second) continue;
+    pair<unordered_map<int, unsigned>::iterator, bool> r =
+      local_feats_.insert(make_pair(static_cast<int>(it->first), feats_.size()));
+    if (r.second) feats_.push_back(it->first);
+    e->feats.push_back(make_pair(r.first->second, it->second));
+  }
+  sort(e->feats.begin(), e->feats.end());
+
+  // the hash only depends on the file-local ids, so it can be stored
+  string key;
+  for (unsigned i = 0; i < e->words.size(); ++i)
+    Put<uint32_t>(e->words[i], &key);
+  for (unsigned i = 0; i < e->feats.size(); ++i) {
+    Put<uint32_t>(e->feats[i].first, &key);
+    Put<double>(ApproxVectorHasher::round(e->feats[i].second), &key);
+  }
+  uint64_t h[2];
+  cdec::MurmurHash3_x64_128(key.data(), key.size(), kHashSeed, h);
+  e->hash = h[0];
+}
+
+bool CandidatePool::Equals(size_t i, const Entry& e) const {
+  if (i >= records_.size()) {
+    const Entry& o = added_[i - records_.size()];
+    if (o.words != e.words || o.feats.size() != e.feats.size()) return false;
+    for (unsigned j = 0; j < e.feats.size(); ++j)
+      if (o.feats[j].first != e.feats[j].first ||
+          ApproxVectorHasher::round(o.feats[j].second) != ApproxVectorHasher::round(e.feats[j].second))
+        return false;
+    return true;
+  }
+  const Record& r = records_[i];
+  if (r.num_words != e.words.size() || r.num_feats != e.feats.size()) return false;
+  const char* p = r.words;
+  for (unsigned j = 0; j < r.num_words; ++j, p += sizeof(uint32_t))
+    if (Peek<uint32_t>(p) != e.words[j]) return false;
+  for (unsigned j = 0; j < r.num_feats; ++j, p += kFeatureSize)
+    if (Peek<uint32_t>(p) != e.feats[j].first ||
+        ApproxVectorHasher::round(Peek<double>(p + sizeof(uint32_t))) != ApproxVectorHasher::round(e.feats[j].second))
+      return false;
+  return true;
+}
+
+bool CandidatePool::Contains(const Entry& e) const {
+  pair<unordered_multimap<uint64_t, unsigned>::const_iterator,
+       unordered_multimap<uint64_t, unsigned>::const_iterator> r = index_.equal_range(e.hash);
+  for (; r.first != r.second; ++r.first)
+    if (Equals(r.first->second, e)) return true;
+  return false;
+}
+
+void CandidatePool::Insert(Entry* e) {
+  index_.insert(make_pair(e->hash, size()));
+  added_.push_back(Entry());
+  added_.back().words.swap(e->words);
+  added_.back().feats.swap(e->feats);
+  added_.back().stats.swap(e->stats);
+  added_.back().hash = e->hash;
+}
+
+bool CandidatePool::Add(const Candidate& c) {
+  Entry e;
+  Encode(c.ewords, c.fmap, &e);
+  if (Contains(e)) return false;
+  if (metric_id_.empty()) metric_id_ = c.eval_feats.id_;
+  e.stats = c.eval_feats.fields;
+  Insert(&e);
+  return true;
+}
+
+size_t CandidatePool::AddKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer) {
+  KBest::KBestDerivations<vector<WordID>, ESentenceTraversal> kbest(hg, kbest_size);
+
+  const size_t first = size();
+  vector<vector<WordID> > hyps;
+  for (unsigned i = 0; i < kbest_size; ++i) {
+    const KBest::KBestDerivations<vector<WordID>, ESentenceTraversal>::Derivation* d =
+      kbest.LazyKthBest(hg.nodes_.size() - 1, i);
+    if (!d) break;
+    Entry e;
+    Encode(d->yield, d->feature_values, &e);
+    if (Contains(e)) continue;
+    Insert(&e);
+    hyps.push_back(d->yield);
+  }
+  // only the new candidates are scored
+  if (scorer && hyps.size()) {
+    vector<SufficientStats> stats;
+    scorer->EvaluateBatch(hyps, &stats);
+    if (metric_id_.empty()) metric_id_ = stats[0].id_;
+    for (unsigned i = 0; i < stats.size(); ++i)
+      added_[first - records_.size() + i].stats.swap(stats[i].fields);
+  }
+  if (!SILENT) cerr << "  added " << hyps.size() << " new candidates, pool size=" << size() << endl;
+  return hyps.size();
+}
+
+void CandidatePool::Flush() {
+  if (flushed_ == added_.size()) return;
+  string buf;
+  buf += metric_id_;
+  buf += '\0';
+  for (size_t i = flushed_words_; i < words_.size(); ++i) {
+    buf += TD::Convert(words_[i]);
+    buf += '\0';
+  }
+  for (size_t i = flushed_feats_; i < feats_.size(); ++i) {
+    buf += FD::Convert(feats_[i]);
+    buf += '\0';
+  }
+  for (size_t i = flushed_; i < added_.size(); ++i) {
+    const Entry& e = added_[i];
+    Put<uint64_t>(e.hash, &buf);
+    Put<uint32_t>(e.words.size(), &buf);
+    Put<uint32_t>(e.feats.size(), &buf);
+    Put<uint32_t>(e.stats.size(), &buf);
+    for (unsigned j = 0; j < e.words.size(); ++j)
+      Put<uint32_t>(e.words[j], &buf);
+    for (unsigned j = 0; j < e.feats.size(); ++j) {
+      Put<uint32_t>(e.feats[j].first, &buf);
+      Put<double>(e.feats[j].second, &buf);
+    }
+    for (unsigned j = 0; j < e.stats.size(); ++j)
+      Put<float>(e.stats[j], &buf);
+  }
+  string header;
+  Put<uint32_t>(kMagic, &header);
+  Put<uint32_t>(words_.size() - flushed_words_, &header);
+  Put<uint32_t>(feats_.size() - flushed_feats_, &header);
+  Put<uint32_t>(added_.size() - flushed_, &header);
+  Put<uint64_t>(buf.size(), &header);
+
+  // drop an incomplete chunk left by an earlier writer
+  if (valid_size_ < map_size_ && truncate(file_.c_str(), valid_size_) != 0) {
+    cerr << "Can't truncate " << file_ << endl;
+    exit(1);
+  }
+  ofstream out(file_.c_str(), ios::out | ios::binary | ios::app);
+  out.write(header.data(), header.size());
+  out.write(buf.data(), buf.size());
+  out.close();
+  if (!out) {
+    cerr << "Failed to write candidates to " << file_ << endl;
+    exit(1);
+  }
+  valid_size_ += header.size() + buf.size();
+  flushed_ = added_.size();
+  flushed_words_ = words_.size();
+  flushed_feats_ = feats_.size();
+}
+
+}
@@ -0,0 +1,106 @@
+#ifndef _CANDIDATE_POOL_H_
+#define _CANDIDATE_POOL_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_map; using std::tr1::unordered_multimap; }
+#endif
+
+#include "ns.h"
+#include "wordid.h"
+#include "sparse_vector.h"
+#include "candidate_set.h"
+
+class Hypergraph;
+
+namespace training {
+
+// A CandidatePool is the binary, append-only counterpart of a CandidateSet
+// that is kept on disk between iterations (e.g. the k-best repository of
+// PRO). The file is a sequence of chunks, one per call to Flush(), each with
+// the words and feature names it introduces (so the file does not depend
+// on the TD/FD ids of the process that wrote it) followed by the new
+// candidates: yield, features, sufficient statistics, and a hash used to
+// detect duplicates. Existing candidates are memory-mapped and only decoded
+// when they are accessed, so opening a pool and adding a k-best list costs
+// time proportional to the number of candidates, not to their size.
+class CandidatePool {
+ public:
+  // maps file if it exists; a truncated last chunk (e.g. from a killed
+  // process) is ignored and overwritten by the next Flush()
+  explicit CandidatePool(const std::string& file);
+  ~CandidatePool();
+
+  size_t size() const { return records_.size() + added_.size(); }
+
+  // number of words in the yield of candidate i
+  unsigned Length(size_t i) const;
+  void Yield(size_t i, std::vector<WordID>* ewords) const;
+  void Features(size_t i, SparseVector<double>* fmap) const;
+  void Stats(size_t i, SufficientStats* stats) const;
+  void Get(size_t i, Candidate* c) const;
+
+  // adds c (which must already be scored) unless it is in the pool
+  bool Add(const Candidate& c);
+  // adds the (scored) k-best derivations of hg that are not in the pool,
+  // returns the number of new candidates
+  size_t AddKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer = NULL);
+  // appends the candidates added since the last Flush() to the file
+  void Flush();
+
+ private:
+  // a candidate in terms of the file-local word and feature ids; the
+  // features are sorted by id
+  struct Entry {
+    std::vector<unsigned> words;
+    std::vector<std::pair<unsigned, double> > feats;
+    std::vector<float> stats;
+    uint64_t hash;
+  };
+  // a candidate in the mapped file
+  struct Record {
+    const char* words;  // num_words uint32 ids, then the features and stats
+    unsigned num_words;
+    unsigned num_feats;
+    unsigned num_stats;
+  };
+
+  void Map();
+  size_t ReadChunk(size_t pos);
+  void Encode(const std::vector<WordID>& ewords, const SparseVector<double>& fmap, Entry* e);
+  bool Contains(const Entry& e) const;
+  bool Equals(size_t i, const Entry& e) const;
+  void Insert(Entry* e);
+
+  std::string file_;
+  const char* map_;
+  size_t map_size_;
+  size_t valid_size_;        // bytes of complete chunks in the file
+
+  std::vector<Record> records_;
+  std::vector<Entry> added_;
+  size_t flushed_;           // entries of added_ already in the file
+  std::string metric_id_;
+
+  // file-local word and feature ids
+  std::vector<WordID> words_;
+  std::vector<int> feats_;
+  std::unordered_map<WordID, unsigned> local_words_;
+  std::unordered_map<int, unsigned> local_feats_;
+  size_t flushed_words_, flushed_feats_;
+
+  std::unordered_multimap<uint64_t, unsigned> index_;  // hash -> candidate
+
+  CandidatePool(const CandidatePool&);
+  void operator=(const CandidatePool&);
+};
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include "candidate_pool.h"
+#include "murmur_hash3.h"
+#include "tdict.h"
+#include "fdict.h"
+
+using namespace std;
+
+training::Candidate MakeCandidate(const string& sentence, const string& f, double v, float stat) {
+  training::Candidate c;
+  TD::ConvertSentence(sentence, &c.ewords);
+  c.fmap.set_value(FD::Convert(f), v);
+  c.fmap.set_value(FD::Convert("Glue"), 1.0);
+  c.eval_feats.id_ = "TEST";
+  c.eval_feats.fields.push_back(stat);
+  c.eval_feats.fields.push_back(c.ewords.size());
+  return c;
+}
+
+void CheckCandidate(const training::CandidatePool& pool, size_t i, const training::Candidate& ref) {
+  training::Candidate c;
+  pool.Get(i, &c);
+  assert(pool.Length(i) == ref.ewords.size());
+  assert(c.ewords == ref.ewords);
+  assert(c.fmap == ref.fmap);
+  assert(c.eval_feats == ref.eval_feats);
+  assert(c.eval_feats.id_ == "TEST");
+}
+
+template <typename T>
+T Read(const char* p) {
+  T x;
+  memcpy(&x, p, sizeof(T));
+  return x;
+}
+
+// the hash of the first record of the file must be the documented one, so
+// that pools can be shared between platforms and builds
+void CheckStoredHash(const string& file) {
+  ifstream in(file.c_str(), ios::in | ios::binary);
+  const string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  const char* p = data.data();
+  const unsigned num_strings = 1 + Read<uint32_t>(p + 4) + Read<uint32_t>(p + 8);
+  p += 4 * sizeof(uint32_t) + sizeof(uint64_t);
+  for (unsigned i = 0; i < num_strings; ++i)
+    p += strlen(p) + 1;
+  const uint64_t stored = Read<uint64_t>(p);
+  const unsigned num_words = Read<uint32_t>(p + 8);
+  const unsigned num_feats = Read<uint32_t>(p + 12);
+  p += sizeof(uint64_t) + 3 * sizeof(uint32_t);
+  string key(p, num_words * sizeof(uint32_t));
+  p += key.size();
+  for (unsigned i = 0; i < num_feats; ++i) {
+    key.append(p, sizeof(uint32_t));
+    const double v = training::ApproxVectorHasher::round(Read<double>(p + sizeof(uint32_t)));
+    key.append(reinterpret_cast<const char*>(&v), sizeof(double));
+    p += sizeof(uint32_t) + sizeof(double);
+  }
+  uint64_t h[2];
+  cdec::MurmurHash3_x64_128(key.data(), key.size(), 0x9e3779b9, h);
+  assert(stored == h[0]);
+}
+
+int main() {
+  const string file = "candidate_pool_test.bin";
+  remove(file.c_str());
+  vector<training::Candidate> cs;
+  cs.push_back(MakeCandidate("a b c", "LM", -1.5, 0.5));
+  cs.push_back(MakeCandidate("a b d", "LM", -2.5, 0.25));
+  cs.push_back(MakeCandidate("a b c", "TM", -1.5, 0.75));
+  {
+    training::CandidatePool pool(file);
+    assert(pool.size() == 0);
+    for (unsigned i = 0; i < cs.size(); ++i)
+      assert(pool.Add(cs[i]));
+    assert(!pool.Add(cs[1]));
+    assert(!pool.Add(MakeCandidate("a b d", "LM", -2.5 + 1e-15, 0.25)));
+    assert(pool.size() == 3);
+    pool.Flush();
+    CheckCandidate(pool, 2, cs[2]);
+  }
+  CheckStoredHash(file);
+  {
+    training::CandidatePool pool(file);
+    assert(pool.size() == 3);
+    for (unsigned i = 0; i < cs.size(); ++i) {
+      CheckCandidate(pool, i, cs[i]);
+      assert(!pool.Add(cs[i]));
+    }
+    cs.push_back(MakeCandidate("x y", "NewFeature", 3.0, 1.0));
+    assert(pool.Add(cs.back()));
+    CheckCandidate(pool, 3, cs[3]);
+    pool.Flush();
+  }
+  {
+    // simulate a writer that was killed in the middle of a chunk
+    ofstream out(file.c_str(), ios::out | ios::binary | ios::app);
+    out.write("CDPLxxxx", 8);
+  }
+  {
+    training::CandidatePool pool(file);
+    assert(pool.size() == 4);
+    for (unsigned i = 0; i < cs.size(); ++i)
+      CheckCandidate(pool, i, cs[i]);
+    cs.push_back(MakeCandidate("x y z", "NewFeature", 1.0, 0.0));
+    assert(pool.Add(cs.back()));
+    pool.Flush();
+  }
+  {
+    training::CandidatePool pool(file);
+    assert(pool.size() == 5);
+    for (unsigned i = 0; i < cs.size(); ++i)
+      CheckCandidate(pool, i, cs[i]);
+  }
+  remove(file.c_str());
+  cerr << "candidate pool tests passed\n";
+  return 0;
+}
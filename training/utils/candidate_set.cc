@@ -1,12 +1,5 @@
 #include "candidate_set.h"
 
-#ifndef HAVE_OLD_CPP
-# include <unordered_set>
-#else
-# include <tr1/unordered_set>
-namespace std { using std::tr1::unordered_set; }
-#endif
-
 #include <boost/functional/hash.hpp>
 
 #include "verbose.h"
@@ -22,52 +15,6 @@ using namespace std;
 
 namespace training {
 
-struct ApproxVectorHasher {
-  static const size_t MASK = 0xFFFFFFFFull;
-  union UType {
-    double f;   // leave as double
-    size_t i;
-  };
-  static inline double round(const double x) {
-    UType t;
-    t.f = x;
-    size_t r = t.i & MASK;
-    if ((r << 1) > MASK)
-      t.i += MASK - r + 1;
-    else
-      t.i &= (1ull - MASK);
-    return t.f;
-  }
-  size_t operator()(const SparseVector<double>& x) const {
-    size_t h = 0x573915839;
-    for (SparseVector<double>::const_iterator it = x.begin(); it != x.end(); ++it) {
-      UType t;
-      t.f = it->second;
-      if (t.f) {
-        size_t z = (t.i >> 32);
-        boost::hash_combine(h, it->first);
-        boost::hash_combine(h, z);
-      }
-    }
-    return h;
-  }
-};
-
-struct ApproxVectorEquals {
-  bool operator()(const SparseVector<double>& a, const SparseVector<double>& b) const {
-    SparseVector<double>::const_iterator bit = b.begin();
-    for (SparseVector<double>::const_iterator ait = a.begin(); ait != a.end(); ++ait) {
-      if (bit == b.end() ||
-          ait->first != bit->first ||
-          ApproxVectorHasher::round(ait->second) != ApproxVectorHasher::round(bit->second))
-        return false;
-      ++bit;
-    }
-    if (bit != b.end()) return false;
-    return true;
-  }
-};
-
 struct CandidateCompare {
   bool operator()(const Candidate& a, const Candidate& b) const {
     ApproxVectorEquals eq;
@@ -134,56 +81,72 @@ void CandidateSet::ReadFromFile(const string& file) {
     getline(in, feats);
     getline(in, ss);
     assert(in);
-    cs.push_back(Candidate());
-    TD::ConvertSentence(cand, &cs.back().ewords);
-    ParseSparseVector(feats, 0, &cs.back().fmap);
-    cs.back().eval_feats = SufficientStats(ss);
+    Candidate c;
+    TD::ConvertSentence(cand, &c.ewords);
+    ParseSparseVector(feats, 0, &c.fmap);
+    c.eval_feats = SufficientStats(ss);
+    AddUnique(&c);
   }
   if(!SILENT) cerr << "  read " << cs.size() << " candidates\n";
 }
 
-void CandidateSet::Dedup() {
-  if(!SILENT) cerr << "Dedup in=" << cs.size();
-  unordered_set<Candidate, CandidateHasher, CandidateCompare> u;
-  while(cs.size() > 0) {
-    u.insert(cs.back());
-    cs.pop_back();
-  }
-  unordered_set<Candidate, CandidateHasher, CandidateCompare>::iterator it = u.begin();
-  while (it != u.end()) {
-    cs.push_back(*it);
-    it = u.erase(it);
-  }
-  if(!SILENT) cerr << "  out=" << cs.size() << endl;
+bool CandidateSet::AddUnique(Candidate* c) {
+  const size_t h = CandidateHasher()(*c);
+  CandidateCompare eq;
+  pair<unordered_multimap<size_t, unsigned>::iterator,
+       unordered_multimap<size_t, unsigned>::iterator> r = index.equal_range(h);
+  for (; r.first != r.second; ++r.first)
+    if (eq(cs[r.first->second], *c)) return false;
+  index.insert(make_pair(h, cs.size()));
+  cs.push_back(Candidate());
+  cs.back().swap(*c);
+  return true;
+}
+
+// scores cs[first..] with one batched call so that metrics backed by
+// external processes can keep the whole k-best list in flight
+void CandidateSet::ScoreFrom(size_t first, const SegmentEvaluator* scorer) {
+  if (!scorer || first >= cs.size()) return;
+  vector<vector<WordID> > hyps(cs.size() - first);
+  for (size_t i = first; i < cs.size(); ++i)
+    hyps[i - first] = cs[i].ewords;
+  vector<SufficientStats> stats;
+  scorer->EvaluateBatch(hyps, &stats);
+  for (size_t i = first; i < cs.size(); ++i)
+    cs[i].eval_feats.swap(stats[i - first]);
 }
 
 void CandidateSet::AddKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer) {
   KBest::KBestDerivations<vector<WordID>, ESentenceTraversal> kbest(hg, kbest_size);
 
+  const size_t first = cs.size();
   for (unsigned i = 0; i < kbest_size; ++i) {
     const KBest::KBestDerivations<vector<WordID>, ESentenceTraversal>::Derivation* d =
       kbest.LazyKthBest(hg.nodes_.size() - 1, i);
     if (!d) break;
-    cs.push_back(Candidate(d->yield, d->feature_values));
-    if (scorer)
-      scorer->Evaluate(d->yield, &cs.back().eval_feats);
+    Candidate c(d->yield, d->feature_values);
+    AddUnique(&c);
   }
-  Dedup();
+  // only the new candidates are scored
+  ScoreFrom(first, scorer);
+  if(!SILENT) cerr << "Added " << (cs.size() - first) << " new candidates, size=" << cs.size() << endl;
 }
 
 void CandidateSet::AddUniqueKBestCandidates(const Hypergraph& hg, size_t kbest_size, const SegmentEvaluator* scorer) {
   typedef KBest::KBestDerivations<vector<WordID>, ESentenceTraversal, KBest::FilterUnique> K;
   K kbest(hg, kbest_size);
 
+  const size_t first = cs.size();
   for (unsigned i = 0; i < kbest_size; ++i) {
     const K::Derivation* d =
       kbest.LazyKthBest(hg.nodes_.size() - 1, i);
     if (!d) break;
-    cs.push_back(Candidate(d->yield, d->feature_values));
-    if (scorer)
-      scorer->Evaluate(d->yield, &cs.back().eval_feats);
+    Candidate c(d->yield, d->feature_values);
+    AddUnique(&c);
   }
-  Dedup();
+  // only the new candidates are scored
+  ScoreFrom(first, scorer);
+  if(!SILENT) cerr << "Added " << (cs.size() - first) << " new candidates, size=" << cs.size() << endl;
 }
 
 }
@@ -3,6 +3,14 @@
 
 #include <vector>
 #include <algorithm>
+#include <boost/functional/hash.hpp>
+
+#ifndef HAVE_OLD_CPP
+# include <unordered_map>
+#else
+# include <tr1/unordered_map>
+namespace std { using std::tr1::unordered_multimap; }
+#endif
 
 #include "ns.h"
 #include "wordid.h"
@@ -12,6 +20,54 @@ class Hypergraph;
 
 namespace training {
 
+// hashing and comparison of feature vectors that treat values which differ
+// only in their lowest bits as equal
+struct ApproxVectorHasher {
+  static const size_t MASK = 0xFFFFFFFFull;
+  union UType {
+    double f;   // leave as double
+    size_t i;
+  };
+  static inline double round(const double x) {
+    UType t;
+    t.f = x;
+    size_t r = t.i & MASK;
+    if ((r << 1) > MASK)
+      t.i += MASK - r + 1;
+    else
+      t.i &= (1ull - MASK);
+    return t.f;
+  }
+  size_t operator()(const SparseVector<double>& x) const {
+    size_t h = 0x573915839;
+    for (SparseVector<double>::const_iterator it = x.begin(); it != x.end(); ++it) {
+      UType t;
+      t.f = it->second;
+      if (t.f) {
+        size_t z = (t.i >> 32);
+        boost::hash_combine(h, it->first);
+        boost::hash_combine(h, z);
+      }
+    }
+    return h;
+  }
+};
+
+struct ApproxVectorEquals {
+  bool operator()(const SparseVector<double>& a, const SparseVector<double>& b) const {
+    SparseVector<double>::const_iterator bit = b.begin();
+    for (SparseVector<double>::const_iterator ait = a.begin(); ait != a.end(); ++ait) {
+      if (bit == b.end() ||
+          ait->first != bit->first ||
+          ApproxVectorHasher::round(ait->second) != ApproxVectorHasher::round(bit->second))
+        return false;
+      ++bit;
+    }
+    if (bit != b.end()) return false;
+    return true;
+  }
+};
+
 struct Candidate {
   Candidate() {}
   Candidate(const std::vector<WordID>& e, const SparseVector<double>& fm) :
@@ -51,8 +107,11 @@ class CandidateSet {
   // TODO add code to draw k samples
 
  private:
-  void Dedup();
+  void ScoreFrom(size_t first, const SegmentEvaluator* scorer);
+  // appends c unless it is already in the set
+  bool AddUnique(Candidate* c);
   std::vector<Candidate> cs;
+  std::unordered_multimap<size_t, unsigned> index;  // hash -> position in cs
 };
 
 }
@@ -0,0 +1,89 @@
+#include "decoder_threads.h"
+
+#include <cassert>
+#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "fdict.h"
+#include "tdict.h"
+#include "verbose.h"
+
+using namespace std;
+
+namespace {
+// the decoder (and the per thread observer) of the calling thread; OpenMP may
+// give a parallel region fewer threads than requested (OMP_THREAD_LIMIT,
+// OMP_DYNAMIC, nesting), so they cannot be chosen by sentence
+int ThreadNum() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+}
+
+DecoderThreads::DecoderThreads(istream* config, int num_threads) : next_id_() {
+#ifndef _OPENMP
+  if (num_threads > 1) {
+    cerr << "Compiled without OpenMP support, using 1 decoder thread\n";
+    num_threads = 1;
+  }
+#endif
+  assert(num_threads > 0);
+  if (num_threads > 1) {
+    TD::SetThreadSafe();
+    FD::SetThreadSafe();
+    SetSilent(true);
+  }
+  ostringstream os;
+  os << config->rdbuf();
+  const string ini = os.str();
+  for (int t = 0; t < num_threads; ++t) {
+    istringstream in(ini);
+    decoders_.push_back(boost::shared_ptr<Decoder>(new Decoder(&in)));
+  }
+}
+
+void DecoderThreads::SyncWeights() {
+  const vector<weight_t>& weights = decoders_[0]->CurrentWeightVector();
+  for (unsigned t = 1; t < decoders_.size(); ++t)
+    decoders_[t]->CurrentWeightVector() = weights;
+}
+
+void DecoderThreads::Decode(const vector<string>& corpus,
+                            const vector<DecoderObserver*>& observers) {
+  const int num_sents = corpus.size();
+  const bool per_sentence = observers.size() >= num_sents;
+  assert(observers.size() == decoders_.size() || per_sentence);
+  SyncWeights();
+  const int n = decoders_.size();
+#pragma omp parallel for schedule(static, 1) num_threads(n)
+  for (int i = 0; i < num_sents; ++i) {
+    const int t = ThreadNum();
+    Decoder& decoder = *decoders_[t];
+    decoder.SetId(next_id_ + i);
+    decoder.Decode(corpus[i], observers[per_sentence ? i : t]);
+  }
+  next_id_ += num_sents;
+}
+
+void DecoderThreads::Decode(const vector<string>& corpus,
+                            const vector<int>& ids,
+                            const vector<unsigned>& which,
+                            const vector<DecoderObserver*>& observers) {
+  const int num_sents = which.size();
+  const bool per_sentence = observers.size() >= num_sents;
+  assert(observers.size() == decoders_.size() || per_sentence);
+  SyncWeights();
+  const int n = decoders_.size();
+#pragma omp parallel for schedule(static, 1) num_threads(n)
+  for (int i = 0; i < num_sents; ++i) {
+    const int t = ThreadNum();
+    Decoder& decoder = *decoders_[t];
+    decoder.SetId(ids[which[i]]);
+    decoder.Decode(corpus[which[i]], observers[per_sentence ? i : t]);
+  }
+}
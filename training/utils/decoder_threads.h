@@ -0,0 +1,64 @@
+#ifndef _DECODER_THREADS_H_
+#define _DECODER_THREADS_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "decoder.h"
+
+// DecoderThreads decodes sentences with several decoders in parallel (one
+// OpenMP thread per decoder) in a single process, so the CRF optimizers and
+// MIRA can use all cores of a machine without MPI (or combine both).
+//
+// Every decoder loads its own copy of the models in the configuration, since
+// a Decoder cannot be shared between threads. All decoders use the weights
+// of the first one (CurrentWeightVector()), which are copied to the others
+// at the start of each call to Decode.
+//
+// Each thread decodes with its own decoder (decoder t for OpenMP thread t)
+// and sends the notifications to its own observer, observers[t], or, if
+// there is one observer per sentence, to the observer of the sentence. The
+// sentences are dealt to the threads round-robin, so with a full team of
+// size() threads sentence i is decoded by decoder i % size().
+class DecoderThreads {
+ public:
+  // reads the decoder configuration (cdec.ini) from config
+  DecoderThreads(std::istream* config, int num_threads);
+
+  int size() const { return decoders_.size(); }
+  Decoder& operator[](int t) { return *decoders_[t]; }
+  std::vector<weight_t>& CurrentWeightVector() { return decoders_[0]->CurrentWeightVector(); }
+
+  // decodes all of corpus; the sentence ids continue from the previous call,
+  // as if a single decoder had been used
+  void Decode(const std::vector<std::string>& corpus,
+              const std::vector<DecoderObserver*>& observers);
+
+  // decodes corpus[which[i]] with sentence id ids[which[i]]
+  void Decode(const std::vector<std::string>& corpus,
+              const std::vector<int>& ids,
+              const std::vector<unsigned>& which,
+              const std::vector<DecoderObserver*>& observers);
+
+ private:
+  void SyncWeights();
+
+  std::vector<boost::shared_ptr<Decoder> > decoders_;
+  int next_id_;
+};
+
+// sums the elements of *v into (*v)[0], adding pairs of partial sums in
+// parallel (log2(v->size()) rounds)
+template <typename T>
+void TreeReduce(std::vector<T>* v) {
+  const int n = v->size();
+  for (int stride = 1; stride < n; stride *= 2) {
+#pragma omp parallel for num_threads(n / (2 * stride) + 1)
+    for (int i = 0; i < n - stride; i += 2 * stride)
+      (*v)[i] += (*v)[i + stride];
+  }
+}
+
+#endif
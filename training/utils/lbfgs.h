@@ -11,6 +11,8 @@
 #include <iostream>
 #include <sstream>
 
+#include "vector_ops.h"
+
 namespace scitbx {
 
 //! Limited-memory Broyden-Fletcher-Goldfarb-Shanno (LBFGS) %minimizer.
@@ -147,6 +149,103 @@ namespace lbfgs {
       return x;
     }
 
+    // Unit-stride kernels of the loops over all the variables. The generic
+    // versions are the original loops; those for double precision, used by
+    // LBFGSOptimizer, are vectorized and, for long vectors, multithreaded
+    // (see vector_ops.h).
+    template <typename FloatType, typename SizeType>
+    FloatType dot_unit(SizeType n, const FloatType* dx, const FloatType* dy)
+    {
+      SizeType i, m;
+      FloatType dtemp(0);
+      m = n % 5;
+      for (i = 0; i < m; i++) {
+        dtemp += dx[i] * dy[i];
+      }
+      for (; i < n;) {
+        dtemp += dx[i] * dy[i]; i++;
+        dtemp += dx[i] * dy[i]; i++;
+        dtemp += dx[i] * dy[i]; i++;
+        dtemp += dx[i] * dy[i]; i++;
+        dtemp += dx[i] * dy[i]; i++;
+      }
+      return dtemp;
+    }
+
+    inline
+    double dot_unit(std::size_t n, const double* dx, const double* dy)
+    {
+      return VecDot(n, dx, dy);
+    }
+
+    // dy += da * dx
+    template <typename FloatType, typename SizeType>
+    void axpy_unit(SizeType n, FloatType da, const FloatType* dx, FloatType* dy)
+    {
+      SizeType i, m;
+      m = n % 4;
+      for (i = 0; i < m; i++) {
+        dy[i] += da * dx[i];
+      }
+      for (; i < n;) {
+        dy[i] += da * dx[i]; i++;
+        dy[i] += da * dx[i]; i++;
+        dy[i] += da * dx[i]; i++;
+        dy[i] += da * dx[i]; i++;
+      }
+    }
+
+    inline
+    void axpy_unit(std::size_t n, double da, const double* dx, double* dy)
+    {
+      VecAxpy(n, da, dx, dy);
+    }
+
+    // dz = dx + da * dy
+    template <typename FloatType, typename SizeType>
+    void axpy_to_unit(SizeType n, const FloatType* dx, FloatType da, const FloatType* dy, FloatType* dz)
+    {
+      for (SizeType i = 0; i < n; i++) {
+        dz[i] = dx[i] + da * dy[i];
+      }
+    }
+
+    inline
+    void axpy_to_unit(std::size_t n, const double* dx, double da, const double* dy, double* dz)
+    {
+      VecAxpyTo(n, dx, da, dy, dz);
+    }
+
+    // dx *= da
+    template <typename FloatType, typename SizeType>
+    void scale_unit(SizeType n, FloatType da, FloatType* dx)
+    {
+      for (SizeType i = 0; i < n; i++) {
+        dx[i] *= da;
+      }
+    }
+
+    inline
+    void scale_unit(std::size_t n, double da, double* dx)
+    {
+      VecScale(n, da, dx);
+    }
+
+    // dx[i] *= dd[i]
+    template <typename FloatType, typename SizeType>
+    void mul_unit(SizeType n, const FloatType* dd, FloatType* dx)
+    {
+      for (SizeType i = 0; i < n; i++) {
+        dx[i] *= dd[i];
+      }
+    }
+
+    inline
+    void mul_unit(std::size_t n, const double* dd, double* dx)
+    {
+      VecMul(n, dd, dx);
+    }
+
     // This class implements an algorithm for multi-dimensional line search.
     template <typename FloatType, typename SizeType = std::size_t>
     class mcsrch
@@ -435,10 +534,7 @@ namespace lbfgs {
         }
         // Compute the initial gradient in the search direction
         // and check that s is a descent direction.
-        dginit = FloatType(0);
-        for (SizeType j = 0; j < n; j++) {
-          dginit += g[j] * s[is0+j];
-        }
+        dginit = dot_unit(n, g, s + is0);
         if (dginit >= FloatType(0)) {
           throw error_search_direction_not_descent();
         }
@@ -489,18 +585,13 @@ namespace lbfgs {
           // Evaluate the function and gradient at stp
           // and compute the directional derivative.
           // We return to main program to obtain F and G.
-          for (SizeType j = 0; j < n; j++) {
-            x[j] = wa[j] + stp * s[is0+j];
-          }
+          axpy_to_unit(n, wa, stp, s + is0, x);
           info=-1;
           break;
         }
         info = 0;
         nfev++;
-        FloatType dg(0);
-        for (SizeType j = 0; j < n; j++) {
-          dg += g[j] * s[is0+j];
-        }
+        FloatType dg = dot_unit(n, g, s + is0);
         FloatType ftest1 = finit + stp*dgtest;
         // Test for convergence.
         if ((brackt && (stp <= stmin || stp >= stmax)) || infoc == 0) {
@@ -772,7 +863,7 @@ namespace lbfgs {
       SizeType iy0,
       SizeType incy)
     {
-      SizeType i, ix, iy, m;
+      SizeType i, ix, iy;
       if (n == 0) return;
       if (da == FloatType(0)) return;
       if  (!(incx == 1 && incy == 1)) {
@@ -785,16 +876,7 @@ namespace lbfgs {
         }
         return;
       }
-      m = n % 4;
-      for (i = 0; i < m; i++) {
-        dy[iy0+i] += da * dx[ix0+i];
-      }
-      for (; i < n;) {
-        dy[iy0+i] += da * dx[ix0+i]; i++;
-        dy[iy0+i] += da * dx[ix0+i]; i++;
-        dy[iy0+i] += da * dx[ix0+i]; i++;
-        dy[iy0+i] += da * dx[ix0+i]; i++;
-      }
+      axpy_unit(n, da, dx + ix0, dy + iy0);
     }
 
     template <typename FloatType, typename SizeType>
@@ -823,7 +905,7 @@ namespace lbfgs {
       SizeType iy0,
       SizeType incy)
     {
-      SizeType i, ix, iy, m;
+      SizeType i, ix, iy;
       FloatType dtemp(0);
       if (n == 0) return FloatType(0);
       if (!(incx == 1 && incy == 1)) {
@@ -836,18 +918,7 @@ namespace lbfgs {
         }
         return dtemp;
       }
-      m = n % 5;
-      for (i = 0; i < m; i++) {
-        dtemp += dx[ix0+i] * dy[iy0+i];
-      }
-      for (; i < n;) {
-        dtemp += dx[ix0+i] * dy[iy0+i]; i++;
-        dtemp += dx[ix0+i] * dy[iy0+i]; i++;
-        dtemp += dx[ix0+i] * dy[iy0+i]; i++;
-        dtemp += dx[ix0+i] * dy[iy0+i]; i++;
-        dtemp += dx[ix0+i] * dy[iy0+i]; i++;
-      }
-      return dtemp;
+      return dot_unit(n, dx + ix0, dy + iy0);
     }
 
     template <typename FloatType, typename SizeType>
@@ -1335,9 +1406,7 @@ namespace lbfgs {
           w[inmc] = w[n_ + cp] * sq;
           detail::daxpy(n_, -w[inmc], w, iycn, w);
         }
-        for (i = 0; i < n_; i++) {
-          w[i] *= diag[i];
-        }
+        detail::mul_unit(n_, diag, w);
         for (i = 0; i < bound; i++) {
           FloatType yr = detail::ddot(
             n_, w, iypt + cp * n_, SizeType(1), w, SizeType(0), SizeType(1));
@@ -1368,10 +1437,8 @@ namespace lbfgs {
     }
     nfun_ += nfev;
     npt = point*n_;
-    for (SizeType i = 0; i < n_; i++) {
-      w[ispt + npt + i] = stp_ * w[ispt + npt + i];
-      w[iypt + npt + i] = g[i] - w[i];
-    }
+    detail::scale_unit(n_, stp_, w + ispt + npt);
+    detail::axpy_to_unit(n_, g, FloatType(-1), w, w + iypt + npt);
     point++;
     if (point == m_) point = 0;
     return false;
@@ -0,0 +1,66 @@
+// measures the time per iteration spent by the LBFGS minimizer itself (the
+// two-loop recursion and the line search, not the objective) on a badly
+// conditioned separable quadratic:
+//   lbfgs_bench [number of variables] [iterations] [threads]
+// minimizer<double, unsigned> instantiates the original scalar loops, and
+// minimizer<double> (the one used by LBFGSOptimizer) the vector kernels.
+#include <sys/time.h>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include "lbfgs.h"
+#include "vector_ops.h"
+
+using namespace std;
+
+double Now() {
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// f(x) = sum_i a_i (x_i - i%7)^2
+double Evaluate(const vector<double>& a, const vector<double>& x, vector<double>* g) {
+  double f = 0;
+  for (size_t i = 0; i < x.size(); ++i) {
+    const double d = x[i] - static_cast<double>(i % 7);
+    f += a[i] * d * d;
+    (*g)[i] = 2 * a[i] * d;
+  }
+  return f;
+}
+
+template <typename SizeType>
+void Run(const char* name, const vector<double>& a, const unsigned iterations) {
+  const size_t n = a.size();
+  vector<double> x(n, 0.0), g(n);
+  scitbx::lbfgs::minimizer<double, SizeType> opt(n, 10);
+  double f = Evaluate(a, x, &g);
+  double secs = 0;
+  while (opt.iter() < iterations) {
+    const double t_start = Now();
+    opt.run(&x[0], f, &g[0]);
+    if (!opt.requests_f_and_g()) opt.run(&x[0], f, &g[0]);
+    secs += Now() - t_start;
+    f = Evaluate(a, x, &g);
+  }
+  cout << name << ": " << opt.iter() << " iterations, " << opt.nfun() << " evaluations, f=" << f << endl
+       << "  " << secs << " s, " << secs * 1000 / opt.iter() << " ms/iteration" << endl;
+}
+
+int main(int argc, char** argv) {
+  const size_t n = argc > 1 ? boost::lexical_cast<size_t>(argv[1]) : 1000000;
+  const unsigned iterations = argc > 2 ? boost::lexical_cast<unsigned>(argv[2]) : 20;
+  const int threads = argc > 3 ? boost::lexical_cast<int>(argv[3]) : 1;
+  SetVectorOpsThreads(threads);
+  vector<double> a(n);
+  for (size_t i = 0; i < n; ++i)
+    a[i] = 1.0 + (i * 7919 % 1000) / 10.0;  // condition number 100
+  cout << n << " variables, " << VectorOpsThreads() << " thread(s)" << endl;
+  Run<unsigned>("scalar", a, iterations);
+  Run<size_t>("vector", a, iterations);
+  return 0;
+}
@@ -2,7 +2,9 @@
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <vector>
 #include "lbfgs.h"
+#include "vector_ops.h"
 #include "sparse_vector.h"
 #include "fdict.h"
 
@@ -103,6 +105,40 @@ void TestSparseVector() {
   assert(g.size() == v.size());
 }
 
+void TestVectorOps() {
+  cerr << "Testing vector kernels.\n";
+  // long enough to be split among threads, with a partial block and lane
+  const size_t n = (1 << 19) + 13;
+  vector<double> x(n), y(n), z(n);
+  long double ref = 0;
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = sin(i * 0.001) * (1 + i % 3);
+    y[i] = cos(i * 0.002) / (1 + i % 5);
+    ref += static_cast<long double>(x[i]) * y[i];
+  }
+  SetVectorOpsThreads(1);
+  const double d1 = VecDot(n, &x[0], &y[0]);
+  assert(fabs(d1 - ref) < 1e-9 * fabs(ref));
+  SetVectorOpsThreads(3);
+  const double d3 = VecDot(n, &x[0], &y[0]);
+  cerr << "  dot=" << d1 << " (1 thread) " << d3 << " (3 threads)\n";
+  assert(d1 == d3);  // same order of summation
+  const double d13 = VecDot(13, &x[0], &y[0]);
+  double ref13 = 0;
+  for (size_t i = 0; i < 13; ++i) ref13 += x[i] * y[i];
+  assert(fabs(d13 - ref13) < 1e-12 * fabs(ref13));
+
+  z = y;
+  VecAxpy(n, 0.5, &x[0], &z[0]);
+  for (size_t i = 0; i < n; ++i) assert(z[i] == y[i] + 0.5 * x[i]);
+  VecAxpyTo(n, &x[0], -2.0, &y[0], &z[0]);
+  for (size_t i = 0; i < n; ++i) assert(z[i] == x[i] + -2.0 * y[i]);
+  VecMul(n, &x[0], &z[0]);
+  VecScale(n, 3.0, &z[0]);
+  for (size_t i = 0; i < n; ++i) assert(z[i] == (x[i] + -2.0 * y[i]) * x[i] * 3.0);
+  SetVectorOpsThreads(1);
+}
+
 int main() {
   double o1 = TestOptimizer();
   double o2 = TestPersistentOptimizer();
@@ -111,6 +147,7 @@ int main() {
     return 1;
   }
   TestSparseVector();
+  TestVectorOps();
   cerr << "SUCCESS\n";
   return 0;
 }
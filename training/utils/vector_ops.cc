@@ -0,0 +1,213 @@
+#include "vector_ops.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// every kernel is compiled once per instruction set and dispatched by the
+// dynamic loader (this needs ifunc support, i.e. glibc); contraction into
+// fused multiply-adds is turned off since it is only possible in some of
+// the versions and would make their results differ
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 && defined(__x86_64__) && defined(__linux__)
+# define VECTOR_OPS_KERNEL __attribute__((target_clones("avx512f", "avx2", "default"), optimize("fp-contract=off")))
+#elif defined(__GNUC__) && !defined(__clang__)
+# define VECTOR_OPS_KERNEL __attribute__((optimize("fp-contract=off")))
+#else
+# define VECTOR_OPS_KERNEL
+#endif
+
+namespace {
+
+// entries per block (16k of each operand)
+const size_t kBlockSize = 2048;
+// shorter vectors are not worth handing out to other threads
+const size_t kMinParallelSize = 1 << 18;
+
+int num_threads = 1;
+
+#ifdef __GNUC__
+// eight lanes, which the compiler maps to one AVX-512 register, two AVX2 or
+// four SSE2 registers; the lanes are added up the same way in all cases
+typedef double v8d __attribute__((vector_size(64)));
+#endif
+
+VECTOR_OPS_KERNEL
+double BlockDot(size_t n, const double* x, const double* y) {
+  double s[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t i = 0;
+#ifdef __GNUC__
+  v8d acc = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (; i + 8 <= n; i += 8) {
+    v8d a, b;
+    memcpy(&a, x + i, sizeof(a));
+    memcpy(&b, y + i, sizeof(b));
+    acc += a * b;
+  }
+  memcpy(s, &acc, sizeof(s));
+#else
+  for (; i + 8 <= n; i += 8)
+    for (int j = 0; j < 8; ++j)
+      s[j] += x[i + j] * y[i + j];
+#endif
+  for (; i < n; ++i)
+    s[i & 7] += x[i] * y[i];
+  return ((s[0] + s[4]) + (s[2] + s[6])) + ((s[1] + s[5]) + (s[3] + s[7]));
+}
+
+VECTOR_OPS_KERNEL
+void BlockAxpy(size_t n, double a, const double* x, double* y) {
+  size_t i = 0;
+#ifdef __GNUC__
+  for (; i + 8 <= n; i += 8) {
+    v8d u, v;
+    memcpy(&u, x + i, sizeof(u));
+    memcpy(&v, y + i, sizeof(v));
+    v += a * u;
+    memcpy(y + i, &v, sizeof(v));
+  }
+#endif
+  for (; i < n; ++i)
+    y[i] += a * x[i];
+}
+
+VECTOR_OPS_KERNEL
+void BlockAxpyTo(size_t n, const double* x, double a, const double* y, double* z) {
+  size_t i = 0;
+#ifdef __GNUC__
+  for (; i + 8 <= n; i += 8) {
+    v8d u, v;
+    memcpy(&u, x + i, sizeof(u));
+    memcpy(&v, y + i, sizeof(v));
+    u += a * v;
+    memcpy(z + i, &u, sizeof(u));
+  }
+#endif
+  for (; i < n; ++i)
+    z[i] = x[i] + a * y[i];
+}
+
+VECTOR_OPS_KERNEL
+void BlockScale(size_t n, double a, double* x) {
+  size_t i = 0;
+#ifdef __GNUC__
+  for (; i + 8 <= n; i += 8) {
+    v8d u;
+    memcpy(&u, x + i, sizeof(u));
+    u *= a;
+    memcpy(x + i, &u, sizeof(u));
+  }
+#endif
+  for (; i < n; ++i)
+    x[i] *= a;
+}
+
+VECTOR_OPS_KERNEL
+void BlockMul(size_t n, const double* d, double* x) {
+  size_t i = 0;
+#ifdef __GNUC__
+  for (; i + 8 <= n; i += 8) {
+    v8d u, v;
+    memcpy(&u, d + i, sizeof(u));
+    memcpy(&v, x + i, sizeof(v));
+    v *= u;
+    memcpy(x + i, &v, sizeof(v));
+  }
+#endif
+  for (; i < n; ++i)
+    x[i] *= d[i];
+}
+
+struct Axpy {
+  Axpy(double a_, const double* x_, double* y_) : a(a_), x(x_), y(y_) {}
+  void operator()(size_t start, size_t len) const { BlockAxpy(len, a, x + start, y + start); }
+  const double a;
+  const double* x;
+  double* y;
+};
+
+struct AxpyTo {
+  AxpyTo(const double* x_, double a_, const double* y_, double* z_) : x(x_), a(a_), y(y_), z(z_) {}
+  void operator()(size_t start, size_t len) const { BlockAxpyTo(len, x + start, a, y + start, z + start); }
+  const double* x;
+  const double a;
+  const double* y;
+  double* z;
+};
+
+struct Scale {
+  Scale(double a_, double* x_) : a(a_), x(x_) {}
+  void operator()(size_t start, size_t len) const { BlockScale(len, a, x + start); }
+  const double a;
+  double* x;
+};
+
+struct Mul {
+  Mul(const double* d_, double* x_) : d(d_), x(x_) {}
+  void operator()(size_t start, size_t len) const { BlockMul(len, d + start, x + start); }
+  const double* d;
+  double* x;
+};
+
+// applies op to the blocks of [0, n), in parallel if n is large enough
+template <class Op>
+void ForEachBlock(const size_t n, const Op& op) {
+  if (num_threads > 1 && n >= kMinParallelSize) {
+    const long blocks = (n + kBlockSize - 1) / kBlockSize;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (long b = 0; b < blocks; ++b) {
+      const size_t start = b * kBlockSize;
+      op(start, min(kBlockSize, n - start));
+    }
+  } else {
+    for (size_t start = 0; start < n; start += kBlockSize)
+      op(start, min(kBlockSize, n - start));
+  }
+}
+
+}
+
+void SetVectorOpsThreads(int threads) {
+  num_threads = max(1, threads);
+}
+
+int VectorOpsThreads() {
+  return num_threads;
+}
+
+double VecDot(size_t n, const double* x, const double* y) {
+  // the blocks are summed in order, whoever computed them
+  double s = 0;
+  if (num_threads > 1 && n >= kMinParallelSize) {
+    const long blocks = (n + kBlockSize - 1) / kBlockSize;
+    vector<double> partial(blocks);
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (long b = 0; b < blocks; ++b) {
+      const size_t start = b * kBlockSize;
+      partial[b] = BlockDot(min(kBlockSize, n - start), x + start, y + start);
+    }
+    for (long b = 0; b < blocks; ++b)
+      s += partial[b];
+  } else {
+    for (size_t start = 0; start < n; start += kBlockSize)
+      s += BlockDot(min(kBlockSize, n - start), x + start, y + start);
+  }
+  return s;
+}
+
+void VecAxpy(size_t n, double a, const double* x, double* y) {
+  ForEachBlock(n, Axpy(a, x, y));
+}
+
+void VecAxpyTo(size_t n, const double* x, double a, const double* y, double* z) {
+  ForEachBlock(n, AxpyTo(x, a, y, z));
+}
+
+void VecScale(size_t n, double a, double* x) {
+  ForEachBlock(n, Scale(a, x));
+}
+
+void VecMul(size_t n, const double* d, double* x) {
+  ForEachBlock(n, Mul(d, x));
+}
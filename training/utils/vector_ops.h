@@ -0,0 +1,37 @@
+#ifndef _VECTOR_OPS_H_
+#define _VECTOR_OPS_H_
+
+#include <cstddef>
+
+// Dense vector kernels for the batch optimizers (see lbfgs.h), whose
+// vectors have one entry per feature and so can be very long.
+//
+// On x86-64 with GCC, the kernels are compiled for AVX-512, AVX2 and the
+// baseline instruction set, and the best version for the CPU is chosen at
+// load time. Vectors are processed in blocks, and, if SetVectorOpsThreads
+// was given more than one thread, long vectors are processed by several
+// threads. Dot products are summed in the same order whatever the
+// instruction set or the number of threads, so the results (and thus the
+// optimization) do not depend on either.
+
+// number of threads used for vectors of at least a few hundred thousand
+// entries (1 by default)
+void SetVectorOpsThreads(int threads);
+int VectorOpsThreads();
+
+// returns sum_i x[i] * y[i]
+double VecDot(std::size_t n, const double* x, const double* y);
+
+// y += a * x
+void VecAxpy(std::size_t n, double a, const double* x, double* y);
+
+// z = x + a * y
+void VecAxpyTo(std::size_t n, const double* x, double a, const double* y, double* z);
+
+// x *= a
+void VecScale(std::size_t n, double a, double* x);
+
+// x[i] *= d[i]
+void VecMul(std::size_t n, const double* d, double* x);
+
+#endif
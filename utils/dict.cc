@@ -1,8 +1,23 @@
 #include "dict.h"
 
+#include <pthread.h>
 #include <string>
 #include <vector>
 
+namespace {
+  struct ReadLock {
+    explicit ReadLock(pthread_rwlock_t* lock) : lock_(lock) { pthread_rwlock_rdlock(lock_); }
+    ~ReadLock() { pthread_rwlock_unlock(lock_); }
+    pthread_rwlock_t* lock_;
+  };
+
+  struct WriteLock {
+    explicit WriteLock(pthread_rwlock_t* lock) : lock_(lock) { pthread_rwlock_wrlock(lock_); }
+    ~WriteLock() { pthread_rwlock_unlock(lock_); }
+    pthread_rwlock_t* lock_;
+  };
+}
+
 void TokenizeStringSeparator(
           const std::string& str,
           const std::string& separator,
@@ -25,3 +40,26 @@ void Dict::AsVector(const WordID& id, std::vector<std::string>* results) const {
   TokenizeStringSeparator(Convert(id), " ||| ", results);
 }
 
+
+WordID Dict::LockedConvert(const std::string& word, bool frozen) {
+  {
+    ReadLock lock(&lock_);
+    Map::const_iterator i = d_.find(word);
+    if (i != d_.end()) return i->second;
+  }
+  if (frozen) return 0;
+  // another thread may have added the word in the meantime
+  WriteLock lock(&lock_);
+  return UnlockedConvert(word, frozen);
+}
+
+const std::string& Dict::LockedConvert(const WordID& id) const {
+  ReadLock lock(&lock_);
+  assert(id <= (int)words_.size());
+  return words_[id-1];
+}
+
+int Dict::LockedMax() const {
+  ReadLock lock(&lock_);
+  return words_.size();
+}
@@ -4,7 +4,9 @@
 
 #include <cassert>
 #include <cstring>
+#include <pthread.h>
 
+#include <deque>
 #include <string>
 #include <vector>
 #include "hash.h"
@@ -15,12 +17,19 @@ class Dict {
  //HASH_MAP<std::string, WordID, boost::hash<std::string> > Map;
  HASH_MAP<std::string, WordID> Map;
  public:
-  Dict() : b0_("<bad0>") {
+  Dict() : b0_("<bad0>"), thread_safe_(false) {
     HASH_MAP_EMPTY(d_,"<bad1>");
-    words_.reserve(1000);
+    pthread_rwlock_init(&lock_, NULL);
   }
+  ~Dict() { pthread_rwlock_destroy(&lock_); }
 
-  inline int max() const { return words_.size(); }
+  // after this, the dictionary may be used by several threads at once (e.g.
+  // by the decoders of multithreaded training): lookups share a read lock
+  // and only the insertion of a new word takes the write lock. The strings
+  // never move, so the references returned by Convert stay valid.
+  void SetThreadSafe() { thread_safe_ = true; }
+
+  inline int max() const { return thread_safe_ ? LockedMax() : words_.size(); }
 
   static bool is_ws(char x) {
     return (x == ' ' || x == '\t');
@@ -47,16 +56,8 @@ class Dict {
   }
 
   inline WordID Convert(const std::string& word, bool frozen = false) {
-    Map::iterator i = d_.find(word);
-    if (i == d_.end()) {
-      if (frozen)
-        return 0;
-      words_.push_back(word);
-      d_[word] = words_.size();
-      return words_.size();
-    } else {
-      return i->second;
-    }
+    if (thread_safe_) return LockedConvert(word, frozen);
+    return UnlockedConvert(word, frozen);
   }
 
   inline WordID Convert(const std::vector<std::string>& words, bool frozen = false)
@@ -74,6 +75,7 @@ class Dict {
 
   inline const std::string& Convert(const WordID& id) const {
     if (id == 0) return b0_;
+    if (thread_safe_) return LockedConvert(id);
     assert(id <= (int)words_.size());
     return words_[id-1];
   }
@@ -83,9 +85,30 @@ class Dict {
   void clear() { words_.clear(); d_.clear(); }
 
  private:
+  inline WordID UnlockedConvert(const std::string& word, bool frozen) {
+    Map::iterator i = d_.find(word);
+    if (i == d_.end()) {
+      if (frozen)
+        return 0;
+      words_.push_back(word);
+      d_[word] = words_.size();
+      return words_.size();
+    } else {
+      return i->second;
+    }
+  }
+  WordID LockedConvert(const std::string& word, bool frozen);
+  const std::string& LockedConvert(const WordID& id) const;
+  int LockedMax() const;
+
   const std::string b0_;
-  std::vector<std::string> words_;
+  std::deque<std::string> words_;
   Map d_;
+  bool thread_safe_;
+  mutable pthread_rwlock_t lock_;
+
+  Dict(const Dict&);
+  void operator=(const Dict&);
 };
 
 #endif
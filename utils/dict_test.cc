@@ -3,6 +3,9 @@
 #include "fdict.h"
 
 #include <iostream>
+#include <sstream>
+#include <vector>
+#include <pthread.h>
 #define BOOST_TEST_MODULE CrpTest
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
@@ -22,6 +25,43 @@ BOOST_AUTO_TEST_CASE(Convert) {
   BOOST_CHECK_EQUAL(d.Convert(b), "bar");
 }
 
+static const int kNUM_WORDS = 1000;
+
+static void* ConvertWords(void* arg) {
+  Dict* d = static_cast<Dict*>(arg);
+  vector<WordID>* ids = new vector<WordID>;
+  for (int i = 0; i < kNUM_WORDS; ++i) {
+    ostringstream os;
+    os << "w" << i;
+    ids->push_back(d->Convert(os.str()));
+    if (d->Convert(ids->back()) != os.str()) ids->back() = 0;
+  }
+  return ids;
+}
+
+BOOST_AUTO_TEST_CASE(ThreadSafe) {
+  Dict d;
+  d.SetThreadSafe();
+  const int num_threads = 4;
+  vector<pthread_t> threads(num_threads);
+  for (int t = 0; t < num_threads; ++t)
+    pthread_create(&threads[t], NULL, ConvertWords, &d);
+  vector<vector<WordID>*> ids(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    void* result;
+    pthread_join(threads[t], &result);
+    ids[t] = static_cast<vector<WordID>*>(result);
+  }
+  BOOST_CHECK_EQUAL(d.max(), kNUM_WORDS);
+  for (int t = 0; t < num_threads; ++t) {
+    for (int i = 0; i < kNUM_WORDS; ++i) {
+      BOOST_CHECK((*ids[t])[i] > 0);
+      BOOST_CHECK_EQUAL((*ids[t])[i], (*ids[0])[i]);
+    }
+  }
+  for (int t = 0; t < num_threads; ++t) delete ids[t];
+}
+
 BOOST_AUTO_TEST_CASE(FDictTest) {
   int fid = FD::Convert("First");
   assert(fid > 0);
@@ -21,6 +21,10 @@ struct FD {
   static void Freeze() {
     frozen_ = true;
   }
+  // must be called before features are converted by several threads
+  static void SetThreadSafe() {
+    dict_.SetThreadSafe();
+  }
   static bool UsingPerfectHashFunction() {
 #ifdef HAVE_CMPH
     return hash_;
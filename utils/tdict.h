@@ -14,6 +14,10 @@ struct TD {
   static std::string GetString(const std::vector<WordID>& str);
   static std::string GetString(WordID const* i,WordID const* e);
   static int AppendString(const WordID& w, int pos, int bufsize, char* buffer);
+  // must be called before the dictionary is used by several threads
+  static void SetThreadSafe() {
+    dict_.SetThreadSafe();
+  }
   static unsigned int NumWords() {
     return dict_.max();
   }
@@ -1,24 +1,38 @@
 #include "timing_stats.h"
 
 #include <iostream>
+#include <pthread.h>
 #include "time.h" //cygwin needs
 
 #include "verbose.h"
 
 using namespace std;
 
+namespace {
+  // timers may run in several decoder threads at once
+  pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+  struct StatsLock {
+    StatsLock() { pthread_mutex_lock(&stats_mutex); }
+    ~StatsLock() { pthread_mutex_unlock(&stats_mutex); }
+  };
+}
+
 map<string, TimerInfo> Timer::stats;
 
-Timer::Timer(const string& timername) : start_t(clock()), cur(stats[timername]) {}
+Timer::Timer(const string& timername) : name(timername), start_t(clock()) {}
 
 Timer::~Timer() {
-  ++cur.calls;
   const clock_t end_t = clock();
   const double elapsed = (end_t - start_t) / 1000000.0;
+  StatsLock lock;
+  TimerInfo& cur = stats[name];
+  ++cur.calls;
   cur.total_time += elapsed;
 }
 
 void Timer::Summarize() {
+  StatsLock lock;
   if (!SILENT) {
     for (map<string, TimerInfo>::iterator it = stats.begin(); it != stats.end(); ++it) {
       cerr << it->first << ": " << it->second.total_time << " secs (" << it->second.calls << " calls)\n";
@@ -16,8 +16,8 @@ struct Timer {
   static void Summarize();
  private:
   static std::map<std::string, TimerInfo> stats;
+  std::string name;
   clock_t start_t;
-  TimerInfo& cur;
   Timer(const Timer& other);
   const Timer& operator=(const Timer& other);
 };
@@ -1,6 +1,10 @@
 #include <iostream>
+#include <sstream>
 #include <cmath>
 #include <utility>
+#include <vector>
+#include <algorithm>
+#include <map>
 #ifndef HAVE_OLD_CPP
 # include <unordered_map>
 #else
@@ -9,10 +13,13 @@ namespace std { using std::tr1::unordered_map; }
 #endif
 
 #include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/program_options.hpp>
 #include <boost/program_options/variables_map.hpp>
 
 #include "m.h"
+#include "alignment_commands.h"
+#include "alignment_io.h"
 #include "corpus_tools.h"
 #include "stringlib.h"
 #include "filelib.h"
@@ -29,7 +36,8 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("input,i",po::value<string>(),"Parallel corpus input file")
         ("reverse,r","Reverse estimation (swap source and target during training)")
         ("iterations,I",po::value<unsigned>()->default_value(5),"Number of iterations of EM training")
-        //("bidir,b", "Run bidirectional alignment")
+        ("bidir", "Train the models of both directions at once, over the same corpus, and write the symmetrized alignments")
+        ("symmetrize,s", po::value<string>()->default_value("grow-diag-final-and"), "With --bidir, how to combine the alignments of the two directions (an atools command: grow-diag-final-and, grow-diag-final, grow-diag, intersect, union)")
         ("favor_diagonal,d", "Use a static alignment distribution that assigns higher probabilities to alignments near the diagonal")
         ("prob_align_null", po::value<double>()->default_value(0.08), "When --favor_diagonal is set, what's the probability of a null alignment?")
         ("diagonal_tension,T", po::value<double>()->default_value(4.0), "How sharp or flat around the diagonal is the alignment distribution (<1 = flat >1 = sharp)")
@@ -38,12 +46,16 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
         ("alpha,a", po::value<double>()->default_value(0.01), "Hyperparameter for optional Dirichlet prior")
         ("no_null_word,N","Do not generate from a null token")
         ("output_parameters,p", po::value<string>(), "Write model parameters to file")
+        ("reverse_parameters,P", po::value<string>(), "With --bidir, write the parameters of the reverse model to file")
+        ("binary_parameters,b", po::value<string>(), "Also write the model parameters of -p to this file in binary form, which --force_align maps into memory instead of parsing it (with --force_align, converts the loaded parameters)")
+        ("single_precision", "Store the translation probabilities as floats")
         ("beam_threshold,t",po::value<double>()->default_value(-4),"When writing parameters, log_10 of beam threshold for writing parameter (-10000 to include everything, 0 max parameter only)")
         ("hide_training_alignments,H", "Hide training alignments (only useful if you want to use -x option and just compute testset statistics)")
         ("testset,x", po::value<string>(), "After training completes, compute the log likelihood of this set of sentence pairs under the learned model")
         ("no_add_viterbi,V","When writing model parameters, do not add Viterbi alignment points (may generate a grammar where some training sentence pairs are unreachable)")
-		("force_align,f",po::value<string>(), "Load previously written parameters to 'force align' input. Set --diagonal_tension and --mean_srclen_multiplier as estimated during training.")
-		("mean_srclen_multiplier,m",po::value<double>()->default_value(1), "When --force_align, use this source length multiplier");
+		("force_align,f",po::value<string>(), "Load previously written parameters (text or binary) to 'force align' input. Set --diagonal_tension and --mean_srclen_multiplier as estimated during training.")
+		("mean_srclen_multiplier,m",po::value<double>()->default_value(1), "When --force_align, use this source length multiplier")
+        ("threads,j",po::value<int>()->default_value(1), "Number of threads for the E step of training");
   po::options_description clo("Command line options");
   clo.add_options()
         ("config", po::value<string>(), "Configuration file")
@@ -67,11 +79,221 @@ bool InitCommandLine(int argc, char** argv, po::variables_map* conf) {
   return true;
 }
 
+// the training corpus, read (and converted to word ids) once for all the
+// iterations of EM; the words of sentence pair k are
+// words[starts[k] .. starts[k] + src_lens[k]) (source) followed by the
+// target words up to starts[k + 1]
+struct ParallelCorpus {
+  ParallelCorpus() : starts(1, 0) {}
+  size_t size() const { return src_lens.size(); }
+  const WordID* src(size_t k) const { return &words[starts[k]]; }
+  unsigned src_len(size_t k) const { return src_lens[k]; }
+  const WordID* trg(size_t k) const { return &words[starts[k] + src_lens[k]]; }
+  unsigned trg_len(size_t k) const { return starts[k + 1] - starts[k] - src_lens[k]; }
+  void Add(const vector<WordID>& s, const vector<WordID>& t) {
+    words.insert(words.end(), s.begin(), s.end());
+    words.insert(words.end(), t.begin(), t.end());
+    starts.push_back(words.size());
+    src_lens.push_back(s.size());
+  }
+  vector<WordID> words;
+  vector<size_t> starts;
+  vector<unsigned> src_lens;
+};
+
+// the settings of the E step in an iteration of EM
+struct EStepConfig {
+  bool reverse;
+  bool use_null;
+  bool favor_diagonal;
+  double prob_align_null;
+  double prob_align_not_null;
+  double diagonal_tension;
+  WordID kNULL;
+  bool final_iteration;
+  bool add_viterbi;
+  bool write_alignments;  // in the final iteration
+};
+
+// what a thread accumulates during the E step
+struct EStepStats {
+  EStepStats() : likelihood(), c0(), emp_feat(), toks(), counts(), viterbi() {}
+  double likelihood;
+  double c0;
+  double emp_feat;
+  double toks;
+  TTable* counts;  // the expected counts are added with Increment
+  TTable::Word2Word2Double* viterbi;
+};
+
+// computes the posteriors of the alignment links of a sentence pair under
+// the current model s2t, and adds them to the statistics (or, in the final
+// iteration, finds the Viterbi alignment)
+void EStep(const EStepConfig& c,
+           const TTable& s2t,
+           const WordID* src,
+           const unsigned src_size,
+           const WordID* trg,
+           const unsigned trg_size,
+           vector<double>* pprobs,
+           EStepStats* stats,
+           ostream* alignment) {
+  vector<double>& probs = *pprobs;
+  probs.resize(src_size + 1);
+  bool first_al = true;  // used for write_alignments
+  stats->toks += trg_size;
+  for (unsigned j = 0; j < trg_size; ++j) {
+    const WordID& f_j = trg[j];
+    double sum = 0;
+    double prob_a_i = 1.0 / (src_size + c.use_null);  // uniform (model 1)
+    if (c.use_null) {
+      if (c.favor_diagonal) prob_a_i = c.prob_align_null;
+      probs[0] = s2t.prob(c.kNULL, f_j) * prob_a_i;
+      sum += probs[0];
+    }
+    double az = 0;
+    if (c.favor_diagonal)
+      az = DiagonalAlignment::ComputeZ(j+1, trg_size, src_size, c.diagonal_tension) / c.prob_align_not_null;
+    for (unsigned i = 1; i <= src_size; ++i) {
+      if (c.favor_diagonal)
+        prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg_size, src_size, c.diagonal_tension) / az;
+      probs[i] = s2t.prob(src[i-1], f_j) * prob_a_i;
+      sum += probs[i];
+    }
+    if (c.final_iteration) {
+      if (c.add_viterbi || c.write_alignments) {
+        WordID max_i = 0;
+        double max_p = -1;
+        int max_index = -1;
+        if (c.use_null) {
+          max_i = c.kNULL;
+          max_index = 0;
+          max_p = probs[0];
+        }
+        for (unsigned i = 1; i <= src_size; ++i) {
+          if (probs[i] > max_p) {
+            max_index = i;
+            max_p = probs[i];
+            max_i = src[i-1];
+          }
+        }
+        if (c.write_alignments) {
+          if (max_index > 0) {
+            if (first_al) first_al = false; else *alignment << ' ';
+            if (c.reverse)
+              *alignment << j << '-' << (max_index - 1);
+            else
+              *alignment << (max_index - 1) << '-' << j;
+          }
+        }
+        TTable::Word2Word2Double& s2t_viterbi = *stats->viterbi;
+        if (s2t_viterbi.size() <= static_cast<unsigned>(max_i)) s2t_viterbi.resize(max_i + 1);
+        s2t_viterbi[max_i][f_j] = 1.0;
+      }
+    } else {
+      if (c.use_null) {
+        double count = probs[0] / sum;
+        stats->c0 += count;
+        stats->counts->Increment(c.kNULL, f_j, count);
+      }
+      for (unsigned i = 1; i <= src_size; ++i) {
+        const double p = probs[i] / sum;
+        stats->counts->Increment(src[i-1], f_j, p);
+        stats->emp_feat += DiagonalAlignment::Feature(j, i, trg_size, src_size) * p;
+      }
+    }
+    stats->likelihood += log(sum);
+  }
+}
+
+// the entries of the trained table that are written out: those within the
+// beam of the best translation of their source word, and the Viterbi links
+struct ParameterFilter {
+  ParameterFilter(const TTable& s2t, const TTable::Word2Word2Double& vit, const double beam) :
+      viterbi(vit), thresholds(s2t.num_rows()) {
+    for (unsigned e = 0; e < s2t.num_rows(); ++e) {
+      double max_p = -1;
+      for (size_t k = s2t.row_begin(e); k < s2t.row_end(e); ++k)
+        if (s2t.value(k) > max_p) max_p = s2t.value(k);
+      thresholds[e] = max_p * beam;
+    }
+  }
+  bool operator()(WordID e, WordID f, double p) const {
+    if (e == 0) return false;
+    return p > thresholds[e] || viterbi[e].find(f) != viterbi[e].end();
+  }
+  const TTable::Word2Word2Double& viterbi;
+  vector<double> thresholds;
+};
+
+typedef unordered_map<pair<short, short>, unsigned, boost::hash<pair<short, short> > > SizeCounts;
+
+// one direction of the alignment model, with the statistics of the corpus
+// that its training needs
+struct AlignmentModel {
+  AlignmentModel(bool rev, int threads) :
+      reverse(rev), diagonal_tension(), tot_len_ratio(), mean_srclen_multiplier(),
+      thread_viterbi(threads - 1) {
+    // TTable can't be copied, which vector(n) needs without C++11
+    for (int t = 1; t < threads; ++t)
+      thread_counts.push_back(boost::shared_ptr<TTable>(new TTable));
+  }
+  // sentence pair k of the corpus in this direction
+  const WordID* src(const ParallelCorpus& c, size_t k) const { return reverse ? c.trg(k) : c.src(k); }
+  unsigned src_len(const ParallelCorpus& c, size_t k) const { return reverse ? c.trg_len(k) : c.src_len(k); }
+  const WordID* trg(const ParallelCorpus& c, size_t k) const { return reverse ? c.src(k) : c.trg(k); }
+  unsigned trg_len(const ParallelCorpus& c, size_t k) const { return reverse ? c.src_len(k) : c.trg_len(k); }
+  bool reverse;
+  TTable s2t;
+  TTable::Word2Word2Double s2t_viterbi;
+  double diagonal_tension;
+  SizeCounts size_counts;
+  double tot_len_ratio;
+  double mean_srclen_multiplier;
+  // the counts of the threads other than thread 0 (see main)
+  vector<boost::shared_ptr<TTable> > thread_counts;
+  vector<TTable::Word2Word2Double> thread_viterbi;
+};
+
+// writes the parameters of a trained model as text and, if binary_file is
+// not empty, in binary form
+void WriteParameters(AlignmentModel* m, const double beam, const string& file, const string& binary_file) {
+  const TTable& s2t = m->s2t;
+  // words that are never the Viterbi link of any target word
+  if (m->s2t_viterbi.size() < s2t.num_rows()) m->s2t_viterbi.resize(s2t.num_rows());
+  const ParameterFilter keep(s2t, m->s2t_viterbi, beam);
+  WriteFile params_out(file);
+  for (unsigned eind = 1; eind < s2t.num_rows(); ++eind) {
+    const string& esym = TD::Convert(eind);
+    for (size_t k = s2t.row_begin(eind); k < s2t.row_end(eind); ++k) {
+      if (keep(eind, s2t.target(k), s2t.value(k))) {
+        *params_out << esym << ' ' << TD::Convert(s2t.target(k)) << ' ' << log(s2t.value(k)) << endl;
+      }
+    }
+  }
+  if (binary_file.size())
+    s2t.WriteBinary(binary_file, keep);
+}
+
+// combines the alignments of the two directions (both source-target, in
+// Pharaoh format) as atools -c would
+string Symmetrize(const string& forward, const string& reverse, Command* command) {
+  Array2D<bool> x;
+  command->Apply(*AlignmentIO::ReadPharaohAlignmentGrid(forward),
+                 *AlignmentIO::ReadPharaohAlignmentGrid(reverse), &x);
+  ostringstream os;
+  AlignmentIO::SerializePharaohFormat(x, &os);
+  string al = os.str();
+  al.resize(al.size() - 1);  // without the end of line
+  return al;
+}
+
 int main(int argc, char** argv) {
   po::variables_map conf;
   if (!InitCommandLine(argc, argv, &conf)) return 1;
   const string fname = conf["input"].as<string>();
   const bool reverse = conf.count("reverse") > 0;
+  const bool bidir = conf.count("bidir") > 0;
   const int ITERATIONS = (conf.count("force_align")) ? 0 : conf["iterations"].as<unsigned>();
   const double BEAM_THRESHOLD = pow(10.0, conf["beam_threshold"].as<double>());
   const bool use_null = (conf.count("no_null_word") == 0);
@@ -79,7 +301,6 @@ int main(int argc, char** argv) {
   const bool add_viterbi = (conf.count("no_add_viterbi") == 0);
   const bool variational_bayes = (conf.count("variational_bayes") > 0);
   const bool output_parameters = (conf.count("force_align")) ? false : conf.count("output_parameters");
-  double diagonal_tension = conf["diagonal_tension"].as<double>();
   bool optimize_tension = conf.count("optimize_tension");
   bool hide_training_alignments = (conf.count("hide_training_alignments") > 0);
   const bool write_alignments = (conf.count("force_align")) ? true : !hide_training_alignments;
@@ -94,167 +315,220 @@ int main(int argc, char** argv) {
     cerr << "--alpha must be > 0\n";
     return 1;
   }
-  
-  
-  TTable s2t, t2s;
-  TTable::Word2Word2Double s2t_viterbi;
-  unordered_map<pair<short, short>, unsigned, boost::hash<pair<short, short> > > size_counts;
-  double tot_len_ratio = 0;
-  double mean_srclen_multiplier = 0;
-  vector<double> probs;
-  
+  if (bidir && (reverse || testset.size())) {
+    cerr << "--bidir can't be used with --reverse, --force_align or --testset\n";
+    return 1;
+  }
+  const string heuristic = conf["symmetrize"].as<string>();
+  map<string, boost::shared_ptr<Command> > commands;
+  GetAlignmentCommands(&commands);
+  if (bidir && (commands.count(heuristic) == 0 || commands[heuristic]->Result() != 1 ||
+                !commands[heuristic]->RequiresTwoOperands())) {
+    cerr << "Don't understand --symmetrize " << heuristic << endl;
+    return 1;
+  }
+
+  const int threads = max(1, conf["threads"].as<int>());
+  // the model, and with --bidir the reverse model trained alongside
+  AlignmentModel model(reverse, threads), reverse_model(true, threads);
+  vector<AlignmentModel*> models(1, &model);
+  if (bidir) models.push_back(&reverse_model);
+  for (unsigned d = 0; d < models.size(); ++d) {
+    models[d]->diagonal_tension = conf["diagonal_tension"].as<double>();
+    models[d]->s2t.SetSinglePrecision(conf.count("single_precision"));
+  }
+
   if (conf.count("force_align")) {
 	// load model parameters
-	ReadFile s2t_f(conf["force_align"].as<string>());
-	s2t.DeserializeLogProbsFromText(s2t_f.stream());
-	mean_srclen_multiplier = conf["mean_srclen_multiplier"].as<double>();
+	const string params = conf["force_align"].as<string>();
+	if (TTable::IsBinaryFile(params)) {
+	  model.s2t.ReadBinary(params);
+	} else {
+	  ReadFile s2t_f(params);
+	  model.s2t.DeserializeLogProbsFromText(s2t_f.stream());
+	}
+	model.mean_srclen_multiplier = conf["mean_srclen_multiplier"].as<double>();
+	if (conf.count("binary_parameters"))
+	  model.s2t.WriteBinary(conf["binary_parameters"].as<string>());
   }
   
-  for (int iter = 0; iter < ITERATIONS; ++iter) {
-    const bool final_iteration = (iter == (ITERATIONS - 1));
-    cerr << "ITERATION " << (iter + 1) << (final_iteration ? " (FINAL)" : "") << endl;
+  ParallelCorpus corpus;
+  if (ITERATIONS > 0) {
     ReadFile rf(fname);
     istream& in = *rf.stream();
-    double likelihood = 0;
-    double denom = 0.0;
     int lc = 0;
     bool flag = false;
     string line;
-    string ssrc, strg;
     vector<WordID> src, trg;
-    double c0 = 0;
-    double emp_feat = 0;
-    double toks = 0;
-    while(true) {
-      getline(in, line);
-      if (!in) break;
+    while(getline(in, line)) {
       ++lc;
       if (lc % 1000 == 0) { cerr << '.'; flag = true; }
       if (lc %50000 == 0) { cerr << " [" << lc << "]\n" << flush; flag = false; }
-      src.clear(); trg.clear();
       CorpusTools::ReadLine(line, &src, &trg);
-      if (reverse) swap(src, trg);
       if (src.size() == 0 || trg.size() == 0) {
         cerr << "Error: " << lc << "\n" << line << endl;
         return 1;
       }
-      if (iter == 0)
-        tot_len_ratio += static_cast<double>(trg.size()) / static_cast<double>(src.size());
-      denom += trg.size();
-      probs.resize(src.size() + 1);
-      if (iter == 0)
-        ++size_counts[make_pair<short,short>(trg.size(), src.size())];
-      bool first_al = true;  // used for write_alignments
-      toks += trg.size();
-      for (unsigned j = 0; j < trg.size(); ++j) {
-        const WordID& f_j = trg[j];
-        double sum = 0;
-        double prob_a_i = 1.0 / (src.size() + use_null);  // uniform (model 1)
-        if (use_null) {
-          if (favor_diagonal) prob_a_i = prob_align_null;
-          probs[0] = s2t.prob(kNULL, f_j) * prob_a_i;
-          sum += probs[0];
-        }
-        double az = 0;
-        if (favor_diagonal)
-          az = DiagonalAlignment::ComputeZ(j+1, trg.size(), src.size(), diagonal_tension) / prob_align_not_null;
-        for (unsigned i = 1; i <= src.size(); ++i) {
-          if (favor_diagonal)
-            prob_a_i = DiagonalAlignment::UnnormalizedProb(j + 1, i, trg.size(), src.size(), diagonal_tension) / az;
-          probs[i] = s2t.prob(src[i-1], f_j) * prob_a_i;
-          sum += probs[i];
-        }
-        if (final_iteration) {
-          if (add_viterbi || write_alignments) {
-            WordID max_i = 0;
-            double max_p = -1;
-            int max_index = -1;
-            if (use_null) {
-              max_i = kNULL;
-              max_index = 0;
-              max_p = probs[0];
-            }
-            for (unsigned i = 1; i <= src.size(); ++i) {
-              if (probs[i] > max_p) {
-                max_index = i;
-                max_p = probs[i];
-                max_i = src[i-1];
-              }
-            }
-            if (!hide_training_alignments && write_alignments) {
-              if (max_index > 0) {
-                if (first_al) first_al = false; else cout << ' ';
-                if (reverse)
-                  cout << j << '-' << (max_index - 1);
-                else
-                  cout << (max_index - 1) << '-' << j;
-              }
-            }
-            if (s2t_viterbi.size() <= static_cast<unsigned>(max_i)) s2t_viterbi.resize(max_i + 1);
-            s2t_viterbi[max_i][f_j] = 1.0;
-          }
-        } else {
-          if (use_null) {
-            double count = probs[0] / sum;
-            c0 += count;
-            s2t.Increment(kNULL, f_j, count);
+      for (unsigned d = 0; d < models.size(); ++d) {
+        AlignmentModel& m = *models[d];
+        const vector<WordID>& s = m.reverse ? trg : src;
+        const vector<WordID>& t = m.reverse ? src : trg;
+        m.tot_len_ratio += static_cast<double>(t.size()) / static_cast<double>(s.size());
+        ++m.size_counts[make_pair<short,short>(t.size(), s.size())];
+      }
+      corpus.Add(src, trg);
+    }
+    if (flag) { cerr << endl; }
+    cerr << "Read " << corpus.size() << " sentence pairs (" << corpus.words.size() << " words)\n";
+  }
+
+  // thread 0 adds its counts to s2t itself, the others to their own tables,
+  // which are added to s2t in order once all the sentences are done (so
+  // with one thread, the sums are computed exactly as before); the corpus
+  // is processed in blocks so that the alignments of the final iteration
+  // can be written in order
+  const size_t kBlockSize = 10000;
+  vector<vector<double> > thread_probs(threads);
+  vector<map<string, boost::shared_ptr<Command> > > thread_commands(threads);
+  for (int t = 0; t < threads; ++t)
+    GetAlignmentCommands(&thread_commands[t]);
+  vector<string> alignments;
+  for (int iter = 0; iter < ITERATIONS; ++iter) {
+    const bool final_iteration = (iter == (ITERATIONS - 1));
+    cerr << "ITERATION " << (iter + 1) << (final_iteration ? " (FINAL)" : "") << endl;
+    vector<EStepConfig> configs(models.size());
+    vector<vector<EStepStats> > stats(models.size(), vector<EStepStats>(threads));
+    for (unsigned d = 0; d < models.size(); ++d) {
+      AlignmentModel& m = *models[d];
+      EStepConfig& config = configs[d];
+      config.reverse = m.reverse;
+      config.use_null = use_null;
+      config.favor_diagonal = favor_diagonal;
+      config.prob_align_null = prob_align_null;
+      config.prob_align_not_null = prob_align_not_null;
+      config.diagonal_tension = m.diagonal_tension;
+      config.kNULL = kNULL;
+      config.final_iteration = final_iteration;
+      config.add_viterbi = add_viterbi;
+      config.write_alignments = final_iteration && write_alignments && !hide_training_alignments;
+      for (int t = 0; t < threads; ++t) {
+        stats[d][t].counts = t ? m.thread_counts[t - 1].get() : &m.s2t;
+        stats[d][t].viterbi = t ? &m.thread_viterbi[t - 1] : &m.s2t_viterbi;
+      }
+    }
+    const bool write_training_alignments = configs[0].write_alignments;
+    const size_t lc = corpus.size();
+    bool flag = false;
+    for (size_t block = 0; block < lc; block += kBlockSize) {
+      const size_t block_end = min(lc, block + kBlockSize);
+      if (write_training_alignments) alignments.resize(block_end - block);
+#pragma omp parallel for schedule(static, 1) num_threads(threads)
+      for (int t = 0; t < threads; ++t) {
+        // a contiguous part of the block for each thread
+        const size_t start = block + (block_end - block) * t / threads;
+        const size_t end = block + (block_end - block) * (t + 1) / threads;
+        ostringstream os[2];  // the alignments of each direction
+        for (size_t k = start; k < end; ++k) {
+          for (unsigned d = 0; d < models.size(); ++d) {
+            const AlignmentModel& m = *models[d];
+            EStep(configs[d], m.s2t, m.src(corpus, k), m.src_len(corpus, k), m.trg(corpus, k), m.trg_len(corpus, k),
+                  &thread_probs[t], &stats[d][t], &os[d]);
           }
-          for (unsigned i = 1; i <= src.size(); ++i) {
-            const double p = probs[i] / sum;
-            s2t.Increment(src[i-1], f_j, p);
-            emp_feat += DiagonalAlignment::Feature(j, i, trg.size(), src.size()) * p;
+          if (write_training_alignments) {
+            if (bidir)
+              alignments[k - block] = Symmetrize(os[0].str(), os[1].str(), thread_commands[t][heuristic].get());
+            else
+              alignments[k - block] = os[0].str();
+            os[0].str("");
+            os[1].str("");
           }
         }
-        likelihood += log(sum);
       }
-      if (write_alignments && final_iteration && !hide_training_alignments) cout << endl;
+      if (write_training_alignments)
+        for (unsigned k = 0; k < alignments.size(); ++k)
+          cout << alignments[k] << '\n';
+      for (size_t k = block / 1000 + 1; k <= block_end / 1000; ++k) {
+        cerr << '.'; flag = true;
+        if (k % 50 == 0) { cerr << " [" << k * 1000 << "]\n" << flush; flag = false; }
+      }
     }
+    if (write_training_alignments) cout << flush;
+    if (flag) { cerr << endl; }
 
-    // log(e) = 1.0
-    double base2_likelihood = likelihood / log(2);
+    for (unsigned d = 0; d < models.size(); ++d) {
+      AlignmentModel& m = *models[d];
+      TTable& s2t = m.s2t;
+      double likelihood = stats[d][0].likelihood;
+      double c0 = stats[d][0].c0;
+      double emp_feat = stats[d][0].emp_feat;
+      double toks = stats[d][0].toks;
+      for (int t = 1; t < threads; ++t) {
+        likelihood += stats[d][t].likelihood;
+        c0 += stats[d][t].c0;
+        emp_feat += stats[d][t].emp_feat;
+        toks += stats[d][t].toks;
+        s2t += *m.thread_counts[t - 1];
+        m.thread_counts[t - 1]->counts.clear();
+        TTable::Word2Word2Double& vit = m.thread_viterbi[t - 1];
+        if (vit.size() > m.s2t_viterbi.size()) m.s2t_viterbi.resize(vit.size());
+        for (unsigned e = 0; e < vit.size(); ++e)
+          for (TTable::Word2Double::const_iterator fi = vit[e].begin(); fi != vit[e].end(); ++fi)
+            m.s2t_viterbi[e][fi->first] = 1.0;
+        vit.clear();
+      }
+      const double denom = toks;
 
-    if (flag) { cerr << endl; }
-    if (iter == 0) {
-      mean_srclen_multiplier = tot_len_ratio / lc;
-      cerr << "expected target length = source length * " << mean_srclen_multiplier << endl;
-    }
-    emp_feat /= toks;
-    cerr << "  log_e likelihood: " << likelihood << endl;
-    cerr << "  log_2 likelihood: " << base2_likelihood << endl;
-    cerr << "     cross entropy: " << (-base2_likelihood / denom) << endl;
-    cerr << "        perplexity: " << pow(2.0, -base2_likelihood / denom) << endl;
-    cerr << "      posterior p0: " << c0 / toks << endl;
-    cerr << " posterior al-feat: " << emp_feat << endl;
-    //cerr << "     model tension: " << mod_feat / toks << endl;
-    cerr << "       size counts: " << size_counts.size() << endl;
-    if (!final_iteration) {
-      if (favor_diagonal && optimize_tension && iter > 0) {
-        for (int ii = 0; ii < 8; ++ii) {
-          double mod_feat = 0;
-          unordered_map<pair<short,short>,unsigned,boost::hash<pair<short, short> > >::iterator it = size_counts.begin();
-          for(; it != size_counts.end(); ++it) {
-            const pair<short,short>& p = it->first;
-            for (short j = 1; j <= p.first; ++j)
-              mod_feat += it->second * DiagonalAlignment::ComputeDLogZ(j, p.first, p.second, diagonal_tension);
+      // log(e) = 1.0
+      double base2_likelihood = likelihood / log(2);
+
+      if (bidir) cerr << (m.reverse ? " reverse model:" : " forward model:") << endl;
+      if (iter == 0) {
+        m.mean_srclen_multiplier = m.tot_len_ratio / lc;
+        cerr << "expected target length = source length * " << m.mean_srclen_multiplier << endl;
+      }
+      emp_feat /= toks;
+      cerr << "  log_e likelihood: " << likelihood << endl;
+      cerr << "  log_2 likelihood: " << base2_likelihood << endl;
+      cerr << "     cross entropy: " << (-base2_likelihood / denom) << endl;
+      cerr << "        perplexity: " << pow(2.0, -base2_likelihood / denom) << endl;
+      cerr << "      posterior p0: " << c0 / toks << endl;
+      cerr << " posterior al-feat: " << emp_feat << endl;
+      //cerr << "     model tension: " << mod_feat / toks << endl;
+      cerr << "       size counts: " << m.size_counts.size() << endl;
+      if (!final_iteration) {
+        if (favor_diagonal && optimize_tension && iter > 0) {
+          double& diagonal_tension = m.diagonal_tension;
+          for (int ii = 0; ii < 8; ++ii) {
+            double mod_feat = 0;
+            SizeCounts::iterator it = m.size_counts.begin();
+            for(; it != m.size_counts.end(); ++it) {
+              const pair<short,short>& p = it->first;
+              for (short j = 1; j <= p.first; ++j)
+                mod_feat += it->second * DiagonalAlignment::ComputeDLogZ(j, p.first, p.second, diagonal_tension);
+            }
+            mod_feat /= toks;
+            cerr << "  " << ii + 1 << "  model al-feat: " << mod_feat << " (tension=" << diagonal_tension << ")\n";
+            diagonal_tension += (emp_feat - mod_feat) * 20.0;
+            if (diagonal_tension <= 0.1) diagonal_tension = 0.1;
+            if (diagonal_tension > 14) diagonal_tension = 14;
           }
-          mod_feat /= toks;
-          cerr << "  " << ii + 1 << "  model al-feat: " << mod_feat << " (tension=" << diagonal_tension << ")\n";
-          diagonal_tension += (emp_feat - mod_feat) * 20.0;
-          if (diagonal_tension <= 0.1) diagonal_tension = 0.1;
-          if (diagonal_tension > 14) diagonal_tension = 14;
+          cerr << "     final tension: " << diagonal_tension << endl;
         }
-        cerr << "     final tension: " << diagonal_tension << endl;
+        if (variational_bayes)
+          s2t.NormalizeVB(alpha);
+        else
+          s2t.Normalize();
       }
-      if (variational_bayes)
-        s2t.NormalizeVB(alpha);
-      else
-        s2t.Normalize();
+    }
+    if (!final_iteration) {
       //prob_align_null *= 0.8; // XXX
       //prob_align_null += (c0 / toks) * 0.2;
       prob_align_not_null = 1.0 - prob_align_null;
     }
   }
   if (testset.size()) {
+    const TTable& s2t = model.s2t;
+    const double diagonal_tension = model.diagonal_tension;
     ReadFile rf(testset);
     istream& in = *rf.stream();
     int lc = 0;
@@ -266,7 +540,7 @@ int main(int argc, char** argv) {
       CorpusTools::ReadLine(line, &src, &trg);
       cout << TD::GetString(src) << " ||| " << TD::GetString(trg) << " |||";
       if (reverse) swap(src, trg);
-      double log_prob = Md::log_poisson(trg.size(), 0.05 + src.size() * mean_srclen_multiplier);
+      double log_prob = Md::log_poisson(trg.size(), 0.05 + src.size() * model.mean_srclen_multiplier);
 
       // compute likelihood
       for (unsigned j = 0; j < trg.size(); ++j) {
@@ -308,22 +582,10 @@ int main(int argc, char** argv) {
   }
 
   if (output_parameters) {
-    WriteFile params_out(conf["output_parameters"].as<string>());
-    for (unsigned eind = 1; eind < s2t.ttable.size(); ++eind) {
-      const auto& cpd = s2t.ttable[eind];
-      const TTable::Word2Double& vit = s2t_viterbi[eind];
-      const string& esym = TD::Convert(eind);
-      double max_p = -1;
-      for (auto& fi : cpd)
-        if (fi.second > max_p) max_p = fi.second;
-      const double threshold = max_p * BEAM_THRESHOLD;
-      for (auto& fi : cpd) {
-        if (fi.second > threshold || (vit.find(fi.first) != vit.end())) {
-          *params_out << esym << ' ' << TD::Convert(fi.first) << ' ' << log(fi.second) << endl;
-        }
-      } 
-    }
+    const string binary_file = conf.count("binary_parameters") ? conf["binary_parameters"].as<string>() : "";
+    WriteParameters(&model, BEAM_THRESHOLD, conf["output_parameters"].as<string>(), binary_file);
   }
+  if (bidir && conf.count("reverse_parameters"))
+    WriteParameters(&reverse_model, BEAM_THRESHOLD, conf["reverse_parameters"].as<string>(), "");
   return 0;
 }
-
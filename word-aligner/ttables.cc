@@ -1,24 +1,127 @@
 #include "ttables.h"
 
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "dict.h"
 
 using namespace std;
 
+// Binary file layout (native byte order):
+//   uint32 magic, uint32 flags (1 = probabilities are floats),
+//   uint64 #words V, uint64 #entries N, uint64 size of the vocabulary,
+//   vocabulary: V NUL-terminated words (word i has id i), padded to 8 bytes,
+//   uint64 offsets[V + 1]: the entries of source word e are
+//     [offsets[e], offsets[e + 1]),
+//   int32 targets[N], sorted within each source word, padded to 8 bytes,
+//   double or float probabilities[N]
+static const uint32_t kMagic = 0x54544146;  // "FATT"
+static const uint32_t kSinglePrecision = 1;
+static const size_t kHeaderSize = 2 * sizeof(uint32_t) + 3 * sizeof(uint64_t);
+
+static inline size_t Pad8(size_t n) { return (n + 7) & ~static_cast<size_t>(7); }
+
+TTable::TTable() :
+    single_precision_(false),
+    num_rows_(),
+    offsets_(),
+    targets_(),
+    dprobs_(),
+    fprobs_(),
+    map_(),
+    map_size_() {}
+
+TTable::~TTable() {
+  Unmap();
+}
+
+void TTable::Unmap() {
+  if (map_) munmap(const_cast<char*>(map_), map_size_);
+  map_ = NULL;
+  map_size_ = 0;
+  word_map_.clear();
+  file_words_.clear();
+}
+
+void TTable::UseVectors() {
+  offsets_ = offsets_vec_.data();
+  targets_ = targets_vec_.data();
+  dprobs_ = single_precision_ ? NULL : dprobs_vec_.data();
+  fprobs_ = single_precision_ ? fprobs_vec_.data() : NULL;
+}
+
+void TTable::Build(const Word2Word2Double& t) {
+  Unmap();
+  offsets_vec_.assign(1, 0);
+  targets_vec_.clear();
+  dprobs_vec_.clear();
+  fprobs_vec_.clear();
+  vector<pair<WordID, double> > row;
+  for (unsigned e = 0; e < t.size(); ++e) {
+    row.assign(t[e].begin(), t[e].end());
+    sort(row.begin(), row.end());
+    for (unsigned k = 0; k < row.size(); ++k) {
+      targets_vec_.push_back(row[k].first);
+      if (single_precision_)
+        fprobs_vec_.push_back(row[k].second);
+      else
+        dprobs_vec_.push_back(row[k].second);
+    }
+    offsets_vec_.push_back(targets_vec_.size());
+  }
+  num_rows_ = t.size();
+  UseVectors();
+}
+
+void TTable::NormalizeVB(const double alpha) {
+  for (unsigned i = 0; i < counts.size(); ++i) {
+    double tot = 0;
+    Word2Double& cpd = counts[i];
+    for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
+      tot += it->second + alpha;
+    if (!tot) tot = 1;
+    for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
+      it->second = exp(Md::digamma(it->second + alpha) - Md::digamma(tot));
+  }
+  Build(counts);
+  counts.clear();
+}
+
+void TTable::Normalize() {
+  for (unsigned i = 0; i < counts.size(); ++i) {
+    double tot = 0;
+    Word2Double& cpd = counts[i];
+    for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
+      tot += it->second;
+    if (!tot) tot = 1;
+    for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
+      it->second /= tot;
+  }
+  Build(counts);
+  counts.clear();
+}
+
 void TTable::DeserializeProbsFromText(std::istream* in) {
   int c = 0;
   string e;
   string f;
   double p;
+  Word2Word2Double t;
   while(*in) {
     (*in) >> e >> f >> p;
     if (e.empty()) break;
     ++c;
     WordID ie = TD::Convert(e);
-    if (ie >= static_cast<int>(ttable.size())) ttable.resize(ie + 1);
-    ttable[ie][TD::Convert(f)] = p;
+    if (ie >= static_cast<int>(t.size())) t.resize(ie + 1);
+    t[ie][TD::Convert(f)] = p;
   }
+  Build(t);
   cerr << "Loaded " << c << " translation parameters.\n";
 }
 
@@ -27,17 +130,167 @@ void TTable::DeserializeLogProbsFromText(std::istream* in) {
   string e;
   string f;
   double p;
+  Word2Word2Double t;
   while(*in) {
     (*in) >> e >> f >> p;
     if (e.empty()) break;
     ++c;
     WordID ie = TD::Convert(e);
-    if (ie >= static_cast<int>(ttable.size())) ttable.resize(ie + 1);
-    ttable[ie][TD::Convert(f)] = exp(p);
+    if (ie >= static_cast<int>(t.size())) t.resize(ie + 1);
+    t[ie][TD::Convert(f)] = exp(p);
   }
+  Build(t);
   cerr << "Loaded " << c << " translation parameters.\n";
 }
 
+void TTable::WriteBinary(const string& file) const {
+  WriteBinary(file, KeepAll());
+}
+
+void TTable::WriteBinaryImpl(const string& file,
+                             const vector<vector<pair<WordID, double> > >& rows) const {
+  // the words of the file are the sources and targets, in the order of
+  // their TD ids
+  vector<WordID> words;
+  for (unsigned e = 0; e < rows.size(); ++e) {
+    if (rows[e].empty()) continue;
+    words.push_back(e);
+    for (unsigned k = 0; k < rows[e].size(); ++k)
+      words.push_back(rows[e][k].first);
+  }
+  sort(words.begin(), words.end());
+  words.erase(unique(words.begin(), words.end()), words.end());
+  vector<WordID> ids(words.empty() ? 0 : words.back() + 1, -1);
+  for (unsigned i = 0; i < words.size(); ++i)
+    ids[words[i]] = i;
+
+  string vocab;
+  for (unsigned i = 0; i < words.size(); ++i) {
+    vocab += TD::Convert(words[i]);
+    vocab += '\0';
+  }
+  vocab.resize(Pad8(vocab.size()), '\0');
+  vector<uint64_t> offsets(1, 0);
+  vector<int32_t> targets;
+  vector<double> dprobs;
+  vector<float> fprobs;
+  vector<pair<WordID, double> > row;
+  for (unsigned i = 0; i < words.size(); ++i) {
+    const WordID e = words[i];
+    if (e < static_cast<int>(rows.size())) {
+      row = rows[e];
+      for (unsigned k = 0; k < row.size(); ++k)
+        row[k].first = ids[row[k].first];
+      sort(row.begin(), row.end());
+      for (unsigned k = 0; k < row.size(); ++k) {
+        targets.push_back(row[k].first);
+        if (single_precision_)
+          fprobs.push_back(row[k].second);
+        else
+          dprobs.push_back(row[k].second);
+      }
+    }
+    offsets.push_back(targets.size());
+  }
+  if (targets.size() % 2) targets.push_back(0);  // padding
+
+  ofstream out(file.c_str(), ios::binary);
+  if (!out) {
+    cerr << "Can't write " << file << endl;
+    exit(1);
+  }
+  const uint32_t magic = kMagic;
+  const uint32_t flags = single_precision_ ? kSinglePrecision : 0;
+  const uint64_t num_words = words.size();
+  const uint64_t num_entries = offsets.back();
+  const uint64_t vocab_size = vocab.size();
+  out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+  out.write(reinterpret_cast<const char*>(&flags), sizeof(flags));
+  out.write(reinterpret_cast<const char*>(&num_words), sizeof(num_words));
+  out.write(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
+  out.write(reinterpret_cast<const char*>(&vocab_size), sizeof(vocab_size));
+  out.write(vocab.data(), vocab.size());
+  out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+  out.write(reinterpret_cast<const char*>(targets.data()), targets.size() * sizeof(int32_t));
+  if (single_precision_)
+    out.write(reinterpret_cast<const char*>(fprobs.data()), fprobs.size() * sizeof(float));
+  else
+    out.write(reinterpret_cast<const char*>(dprobs.data()), dprobs.size() * sizeof(double));
+  if (!out) {
+    cerr << "Error writing " << file << endl;
+    exit(1);
+  }
+  cerr << "Wrote " << num_entries << " translation parameters to " << file << endl;
+}
+
+bool TTable::IsBinaryFile(const string& file) {
+  ifstream in(file.c_str(), ios::binary);
+  uint32_t magic = 0;
+  in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  return in && magic == kMagic;
+}
+
+void TTable::ReadBinary(const string& file) {
+  Unmap();
+  const int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    cerr << "Can't open " << file << endl;
+    exit(1);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    cerr << "Can't stat " << file << endl;
+    exit(1);
+  }
+  map_size_ = st.st_size;
+  void* m = map_size_ ? mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (m == MAP_FAILED) {
+    cerr << "Can't map " << file << endl;
+    exit(1);
+  }
+  map_ = static_cast<const char*>(m);
+
+  uint32_t magic = 0, flags = 0;
+  uint64_t num_words = 0, num_entries = 0, vocab_size = 0;
+  if (map_size_ >= kHeaderSize) {
+    memcpy(&magic, map_, sizeof(magic));
+    memcpy(&flags, map_ + 4, sizeof(flags));
+    memcpy(&num_words, map_ + 8, sizeof(num_words));
+    memcpy(&num_entries, map_ + 16, sizeof(num_entries));
+    memcpy(&vocab_size, map_ + 24, sizeof(vocab_size));
+  }
+  const size_t prob_size = (flags & kSinglePrecision) ? sizeof(float) : sizeof(double);
+  const size_t offsets_pos = kHeaderSize + vocab_size;
+  const size_t targets_pos = offsets_pos + (num_words + 1) * sizeof(uint64_t);
+  const size_t probs_pos = targets_pos + Pad8(num_entries * sizeof(int32_t));
+  if (magic != kMagic || map_size_ < probs_pos + num_entries * prob_size) {
+    cerr << file << " is not a translation table written by WriteBinary\n";
+    exit(1);
+  }
+  single_precision_ = flags & kSinglePrecision;
+  num_rows_ = num_words;
+  offsets_ = reinterpret_cast<const uint64_t*>(map_ + offsets_pos);
+  targets_ = reinterpret_cast<const WordID*>(map_ + targets_pos);
+  dprobs_ = single_precision_ ? NULL : reinterpret_cast<const double*>(map_ + probs_pos);
+  fprobs_ = single_precision_ ? reinterpret_cast<const float*>(map_ + probs_pos) : NULL;
+
+  file_words_.resize(num_words);
+  const char* p = map_ + kHeaderSize;
+  for (unsigned i = 0; i < num_words; ++i) {
+    file_words_[i] = TD::Convert(p);
+    p += strlen(p) + 1;
+  }
+  word_map_.assign(TD::NumWords() + 1, -1);
+  for (unsigned i = 0; i < num_words; ++i)
+    word_map_[file_words_[i]] = i;
+  offsets_vec_.clear();
+  targets_vec_.clear();
+  dprobs_vec_.clear();
+  fprobs_vec_.clear();
+  cerr << "Mapped " << num_entries << " translation parameters from " << file << endl;
+}
+
 void TTable::SerializeHelper(string* out, const Word2Word2Double& o) {
   assert(!"not implemented");
 }
@@ -45,4 +298,3 @@ void TTable::SerializeHelper(string* out, const Word2Word2Double& o) {
 void TTable::DeserializeHelper(const string& in, Word2Word2Double* o) {
   assert(!"not implemented");
 }
-
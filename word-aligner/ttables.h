@@ -1,8 +1,11 @@
 #ifndef _TTABLES_H_
 #define _TTABLES_H_
 
+#include <algorithm>
 #include <iostream>
+#include <string>
 #include <vector>
+#include <stdint.h>
 #ifndef HAVE_OLD_CPP
 # include <unordered_map>
 #else
@@ -15,78 +18,80 @@ namespace std { using std::tr1::unordered_map; }
 #include "wordid.h"
 #include "tdict.h"
 
+// The translation probabilities p(f|e) are stored flat: the targets f of
+// each source e are a sorted array, and prob() is a binary search in it.
+// The expected counts are accumulated in hash maps (counts) and turned into
+// the flat table by Normalize() or NormalizeVB().
+//
+// The table can be written to a binary file that ReadBinary() maps into
+// memory, so that it can be used without parsing (e.g. by --force_align).
+// Such a file has its own word ids, and prob() maps the ids of TD to them.
 class TTable {
  public:
-  TTable() {}
+  TTable();
+  ~TTable();
   typedef std::unordered_map<WordID, double> Word2Double;
   typedef std::vector<Word2Double> Word2Word2Double;
-  inline double prob(const int& e, const int& f) const {
-    if (e < static_cast<int>(ttable.size())) {
-      const Word2Double& cpd = ttable[e];
-      const Word2Double::const_iterator it = cpd.find(f);
-      if (it == cpd.end()) return 1e-9;
-      return it->second;
-    } else {
-      return 1e-9;
+  inline double prob(int e, int f) const {
+    if (!word_map_.empty()) {
+      e = MapWord(e);
+      f = MapWord(f);
     }
+    if (e < 0 || e >= static_cast<int>(num_rows_)) return 1e-9;
+    const WordID* begin = targets_ + offsets_[e];
+    const WordID* end = targets_ + offsets_[e + 1];
+    const WordID* it = std::lower_bound(begin, end, f);
+    if (it == end || *it != f) return 1e-9;
+    return value(it - targets_);
   }
   inline void Increment(const int& e, const int& f) {
-    if (e >= static_cast<int>(ttable.size())) counts.resize(e + 1);
+    if (e >= static_cast<int>(counts.size())) counts.resize(e + 1);
     counts[e][f] += 1.0;
   }
   inline void Increment(const int& e, const int& f, double x) {
     if (e >= static_cast<int>(counts.size())) counts.resize(e + 1);
     counts[e][f] += x;
   }
-  void NormalizeVB(const double alpha) {
-    ttable.swap(counts);
-    for (unsigned i = 0; i < ttable.size(); ++i) {
-      double tot = 0;
-      Word2Double& cpd = ttable[i];
-      for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
-        tot += it->second + alpha;
-      if (!tot) tot = 1;
-      for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
-        it->second = exp(Md::digamma(it->second + alpha) - Md::digamma(tot));
-    }
-    counts.clear();
-  }
-  void Normalize() {
-    ttable.swap(counts);
-    for (unsigned i = 0; i < ttable.size(); ++i) {
-      double tot = 0;
-      Word2Double& cpd = ttable[i];
-      for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
-        tot += it->second;
-      if (!tot) tot = 1;
-      for (Word2Double::iterator it = cpd.begin(); it != cpd.end(); ++it)
-        it->second /= tot;
-    }
-    counts.clear();
-  }
+  // the probabilities are stored as floats (from the next Normalize, or
+  // DeserializeProbsFromText)
+  void SetSinglePrecision(bool single) { single_precision_ = single; }
+  void NormalizeVB(const double alpha);
+  void Normalize();
   // adds counts from another TTable - probabilities remain unchanged
   TTable& operator+=(const TTable& rhs) {
     if (rhs.counts.size() > counts.size()) counts.resize(rhs.counts.size());
     for (unsigned i = 0; i < rhs.counts.size(); ++i) {
       const Word2Double& cpd = rhs.counts[i];
       Word2Double& tgt = counts[i];
-      for (auto p : cpd) tgt[p.first] += p.second;
+      for (Word2Double::const_iterator it = cpd.begin(); it != cpd.end(); ++it)
+        tgt[it->first] += it->second;
     }
     return *this;
   }
+
+  // the entries of the flat table: the targets of source e are
+  // target(k) for k in [row_begin(e), row_end(e)), with probability value(k);
+  // e and the targets are ids of the table (see word())
+  size_t num_rows() const { return num_rows_; }
+  size_t row_begin(WordID e) const { return offsets_[e]; }
+  size_t row_end(WordID e) const { return offsets_[e + 1]; }
+  WordID target(size_t k) const { return targets_[k]; }
+  double value(size_t k) const { return fprobs_ ? fprobs_[k] : dprobs_[k]; }
+  // the TD id of a word id of the table
+  WordID word(WordID id) const { return file_words_.empty() ? id : file_words_[id]; }
+
   void ShowTTable() const {
-    for (unsigned it = 0; it < ttable.size(); ++it) {
-      const Word2Double& cpd = ttable[it];
-      for (auto& p : cpd) {
-        std::cerr << "c(" << TD::Convert(p.first) << '|' << TD::Convert(it) << ") = " << p.second << std::endl;
+    for (unsigned e = 0; e < num_rows_; ++e) {
+      for (size_t k = row_begin(e); k < row_end(e); ++k) {
+        std::cerr << "c(" << TD::Convert(word(target(k))) << '|' << TD::Convert(word(e)) << ") = " << value(k) << std::endl;
       }
     }
   }
   void ShowCounts() const {
     for (unsigned it = 0; it < counts.size(); ++it) {
       const Word2Double& cpd = counts[it];
-      for (auto& p : cpd) {
-        std::cerr << "c(" << TD::Convert(p.first) << '|' << TD::Convert(it) << ") = " << p.second << std::endl;
+      for (Word2Double::const_iterator p = cpd.begin(); p != cpd.end(); ++p) {
+        std::cerr << "c(" << TD::Convert(p->first) << '|' << TD::Convert(it) << ") = " << p->second << std::endl;
       }
     }
   }
@@ -94,14 +99,67 @@ class TTable {
   void DeserializeLogProbsFromText(std::istream* in);
   void SerializeCounts(std::string* out) const { SerializeHelper(out, counts); }
   void DeserializeCounts(const std::string& in) { DeserializeHelper(in, &counts); }
-  void SerializeProbs(std::string* out) const { SerializeHelper(out, ttable); }
-  void DeserializeProbs(const std::string& in) { DeserializeHelper(in, &ttable); }
+
+  // the table in binary form; if keep is given, only the entries for which
+  // keep(e, f, p) is true (e and f are TD ids)
+  void WriteBinary(const std::string& file) const;
+  template <class Pred> void WriteBinary(const std::string& file, const Pred& keep) const;
+  // maps a file written by WriteBinary into memory
+  void ReadBinary(const std::string& file);
+  // whether file was written by WriteBinary
+  static bool IsBinaryFile(const std::string& file);
+
  private:
+  TTable(const TTable&);
+  const TTable& operator=(const TTable&);
+  struct KeepAll {
+    bool operator()(WordID, WordID, double) const { return true; }
+  };
   static void SerializeHelper(std::string*, const Word2Word2Double& o);
   static void DeserializeHelper(const std::string&, Word2Word2Double* o);
+  // replaces the flat table by the entries of t (e and f are TD ids)
+  void Build(const Word2Word2Double& t);
+  void Unmap();
+  void UseVectors();
+  inline WordID MapWord(WordID w) const {
+    return w < static_cast<WordID>(word_map_.size()) ? word_map_[w] : -1;
+  }
+  void WriteBinaryImpl(const std::string& file,
+                       const std::vector<std::vector<std::pair<WordID, double> > >& rows) const;
+
+  bool single_precision_;
+  // the flat table, which points into the vectors or into the mapped file
+  size_t num_rows_;
+  const uint64_t* offsets_;
+  const WordID* targets_;
+  const double* dprobs_;  // one of dprobs_ and fprobs_ is NULL
+  const float* fprobs_;
+  std::vector<uint64_t> offsets_vec_;
+  std::vector<WordID> targets_vec_;
+  std::vector<double> dprobs_vec_;
+  std::vector<float> fprobs_vec_;
+  // for a mapped file
+  const char* map_;
+  size_t map_size_;
+  std::vector<WordID> word_map_;    // TD id -> id in the file (-1 if none)
+  std::vector<WordID> file_words_;  // id in the file -> TD id
  public:
-  Word2Word2Double ttable;
   Word2Word2Double counts;
 };
 
+template <class Pred>
+void TTable::WriteBinary(const std::string& file, const Pred& keep) const {
+  std::vector<std::vector<std::pair<WordID, double> > > rows;
+  for (unsigned e = 0; e < num_rows_; ++e) {
+    const WordID we = word(e);
+    for (size_t k = row_begin(e); k < row_end(e); ++k) {
+      const WordID wf = word(target(k));
+      if (!keep(we, wf, value(k))) continue;
+      if (static_cast<int>(rows.size()) <= we) rows.resize(we + 1);
+      rows[we].push_back(std::make_pair(wf, value(k)));
+    }
+  }
+  WriteBinaryImpl(file, rows);
+}
+
 #endif
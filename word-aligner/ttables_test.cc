@@ -0,0 +1,89 @@
+#define BOOST_TEST_MODULE TTablesTest
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ttables.h"
+#include "tdict.h"
+
+using namespace std;
+
+// a text table as written by fast_align: source, target, log probability
+static const char* kTextTable =
+  "<eps> la -2.3025850929940455\n"
+  "<eps> casa -4.6051701859880909\n"
+  "the la -0.10536051565782628\n"
+  "the el -2.5257286443082556\n"
+  "house casa -0.051293294387550578\n"
+  "house la -3.912023005428146\n"
+  "green verde -0.01005033585350145\n"
+  "green casa -4.6151205168412597\n";
+
+struct TTablesTest {
+  TTablesTest() : file("ttables_test.bin") {
+    istringstream in(kTextTable);
+    string e, f;
+    double p;
+    while (in >> e >> f >> p) {
+      sources.push_back(TD::Convert(e));
+      targets.push_back(TD::Convert(f));
+      log_probs.push_back(p);
+    }
+  }
+  ~TTablesTest() { remove(file.c_str()); }
+
+  void ReadText(bool single_precision, TTable* t) const {
+    t->SetSinglePrecision(single_precision);
+    istringstream in(kTextTable);
+    t->DeserializeLogProbsFromText(&in);
+  }
+
+  // the probabilities of the mapped table are those of the text table, and
+  // pairs that are not in the table get the same floor
+  void CheckRoundTrip(bool single_precision) const {
+    TTable text;
+    ReadText(single_precision, &text);
+    text.WriteBinary(file);
+    BOOST_REQUIRE(TTable::IsBinaryFile(file));
+    TTable binary;
+    binary.ReadBinary(file);
+    for (unsigned i = 0; i < sources.size(); ++i) {
+      const double expected = single_precision ? static_cast<float>(exp(log_probs[i])) : exp(log_probs[i]);
+      BOOST_CHECK_EQUAL(text.prob(sources[i], targets[i]), expected);
+      BOOST_CHECK_EQUAL(binary.prob(sources[i], targets[i]), expected);
+    }
+    for (unsigned i = 0; i < sources.size(); ++i)
+      for (unsigned j = 0; j < targets.size(); ++j)
+        BOOST_CHECK_EQUAL(binary.prob(sources[i], targets[j]), text.prob(sources[i], targets[j]));
+    const WordID unseen = TD::Convert("ttables_test_unseen_word");
+    BOOST_CHECK_EQUAL(binary.prob(unseen, targets[0]), text.prob(unseen, targets[0]));
+    BOOST_CHECK_EQUAL(binary.prob(sources[0], unseen), text.prob(sources[0], unseen));
+  }
+
+  const string file;
+  vector<WordID> sources;
+  vector<WordID> targets;
+  vector<double> log_probs;
+};
+
+BOOST_FIXTURE_TEST_CASE(TestBinaryRoundTrip, TTablesTest) {
+  CheckRoundTrip(false);
+}
+
+BOOST_FIXTURE_TEST_CASE(TestSinglePrecisionRoundTrip, TTablesTest) {
+  CheckRoundTrip(true);
+}
+
+BOOST_FIXTURE_TEST_CASE(TestTextFileIsNotBinary, TTablesTest) {
+  {
+    FILE* f = fopen(file.c_str(), "w");
+    BOOST_REQUIRE(f);
+    fputs(kTextTable, f);
+    fclose(f);
+  }
+  BOOST_CHECK(!TTable::IsBinaryFile(file));
+}